@@ -0,0 +1,112 @@
+/** Edit distance using the bit-parallel algorithm of Myers (1999),
+ * with the extension to multiple words and global alignment by
+ * Hyyrö (2003). Each column of the dynamic-programming matrix is
+ * represented by bit vectors of its vertical deltas, 64 rows per word,
+ * so that the distance is computed in O(nm/64) time and O(n) space.
+ */
+
+#include "editDistance.h"
+#include "Sequence.h"
+#include <algorithm>
+#include <cassert>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+typedef uint64_t Word;
+
+/** The number of bits in a word. */
+static const unsigned WORD_SIZE = 64;
+
+/** Return whether the bases a and b match. */
+static bool isMatch(char a, char b)
+{
+	if (a == b)
+		return true;
+	char c = ambiguityOr(a, b);
+	return c == a || c == b;
+}
+
+/** Advance one block of 64 rows by one column.
+ * @param pv the positive vertical deltas, which are updated
+ * @param mv the negative vertical deltas, which are updated
+ * @param eq the rows of the pattern that match the text character
+ * @param hin the horizontal delta entering the top of the block
+ * @param bit the row of the block whose horizontal delta is returned
+ * @return the horizontal delta leaving the specified row
+ */
+static inline int advanceBlock(Word& pv, Word& mv, Word eq, int hin,
+		unsigned bit)
+{
+	Word xv = eq | mv;
+	if (hin < 0)
+		eq |= 1;
+	Word xh = (((eq & pv) + pv) ^ pv) | eq;
+	Word ph = mv | ~(xh | pv);
+	Word mh = pv & xh;
+
+	int hout = (int)((ph >> bit) & 1) - (int)((mh >> bit) & 1);
+
+	ph <<= 1;
+	mh <<= 1;
+	if (hin < 0)
+		mh |= 1;
+	else if (hin > 0)
+		ph |= 1;
+	pv = mh | ~(xv | ph);
+	mv = ph & xv;
+	return hout;
+}
+
+unsigned editDistance(const string& a, const string& b,
+		unsigned maxDistance)
+{
+	// The shorter sequence is the pattern, whose rows are packed
+	// into words. The longer sequence is the text.
+	const string& pattern = a.size() <= b.size() ? a : b;
+	const string& text = a.size() <= b.size() ? b : a;
+	size_t n = pattern.size(), m = text.size();
+	if (n == 0 || m - n > maxDistance)
+		return m - n;
+
+	// The match vector of each distinct character of the text.
+	size_t numBlocks = (n + WORD_SIZE - 1) / WORD_SIZE;
+	vector<int> peqIndex(256, -1);
+	vector<Word> peq;
+	for (size_t j = 0; j < m; ++j) {
+		unsigned char c = text[j];
+		if (peqIndex[c] >= 0)
+			continue;
+		peqIndex[c] = peq.size() / numBlocks;
+		peq.resize(peq.size() + numBlocks);
+		Word* eq = &peq[peq.size() - numBlocks];
+		for (size_t i = 0; i < n; ++i)
+			if (isMatch(pattern[i], c))
+				eq[i / WORD_SIZE] |= (Word)1 << (i % WORD_SIZE);
+	}
+
+	// The first column is D[i][0] = i, and the first row is
+	// D[0][j] = j.
+	vector<Word> pv(numBlocks, ~(Word)0), mv(numBlocks, 0);
+	unsigned lastBit = (n - 1) % WORD_SIZE;
+	size_t score = n;
+	for (size_t j = 0; j < m; ++j) {
+		const Word* eq = &peq[peqIndex[(unsigned char)text[j]]
+			* numBlocks];
+		int carry = 1;
+		for (size_t k = 0; k + 1 < numBlocks; ++k)
+			carry = advanceBlock(pv[k], mv[k], eq[k], carry,
+					WORD_SIZE - 1);
+		carry = advanceBlock(pv[numBlocks - 1], mv[numBlocks - 1],
+				eq[numBlocks - 1], carry, lastBit);
+		score += carry;
+
+		// The score of the last row decreases by at most one per
+		// column.
+		size_t remaining = m - j - 1;
+		if (score > maxDistance + remaining)
+			return score - remaining;
+	}
+	return score;
+}
@@ -0,0 +1,18 @@
+#ifndef EDITDISTANCE_H
+#define EDITDISTANCE_H 1
+
+#include <climits>
+#include <string>
+
+/** Return the edit distance of the global alignment of a and b.
+ * Two bases match when they are equal or one ambiguity code is a
+ * subset of the other, as in alignGlobal.
+ * @param maxDistance stop early when the distance is known to be
+ * greater than maxDistance
+ * @return the edit distance, or when it is greater than maxDistance,
+ * a lower bound of the edit distance that is greater than maxDistance
+ */
+unsigned editDistance(const std::string& a, const std::string& b,
+		unsigned maxDistance = UINT_MAX);
+
+#endif
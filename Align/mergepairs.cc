@@ -15,6 +15,9 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -50,6 +53,7 @@ static const char USAGE_MESSAGE[] =
 "                          default for FASTQ and SAM files\n"
 "      --illumina-quality  zero quality is `@' (64)\n"
 "                          default for qseq and export files\n"
+"  -j, --threads=N         use N parallel threads [1]\n"
 "  -v, --verbose           display verbose output\n"
 "      --help              display this help and exit\n"
 "      --version           output version information and exit\n"
@@ -66,8 +70,14 @@ namespace opt {
 
 	/** Max length of read 2. */
 	static int max_len_2 = 0;
+
+	/** Number of threads. */
+	static int threads = 1;
 }
 
+/** The number of read pairs merged in parallel at a time. */
+static const size_t BATCH_SIZE = 4096;
+
 static struct {
 	unsigned total_reads;
 	unsigned merged_reads;
@@ -80,7 +90,7 @@ static struct {
 	unsigned pid_low;
 } stats;
 
-static const char shortopts[] = "o:p:m:q:1:2:v";
+static const char shortopts[] = "o:p:m:q:1:2:j:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -88,6 +98,7 @@ static const struct option longopts[] = {
 	{ "prefix",           required_argument, NULL, 'o' },
 	{ "identity",         required_argument, NULL, 'p' },
 	{ "matches",          required_argument, NULL, 'm' },
+	{ "threads",          required_argument, NULL, 'j' },
 	{ "verbose",          no_argument,       NULL, 'v' },
 	{ "length1",          no_argument,       NULL, '1' },
 	{ "length2",          no_argument,       NULL, '2' },
@@ -164,13 +175,20 @@ bool isGapless(overlap_align& o, Sequence& s) {
 		o.length() == o.overlap_h_pos + 1;
 }
 
-static void filterAlignments(vector<overlap_align>& overlaps,
+/** The outcome of aligning a read pair. */
+enum Outcome {
+	MERGED, NO_ALIGNMENT, LOW_MATCHES, PID_LOW, HAS_INDEL,
+	TOO_MANY_ALIGNS
+};
+
+/** Remove the alignments that do not pass the filters.
+ * @return the reason that no alignment passed, or MERGED if any did
+ */
+static Outcome filterAlignments(vector<overlap_align>& overlaps,
 		FastaRecord& rec)
 {
-	if (overlaps.empty()) {
-		stats.no_alignment++;
-		return;
-	}
+	if (overlaps.empty())
+		return NO_ALIGNMENT;
 
 	vector<overlap_align>::iterator it;
 	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
@@ -178,33 +196,54 @@ static void filterAlignments(vector<overlap_align>& overlaps,
 		if (o.overlap_match < opt::min_matches)
 			overlaps.erase(it--);
 	}
-	if (overlaps.empty()) {
-		stats.low_matches++;
-		return;
-	}
+	if (overlaps.empty())
+		return LOW_MATCHES;
 
 	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
 		overlap_align o = *it;
 		if (o.pid() < opt::identity)
 			overlaps.erase(it--);
 	}
-	if (overlaps.empty()) {
-		stats.pid_low++;
-		return;
-	}
+	if (overlaps.empty())
+		return PID_LOW;
 
 	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
 		overlap_align o = *it;
 		if (!isGapless(o, rec.seq))
 			overlaps.erase(it--);
 	}
-	if (overlaps.empty()) {
-		stats.has_indel++;
-		return;
+	if (overlaps.empty())
+		return HAS_INDEL;
+	return overlaps.size() == 1 ? MERGED : TOO_MANY_ALIGNS;
+}
+
+/** A read pair and the result of merging it. */
+struct ReadPair {
+	FastqRecord rec1, rec2;
+	Outcome outcome;
+	/** The merged read. */
+	FastqRecord merged;
+	/** The length of the overlap and its number of matches. */
+	unsigned length, matches;
+};
+
+/** Align a read pair and merge it if it has one good alignment. */
+static void mergePair(ReadPair& pair)
+{
+	vector<overlap_align> overlaps;
+	alignOverlap(pair.rec1.seq, reverseComplement(pair.rec2.seq), 0,
+			overlaps, true, opt::verbose > 2);
+
+	pair.outcome = filterAlignments(overlaps, pair.rec1);
+	if (pair.outcome == MERGED) {
+		mergeReads(overlaps[0], pair.rec1, pair.rec2, pair.merged);
+		pair.length = overlaps[0].length();
+		pair.matches = overlaps[0].overlap_match;
 	}
 }
 
-/** Align read pairs. */
+/** Align read pairs. The pairs are read and written in batches, and
+ * the pairs of a batch are merged in parallel. */
 static void alignFiles(const char* reads1, const char* reads2)
 {
 	if (opt::verbose > 0)
@@ -223,39 +262,48 @@ static void alignFiles(const char* reads1, const char* reads2)
 	name.append("_merged.fastq");
 	ofstream merged(name.c_str());
 
-	FastqRecord rec1, rec2;
+	vector<ReadPair> batch(BATCH_SIZE);
 	int x = 0;
-	while (r1 >> rec1 && r2 >> rec2) {
-		stats.total_reads++;
-		string rc_qual2(rec2.qual);
-		reverse(rc_qual2.begin(), rc_qual2.end());
-		vector<overlap_align> overlaps;
-		alignOverlap(rec1.seq, reverseComplement(rec2.seq), 0, overlaps,
-				true, opt::verbose > 2);
-
-		filterAlignments(overlaps, rec1);
-
-		if (overlaps.size() == 1) {
-			// If there is only one good alignment, merge reads and
-			// print to merged file
-			stats.merged_reads++;
-			FastqRecord out;
-			mergeReads(overlaps[0], rec1, rec2, out);
-			merged << out;
-			cout << overlaps[0].length() << ' ' <<
-				overlaps[0].overlap_match << '\n';
-		} else {
-			// print reads to separate files
-			if (overlaps.size() > 1)
-				stats.too_many_aligns++;
-			stats.unmerged_reads++;
-			unmerged1 << rec1;
-			unmerged2 << rec2;
-		}
-		if (opt::verbose > 0 && ++x % 10000 == 0) {
-			cerr << "Aligned " << x << " reads.\n";
+	for (bool good = true; good;) {
+		size_t n = 0;
+		while (n < batch.size()
+				&& (good = r1 >> batch[n].rec1 && r2 >> batch[n].rec2))
+			n++;
+
+#pragma omp parallel for schedule(dynamic)
+		for (size_t i = 0; i < n; i++)
+			mergePair(batch[i]);
+
+		// Write the batch in the order of the input.
+		for (size_t i = 0; i < n; i++) {
+			ReadPair& pair = batch[i];
+			stats.total_reads++;
+			switch (pair.outcome) {
+			  case MERGED:
+				// If there is only one good alignment, merge reads and
+				// print to merged file
+				stats.merged_reads++;
+				merged << pair.merged;
+				cout << pair.length << ' ' << pair.matches << '\n';
+				break;
+			  case NO_ALIGNMENT: stats.no_alignment++; break;
+			  case LOW_MATCHES: stats.low_matches++; break;
+			  case PID_LOW: stats.pid_low++; break;
+			  case HAS_INDEL: stats.has_indel++; break;
+			  case TOO_MANY_ALIGNS: stats.too_many_aligns++; break;
+			}
+			if (pair.outcome != MERGED) {
+				// print reads to separate files
+				stats.unmerged_reads++;
+				unmerged1 << pair.rec1;
+				unmerged2 << pair.rec2;
+			}
+			if (opt::verbose > 0 && ++x % 10000 == 0) {
+				cerr << "Aligned " << x << " reads.\n";
+			}
 		}
 	}
+	FastqRecord rec2;
 	r2 >> rec2;
 	stats.unchaste_reads = r1.unchaste();
 	stats.total_reads += r1.unchaste();
@@ -287,6 +335,7 @@ int main(int argc, char** argv)
 			case 'q': arg >> opt::qualityThreshold; break;
 			case '1': arg >> opt::max_len_1; break;
 			case '2': arg >> opt::max_len_2; break;
+			case 'j': arg >> opt::threads; break;
 			case 'v': opt::verbose++; break;
 			case OPT_HELP:
 					  cout << USAGE_MESSAGE;
@@ -318,6 +367,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	const char* reads1 = argv[optind++];
 	const char* reads2 = argv[optind++];
 
@@ -11,8 +11,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
-#include <cfloat> // for DBL_MAX
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <stdint.h>
 
 using namespace std;
 
@@ -79,27 +81,246 @@ static bool isMatch(char a, char b, char& c)
 	return true;
 }
 
-/** Return the score of the alignment of a and b. */
-static int matchScore(const char a, const char b)
+
+/** The predecessor of a cell of the dynamic programming matrix. */
+enum Direction { DIAG = 0, UP = 1, LEFT = 2, NONE = 3 };
+
+/** The score of a cell that is not pinned at the start of seq_b.
+ * Every valid score is greater than INVALID / 2.
+ */
+static const int32_t INVALID = INT32_MIN / 2;
+
+/** Return a mask of the lanes of a and b for which a > b. */
+static inline int32_t gt(int32_t a, int32_t b)
+{
+	return -(int32_t)(a > b);
+}
+
+/** Return a mask of the lanes of a and b for which a == b. */
+static inline int32_t eq(int32_t a, int32_t b)
+{
+	return -(int32_t)(a == b);
+}
+
+#if __GNUC__
+/** Four 32-bit lanes, which the compiler maps to a SIMD register. */
+typedef int32_t v4si __attribute__((vector_size(16)));
+
+static inline v4si gt(v4si a, v4si b) { return a > b; }
+static inline v4si eq(v4si a, v4si b) { return a == b; }
+
+static inline v4si load(const int32_t* p)
+{
+	v4si x;
+	memcpy(&x, p, sizeof x);
+	return x;
+}
+
+static inline void store(int32_t* p, v4si x)
+{
+	memcpy(p, &x, sizeof x);
+}
+#endif
+
+/** Return the lanes of a where mask is set and of b elsewhere. */
+template <typename V>
+static inline V select(V mask, V a, V b)
+{
+	return (a & mask) | (b & ~mask);
+}
+
+/** The scoring parameters broadcast to every lane. */
+template <typename V>
+struct LaneScores {
+	V match, mismatch, open, extend, invalid, threshold;
+	V zero, diag, up, left;
+
+	LaneScores()
+	{
+		zero = V();
+		match = zero + opt::match;
+		mismatch = zero + opt::mismatch;
+		open = zero + opt::gap_open;
+		extend = zero + opt::gap_extend;
+		invalid = zero + INVALID;
+		threshold = zero + INVALID / 2;
+		diag = zero + (int32_t)DIAG;
+		up = zero + (int32_t)UP;
+		left = zero + (int32_t)LEFT;
+	}
+};
+
+/** Score a cell, or one cell per lane, from its three predecessors.
+ * The gap of a vertical (horizontal) move is extended when the cell
+ * above (to the left) was itself reached by a vertical (horizontal)
+ * move. Ties are broken in the order diagonal, up, left.
+ * @param matched the mask of the lanes whose characters match
+ * @param [out] h the score
+ * @param [out] dir the direction of the predecessor
+ */
+template <typename V>
+static inline void scoreCells(const LaneScores<V>& s,
+		V diag, V up, V left, V upDir, V leftDir, V matched,
+		V& h, V& dir)
+{
+	V fromDiag = select(gt(diag, s.threshold),
+			diag + select(matched, s.match, s.mismatch), s.invalid);
+	V fromUp = select(gt(up, s.threshold),
+			up + select(eq(upDir, s.up), s.extend, s.open), s.invalid);
+	V fromLeft = select(gt(left, s.threshold),
+			left + select(eq(leftDir, s.left), s.extend, s.open),
+			s.invalid);
+	h = fromDiag;
+	dir = s.diag;
+	V m = gt(fromUp, h);
+	h = select(m, fromUp, h);
+	dir = select(m, s.up, dir);
+	m = gt(fromLeft, h);
+	h = select(m, fromLeft, h);
+	dir = select(m, s.left, dir);
+}
+
+/** Return the code of a nucleotide, such that two nucleotides match
+ * when their codes intersect, or 0 if the character is not one of
+ * ACGTN in either case.
+ */
+static inline int32_t matchCode(char c)
+{
+	switch (c) {
+	  case 'A': case 'a': return 1;
+	  case 'C': case 'c': return 2;
+	  case 'G': case 'g': return 4;
+	  case 'T': case 't': return 8;
+	  case 'N': case 'n': return 15;
+	  default: return 0;
+	}
+}
+
+/** Buffers of alignOverlap, which are reused by the calls of each
+ * thread to avoid allocating the matrix for every pair of reads. */
+struct OverlapBuffers {
+	/** The scores of the last three anti-diagonals indexed by i. */
+	vector<int32_t> h[3];
+	/** The directions of the last two anti-diagonals. */
+	vector<int32_t> dir[2];
+	/** The direction of every cell, row by row. */
+	vector<uint8_t> trace;
+	/** The scores of the last row. */
+	vector<int32_t> last;
+	/** The match codes of seq_a and of seq_b reversed. */
+	vector<int32_t> codeA, codeB;
+	/** The columns of the last row sorted by score. */
+	vector<int> order;
+};
+
+static thread_local OverlapBuffers g_buffers;
+
+/** Fill the dynamic programming matrix one anti-diagonal d = i + j at
+ * a time. The cells of an anti-diagonal depend only on the previous
+ * two anti-diagonals, so that they may be scored four at a time.
+ * @param simple whether both sequences consist of ACGTN, in which
+ * case characters are compared by their match codes
+ */
+template <bool simple>
+static void fillMatrix(OverlapBuffers& w,
+		const string& seq_a, const string& seq_b)
 {
-	char consensus;
-	return isMatch(a, b, consensus) ? opt::match : opt::mismatch;
+	const int N_a = seq_a.length(), N_b = seq_b.length();
+	const int width = N_b + 1;
+	const LaneScores<int32_t> s;
+#if __GNUC__
+	const LaneScores<v4si> vs;
+#endif
+
+	w.h[0][0] = 0;
+	w.dir[0][0] = NONE;
+	for (int d = 1; d <= N_a + N_b; d++) {
+		int32_t* h = &w.h[d % 3][0];
+		const int32_t* h1 = &w.h[(d + 2) % 3][0];
+		const int32_t* h2 = &w.h[(d + 1) % 3][0];
+		int32_t* dir = &w.dir[d % 2][0];
+		const int32_t* dir1 = &w.dir[(d + 1) % 2][0];
+
+		// The first column is valid and the first row is not.
+		if (d <= N_a) {
+			h[d] = 0;
+			dir[d] = NONE;
+		}
+		if (d <= N_b) {
+			h[0] = INVALID;
+			dir[0] = NONE;
+		}
+
+		int i = max(1, d - N_b), hi = min(N_a, d - 1);
+		// The character of seq_b of cell (i, d - i) is codeB[b + i].
+		const int b = N_b - d;
+#if __GNUC__
+		if (simple) {
+			for (; i + 3 <= hi; i += 4) {
+				v4si matched = ~eq(load(&w.codeA[i - 1])
+						& load(&w.codeB[b + i]), vs.zero);
+				v4si vh, vdir;
+				scoreCells(vs, load(&h2[i - 1]), load(&h1[i - 1]),
+						load(&h1[i]), load(&dir1[i - 1]), load(&dir1[i]),
+						matched, vh, vdir);
+				store(&h[i], vh);
+				store(&dir[i], vdir);
+				uint8_t* p = &w.trace[i * width + d - i];
+				p[0] = vdir[0];
+				p[width - 1] = vdir[1];
+				p[2 * (width - 1)] = vdir[2];
+				p[3 * (width - 1)] = vdir[3];
+			}
+		}
+#endif
+		for (; i <= hi; i++) {
+			char c;
+			int32_t matched = simple
+				? -(int32_t)((w.codeA[i - 1] & w.codeB[b + i]) != 0)
+				: -(int32_t)isMatch(seq_a[i - 1], seq_b[d - i - 1], c);
+			scoreCells(s, h2[i - 1], h1[i - 1], h1[i],
+					dir1[i - 1], dir1[i], matched, h[i], dir[i]);
+			w.trace[i * width + d - i] = dir[i];
+		}
+
+		if (d > N_a)
+			w.last[d - N_a] = h[N_a];
+	}
 }
 
-/** Return the score of a gap, either newly opened or extended. */
-static int gapScore(bool prev_is_gap)
+/** Return the predecessor of cell (i, j). */
+static inline void predecessor(const OverlapBuffers& w, int width,
+		int i, int j, int& next_i, int& next_j)
 {
-	return prev_is_gap ? opt::gap_extend : opt::gap_open;
+	switch (w.trace[i * width + j]) {
+	  case DIAG:
+		next_i = i - 1;
+		next_j = j - 1;
+		break;
+	  case UP:
+		next_i = i - 1;
+		next_j = j;
+		break;
+	  case LEFT:
+		next_i = i;
+		next_j = j - 1;
+		break;
+	  default:
+		assert(false);
+		next_i = i;
+		next_j = j;
+	}
 }
 
 //the backtrack step in smith_waterman
-unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
+static unsigned Backtrack(const int i_max, const int j_max,
+		const OverlapBuffers& w, int width,
 		const string& seq_a, const string& seq_b, SMAlignment& align, unsigned* align_pos)
 {
 	// Backtracking from H_max
 	int current_i=i_max,current_j=j_max;
-	int next_i=I_i[current_i][current_j];
-	int next_j=I_j[current_i][current_j];
+	int next_i, next_j;
+	predecessor(w, width, current_i, current_j, next_i, next_j);
 	string consensus_a(""), consensus_b(""), match("");
 	unsigned num_of_match = 0;
 	while(((current_i!=next_i) || (current_j!=next_j)) && (next_j!=0) && (next_i!=0)){
@@ -131,8 +352,7 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
 
 		current_i = next_i;
 		current_j = next_j;
-		next_i=I_i[current_i][current_j];
-		next_j=I_j[current_i][current_j];
+		predecessor(w, width, current_i, current_j, next_i, next_j);
 	}
 
 	//check whether the alignment is what we want (pinned at the ends), modified version of SW (i_max is already fixed)
@@ -175,6 +395,9 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
  * looks for a global alignment, but without penalizing overhangs...
  * and make sure the alignment is end-to-end (end of seqA to beginning
  * of seqB).
+ * The scores are computed in 32-bit integers and only the direction
+ * of each cell is kept for the backtrack, which starts only from
+ * the cells of the last row whose score is positive.
  */
 void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start_pos,
 	vector<overlap_align>& overlaps, bool multi_align, bool verbose)
@@ -182,87 +405,63 @@ void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start
 	// get the actual lengths of the sequences
 	int N_a = seq_a.length();
 	int N_b = seq_b.length();
+	if (N_a == 0 || N_b == 0)
+		return;
 
-	// initialize H
-	int i, j;
-	double** H;
-	int **I_i, **I_j;
-	H = new double*[N_a+1];
-	I_i = new int*[N_a+1];
-	I_j = new int*[N_a+1];
-	bool** V = new bool*[N_a+1];
-
-	for(i=0;i<=N_a;i++){
-		H[i] = new double[N_b+1];
-		I_i[i] = new int[N_b+1];
-		I_j[i] = new int[N_b+1];
-		H[i][0]=0; //only need to initialize first row and first column
-		I_i[i][0] = i-1;
-		V[i] = new bool[N_b+1];
-		V[i][0] = true; //valid start
-	}
+	// Check that no score can reach INVALID / 2.
+	int64_t maxScore = max(max(abs(opt::match), abs(opt::mismatch)),
+			max(abs(opt::gap_open), abs(opt::gap_extend)));
+	assert((int64_t)(N_a + N_b) * maxScore < -(int64_t)INVALID / 2);
+	(void)maxScore;
 
-	for (j = 0; j <= N_b; j++) {
-		H[0][j] = 0; //initialize first column
-		I_j[0][j] = j-1;
-		V[0][j] = false; //wrong start, not overlap
-	}
-	V[0][0] = true;
-
-	for(i=1;i<=N_a;i++){
-		for(j=1;j<=N_b;j++){
-			char a = seq_a[i-1], b = seq_b[j-1];
-			double scores[3] = {
-				V[i-1][j-1] ? H[i-1][j-1] + matchScore(a, b)
-					: -DBL_MAX, // match or mismatch
-				V[i-1][j] ? H[i-1][j] + gapScore(I_j[i-1][j] == j)
-					: -DBL_MAX, // deletion in sequence A
-				V[i][j-1] ? H[i][j-1] + gapScore(I_i[i][j-1] == i)
-					: -DBL_MAX // deletion in sequence B
-			};
-			double* pMax = max_element(scores, scores + 3);
-			H[i][j] = *pMax;
-			switch (pMax - scores) {
-			  case 0: // match or mismatch
-				I_i[i][j] = i-1;
-				I_j[i][j] = j-1;
-				break;
-			  case 1: // deletion in sequence A
-				I_i[i][j] = i-1;
-				I_j[i][j] = j;
-				break;
-			  case 2: // deletion in sequence B
-				I_i[i][j] = i;
-				I_j[i][j] = j-1;
-				break;
-			}
-			V[i][j] = H[i][j] == -DBL_MAX ? false : true;
-		}
-	}
+	OverlapBuffers& w = g_buffers;
+	for (unsigned k = 0; k < 3; k++)
+		w.h[k].resize(N_a + 1);
+	for (unsigned k = 0; k < 2; k++)
+		w.dir[k].resize(N_a + 1);
+	w.trace.resize((size_t)(N_a + 1) * (N_b + 1));
+	w.last.resize(N_b + 1);
+
+	bool simple = true;
+	w.codeA.resize(N_a);
+	for (int i = 0; i < N_a; i++)
+		simple &= (w.codeA[i] = matchCode(seq_a[i])) != 0;
+	w.codeB.resize(N_b);
+	for (int j = 0; j < N_b; j++)
+		simple &= (w.codeB[N_b - 1 - j] = matchCode(seq_b[j])) != 0;
+	if (simple)
+		fillMatrix<true>(w, seq_a, seq_b);
+	else
+		fillMatrix<false>(w, seq_a, seq_b);
 
 	// search H for the maximal score
+	const int width = N_b + 1;
+	const int32_t* H = &w.last[0];
 	unsigned num_of_match = 0;
-	double H_max = 0.;
+	int32_t H_max = 0;
 	int i_max=N_a, j_max;
-	int* j_max_indexes=new int[N_b]; //this array holds the index of j_max in H[N_a]
+	int j;
+	vector<int>& j_max_indexes = w.order; //this array holds the index of j_max in H[N_a]
+	j_max_indexes.resize(N_b);
 	for (j=0; j<N_b; j++)
 		j_max_indexes[j]=j+1;
 
 	//sort H[N_a], store the sorted index in j_max_indexes
-	sort(j_max_indexes, j_max_indexes+N_b, index_cmp<double*>(H[N_a]));
+	sort(j_max_indexes.begin(), j_max_indexes.end(),
+			index_cmp<const int32_t*>(H));
 
 	//find ALL overlap alignments, starting from the highest score j_max
 	j = 0;
 	bool found = false;
 	while (j < N_b) {
 		j_max = j_max_indexes[j];
-		H_max = H[N_a][j_max];
+		H_max = H[j_max];
 		if (H_max == 0)
 			break;
 
 		SMAlignment align;
-		unsigned align_pos[4];
-		num_of_match = Backtrack(i_max, j_max, I_i, I_j, seq_a, seq_b, align, align_pos);
+		unsigned align_pos[4] = { 0, 0, 0, 0 };
+		num_of_match = Backtrack(i_max, j_max, w, width, seq_a, seq_b, align, align_pos);
 		if (num_of_match) {
 			overlaps.push_back(overlap_align(seq_a_start_pos+align_pos[0], align_pos[3], align.match_align, num_of_match));
 			if (!found) {
@@ -272,21 +471,10 @@ void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start
 				found = true;
 				if (!multi_align
 						|| (j+1 < N_b
-							&& H[N_a][j_max_indexes[j+1]] < H_max))
+							&& H[j_max_indexes[j+1]] < H_max))
 					break;
 			}
 		}
 		j++;
 	}
-	delete [] j_max_indexes;
-	for(i=0;i<=N_a;i++){
-		delete [] H[i];
-		delete [] I_i[i];
-		delete [] I_j[i];
-		delete [] V[i];
-	}
-	delete [] H;
-	delete [] I_i;
-	delete [] I_j;
-	delete [] V;
 }
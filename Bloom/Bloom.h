@@ -22,7 +22,9 @@
 #include "Common/Uncompress.h"
 #include "Common/IOUtil.h"
 #include "DataLayer/FastaReader.h"
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #if _OPENMP
@@ -47,6 +49,8 @@ namespace Bloom {
 	static const unsigned LOAD_PROGRESS_STEP = 100000;
 	/** file format version number */
 	static const unsigned BLOOM_VERSION = 5;
+	/** file format version number of Bloom filters hashed by ntHash */
+	static const unsigned ROLLING_BLOOM_VERSION = 6;
 
 	/** Return the hash value of this object. */
 	inline static size_t hash(const key_type& key)
@@ -133,11 +137,12 @@ namespace Bloom {
 		}
 	}
 
-	inline static void writeHeader(std::ostream& out, const FileHeader& header)
+	inline static void writeHeader(std::ostream& out, const FileHeader& header,
+			unsigned version = BLOOM_VERSION)
 	{
 		(void)writeHeader;
 
-		out << BLOOM_VERSION << '\n';
+		out << version << '\n';
 		out << Kmer::length() << '\n';
 		out << header.fullBloomSize
 			<< '\t' << header.startBitPos
@@ -147,7 +152,7 @@ namespace Bloom {
 		assert(out);
 	}
 
-	FileHeader readHeader(std::istream& in)
+	FileHeader readHeader(std::istream& in, unsigned version = BLOOM_VERSION)
 	{
 		FileHeader header;
 
@@ -155,10 +160,10 @@ namespace Bloom {
 
 		in >> header.bloomVersion >> expect("\n");
 		assert(in);
-		if (header.bloomVersion != BLOOM_VERSION) {
+		if (header.bloomVersion != version) {
 			std::cerr << "error: bloom filter version (`"
 				<< header.bloomVersion << "'), does not match version required "
-				"by this program (`" << BLOOM_VERSION << "').\n";
+				"by this program (`" << version << "').\n";
 			exit(EXIT_FAILURE);
 		}
 
@@ -190,6 +195,19 @@ namespace Bloom {
 		return header;
 	}
 
+	/** Return the file format version of the specified Bloom filter
+	 * file, which identifies its hash function.
+	 */
+	static inline unsigned readVersion(const std::string& path)
+	{
+		std::ifstream in(path.c_str(), std::ios_base::in | std::ios_base::binary);
+		assert_good(in, path);
+		unsigned version;
+		in >> version;
+		assert_good(in, path);
+		return version;
+	}
+
 };
 
 #endif /* BLOOM_H_ */
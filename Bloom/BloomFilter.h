@@ -74,6 +74,12 @@ class BloomFilter
 		return m_array[i / 8] & 1 << (7 - i % 8);
 	}
 
+	/** Return the hash value of this object given seed. */
+	static size_t hash(const Bloom::key_type& key, size_t seed)
+	{
+		return Bloom::hash(key, seed);
+	}
+
 	/** Return whether the object is present in this set. */
 	bool operator[](const Bloom::key_type& key) const
 	{
@@ -108,9 +114,10 @@ class BloomFilter
 	}
 
 	/** Read a bloom filter from a stream. */
-	void read(std::istream& in, BitwiseOp readOp = BITWISE_OVERWRITE)
+	void read(std::istream& in, BitwiseOp readOp = BITWISE_OVERWRITE,
+			unsigned version = Bloom::BLOOM_VERSION)
 	{
-		Bloom::FileHeader header = Bloom::readHeader(in);
+		Bloom::FileHeader header = Bloom::readHeader(in, version);
 		assert(in);
 
 		if (m_hashSeed != header.hashSeed) {
@@ -139,7 +146,8 @@ class BloomFilter
 	}
 
 	/** Write a bloom filter to a stream. */
-	void write(std::ostream& out) const
+	void write(std::ostream& out,
+			unsigned version = Bloom::BLOOM_VERSION) const
 	{
 		Bloom::FileHeader header;
 		header.fullBloomSize = m_size;
@@ -147,7 +155,7 @@ class BloomFilter
 		header.endBitPos = m_size - 1;
 		header.hashSeed = m_hashSeed;
 
-		Bloom::writeHeader(out, header);
+		Bloom::writeHeader(out, header, version);
 		assert(out);
 
 		out.write(m_array, (m_size + 7)/8);
@@ -7,28 +7,30 @@
 
 #include "Bloom/Bloom.h"
 #include "BloomFilter.h"
+#include "RollingBloomFilter.h"
 #include <vector>
 
-/** A Cascading Bloom filter. */
-class CascadingBloomFilter
+/** A Cascading Bloom filter whose levels are of type BF. */
+template <typename BF>
+class BasicCascadingBloomFilter
 {
   public:
 
 	/** Constructor */
-	CascadingBloomFilter() {}
+	BasicCascadingBloomFilter() {}
 
 	/** Constructor */
-	CascadingBloomFilter(size_t n, size_t max_count, size_t hashSeed=0) : m_hashSeed(hashSeed)
+	BasicCascadingBloomFilter(size_t n, size_t max_count, size_t hashSeed=0) : m_hashSeed(hashSeed)
 	{
 		m_data.reserve(max_count);
 		for (unsigned i = 0; i < max_count; i++)
-			m_data.push_back(new Konnector::BloomFilter(n, hashSeed));
+			m_data.push_back(new BF(n, hashSeed));
 	}
 
 	/** Destructor */
-	~CascadingBloomFilter()
+	~BasicCascadingBloomFilter()
 	{
-		typedef std::vector<Konnector::BloomFilter*>::iterator Iterator;
+		typedef typename std::vector<BF*>::iterator Iterator;
 		for (Iterator i = m_data.begin(); i != m_data.end(); i++) {
 			assert(*i != NULL);
 			delete *i;
@@ -64,11 +66,17 @@ class CascadingBloomFilter
 		return (*m_data.back())[i];
 	}
 
+	/** Return the hash value of this object given seed. */
+	static size_t hash(const Bloom::key_type& key, size_t seed)
+	{
+		return BF::hash(key, seed);
+	}
+
 	/** Return whether this element has count >= max_count. */
 	bool operator[](const Bloom::key_type& key) const
 	{
 		assert(m_data.back() != NULL);
-		return (*m_data.back())[Bloom::hash(key, m_hashSeed) % m_data.back()->size()];
+		return (*m_data.back())[BF::hash(key, m_hashSeed) % m_data.back()->size()];
 	}
 
 	/** Add the object with the specified index to this multiset. */
@@ -87,11 +95,11 @@ class CascadingBloomFilter
 	void insert(const Bloom::key_type& key)
 	{
 		assert(m_data.back() != NULL);
-		insert(Bloom::hash(key, m_hashSeed) % m_data.back()->size());
+		insert(BF::hash(key, m_hashSeed) % m_data.back()->size());
 	}
 
 	/** Get the Bloom filter for a given level */
-	Konnector::BloomFilter& getBloomFilter(unsigned level)
+	BF& getBloomFilter(unsigned level)
 	{
 		assert(m_data.at(level) != NULL);
 		return *m_data.at(level);
@@ -104,7 +112,7 @@ class CascadingBloomFilter
 	}
 
 	/** Operator for writing the bloom filter to a stream */
-	friend std::ostream& operator<<(std::ostream& out, const CascadingBloomFilter& o)
+	friend std::ostream& operator<<(std::ostream& out, const BasicCascadingBloomFilter& o)
 	{
 		o.write(out);
 		return out;
@@ -112,8 +120,16 @@ class CascadingBloomFilter
 
   private:
 	size_t m_hashSeed;
-	std::vector<Konnector::BloomFilter*> m_data;
+	std::vector<BF*> m_data;
 
 };
 
+/** A Cascading Bloom filter of k-mers hashed by CityHash. */
+typedef BasicCascadingBloomFilter<Konnector::BloomFilter>
+	CascadingBloomFilter;
+
+/** A Cascading Bloom filter of k-mers hashed by ntHash. */
+typedef BasicCascadingBloomFilter<Konnector::RollingBloomFilter>
+	RollingCascadingBloomFilter;
+
 #endif
@@ -55,7 +55,7 @@ public:
 	/** Return whether the object is present in this set. */
 	bool operator[](const Bloom::key_type& key) const
 	{
-		return *this[Bloom::hash(key, m_hashSeed) % m_bloom.size()];
+		return *this[BloomFilterType::hash(key, m_hashSeed) % m_bloom.size()];
 	}
 
 	/** Add the object with the specified index to this set. */
@@ -70,7 +70,7 @@ public:
 	/** Add the object to this set. */
 	void insert(const Bloom::key_type& key)
 	{
-		insert(Bloom::hash(key, m_hashSeed) % m_bloom.size());
+		insert(BloomFilterType::hash(key, m_hashSeed) % m_bloom.size());
 	}
 
 private:
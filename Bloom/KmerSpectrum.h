@@ -0,0 +1,350 @@
+#ifndef BLOOM_KMERSPECTRUM_H
+#define BLOOM_KMERSPECTRUM_H 1
+
+#include "config.h"
+#include "Bloom/Bloom.h"
+#include "Common/Histogram.h"
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A counting Bloom filter of approximate k-mer counts, which keeps
+ * the k-mer count histogram (the k-mer spectrum) as it is built.
+ *
+ * Each count is a probabilistic log count stored in a 4-bit cell,
+ * sixteen cells to a 64-bit word. The cell is a minifloat with a
+ * 1-bit mantissa, whose values are 0, 1, 2, 3, 4, 6, 8, 12, ..., 192.
+ * A cell whose value is v is incremented with probability 1/s, where
+ * s is the difference between v and the next value, so that the
+ * expected value of a cell is the number of times it was incremented.
+ *
+ * Cells are incremented with compare-and-swap and saturate at 192,
+ * so that k-mers may be inserted by many threads at once. Each
+ * insertion that raises the count of a k-mer moves that k-mer from
+ * one bin of the histogram to the next. With more than one hash
+ * function, the cells of a k-mer cannot be incremented atomically
+ * together, so the insertions of a k-mer are serialized by a lock
+ * chosen by its hash, and one insertion moves the k-mer only once.
+ */
+class KmerSpectrum
+{
+  public:
+	typedef Bloom::key_type key_type;
+
+	/** The number of bits in a cell. */
+	static const unsigned CELL_BITS = 4;
+
+	/** The number of cells in a word. */
+	static const unsigned CELLS_PER_WORD = 64 / CELL_BITS;
+
+	/** The largest state of a cell. */
+	static const unsigned MAX_STATE = (1 << CELL_BITS) - 1;
+
+	/** The number of locks that serialize the insertions of k-mers
+	 * with more than one hash function. */
+	static const unsigned NUM_LOCKS = 1024;
+
+	/**
+	 * Construct a k-mer spectrum store.
+	 * @param bytes the size of the table of cells
+	 * @param hashNum the number of cells of each k-mer
+	 * @param seed the seed of the probabilistic increments
+	 */
+	KmerSpectrum(size_t bytes, unsigned hashNum = 1, uint64_t seed = 0)
+		: m_words((bytes + sizeof (uint64_t) - 1) / sizeof (uint64_t)),
+		m_size(m_words.size() * CELLS_PER_WORD),
+		m_hashNum(hashNum), m_seed(seed), m_draws(0)
+	{
+		assert(bytes > 0);
+		assert(hashNum > 0 && hashNum <= MAX_HASHES);
+		for (size_t i = 0; i < m_words.size(); ++i)
+			m_words[i].store(0, std::memory_order_relaxed);
+		for (unsigned v = 0; v <= MAX_STATE; ++v)
+			m_hist[v].store(0, std::memory_order_relaxed);
+	}
+
+	/** Return the number of cells. */
+	size_t size() const { return m_size; }
+
+	/** Return the number of hash functions. */
+	unsigned hashNum() const { return m_hashNum; }
+
+	/** Return the count that a cell in the specified state
+	 * represents. */
+	static unsigned value(unsigned state)
+	{
+		assert(state <= MAX_STATE);
+		return state < 2 ? state : ((state & 1) | 2) << ((state >> 1) - 1);
+	}
+
+	/** Return the inverse probability of incrementing a cell in the
+	 * specified state, which is a power of two. */
+	static unsigned step(unsigned state)
+	{
+		return state < 2 ? 1 : 1 << ((state >> 1) - 1);
+	}
+
+	/** Return the state of the cell with the specified index. */
+	unsigned state(size_t i) const
+	{
+		assert(i < m_size);
+		uint64_t word = m_words[i / CELLS_PER_WORD].load(
+				std::memory_order_relaxed);
+		return word >> (i % CELLS_PER_WORD * CELL_BITS) & MAX_STATE;
+	}
+
+	/** Return the approximate count of the specified k-mer. */
+	unsigned operator[](const key_type& key) const
+	{
+		unsigned minState = MAX_STATE;
+		for (unsigned i = 0; i < m_hashNum && minState > 0; ++i)
+			minState = std::min(minState, state(index(key, i)));
+		return value(minState);
+	}
+
+	/** Count one occurrence of the specified k-mer, drawing random
+	 * numbers from one stream shared by all threads. */
+	void insert(const key_type& key)
+	{
+		insert(key, m_draws);
+	}
+
+	/**
+	 * Count one occurrence of the specified k-mer. The cells of the
+	 * k-mer whose state is the smallest of its cells are incremented,
+	 * all with the same probability.
+	 * @param draws the counter of the random draws used to decide
+	 * whether to increment the cells
+	 */
+	template <typename Counter>
+	void insert(const key_type& key, Counter& draws)
+	{
+		if (m_hashNum == 1) {
+			insertUnlocked(key, draws);
+		} else {
+			std::lock_guard<std::mutex> lock(
+					m_locks[Bloom::hash(key) % NUM_LOCKS]);
+			insertUnlocked(key, draws);
+		}
+	}
+
+	/** Return the number of distinct k-mers counted. */
+	size_t distinct() const
+	{
+		size_t n = 0;
+		for (unsigned v = 1; v <= MAX_STATE; ++v)
+			n += m_hist[v].load(std::memory_order_relaxed);
+		return n;
+	}
+
+	/** Return the number of distinct k-mers whose cells are in the
+	 * specified state. */
+	size_t histogram(unsigned state) const
+	{
+		assert(state <= MAX_STATE);
+		return m_hist[state].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Return the k-mer count histogram. The k-mers of a state are
+	 * spread evenly across the counts that the state spans, so that
+	 * the histogram may be used like an exact k-mer coverage
+	 * histogram, such as to choose a coverage threshold.
+	 */
+	Histogram histogram() const
+	{
+		Histogram h;
+		for (unsigned v = 1; v <= MAX_STATE; ++v) {
+			size_t n = histogram(v);
+			if (n == 0)
+				continue;
+			unsigned lo = value(v);
+			unsigned width = v < MAX_STATE ? value(v + 1) - lo : 1;
+			for (unsigned i = 0; i < width; ++i)
+				h.insert(lo + i, n / width + (i < n % width));
+		}
+		return h;
+	}
+
+	/** Return the proportion of cells that are not zero. */
+	double occupancy() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < m_words.size(); ++i) {
+			uint64_t word = m_words[i].load(std::memory_order_relaxed);
+			for (unsigned j = 0; j < CELLS_PER_WORD; ++j)
+				n += (word >> (j * CELL_BITS) & MAX_STATE) != 0;
+		}
+		return double(n) / m_size;
+	}
+
+	/** Return the estimated false positive rate. */
+	double FPR() const
+	{
+		return pow(occupancy(), m_hashNum);
+	}
+
+	/** Load the k-mers of a sequence. */
+	void loadSeq(unsigned k, const std::string& seq)
+	{
+		Bloom::loadSeq(*this, k, seq);
+	}
+
+	/**
+	 * Load the k-mers of a sequence file using all threads. The reads
+	 * are split into batches, and each batch draws its random numbers
+	 * from its own stream, which is determined by the seed and the
+	 * index of the batch. The random draws of a read therefore do not
+	 * depend on which thread loads it, nor on the number of threads.
+	 * @param batches the number of batches loaded so far, which is
+	 * incremented by the number of batches of this file
+	 */
+	void loadFile(unsigned k, const std::string& path, size_t& batches,
+			bool verbose = false, size_t taskIOBufferSize = 100000)
+	{
+		assert(!path.empty());
+		if (verbose)
+			std::cerr << "Reading `" << path << "'...\n";
+		FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
+		uint64_t count = 0;
+#pragma omp parallel
+		for (std::vector<std::string> buffer;;) {
+			buffer.clear();
+			size_t batch = 0;
+			size_t bufferSize = 0;
+#pragma omp critical(in)
+			{
+				std::string seq;
+				while (bufferSize < taskIOBufferSize && in >> seq) {
+					bufferSize += seq.length();
+					buffer.push_back(seq);
+				}
+				if (!buffer.empty())
+					batch = batches++;
+			}
+			if (buffer.empty())
+				break;
+
+			Stream stream(*this, batch);
+			for (size_t j = 0; j < buffer.size(); j++)
+				Bloom::loadSeq(stream, k, buffer[j]);
+
+			if (verbose)
+#pragma omp critical(cerr)
+			{
+				size_t prev = count;
+				count += buffer.size();
+				if (count / Bloom::LOAD_PROGRESS_STEP
+						!= prev / Bloom::LOAD_PROGRESS_STEP)
+					std::cerr << "Loaded " << count << " reads\n";
+			}
+		}
+		assert(in.eof());
+		if (verbose)
+			std::cerr << "Loaded " << count << " reads from `"
+				<< path << "'\n";
+	}
+
+  private:
+	/** The number of random draws reserved for each batch of reads. */
+	static const unsigned DRAWS_PER_BATCH_BITS = 40;
+
+	/** Insert k-mers drawing random numbers from the stream of one
+	 * batch of reads. */
+	class Stream
+	{
+	  public:
+		Stream(KmerSpectrum& spectrum, size_t batch)
+			: m_spectrum(spectrum),
+			m_draws(uint64_t(batch) << DRAWS_PER_BATCH_BITS) { }
+
+		void insert(const key_type& key)
+		{
+			m_spectrum.insert(key, m_draws);
+		}
+
+	  private:
+		KmerSpectrum& m_spectrum;
+		uint64_t m_draws;
+	};
+
+	/** Count one occurrence of the specified k-mer. The cells of a
+	 * k-mer with more than one hash function must not be modified by
+	 * another insertion of the same k-mer. */
+	template <typename Counter>
+	void insertUnlocked(const key_type& key, Counter& draws)
+	{
+		assert(m_hashNum <= MAX_HASHES);
+		size_t indices[MAX_HASHES];
+		unsigned minState = MAX_STATE;
+		for (unsigned i = 0; i < m_hashNum; ++i) {
+			indices[i] = index(key, i);
+			minState = std::min(minState, state(indices[i]));
+		}
+		if (minState == MAX_STATE)
+			return;
+
+		unsigned s = step(minState);
+		if (s > 1 && (random(draws++) & (s - 1)) != 0)
+			return;
+
+		bool incremented = false;
+		for (unsigned i = 0; i < m_hashNum; ++i)
+			incremented |= increment(indices[i], minState);
+		if (incremented) {
+			if (minState > 0)
+				m_hist[minState].fetch_sub(1, std::memory_order_relaxed);
+			m_hist[minState + 1].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/** Return the index of the cell of a k-mer for the specified hash
+	 * function. */
+	size_t index(const key_type& key, unsigned i) const
+	{
+		return Bloom::hash(key, i) % m_size;
+	}
+
+	/** Return the random bits of the specified draw, computed by the
+	 * SplitMix64 generator. */
+	uint64_t random(uint64_t draw) const
+	{
+		uint64_t z = m_seed + (draw + 1) * 0x9e3779b97f4a7c15ULL;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	/** Increment the specified cell if its state is the specified
+	 * state.
+	 * @return whether the cell was incremented
+	 */
+	bool increment(size_t i, unsigned from)
+	{
+		std::atomic<uint64_t>& word = m_words[i / CELLS_PER_WORD];
+		unsigned shift = i % CELLS_PER_WORD * CELL_BITS;
+		uint64_t old = word.load(std::memory_order_relaxed);
+		for (;;) {
+			if ((old >> shift & MAX_STATE) != from)
+				return false;
+			if (word.compare_exchange_weak(old,
+						old + (uint64_t(1) << shift),
+						std::memory_order_relaxed))
+				return true;
+		}
+	}
+
+	std::vector<std::atomic<uint64_t> > m_words;
+	size_t m_size;
+	unsigned m_hashNum;
+	uint64_t m_seed;
+	std::atomic<uint64_t> m_draws;
+	std::atomic<size_t> m_hist[MAX_STATE + 1];
+	std::mutex m_locks[NUM_LOCKS];
+};
+
+#endif
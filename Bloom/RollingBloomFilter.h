@@ -0,0 +1,175 @@
+/**
+ * A Bloom filter of k-mers hashed by ntHash
+ */
+#ifndef ROLLINGBLOOMFILTER_H
+#define ROLLINGBLOOMFILTER_H 1
+
+#include "Bloom/Bloom.h"
+#include "Bloom/BloomFilter.h"
+#include "Common/Kmer.h"
+#include "Common/Sense.h"
+#include "vendor/nthash/nthash.hpp"
+#include <cassert>
+#include <iostream>
+
+/**
+ * The forward and reverse-complement ntHash values of a k-mer.
+ * The hash values of a neighbouring k-mer are computed in constant
+ * time from those of the k-mer, rather than in time linear in k.
+ */
+struct RollingKmerHash
+{
+	uint64_t fwd;
+	uint64_t rev;
+
+	RollingKmerHash() : fwd(0), rev(0) { }
+
+	/** Hash the specified k-mer from scratch. */
+	explicit RollingKmerHash(const Kmer& kmer) : fwd(0), rev(0)
+	{
+		unsigned k = Kmer::length();
+		unsigned char packed[Kmer::NUM_BYTES];
+		kmer.serialize(packed);
+		for (unsigned i = 0; i < k; ++i) {
+			unsigned char c = baseChar(
+					packed[i / 4] >> 2 * (3 - i % 4) & 0x3);
+			fwd = swapbits033(rol1(fwd)) ^ seedTab[c];
+			// the complement of the i-th base is rotated i times
+			c &= cpOff;
+			rev ^= msTab31l[c][i % 31] | msTab33r[c][i % 33];
+		}
+	}
+
+	/** Return the strand-independent hash value. */
+	uint64_t canonical() const
+	{
+		return rev < fwd ? rev : fwd;
+	}
+
+	/** Return the nucleotide of the specified 2-bit code. */
+	static unsigned char baseChar(uint8_t code)
+	{
+		return "ACGT"[code];
+	}
+
+	/**
+	 * Return the hash values of the k-mer obtained by removing the
+	 * nucleotide charOut from this k-mer and adding charIn. The
+	 * nucleotide charIn is appended if dir is SENSE and prepended
+	 * otherwise.
+	 */
+	RollingKmerHash rolled(extDirection dir,
+			unsigned char charOut, unsigned char charIn) const
+	{
+		unsigned k = Kmer::length();
+		RollingKmerHash h;
+		if (dir == SENSE) {
+			h.fwd = NTF64(fwd, k, charOut, charIn);
+			h.rev = NTR64(rev, k, charOut, charIn);
+		} else {
+			h.fwd = NTF64L(fwd, k, charOut, charIn);
+			h.rev = NTR64L(rev, k, charOut, charIn);
+		}
+		return h;
+	}
+
+	/**
+	 * Return the hash values of the neighbour of kmer obtained by
+	 * shifting it in the specified direction and adding the
+	 * specified base, where this object holds the hash values of
+	 * kmer.
+	 */
+	RollingKmerHash shifted(const Kmer& kmer, extDirection dir,
+			uint8_t base) const
+	{
+		uint8_t out = dir == SENSE ? kmer.front() : kmer.back();
+		return rolled(dir, baseChar(out), baseChar(base));
+	}
+};
+
+namespace Konnector {
+
+/**
+ * A Bloom filter of k-mers whose hash function is the canonical
+ * ntHash value, so that the neighbours of a k-mer may be looked up
+ * without rehashing them. Its file format version is
+ * Bloom::ROLLING_BLOOM_VERSION.
+ */
+class RollingBloomFilter : public BloomFilter
+{
+  public:
+
+	/** Constructor. */
+	RollingBloomFilter() { }
+
+	/** Constructor. */
+	RollingBloomFilter(size_t n, size_t hashSeed=0)
+		: BloomFilter(n, hashSeed) { }
+
+	/** Return the hash value of a k-mer given its ntHash values. */
+	static size_t hash(const RollingKmerHash& h, size_t seed)
+	{
+		uint64_t hash = h.canonical();
+		return seed == 0 ? hash
+			: NTE64(hash, Kmer::length(), (unsigned)seed);
+	}
+
+	/** Return the hash value of this k-mer given seed. */
+	static size_t hash(const Bloom::key_type& key, size_t seed)
+	{
+		return hash(RollingKmerHash(key), seed);
+	}
+
+	using BloomFilter::operator[];
+	using BloomFilter::insert;
+
+	/** Return whether the object is present in this set. */
+	bool operator[](const Bloom::key_type& key) const
+	{
+		return (*this)[hash(key, m_hashSeed) % m_size];
+	}
+
+	/** Return whether the k-mer with these hash values is present. */
+	bool operator[](const RollingKmerHash& h) const
+	{
+		return (*this)[hash(h, m_hashSeed) % m_size];
+	}
+
+	/** Add the object to this set. */
+	void insert(const Bloom::key_type& key)
+	{
+		insert(hash(key, m_hashSeed) % m_size);
+	}
+
+	/** Operator for reading a bloom filter from a stream. */
+	friend std::istream& operator>>(std::istream& in,
+			RollingBloomFilter& o)
+	{
+		o.read(in, BITWISE_OVERWRITE);
+		return in;
+	}
+
+	/** Operator for writing the bloom filter to a stream. */
+	friend std::ostream& operator<<(std::ostream& out,
+			const RollingBloomFilter& o)
+	{
+		o.write(out);
+		return out;
+	}
+
+	/** Read a bloom filter from a stream. */
+	void read(std::istream& in, BitwiseOp readOp = BITWISE_OVERWRITE)
+	{
+		BloomFilter::read(in, readOp, Bloom::ROLLING_BLOOM_VERSION);
+	}
+
+	/** Write a bloom filter to a stream. */
+	void write(std::ostream& out) const
+	{
+		BloomFilter::write(out, Bloom::ROLLING_BLOOM_VERSION);
+	}
+};
+
+} // end Konnector namespace
+
+#endif
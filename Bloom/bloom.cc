@@ -8,6 +8,8 @@
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/CascadingBloomFilterWindow.h"
 #include "Bloom/HashAgnosticCascadingBloom.h"
+#include "Bloom/KmerSpectrum.h"
+#include "Bloom/RollingBloomFilter.h"
 #include "Bloom/RollingBloomDBGVisitor.h"
 #include "BloomDBG/BloomIO.h"
 #include "BloomDBG/RollingBloomDBG.h"
@@ -66,6 +68,8 @@ static const char USAGE_MESSAGE[] =
     "Usage 8: " PROGRAM " kmers [GLOBAL_OPTS] [COMMAND_OPTS] <BLOOM_FILE> <READS_FILE>\n"
     "Usage 9: " PROGRAM
     " trim [GLOBAL_OPTS] [COMMAND_OPTS] <BLOOM_FILE> <READS_FILE> [READS_FILE_2]... > trimmed.fq\n"
+    "Usage 10: " PROGRAM " hist [GLOBAL_OPTS] [COMMAND_OPTS] <READS_FILE_1> [READS_FILE_2]... > "
+                         "hist\n"
     "\n"
     "Build and manipulate Bloom filter files.\n"
     "\n"
@@ -84,7 +88,7 @@ static const char USAGE_MESSAGE[] =
                   "[100000]\n"
                   "  -j, --threads=N            use N parallel threads [1]\n"
                   "  -h, --hash-seed=N          seed for hash function (only works with\n"
-                  "                             `-t konnector') [0]\n"
+                  "                             `-t konnector' or `-t konnector-rolling') [0]\n"
                   "  -H, --num-hashes=N         number of hash functions (only works with\n"
                   "                             `-t rolling-hash') [1]\n"
                   "  -l, --levels=N             build a cascading bloom filter with N levels\n"
@@ -99,18 +103,24 @@ static const char USAGE_MESSAGE[] =
                   "  -n, --num-locks=N          number of write locks on bloom filter [1000]\n"
                   "  -q, --trim-quality=N       trim bases from the ends of reads whose\n"
                   "                             quality is less than the threshold\n"
-                  "  -t, --bloom-type=STR       'konnector', 'rolling-hash', or 'counting' [konnector]\n"
+                  "  -t, --bloom-type=STR       'konnector', 'konnector-rolling', 'rolling-hash',\n"
+                  "                             or 'counting' [konnector]. A 'konnector-rolling'\n"
+                  "                             filter hashes k-mers with ntHash, which speeds up\n"
+                  "                             graph traversal in konnector and abyss-sealer\n"
                   "      --standard-quality     zero quality is `!' (33)\n"
                   "                             default for FASTQ and SAM files\n"
                   "      --illumina-quality     zero quality is `@' (64)\n"
                   "                             default for qseq and export files\n"
                   "  -w, --window M/N           build a bloom filter for subwindow M of N\n"
                   "\n"
-                  " Options for `" PROGRAM " union': (none)\n"
-                  " Options for `" PROGRAM " intersect': (none)\n"
+                  " Options for `" PROGRAM " union' and `" PROGRAM " intersect':\n"
+                  "\n"
+                  "  -j, --threads=N            use N parallel threads [1]\n"
+                  "\n"
                   " Options for `" PROGRAM " info': (none)\n"
                   " Options for `" PROGRAM " compare':\n"
                   "\n"
+                  "  -j, --threads=N            use N parallel threads [1]\n"
                   "  -m, --method=`String'      choose distance calculation method \n"
                   "                             [`jaccard'(default), `forbes', `czekanowski']\n"
                   "\n"
@@ -132,6 +142,14 @@ static const char USAGE_MESSAGE[] =
                   "  --raw                      output k-mers in raw format (one per line)\n"
                   "\n"
                   " Options for `" PROGRAM " trim': (none)\n"
+                  " Options for `" PROGRAM " hist':\n"
+                  "\n"
+                  "  -b, --bloom-size=N         size of the table of 4-bit counters [500M]\n"
+                  "  -B, --buffer-size=N        size of I/O buffer for each thread, in bytes "
+                  "[100000]\n"
+                  "  -H, --num-hashes=N         number of hash functions [1]\n"
+                  "  -j, --threads=N            use N parallel threads [1]\n"
+                  "\n"
                   "\n"
                   "Report bugs to <" PACKAGE_BUGREPORT ">.\n";
 ;
@@ -139,6 +157,7 @@ static const char USAGE_MESSAGE[] =
 enum BloomFilterType
 {
 	BT_KONNECTOR,
+	BT_KONNECTOR_ROLLING,
 	BT_ROLLING_HASH,
 	BT_COUNTING,
 	BT_UNKNOWN
@@ -379,6 +398,53 @@ closeOutputStream(ostream* out, const string& path)
 	delete ofs;
 }
 
+/** The size of the blocks in which Bloom filter files are streamed,
+ * in 64-bit words. */
+static const size_t STREAM_BLOCK_WORDS = 8 * 1024 * 1024;
+
+/**
+ * Read the next block of a bit array into a buffer of words. The bits
+ * of the last word past the end of the bit array are cleared.
+ * @param bits the number of bits of the array that remain to be read
+ * @return the number of bits read
+ */
+static inline size_t
+readBlock(istream& in, const string& path, vector<uint64_t>& block, size_t bits)
+{
+	size_t blockBits = min(block.size() * 64, bits);
+	size_t bytes = (blockBits + 7) / 8;
+	block[(bytes - 1) / 8] = 0;
+	char* p = reinterpret_cast<char*>(block.data());
+	in.read(p, bytes);
+	assert_good(in, path);
+	if (blockBits % 8 != 0)
+		p[bytes - 1] &= (unsigned char)(0xFF << (8 - blockBits % 8));
+	return blockBits;
+}
+
+/**
+ * Return whether the Bloom filter files of the specified paths may be
+ * streamed, because each contains a whole Bloom filter rather than a
+ * window of one.
+ */
+static inline bool
+areWholeFilters(char** first, char** last)
+{
+	for (char** it = first; it != last; ++it) {
+		string path(*it);
+		if (path == "-")
+			return false;
+		istream* in = openInputStream(path);
+		assert_good(*in, path);
+		Bloom::FileHeader header = Bloom::readHeader(*in);
+		assert_good(*in, path);
+		closeInputStream(in, path);
+		if (header.startBitPos != 0 || header.endBitPos != header.fullBloomSize - 1)
+			return false;
+	}
+	return true;
+}
+
 template<typename CBF>
 void
 initBloomFilterLevels(CBF& bf)
@@ -495,6 +561,8 @@ strToBloomType(const std::string& str)
 {
 	if (str == "konnector")
 		return BT_KONNECTOR;
+	else if (str == "konnector-rolling")
+		return BT_KONNECTOR_ROLLING;
 	else if (str == "rolling-hash")
 		return BT_ROLLING_HASH;
 	else if (str == "counting")
@@ -509,6 +577,8 @@ bloomTypeToStr(const BloomFilterType type)
 	assert(type != BT_UNKNOWN);
 	if (type == BT_KONNECTOR) {
 		return string("konnector");
+	} else if (type == BT_KONNECTOR_ROLLING) {
+		return string("konnector-rolling");
 	} else if (type == BT_ROLLING_HASH) {
 		return string("rolling-hash");
 	} else {
@@ -517,6 +587,39 @@ bloomTypeToStr(const BloomFilterType type)
 	}
 }
 
+/**
+ * Build a konnector-style Bloom filter, or cascading Bloom filter,
+ * whose levels are of type BF and have the specified size in bits.
+ */
+template<typename BF>
+static inline void
+buildKonnectorBloomLevels(size_t bits, string outputPath, int argc, char** argv)
+{
+	if (opt::levels == 1) {
+		BF bloom(bits, opt::hashSeed);
+#ifdef _OPENMP
+		ConcurrentBloomFilter<BF> cbf(bloom, opt::numLocks, opt::hashSeed);
+		loadFilters(cbf, argc, argv);
+#else
+		loadFilters(bloom, argc, argv);
+#endif
+		printBloomStats(cerr, bloom);
+		writeBloom(bloom, outputPath);
+	} else {
+		BasicCascadingBloomFilter<BF> cascadingBloom(bits, opt::levels, opt::hashSeed);
+		initBloomFilterLevels(cascadingBloom);
+#ifdef _OPENMP
+		ConcurrentBloomFilter<BasicCascadingBloomFilter<BF> > cbf(
+		    cascadingBloom, opt::numLocks, opt::hashSeed);
+		loadFilters(cbf, argc, argv);
+#else
+		loadFilters(cascadingBloom, argc, argv);
+#endif
+		printCascadingBloomStats(cerr, cascadingBloom);
+		writeBloom(cascadingBloom, outputPath);
+	}
+}
+
 /** Build a konnector-style Bloom filter. */
 
 static inline void
@@ -528,31 +631,7 @@ buildKonnectorBloom(size_t bits, string outputPath, int argc, char** argv)
 	bits /= opt::levels;
 
 	if (opt::windows == 0) {
-
-		if (opt::levels == 1) {
-			Konnector::BloomFilter bloom(bits, opt::hashSeed);
-#ifdef _OPENMP
-			ConcurrentBloomFilter<Konnector::BloomFilter> cbf(bloom, opt::numLocks, opt::hashSeed);
-			loadFilters(cbf, argc, argv);
-#else
-			loadFilters(bloom, argc, argv);
-#endif
-			printBloomStats(cerr, bloom);
-			writeBloom(bloom, outputPath);
-		} else {
-			CascadingBloomFilter cascadingBloom(bits, opt::levels, opt::hashSeed);
-			initBloomFilterLevels(cascadingBloom);
-#ifdef _OPENMP
-			ConcurrentBloomFilter<CascadingBloomFilter> cbf(
-			    cascadingBloom, opt::numLocks, opt::hashSeed);
-			loadFilters(cbf, argc, argv);
-#else
-			loadFilters(cascadingBloom, argc, argv);
-#endif
-			printCascadingBloomStats(cerr, cascadingBloom);
-			writeBloom(cascadingBloom, outputPath);
-		}
-
+		buildKonnectorBloomLevels<Konnector::BloomFilter>(bits, outputPath, argc, argv);
 	} else {
 
 		size_t bitsPerWindow = bits / opt::windows;
@@ -580,6 +659,18 @@ buildKonnectorBloom(size_t bits, string outputPath, int argc, char** argv)
 	}
 }
 
+/**
+ * Build a konnector-style Bloom filter of k-mers hashed by ntHash,
+ * whose neighbouring k-mers konnector and abyss-sealer look up without
+ * rehashing them.
+ */
+static inline void
+buildKonnectorRollingBloom(size_t bits, string outputPath, int argc, char** argv)
+{
+	buildKonnectorBloomLevels<Konnector::RollingBloomFilter>(
+	    bits / opt::levels, outputPath, argc, argv);
+}
+
 /** Build a rolling-hash based Bloom filter (used by pre 2.2.0 `abyss-bloom-dbg`) */
 static inline void
 buildRollingHashBloom(size_t bits, string outputPath, int argc, char** argv)
@@ -619,7 +710,8 @@ buildCountingBloom(size_t bytes, string outputPath, int argc, char** argv)
 }
 
 /**
- * Build Bloom filter file of type 'konnector', 'rolling-hash' or 'counting', as
+ * Build Bloom filter file of type 'konnector', 'konnector-rolling',
+ * 'rolling-hash' or 'counting', as
  * per `-t` option.
  */
 int
@@ -701,16 +793,23 @@ build(int argc, char** argv)
 
 	if (opt::bloomType == BT_UNKNOWN) {
 		cerr << PROGRAM ": unrecognized argument to `-t' "
-		     << "(should be 'konnector', 'rolling-hash' or 'counting')\n";
+		     << "(should be 'konnector', 'konnector-rolling', "
+		        "'rolling-hash' or 'counting')\n";
 		dieWithUsageError();
 	}
 
-	if (opt::bloomType == BT_KONNECTOR && opt::numHashes != 1) {
+	if ((opt::bloomType == BT_KONNECTOR || opt::bloomType == BT_KONNECTOR_ROLLING)
+	    && opt::numHashes != 1) {
 		cerr << PROGRAM ": warning: -H option has no effect"
-		                " when using `-t konnector'\n";
+		                " when using `-t " << bloomTypeToStr(opt::bloomType) << "'\n";
 		opt::numHashes = 1;
 	}
 
+	if (opt::bloomType == BT_KONNECTOR_ROLLING && opt::windows != 0) {
+		cerr << PROGRAM ": -w can not be used with `-t konnector-rolling'\n";
+		dieWithUsageError();
+	}
+
 	if (opt::bloomType == BT_COUNTING && (opt::levels != 1)) {
 		cerr << PROGRAM ": warning: -l option has no effect"
 		                " when using `-t counting'\n";
@@ -753,6 +852,8 @@ build(int argc, char** argv)
 	assert(opt::bloomType != BT_UNKNOWN);
 	if (opt::bloomType == BT_KONNECTOR) {
 		buildKonnectorBloom(bits, outputPath, argc, argv);
+	} else if (opt::bloomType == BT_KONNECTOR_ROLLING) {
+		buildKonnectorRollingBloom(bits, outputPath, argc, argv);
 	} else if (opt::bloomType == BT_ROLLING_HASH) {
 		buildRollingHashBloom(bits, outputPath, argc, argv);
 	} else {
@@ -763,19 +864,123 @@ build(int argc, char** argv)
 	return 0;
 }
 
+/**
+ * Write the union or intersection of whole Bloom filter files,
+ * streaming all of them at once in blocks, so that no filter is loaded
+ * into memory.
+ */
+static void
+combineStreams(const string& outputPath, char** first, char** last, BitwiseOp readOp)
+{
+	vector<string> paths(first, last);
+	vector<istream*> ins;
+	Bloom::FileHeader header;
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (opt::verbose)
+			std::cerr << "Opening bloom filter `" << paths[i] << "'...\n";
+		ins.push_back(openInputStream(paths[i]));
+		assert_good(*ins[i], paths[i]);
+		Bloom::FileHeader h = Bloom::readHeader(*ins[i]);
+		assert_good(*ins[i], paths[i]);
+		if (i == 0) {
+			header = h;
+		} else if (h.hashSeed != header.hashSeed) {
+			std::cerr << "error: can't union/intersect bloom filters with "
+			          << "different hash seeds\n";
+			exit(EXIT_FAILURE);
+		} else if (h.fullBloomSize != header.fullBloomSize) {
+			std::cerr << "error: can't union/intersect bloom filters with "
+			          << "different sizes\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	ostream* out = openOutputStream(outputPath);
+	assert_good(*out, outputPath);
+	Bloom::writeHeader(*out, header);
+	assert_good(*out, outputPath);
+
+	vector<uint64_t> result(STREAM_BLOCK_WORDS);
+	vector<uint64_t> block(STREAM_BLOCK_WORDS);
+	size_t popcount = 0;
+	for (size_t pos = 0; pos < header.fullBloomSize;) {
+		size_t bits = readBlock(*ins[0], paths[0], result, header.fullBloomSize - pos);
+		ptrdiff_t words = (bits + 63) / 64;
+		for (size_t i = 1; i < paths.size(); i++) {
+			readBlock(*ins[i], paths[i], block, header.fullBloomSize - pos);
+			if (readOp == BITWISE_OR) {
+#pragma omp parallel for
+				for (ptrdiff_t j = 0; j < words; j++)
+					result[j] |= block[j];
+			} else {
+#pragma omp parallel for
+				for (ptrdiff_t j = 0; j < words; j++)
+					result[j] &= block[j];
+			}
+		}
+		size_t count = 0;
+#pragma omp parallel for reduction(+ : count)
+		for (ptrdiff_t j = 0; j < words; j++)
+			count += ::popcount(result[j]);
+		popcount += count;
+
+		out->write(reinterpret_cast<const char*>(result.data()), (bits + 7) / 8);
+		assert_good(*out, outputPath);
+		pos += bits;
+	}
+
+	for (size_t i = 0; i < paths.size(); i++)
+		closeInputStream(ins[i], paths[i]);
+	out->flush();
+	assert_good(*out, outputPath);
+	closeOutputStream(out, outputPath);
+
+	if (opt::verbose)
+		cerr << "Bloom size (bits): " << header.fullBloomSize << "\n"
+		     << "Bloom popcount (bits): " << popcount << "\n"
+		     << "Bloom filter FPR: " << setprecision(3)
+		     << 100 * (double)popcount / header.fullBloomSize << "%\n";
+}
+
 int
 combine(int argc, char** argv, BitwiseOp readOp)
 {
 	parseGlobalOpts(argc, argv);
 
+	for (int c; (c = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1;) {
+		istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) {
+		case '?':
+			dieWithUsageError();
+		case 'j':
+			arg >> opt::threads;
+			break;
+		}
+		if (optarg != NULL && (!arg.eof() || arg.fail())) {
+			cerr << PROGRAM ": invalid option: `-" << (char)c << optarg << "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	if (argc - optind < 3) {
 		cerr << PROGRAM ": missing arguments\n";
 		dieWithUsageError();
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	string outputPath(argv[optind]);
 	optind++;
 
+	// Windows of a Bloom filter are placed at their offsets in memory.
+	if (areWholeFilters(argv + optind, argv + argc)) {
+		combineStreams(outputPath, argv + optind, argv + argc, readOp);
+		return 0;
+	}
+
 	Konnector::BloomFilter bloom;
 
 	for (int i = optind; i < argc; i++) {
@@ -846,6 +1051,66 @@ info(int argc, char** argv)
 	return 0;
 }
 
+/**
+ * Count the k-mers of the reads approximately, and write the k-mer
+ * count histogram.
+ */
+int
+hist(int argc, char** argv)
+{
+	parseGlobalOpts(argc, argv);
+
+	for (int c; (c = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1;) {
+		istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) {
+		case '?':
+			dieWithUsageError();
+		case 'b':
+			opt::bloomSize = SIToBytes(arg);
+			break;
+		case 'B':
+			arg >> opt::bufferSize;
+			break;
+		case 'H':
+			arg >> opt::numHashes;
+			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
+		}
+		if (optarg != NULL && (!arg.eof() || arg.fail())) {
+			cerr << PROGRAM ": invalid option: `-" << (char)c << optarg << "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (argc - optind < 1) {
+		cerr << PROGRAM ": missing arguments\n";
+		dieWithUsageError();
+	}
+
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
+	KmerSpectrum spectrum(opt::bloomSize, opt::numHashes);
+	size_t batches = 0;
+	for (int i = optind; i < argc; i++)
+		spectrum.loadFile(opt::k, argv[i], batches, opt::verbose, opt::bufferSize);
+
+	if (opt::verbose)
+		cerr << "Counted " << spectrum.distinct() << " distinct k-mers in " << spectrum.size()
+		     << " cells\n"
+		     << "Estimated false positive rate: " << setprecision(3) << 100 * spectrum.FPR()
+		     << "%\n";
+
+	cout << spectrum.histogram();
+	assert_good(cout, "stdout");
+
+	return 0;
+}
+
 int
 compare(int argc, char** argv)
 {
@@ -857,6 +1122,9 @@ compare(int argc, char** argv)
 		case '?':
 			cerr << PROGRAM ": unrecognized option: `-" << optopt << "'" << endl;
 			dieWithUsageError();
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'm':
 			arg >> opt::method;
 			break;
@@ -870,6 +1138,11 @@ compare(int argc, char** argv)
 			std::cerr << "Invalid method: " << opt::method << std::endl;
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	// Set method strin
 	string method(opt::method);
 	if (opt::verbose)
@@ -897,8 +1170,6 @@ compare(int argc, char** argv)
 	assert(tA);
 	assert(tB);
 
-	const size_t IO_BUFFER_SIZE = 32 * 1024;
-	unsigned char mask = 1;
 	// The number of total bits in the vector
 	size_t bitsA = headerA.endBitPos - headerA.startBitPos + 1;
 	size_t bitsB = headerB.endBitPos - headerB.startBitPos + 1;
@@ -918,39 +1189,26 @@ compare(int argc, char** argv)
 	unsigned long a = 0;
 	unsigned long b = 0;
 	unsigned long c = 0;
-	unsigned long d = 0;
-	// Iteratively compare bits
+	// Compare the filters a block of words at a time. The bits past
+	// the end of the filters are cleared in both, so they count
+	// towards none of a, b and c.
+	vector<uint64_t> blockA(STREAM_BLOCK_WORDS);
+	vector<uint64_t> blockB(STREAM_BLOCK_WORDS);
 	for (size_t i = 0; i < bitsA;) {
-		char bufferA[IO_BUFFER_SIZE];
-		char bufferB[IO_BUFFER_SIZE];
-		// The number of bits in the buffer is its size * 8 except for the last iteration
-		size_t bitsRead = std::min(IO_BUFFER_SIZE * 8, bitsA - i);
-		size_t bytesRead = (bitsRead + 7) / 8;
-		// Read bytes from the the istream and immediately assert
-		tA.read(bufferA, bytesRead);
-		tB.read(bufferB, bytesRead);
-		assert(tA);
-		assert(tB);
-		// For each byte in the buffer, compare bits
-		for (size_t j = 0; j < IO_BUFFER_SIZE; j++) {
-			// Compare bit-wise
-			for (int bit = 0; bit < 8; bit++) {
-				bool f = (bufferA[j] & (mask << bit)) != 0;
-				bool s = (bufferB[j] & (mask << bit)) != 0;
-				if (f == 1 && s == 1) {
-					a++;
-				} else if (f == 1 && s == 0) {
-					b++;
-				} else if (f == 0 && s == 1) {
-					c++;
-				} else
-					d++;
-			}
+		size_t bitsRead = readBlock(tA, pathA, blockA, bitsA - i);
+		readBlock(tB, pathB, blockB, bitsA - i);
+		ptrdiff_t words = (bitsRead + 63) / 64;
+#pragma omp parallel for reduction(+ : a, b, c)
+		for (ptrdiff_t j = 0; j < words; j++) {
+			uint64_t x = blockA[j];
+			uint64_t y = blockB[j];
+			a += popcount(x & y);
+			b += popcount(x & ~y);
+			c += popcount(~x & y);
 		}
 		i += bitsRead;
 	}
-	assert(tA);
-	assert(tB);
+	unsigned long d = bitsA - a - b - c;
 	// Result output:
 	std::cout << "1/1: " << a << "\n1/0: " << b << "\n0/1: " << c << "\n0/0: " << d << std::endl;
 	if (method == "jaccard") {
@@ -1413,6 +1671,8 @@ main(int argc, char** argv)
 		return memberOf(argc, argv);
 	} else if (command == "trim") {
 		return trim(argc, argv);
+	} else if (command == "hist") {
+		return hist(argc, argv);
 	}
 
 	cerr << PROGRAM ": unrecognized command: `" << command << "'" << endl;
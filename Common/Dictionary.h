@@ -2,14 +2,23 @@
 #define DICTIONARY_H 1
 
 #include "ConstString.h"
-#include "UnorderedMap.h"
+#include "HashFunction.h"
+#include <algorithm> // for max
 #include <cassert>
 #include <cstdlib>
+#include <cstring> // for strcmp
 #include <iostream>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
-/** A bidirectional map of indices and names. */
+/** A bidirectional map of indices and names.
+ * The names are stored in a vector. The map of names to indices is
+ * an open-addressing hash table of the hash and index of each name,
+ * which needs one random access to find a name and no further
+ * allocation once reserved. A locked dictionary may be read by
+ * multiple threads.
+ */
 class Dictionary
 {
 	public:
@@ -19,24 +28,36 @@ class Dictionary
 		typedef cstring name_reference;
 
 		typedef std::vector<const_string> Vector;
-		typedef unordered_map<name_reference, index_type,
-			hash<name_reference> > Map;
 
 		Dictionary() : m_locked(false) { }
 
 		/** Insert the specified name. */
 		index_reference insert(const name_type& name)
 		{
-			m_vec.push_back(name);
-			std::pair<Map::const_iterator, bool> inserted
-				= m_map.insert(Map::value_type(
-							m_vec.back(), m_map.size()));
-			if (!inserted.second) {
+			if (2 * (m_vec.size() + 1) > m_table.size())
+				rehash(std::max<size_t>(2 * m_table.size(), 16));
+			uint32_t h = hashName(name.c_str(), name.size());
+			size_t i = findSlot(name.c_str(), h);
+			if (m_table[i].index != 0) {
 				std::cerr << "error: duplicate ID: `"
 					<< name << "'\n";
 				abort();
 			}
-			return inserted.first->second;
+			m_vec.push_back(name);
+			m_table[i].hash = h;
+			m_table[i].index = m_vec.size();
+			return m_vec.size() - 1;
+		}
+
+		/** Reserve space for n names. */
+		void reserve(size_t n)
+		{
+			m_vec.reserve(n);
+			size_t size = 16;
+			while (size < 2 * n)
+				size *= 2;
+			if (size > m_table.size())
+				rehash(size);
 		}
 
 		/** If the specified index is within this dictionary, ensure
@@ -59,13 +80,13 @@ class Dictionary
 		/** Return the index of the specified name. */
 		index_reference getIndex(const name_type& name) const
 		{
-			Map::const_iterator it = m_map.find(name);
-			if (it == m_map.end()) {
+			index_type index = find(name);
+			if (index == 0) {
 				std::cerr << "error: unexpected ID: `"
 					<< name << "'\n";
 				abort();
 			}
-			return it->second;
+			return index - 1;
 		}
 
 		/** Return the name of the specified index. */
@@ -90,7 +111,7 @@ class Dictionary
 		/** Return the number of elements with the specified name. */
 		size_t count(const name_type& name) const
 		{
-			return m_map.count(name);
+			return find(name) != 0;
 		}
 
 		/** Return the last name in this dictionary. */
@@ -101,7 +122,62 @@ class Dictionary
 		}
 
 	private:
-		Map m_map;
+		/** A slot of the hash table. An index of zero is empty, and
+		 * is otherwise one more than the index of the name. */
+		struct Slot {
+			uint32_t hash;
+			index_type index;
+			Slot() : hash(0), index(0) { }
+		};
+
+		static uint32_t hashName(const char* s, size_t n)
+		{
+			uint64_t h = hashmem(s, n);
+			return h ^ h >> 32;
+		}
+
+		/** Return the slot of the specified name, or the empty slot
+		 * where it would be inserted. */
+		size_t findSlot(const char* name, uint32_t h) const
+		{
+			size_t mask = m_table.size() - 1;
+			for (size_t i = h & mask;; i = (i + 1) & mask) {
+				const Slot& slot = m_table[i];
+				if (slot.index == 0 || (slot.hash == h
+						&& strcmp(m_vec[slot.index - 1].c_str(),
+							name) == 0))
+					return i;
+			}
+		}
+
+		/** Return one more than the index of the specified name, or
+		 * zero if it is not found. */
+		index_type find(const name_type& name) const
+		{
+			if (m_table.empty())
+				return 0;
+			return m_table[findSlot(name.c_str(),
+					hashName(name.c_str(), name.size()))].index;
+		}
+
+		/** Resize the hash table to n slots, a power of two. */
+		void rehash(size_t n)
+		{
+			std::vector<Slot> table(n);
+			size_t mask = n - 1;
+			for (std::vector<Slot>::const_iterator it
+					= m_table.begin(); it != m_table.end(); ++it) {
+				if (it->index == 0)
+					continue;
+				size_t i = it->hash & mask;
+				while (table[i].index != 0)
+					i = (i + 1) & mask;
+				table[i] = *it;
+			}
+			m_table.swap(table);
+		}
+
+		std::vector<Slot> m_table;
 		Vector m_vec;
 		bool m_locked;
 };
@@ -0,0 +1,94 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H 1
+
+#include <cerrno>
+#include <cstdlib> // for exit
+#include <cstring> // for strerror
+#include <fcntl.h>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Defined in Uncompress.cpp. */
+bool uncompress_piped(const char* path);
+
+/** Return the size of the specified file if it is a regular file
+ * that is not decompressed through a pipe, and 0 otherwise.
+ */
+static inline size_t regularFileSize(const std::string& path)
+{
+	struct stat st;
+	if (path == "-" || uncompress_piped(path.c_str())
+			|| stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode))
+		return 0;
+	return st.st_size;
+}
+
+/** A read-only regular file mapped into memory. A file that is
+ * not a regular file, is empty or is decompressed through a pipe
+ * is not mapped, and data() returns NULL.
+ */
+class MappedFile
+{
+  public:
+	explicit MappedFile(const std::string& path)
+		: m_data(NULL), m_size(0)
+	{
+		if (regularFileSize(path) == 0)
+			return;
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+				|| st.st_size == 0) {
+			close(fd);
+			return;
+		}
+		void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) {
+			std::cerr << "error: mmap `" << path << "': "
+				<< strerror(errno) << '\n';
+			exit(EXIT_FAILURE);
+		}
+		m_data = static_cast<const char*>(p);
+		m_size = st.st_size;
+		madvise(p, m_size, MADV_SEQUENTIAL);
+	}
+
+	~MappedFile()
+	{
+		if (m_data != NULL)
+			munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	/** Return the contents of the file, or NULL if not mapped. */
+	const char* data() const { return m_data; }
+
+	/** Return the size of the file. */
+	size_t size() const { return m_size; }
+
+  private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* m_data;
+	size_t m_size;
+};
+
+/** A read-only stream buffer of a range of memory. */
+class MemoryBuf : public std::streambuf
+{
+  public:
+	MemoryBuf(const char* first, const char* last)
+	{
+		char* p = const_cast<char*>(first);
+		setg(p, p, const_cast<char*>(last));
+	}
+};
+
+#endif
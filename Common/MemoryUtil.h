@@ -4,6 +4,7 @@
 #include "config.h"
 #include <cassert>
 #include <fstream>
+#include <sys/resource.h> // for getrusage
 #include <unistd.h> // for sbrk
 
 #if __MACH__
@@ -41,4 +42,19 @@ static inline ssize_t getMemoryUsage()
 #endif
 }
 
+/** Return the peak resident set size in bytes.
+ * @return -1 on error
+ */
+static inline ssize_t getPeakMemoryUsage()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#if __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (ssize_t)usage.ru_maxrss * 1024;
+#endif
+}
+
 #endif
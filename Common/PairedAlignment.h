@@ -0,0 +1,251 @@
+#ifndef PAIREDALIGNMENT_H
+#define PAIREDALIGNMENT_H 1
+
+#include "ContigID.h" // for g_contigNames
+#include "IOUtil.h"
+#include "SAM.h"
+#include <algorithm> // for swap
+#include <cassert>
+#include <cstdlib> // for exit
+#include <cstring> // for memcmp
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** The magic number that begins a binary paired-alignment stream.
+ * The first byte may not be '@', so that the stream may be
+ * distinguished from SAM.
+ */
+static const char PAIRED_ALIGNMENT_MAGIC[8] = {
+	'\x89', 'A', 'B', 'Y', 'S', 'S', 'P', '1' };
+
+/** The alignment of a read whose mate aligns to a different contig.
+ * This record holds only the fields used by DistanceEst and is
+ * written verbatim to the binary stream of abyss-fixmate --bin.
+ */
+struct PairedAlignment {
+	/** The index of the contig to which this read aligns. */
+	uint32_t contig;
+	/** The index of the contig to which the mate aligns. */
+	uint32_t mateContig;
+	/** The position of the first base of the query on the target,
+	 * extrapolated from the start of the alignment. */
+	int32_t pos;
+	/** The distance to the first base of the mate query. */
+	int32_t isize;
+	uint8_t flag;
+	uint8_t mapq;
+	uint16_t reserved;
+
+	enum {
+		/** the read is mapped to the reverse strand */
+		FREVERSE = 1,
+		/** the mate is mapped to the reverse strand */
+		FMREVERSE = 2,
+	};
+
+	PairedAlignment() { }
+
+	/** Construct a paired alignment from a SAM record whose contig
+	 * names are found in g_contigNames. */
+	explicit PairedAlignment(const SAMRecord& o) :
+		contig(get(g_contigNames, o.rname)),
+		mateContig(get(g_contigNames, o.mrnm)),
+		pos(o.targetAtQueryStart()),
+		isize(o.isize),
+		flag((o.isReverse() ? FREVERSE : 0)
+				| (o.isMateReverse() ? FMREVERSE : 0)),
+		mapq(o.mapq > 255 ? 255 : o.mapq),
+		reserved(0) { }
+
+	bool isReverse() const { return flag & FREVERSE; }
+	bool isMateReverse() const { return flag & FMREVERSE; }
+
+	/** @see SAMAlignment::targetAtQueryStart */
+	int targetAtQueryStart() const { return pos; }
+
+	/** @see SAMRecord::mateTargetAtQueryStart */
+	int mateTargetAtQueryStart() const { return pos + isize; }
+};
+
+/** Partition the alignments by contig in place, so that no second
+ * copy of the alignments is needed.
+ * @param n the number of contigs
+ * @param[out] counts the number of alignments to each contig
+ */
+static inline void partitionPairedAlignments(
+		std::vector<PairedAlignment>& alignments, uint32_t n,
+		std::vector<uint64_t>& counts)
+{
+	counts.assign(n, 0);
+	for (std::vector<PairedAlignment>::const_iterator
+			it = alignments.begin(); it != alignments.end(); ++it) {
+		assert(it->contig < n);
+		++counts[it->contig];
+	}
+
+	// Swap each alignment into the next free slot of its bucket.
+	std::vector<uint64_t> next(n), end(n);
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < n; ++i) {
+		next[i] = sum;
+		sum += counts[i];
+		end[i] = sum;
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		while (next[i] < end[i]) {
+			PairedAlignment& a = alignments[next[i]];
+			if (a.contig == i)
+				++next[i];
+			else
+				std::swap(a, alignments[next[a.contig]++]);
+		}
+	}
+}
+
+/** Write the header of a binary stream of paired alignments, which
+ * consists of the magic number, the number of contigs, the length
+ * and name of each contig, and the number of alignments to each
+ * contig. The alignments of each contig follow in turn.
+ * @param lengths the length of each contig of g_contigNames
+ * @param counts the number of alignments to each contig
+ */
+static inline void writePairedAlignmentHeader(std::ostream& out,
+		const std::vector<unsigned>& lengths,
+		const std::vector<uint64_t>& counts)
+{
+	uint32_t n = lengths.size();
+	assert(g_contigNames.size() == n);
+	assert(counts.size() == n);
+	out.write(PAIRED_ALIGNMENT_MAGIC, sizeof PAIRED_ALIGNMENT_MAGIC);
+	out.write(reinterpret_cast<const char*>(&n), sizeof n);
+	for (uint32_t i = 0; i < n; ++i) {
+		const std::string name(get(g_contigNames, i));
+		uint32_t len = lengths[i], nameLen = name.size();
+		out.write(reinterpret_cast<const char*>(&len), sizeof len);
+		out.write(reinterpret_cast<const char*>(&nameLen),
+				sizeof nameLen);
+		out.write(name.data(), nameLen);
+	}
+	out.write(reinterpret_cast<const char*>(counts.data()),
+			n * sizeof counts[0]);
+}
+
+/** Write the specified alignments as a binary stream partitioned by
+ * contig. The alignments are bucketed by contig in place, so that
+ * the reader need not sort its input.
+ * @param lengths the length of each contig of g_contigNames
+ * @param alignments the alignments, which are cleared
+ */
+static inline void writePairedAlignments(std::ostream& out,
+		const std::vector<unsigned>& lengths,
+		std::vector<PairedAlignment>& alignments)
+{
+	std::vector<uint64_t> counts;
+	partitionPairedAlignments(alignments, lengths.size(), counts);
+	writePairedAlignmentHeader(out, lengths, counts);
+	out.write(reinterpret_cast<const char*>(alignments.data()),
+			alignments.size() * sizeof alignments[0]);
+	std::vector<PairedAlignment>().swap(alignments);
+	assert_good(out, "-");
+}
+
+/** Read a binary stream of paired alignments one contig at a time.
+ * @see writePairedAlignments
+ */
+class PairedAlignmentReader
+{
+  public:
+	/** Return whether the specified stream is a binary stream of
+	 * paired alignments rather than SAM. */
+	static bool isBinary(std::istream& in)
+	{
+		return in.peek() == (unsigned char)PAIRED_ALIGNMENT_MAGIC[0];
+	}
+
+	PairedAlignmentReader(std::istream& in) : m_in(in), m_next(0) { }
+
+	/** Read the header, add the contig names to g_contigNames and
+	 * store the contig lengths in lengths.
+	 * @return the number of contigs
+	 */
+	unsigned readHeader(std::vector<unsigned>& lengths)
+	{
+		assert(lengths.empty());
+		assert(g_contigNames.empty());
+		char magic[sizeof PAIRED_ALIGNMENT_MAGIC];
+		uint32_t n = 0;
+		m_in.read(magic, sizeof magic);
+		m_in.read(reinterpret_cast<char*>(&n), sizeof n);
+		if (!m_in || memcmp(magic, PAIRED_ALIGNMENT_MAGIC,
+					sizeof magic) != 0) {
+			std::cerr << "error: not a binary paired-alignment "
+				"stream\n";
+			exit(EXIT_FAILURE);
+		}
+
+		lengths.reserve(n);
+		std::string name;
+		for (uint32_t i = 0; i < n; ++i) {
+			uint32_t len, nameLen;
+			m_in.read(reinterpret_cast<char*>(&len), sizeof len);
+			m_in.read(reinterpret_cast<char*>(&nameLen),
+					sizeof nameLen);
+			name.resize(nameLen);
+			m_in.read(&name[0], nameLen);
+			put(g_contigNames, i, name);
+			lengths.push_back(len);
+		}
+		m_counts.resize(n);
+		m_in.read(reinterpret_cast<char*>(m_counts.data()),
+				n * sizeof m_counts[0]);
+		checkStream();
+		if (lengths.empty()) {
+			std::cerr << "error: no contigs in the binary "
+				"paired-alignment header\n";
+			exit(EXIT_FAILURE);
+		}
+		return lengths.size();
+	}
+
+	/** Read the alignments of the next contig that has any.
+	 * @return false at the end of the stream
+	 */
+	bool read(std::vector<PairedAlignment>& out)
+	{
+		assert(out.empty());
+		while (m_next < m_counts.size() && m_counts[m_next] == 0)
+			++m_next;
+		if (m_next == m_counts.size()) {
+			// Set the end-of-file flag.
+			m_in.peek();
+			return false;
+		}
+		out.resize(m_counts[m_next++]);
+		m_in.read(reinterpret_cast<char*>(out.data()),
+				out.size() * sizeof out[0]);
+		checkStream();
+		return true;
+	}
+
+  private:
+	void checkStream()
+	{
+		if (!m_in) {
+			std::cerr << "error: truncated binary paired-alignment "
+				"stream\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	std::istream& m_in;
+
+	/** The number of alignments to each contig. */
+	std::vector<uint64_t> m_counts;
+
+	/** The next contig to read. */
+	size_t m_next;
+};
+
+#endif
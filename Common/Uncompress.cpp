@@ -212,6 +212,19 @@ int open(const char *path, int flags, mode_t mode)
 
 #endif // HAVE_LIBDL
 
+/** Return whether opening the specified file opens a pipe to a
+ * program that decompresses or downloads it.
+ */
+bool uncompress_piped(const char* path)
+{
+#if HAVE_LIBDL
+	return wgetExec(path) != NULL || zcatExec(path) != NULL;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
 /** Initialize the uncompress module. */
 bool uncompress_init()
 {
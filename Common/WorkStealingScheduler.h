@@ -0,0 +1,243 @@
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H 1
+
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/** Distribute tasks from a producer to a pool of worker threads.
+ * Each worker has its own deque of tasks, to which the producer adds
+ * tasks in turn. A worker takes the oldest task at the front of its
+ * own deque and, when its deque is empty, steals the newest task at
+ * the back of another worker's deque, so that the owner and a thief
+ * contend for a deque only when it holds a single task. A worker
+ * takes the scheduler lock only to sleep when no task is available.
+ *
+ * The producer blocks while maxPending tasks are pending. A task is
+ * pending from when it is added until done is called for it. When the
+ * output of the tasks is written in order by an OrderedWriter, done
+ * is called once the output of a task has been written, so that
+ * maxPending bounds both the queued tasks and the output that awaits
+ * reordering.
+ */
+template <typename Task>
+class WorkStealingScheduler
+{
+  public:
+	WorkStealingScheduler(unsigned numThreads, size_t maxPending)
+		: m_queues(numThreads), m_next(0), m_available(0),
+		m_pending(0), m_maxPending(maxPending), m_closed(false)
+	{
+		assert(numThreads > 0);
+		assert(maxPending > 0);
+		pthread_mutex_init(&m_mutex, NULL);
+		pthread_cond_init(&m_notEmpty, NULL);
+		pthread_cond_init(&m_notFull, NULL);
+		for (unsigned i = 0; i < m_queues.size(); ++i)
+			pthread_mutex_init(&m_queues[i].mutex, NULL);
+	}
+
+	~WorkStealingScheduler()
+	{
+		for (unsigned i = 0; i < m_queues.size(); ++i)
+			pthread_mutex_destroy(&m_queues[i].mutex);
+		pthread_cond_destroy(&m_notFull);
+		pthread_cond_destroy(&m_notEmpty);
+		pthread_mutex_destroy(&m_mutex);
+	}
+
+	/** Return the number of worker threads. */
+	unsigned size() const { return m_queues.size(); }
+
+	/** Add a task to the deque of the next worker in turn.
+	 * Block while maxPending tasks are pending.
+	 * Only one thread may add tasks.
+	 */
+	void push(const Task& task)
+	{
+		pthread_mutex_lock(&m_mutex);
+		assert(!m_closed);
+		while (m_pending >= m_maxPending)
+			pthread_cond_wait(&m_notFull, &m_mutex);
+		++m_pending;
+		pthread_mutex_unlock(&m_mutex);
+
+		Queue& q = m_queues[m_next];
+		m_next = m_next + 1 < m_queues.size() ? m_next + 1 : 0;
+		pthread_mutex_lock(&q.mutex);
+		q.tasks.push_back(task);
+		pthread_mutex_unlock(&q.mutex);
+
+		// Publish the task before waking a sleeping worker, which
+		// checks m_available while holding m_mutex.
+		m_available.fetch_add(1);
+		pthread_mutex_lock(&m_mutex);
+		pthread_cond_signal(&m_notEmpty);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	/** Signal that no more tasks will be added. */
+	void close()
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_closed = true;
+		pthread_cond_broadcast(&m_notEmpty);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	/** Get a task for the specified worker. Block until a task is
+	 * available.
+	 * @return false when all tasks have been taken and no more tasks
+	 * will be added
+	 */
+	bool pop(unsigned worker, Task& task)
+	{
+		assert(worker < m_queues.size());
+		if (!reserve())
+			return false;
+
+		// The reserved task is in one of the deques.
+		for (unsigned i = worker;; i = i + 1 < m_queues.size() ? i + 1 : 0) {
+			Queue& q = m_queues[i];
+			pthread_mutex_lock(&q.mutex);
+			bool found = !q.tasks.empty();
+			if (found && i == worker) {
+				task = q.tasks.front();
+				q.tasks.pop_front();
+			} else if (found) {
+				task = q.tasks.back();
+				q.tasks.pop_back();
+			}
+			pthread_mutex_unlock(&q.mutex);
+			if (found)
+				return true;
+		}
+	}
+
+	/** Signal that n tasks returned by pop are no longer pending,
+	 * which allows the producer to add more tasks. */
+	void done(size_t n = 1)
+	{
+		if (n == 0)
+			return;
+		pthread_mutex_lock(&m_mutex);
+		assert(m_pending >= n);
+		m_pending -= n;
+		pthread_cond_broadcast(&m_notFull);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+  private:
+	WorkStealingScheduler(const WorkStealingScheduler&);
+	WorkStealingScheduler& operator=(const WorkStealingScheduler&);
+
+	/** Reserve a task that has been added to a deque and not yet
+	 * taken. Block until one is available.
+	 * @return false when no more tasks will be added
+	 */
+	bool reserve()
+	{
+		size_t n = m_available.load();
+		for (;;) {
+			if (n == 0) {
+				pthread_mutex_lock(&m_mutex);
+				while ((n = m_available.load()) == 0 && !m_closed)
+					pthread_cond_wait(&m_notEmpty, &m_mutex);
+				pthread_mutex_unlock(&m_mutex);
+				if (n == 0)
+					return false;
+			}
+			if (m_available.compare_exchange_weak(n, n - 1))
+				return true;
+		}
+	}
+
+	/** The tasks of one worker. */
+	struct Queue {
+		std::deque<Task> tasks;
+		pthread_mutex_t mutex;
+	};
+
+	std::vector<Queue> m_queues;
+
+	/** The deque to which to add the next task. */
+	unsigned m_next;
+
+	/** The number of tasks in the deques not yet reserved. */
+	std::atomic<size_t> m_available;
+
+	/** The number of pending tasks. */
+	size_t m_pending;
+	size_t m_maxPending;
+	bool m_closed;
+
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_notEmpty;
+	pthread_cond_t m_notFull;
+};
+
+/** Write the output of batches in the order of their sequence
+ * numbers, which start at zero, regardless of the order in which the
+ * batches finish.
+ */
+class OrderedWriter
+{
+  public:
+	OrderedWriter(std::ostream& out) : m_out(out), m_next(0)
+	{
+		pthread_mutex_init(&m_mutex, NULL);
+	}
+
+	~OrderedWriter()
+	{
+		assert(m_buffer.empty());
+		pthread_mutex_destroy(&m_mutex);
+	}
+
+	/** Write the output of the specified batch and of any following
+	 * batches that have finished. The string s is cleared.
+	 * @return the number of batches written, which may be zero when
+	 * the batch finished out of order
+	 */
+	size_t write(size_t index, std::string& s)
+	{
+		pthread_mutex_lock(&m_mutex);
+		assert(index >= m_next);
+		m_buffer[index].swap(s);
+		size_t n = 0;
+		for (Buffer::iterator it = m_buffer.begin();
+				it != m_buffer.end() && it->first == m_next;
+				it = m_buffer.begin()) {
+			m_out << it->second;
+			assert(m_out.good());
+			m_buffer.erase(it);
+			++m_next;
+			++n;
+		}
+		pthread_mutex_unlock(&m_mutex);
+		return n;
+	}
+
+  private:
+	OrderedWriter(const OrderedWriter&);
+	OrderedWriter& operator=(const OrderedWriter&);
+
+	typedef std::map<size_t, std::string> Buffer;
+
+	std::ostream& m_out;
+
+	/** The next batch to write. */
+	size_t m_next;
+
+	/** The output of batches that finished out of order. */
+	Buffer m_buffer;
+
+	pthread_mutex_t m_mutex;
+};
+
+#endif
@@ -1,14 +1,19 @@
 #ifndef FASTAREADER_H
 #define FASTAREADER_H 1
 
+#include "Common/MappedFile.h" // for regularFileSize
 #include "Common/Sequence.h"
 #include "Common/StringUtil.h" // for chomp
+#include <algorithm>
 #include <cassert>
 #include <cstdlib> // for exit
 #include <fstream>
 #include <istream>
 #include <limits> // for numeric_limits
 #include <ostream>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 /** Read a FASTA, FASTQ, export, qseq or SAM file. */
 class FastaReader {
@@ -196,4 +201,31 @@ struct FastqRecord : FastaRecord
 	}
 };
 
+/** Read the records of a FASTA file in parallel sections of at least
+ * 1 MB. Call f(rec) for each record, concurrently from multiple
+ * threads. A file that cannot be split, such as standard input or a
+ * compressed file, is read by one thread.
+ */
+template <typename Record, typename F>
+void readFastaSections(const char* path, int flags, F f)
+{
+	unsigned threads = 1;
+#if _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	size_t size = regularFileSize(path);
+	int n = std::max<size_t>(1, std::min<size_t>(threads, size >> 20));
+#if _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+	for (int i = 0; i < n; ++i) {
+		FastaReader in(path, flags);
+		if (n > 1)
+			in.split(i + 1, n);
+		for (Record rec; in >> rec;)
+			f(rec);
+		assert(in.eof());
+	}
+}
+
 #endif //FASTAREADER_H
@@ -2,6 +2,7 @@
 #include "Histogram.h"
 #include "IOUtil.h"
 #include "MLE.h"
+#include "PairedAlignment.h"
 #include "PMF.h"
 #include "SAM.h"
 #include "Uncompress.h"
@@ -42,7 +43,8 @@ static const char USAGE_MESSAGE[] =
 " Arguments:\n"
 "\n"
 "  HIST  distribution of fragments size\n"
-"  PAIR  alignments between contigs\n"
+"  PAIR  alignments between contigs in SAM format sorted by\n"
+"        contig, or the binary output of abyss-fixmate --bin\n"
 "\n"
 " Options:\n"
 "\n"
@@ -152,7 +154,7 @@ static const struct option longopts[] = {
 };
 
 /** A collection of aligned read pairs. */
-typedef vector<SAMRecord> Pairs;
+typedef vector<PairedAlignment> Pairs;
 
 /** Estimate the distance between two contigs using the difference of
  * the population mean and the sample mean.
@@ -336,11 +338,11 @@ static void writeEstimate(ostream& out,
 
 /** Generate distance estimates for the specified alignments. */
 static void writeEstimates(ostream& out,
-		const vector<SAMRecord>& pairs,
+		const Pairs& pairs,
 		const vector<unsigned>& lengthVec, const PMF& pmf)
 {
 	assert(!pairs.empty());
-	ContigID id0(get(g_contigNames, pairs.front().rname));
+	ContigID id0(pairs.front().contig);
 	assert(id0 < lengthVec.size());
 	unsigned len0 = lengthVec[id0];
 	if (len0 < opt::seedLen)
@@ -348,15 +350,14 @@ static void writeEstimates(ostream& out,
 
 	ostringstream ss;
 	if (opt::format == DIST)
-		ss << pairs.front().rname;
+		ss << get(g_contigNames, id0);
 
 	typedef map<ContigNode, Pairs> PairsMap;
 	PairsMap dataMap[2];
 	for (Pairs::const_iterator it = pairs.begin();
 			it != pairs.end(); ++it)
-		dataMap[it->isReverse()][find_vertex(
-				it->mrnm, it->isReverse() == it->isMateReverse(),
-				g_contigNames)]
+		dataMap[it->isReverse()][ContigNode(it->mateContig,
+				it->isReverse() == it->isMateReverse())]
 			.push_back(*it);
 
 	for (int sense0 = false; sense0 <= true; sense0++) {
@@ -398,7 +399,7 @@ static Histogram loadHist(const string& path)
  * @param[in,out] it an input iterator
  */
 template<typename It>
-static void readPairs(It& it, const It& last, vector<SAMRecord>& out)
+static void readPairs(It& it, const It& last, Pairs& out)
 {
 	assert(out.empty());
 	for (; it != last; ++it) {
@@ -406,30 +407,42 @@ static void readPairs(It& it, const It& last, vector<SAMRecord>& out)
 				|| !it->isPaired() || it->rname == it->mrnm
 				|| it->mapq < opt::minMapQ)
 			continue;
-		if (!out.empty() && out.back().rname != it->rname)
+		PairedAlignment a(*it);
+		if (!out.empty() && out.back().contig != a.contig)
 			break;
-
-		out.push_back(*it);
-		SAMRecord& sam = out.back();
-		// Clear unused fields.
-		sam.qname.clear();
-#if SAM_SEQ_QUAL
-		sam.seq.clear();
-		sam.qual.clear();
-#endif
+		out.push_back(a);
 	}
 
 	// Check that the input is sorted.
 	if (it != last && !out.empty()
-			&& get(g_contigNames, it->rname)
-				< get(g_contigNames, out.front().rname)) {
+			&& get(g_contigNames, it->rname) < out.front().contig) {
 		cerr << "error: input must be sorted: saw `"
-			<< out.front().rname << "' before `"
-			<< it->rname << "'\n";
+			<< get(g_contigNames, out.front().contig)
+			<< "' before `" << it->rname << "'\n";
 		exit(EXIT_FAILURE);
 	}
 }
 
+/** Read the alignments of the next contig from a binary stream of
+ * paired alignments, which is partitioned by contig.
+ * @return false at the end of the stream
+ */
+static bool readPairs(PairedAlignmentReader& in, Pairs& out)
+{
+	while (in.read(out)) {
+		// The binary stream holds only pairs that align to
+		// different contigs, so filter only by mapping quality.
+		out.erase(remove_if(out.begin(), out.end(),
+					[](const PairedAlignment& a) {
+						return a.mapq < opt::minMapQ;
+					}),
+				out.end());
+		if (!out.empty())
+			return true;
+	}
+	return false;
+}
+
 int main(int argc, char** argv)
 {
 	if (!opt::db.empty())
@@ -647,9 +660,12 @@ int main(int argc, char** argv)
 
 	// Read the contig lengths.
 	vector<unsigned> contigLens;
+	bool binary = PairedAlignmentReader::isBinary(in);
+	PairedAlignmentReader binaryIn(in);
 
 	vals += make_vector<int>()
-		<< readContigLengths(in, contigLens);
+		<< (binary ? binaryIn.readHeader(contigLens)
+				: readContigLengths(in, contigLens));
 
 	keys += make_vector<string>()
 		<< "CntgCounted";
@@ -659,7 +675,11 @@ int main(int argc, char** argv)
 	g_contigNames.lock();
 
 	// Estimate the distances between contigs.
-	istream_iterator<SAMRecord> it(in), last;
+	istream_iterator<SAMRecord> it, last;
+	if (binary)
+		in.peek();
+	else
+		it = istream_iterator<SAMRecord>(in);
 	if (contigLens.size() == 1) {
 		// When mapping to a single contig, no alignments spanning
 		// contigs are expected.
@@ -669,14 +689,27 @@ int main(int argc, char** argv)
 	assert(in);
 
 	g_recMA = opt::minAlign;
+	if (binary) {
 #pragma omp parallel
-	for (vector<SAMRecord> records;;) {
-		records.clear();
+		for (Pairs records;;) {
+			records.clear();
+			bool more;
 #pragma omp critical(in)
-		readPairs(it, last, records);
-		if (records.empty())
-			break;
-		writeEstimates(out, records, contigLens, pmf);
+			more = readPairs(binaryIn, records);
+			if (!more)
+				break;
+			writeEstimates(out, records, contigLens, pmf);
+		}
+	} else {
+#pragma omp parallel
+		for (Pairs records;;) {
+			records.clear();
+#pragma omp critical(in)
+			readPairs(it, last, records);
+			if (records.empty())
+				break;
+			writeEstimates(out, records, contigLens, pmf);
+		}
 	}
 
 	if (opt::verbose > 0) {
@@ -3,8 +3,11 @@
 #include <boost/tuple/tuple.hpp>
 #include <algorithm> // for swap
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <limits> // for numeric_limits
 #include <utility>
+#include <vector>
 
 using namespace std;
 using boost::tie;
@@ -32,6 +35,11 @@ class WindowFunction {
 					: 1) / (double)x1;
 		}
 
+		/** Return the breakpoints of this window function. */
+		int first() const { return x1; }
+		int second() const { return x2; }
+		int third() const { return x3; }
+
 	private:
 		/** Parameters of this window function. */
 		int x1, x2, x3;
@@ -74,27 +82,120 @@ class HannWindow {
 		int size;
 };
 
+/** The normalizing constant of the PMF f_theta(x) for any theta.
+ * Because the window function is piecewise linear, the constant is
+ * computed in constant time from the prefix sums of p(i) and i*p(i)
+ * over each linear segment of the window.
+ */
+class NormalizingConstant {
+	public:
+		NormalizingConstant(const PMF& pmf, const WindowFunction& window)
+			: m_window(window),
+			m_s0(pmf.maxValue() + 2), m_s1(pmf.maxValue() + 2)
+		{
+			for (int i = pmf.minValue(); i <= (int)pmf.maxValue(); ++i) {
+				m_s0[i + 1] = m_s0[i] + pmf[i];
+				m_s1[i + 1] = m_s1[i] + (long double)i * pmf[i];
+			}
+		}
+
+		/** Return the normalizing constant of f_theta(x). */
+		double operator()(int theta) const
+		{
+			long double x1 = m_window.first();
+			int a = theta + 1;
+			int b = theta + m_window.first();
+			int c = theta + m_window.second();
+			int d = theta + m_window.third();
+			long double sum = s0(INT_MIN, a)
+				+ s1(a, b) - theta * s0(a, b)
+				+ x1 * s0(b, c)
+				+ (long double)d * s0(c, d) - s1(c, d)
+				+ s0(d, INT_MAX);
+			return sum / x1;
+		}
+
+	private:
+		/** Return the sum of p(i) for i in [first, last). */
+		long double s0(int first, int last) const
+		{
+			return sum(m_s0, first, last);
+		}
+
+		/** Return the sum of i*p(i) for i in [first, last). */
+		long double s1(int first, int last) const
+		{
+			return sum(m_s1, first, last);
+		}
+
+		static long double sum(const vector<long double>& s,
+				int first, int last)
+		{
+			int n = s.size() - 1;
+			first = max(0, min(first, n));
+			last = max(0, min(last, n));
+			return first < last ? s[last] - s[first] : 0;
+		}
+
+		const WindowFunction& m_window;
+		vector<long double> m_s0;
+		vector<long double> m_s1;
+};
+
+/** Calculate the normalizing constant of the PMF, f_theta(x), by
+ * summing over its range.
+ */
+static double
+normalizingConstant(int theta, const PMF& pmf, const WindowFunction& window)
+{
+	double c = 0;
+	for (int i = pmf.minValue(); i <= (int)pmf.maxValue(); ++i)
+		c += pmf[i] * window(i - theta);
+	return c;
+}
+
 /** Compute the log likelihood that these samples came from the
- * specified distribution shifted by the parameter theta.
- * @param theta the parameter of the PMF, f_theta(x)
+ * specified distribution shifted by each parameter theta in
+ * [first, last]. The likelihood of every theta is computed as a
+ * correlation of the sample histogram with a table of the log PMF.
+ * The samples are accumulated in the same order for every theta,
+ * which gives the same result as evaluating each theta in turn.
  * @param samples the samples
  * @param pmf the probability mass function
- * @return the log likelihood
+ * @param[out] le the log likelihood of each theta
+ * @param[out] le_n the number of samples with a probability greater
+ * than the minimum probability for each theta
  */
-static pair<double, unsigned>
-computeLikelihood(int theta, const Histogram& samples, const PMF& pmf)
+static void
+computeLikelihoods(int first, int last, const Histogram& samples,
+		const PMF& pmf, vector<double>& le, vector<unsigned>& le_n)
 {
-	double likelihood = 0;
-	unsigned nsamples = 0;
+	assert(first <= last);
+	unsigned ntheta = last - first + 1;
+	le.assign(ntheta, 0);
+	le_n.assign(ntheta, 0);
+
+	// Tabulate the log PMF over the range of x + theta.
+	int offset = samples.minimum() + first;
+	unsigned tableSize = samples.maximum() - samples.minimum() + ntheta;
+	vector<double> logp(tableSize);
+	vector<unsigned> above(tableSize);
+	for (unsigned i = 0; i < tableSize; ++i) {
+		double p = pmf[(int)i + offset];
+		logp[i] = log(p);
+		above[i] = p > pmf.minProbability();
+	}
+
 	for (Histogram::const_iterator it = samples.begin();
 			it != samples.end(); ++it) {
-		double p = pmf[it->first + theta];
 		unsigned n = it->second;
-		likelihood += n * log(p);
-		if (p > pmf.minProbability())
-			nsamples += n;
+		const double* plogp = &logp[it->first + first - offset];
+		const unsigned* pabove = &above[it->first + first - offset];
+		for (unsigned i = 0; i < ntheta; ++i) {
+			le[i] += n * plogp[i];
+			le_n[i] += n * pabove[i];
+		}
 	}
-	return make_pair(likelihood, nsamples);
 }
 
 /** Return the most likely distance between two contigs and the number
@@ -119,35 +220,62 @@ maximumLikelihoodEstimate(int first, int last,
 	double bestLikelihood = -numeric_limits<double>::max();
 	int bestTheta = first;
 	unsigned bestn = 0;
+	if (first > last)
+		return make_pair(bestTheta, bestn);
+
 	vector<double> le;
 	vector<unsigned> le_n;
-	vector<int> le_theta;
-	for (int theta = first; theta <= last; theta++) {
-		// Calculate the normalizing constant of the PMF, f_theta(x).
-		double c = 0;
-		for (int i = pmf.minValue(); i <= (int)pmf.maxValue(); ++i)
-			c += pmf[i] * window(i - theta);
-
-		double likelihood;
-		unsigned n;
-	   	tie(likelihood, n) = computeLikelihood(theta, samples, pmf);
-		likelihood -= nsamples * log(c);
-		le.push_back(likelihood);
-		le_n.push_back(n);
-		le_theta.push_back(theta);
-	}
+	computeLikelihoods(first, last, samples, pmf, le, le_n);
+	vector<double> le_ll(le);
+	NormalizingConstant normalizingConstantOf(pmf, window);
+	for (unsigned i = 0; i < le.size(); i++)
+		le[i] -= nsamples * log(normalizingConstantOf(first + i));
 
 	HannWindow filter(filterSize);
-	for (int i = filterSize / 2; i < (int)le.size()-(filterSize / 2); i++) {
+	int halfSize = filterSize / 2;
+	vector<double> weights;
+	for (int j = -halfSize; j <= halfSize; j++)
+		weights.push_back(filter(j));
+	int end = (int)le.size() - halfSize;
+	vector<double> smoothed(le.size());
+	for (int i = halfSize; i < end; i++) {
+		double likelihood = 0;
+		const double* p = &le[i - halfSize];
+		for (int j = 0; j < (int)weights.size(); j++)
+			likelihood += weights[j] * p[j];
+		smoothed[i] = likelihood;
+		if (le_n[i] > 0 && likelihood > bestLikelihood)
+			bestLikelihood = likelihood;
+	}
+	if (bestLikelihood == -numeric_limits<double>::max())
+		return make_pair(bestTheta, bestn);
+
+	// The prefix sums may differ from summing over the range of the
+	// PMF in the last few bits. Recompute the normalizing constant
+	// by summing over the range of the PMF for those theta whose
+	// smoothed likelihood is close to the best, so that the estimate
+	// does not depend on rounding.
+	double threshold = bestLikelihood
+		- 1e-9 * (fabs(bestLikelihood) + 1);
+	vector<bool> exact(le.size());
+	bestLikelihood = -numeric_limits<double>::max();
+	for (int i = halfSize; i < end; i++) {
+		if (le_n[i] == 0 || smoothed[i] < threshold)
+			continue;
 		double likelihood = 0;
-		for (int j = -filterSize / 2; j <= filterSize / 2; j++) {
-			assert((unsigned)(i + j) < le.size() && i + j >= 0);
-			likelihood += filter(j) * le[i + j];
+		for (int j = -halfSize; j <= halfSize; j++) {
+			unsigned k = i + j;
+			if (!exact[k]) {
+				double c = normalizingConstant(first + k, pmf, window);
+				le[k] = le_ll[k] - nsamples * log(c);
+				exact[k] = true;
+			}
+			likelihood += weights[j + halfSize] * le[k];
 		}
 
-		if (le_n[i] > 0 && likelihood > bestLikelihood) {
+		if (likelihood > bestLikelihood) {
 			bestLikelihood = likelihood;
-			bestTheta = le_theta[i];
+			bestTheta = first + i;
 			bestn = le_n[i];
 		}
 	}
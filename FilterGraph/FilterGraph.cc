@@ -28,6 +28,9 @@
 #include <string>
 #include <utility>
 #include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace rel_ops;
@@ -82,6 +85,7 @@ static const char USAGE_MESSAGE[] =
     "      --gfa2              output the graph in GFA2 format\n"
     "      --gv                output the graph in GraphViz format\n"
     "      --sam               output the graph in SAM format\n"
+    "  -j, --threads=N         use N parallel threads to read input [1]\n"
     "  -v, --verbose           display verbose output\n"
     "      --help              display this help and exit\n"
     "      --version           output version information and exit\n"
@@ -136,9 +140,12 @@ static int minOverlap = 10;
 
 /** Output graph format. */
 int format = ADJ; // used by ContigProperties
+
+/** Number of threads. */
+static int threads = 1;
 }
 
-static const char shortopts[] = "c:C:g:i:r:k:l:L:m:t:T:v";
+static const char shortopts[] = "c:C:g:i:j:r:k:l:L:m:t:T:v";
 
 enum
 {
@@ -174,6 +181,7 @@ static const struct option longopts[] = {
 	{ "assemble", no_argument, &opt::assemble, 1 },
 	{ "no-assemble", no_argument, &opt::assemble, 0 },
 	{ "min-overlap", required_argument, NULL, 'm' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "verbose", no_argument, NULL, 'v' },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
@@ -642,6 +650,9 @@ main(int argc, char** argv)
 		case 'i':
 			arg >> opt::ignorePath;
 			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'r':
 			arg >> opt::removePath;
 			break;
@@ -700,16 +711,18 @@ main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	Graph g;
 	// Read the contig adjacency graph.
 	{
 		string adjPath(argv[optind++]);
 		if (opt::verbose > 0)
 			cerr << "Loading graph from file: " << adjPath << '\n';
-		ifstream fin(adjPath.c_str());
-		assert_good(fin, adjPath);
-		fin >> g;
-		assert(fin.eof());
+		read_graph_file(adjPath, g);
 	}
 
 	// Read the set of contigs to ignore.
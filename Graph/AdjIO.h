@@ -4,13 +4,20 @@
 #include "ContigID.h"
 #include "ContigGraph.h"
 #include "IOUtil.h"
+#include "MappedFile.h"
 #include <boost/graph/graph_traits.hpp>
+#include <boost/tuple/tuple.hpp>
 #include <algorithm> // for count
 #include <cassert>
 #include <cstdlib>
 #include <istream>
 #include <ostream>
+#include <sstream>
 #include <utility>
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std::rel_ops;
 using boost::graph_traits;
@@ -61,25 +68,40 @@ std::ostream& write_adj(std::ostream& out, const Graph& g)
 	return out;
 }
 
-/** Read the edges of a graph in dist format. */
+/** Add the edges of an ADJ file to a graph. */
+template <typename Graph>
+struct AddAdjEdge
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef typename Graph::edge_property_type EP;
+
+	ContigGraph<Graph>& g;
+	AddAdjEdge(ContigGraph<Graph>& g) : g(g) { }
+
+	void operator()(const V& u, const V& v, const EP& ep) const
+	{
+		assert(!edge(u, v, g).second);
+		g.Graph::add_edge(u, v, ep);
+	}
+};
+
+/** Add the edges of a DIST file to a graph.
+ * @param betterEP handle parallel edges
+ */
 template <typename Graph, typename BetterEP>
-std::istream& readDistEdges(std::istream& in, ContigGraph<Graph>& g,
-		typename graph_traits<Graph>::vertex_descriptor u,
-		BetterEP betterEP)
+struct AddDistEdge
 {
 	typedef typename graph_traits<Graph>::vertex_descriptor V;
 	typedef typename graph_traits<Graph>::edge_descriptor E;
 	typedef typename Graph::edge_property_type EP;
-	for (std::string vname; getline(in >> std::ws, vname, ',');) {
-		assert(!vname.empty());
-		V v = find_vertex(vname, g);
-		v = v ^ get(vertex_sense, g, u);
-		EP ep;
-		in >> ep;
-		assert(in);
-		if (in.peek() != ' ')
-			in >> Ignore(' ');
 
+	ContigGraph<Graph>& g;
+	BetterEP betterEP;
+	AddDistEdge(ContigGraph<Graph>& g, BetterEP betterEP)
+		: g(g), betterEP(betterEP) { }
+
+	void operator()(const V& u, const V& v, const EP& ep)
+	{
 		E e;
 		bool found;
 		boost::tie(e, found) = edge(u, v, g);
@@ -90,10 +112,108 @@ std::istream& readDistEdges(std::istream& in, ContigGraph<Graph>& g,
 		} else
 			g.Graph::add_edge(u, v, ep);
 	}
+};
+
+/** Read the edges of a graph in dist format.
+ * Call add(u, v, ep) for each edge.
+ */
+template <typename Graph, typename AddEdge>
+std::istream& readDistEdges(std::istream& in,
+		const ContigGraph<Graph>& g,
+		typename graph_traits<Graph>::vertex_descriptor u,
+		AddEdge& add)
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef typename Graph::edge_property_type EP;
+	for (std::string vname; getline(in >> std::ws, vname, ',');) {
+		assert(!vname.empty());
+		V v = find_vertex(vname, g);
+		v = v ^ get(vertex_sense, g, u);
+		EP ep;
+		in >> ep;
+		assert(in);
+		if (in.peek() != ' ')
+			in >> Ignore(' ');
+		add(u, v, ep);
+	}
 	assert(in.eof());
 	return in;
 }
 
+/** Read the vertex properties of an ADJ or FAI file.
+ * Call add(name, vp) for each vertex.
+ */
+template <typename VertexProp, typename AddVertex>
+std::istream& readAdjVertices(std::istream& in, bool faiFormat,
+		AddVertex& add)
+{
+	for (std::string uname; in >> uname;) {
+		VertexProp vp;
+		if (faiFormat) {
+			unsigned length;
+			in >> length;
+			put(vertex_length, vp, length);
+		} else
+			in >> vp;
+		in >> Ignore('\n');
+		assert(in);
+		add(uname, vp);
+	}
+	return in;
+}
+
+/** Read the edges of an ADJ or DIST file.
+ * Call add(u, v, ep) for each edge.
+ */
+template <typename Graph, typename AddEdge>
+std::istream& readAdjEdges(std::istream& in,
+		const ContigGraph<Graph>& g, bool adjFormat, AddEdge& add)
+{
+	typedef typename Graph::vertex_descriptor vertex_descriptor;
+	typedef typename Graph::edge_property_type edge_property_type;
+	for (std::string name; in >> name;) {
+		if (adjFormat)
+			in >> Ignore(';');
+		vertex_descriptor u = find_vertex(name, false, g);
+		for (int sense = false; sense <= true; ++sense) {
+			std::string s;
+			getline(in, s, !sense ? ';' : '\n');
+			assert(in.good());
+			std::istringstream ss(s);
+			if (!adjFormat) {
+				readDistEdges(ss, g, u ^ sense, add);
+			} else
+			for (std::string vname; ss >> vname;) {
+				ss >> std::ws;
+				vertex_descriptor v = find_vertex(vname, g);
+				edge_property_type ep;
+				if (ss.peek() == '[') {
+					ss.get();
+					ss >> ep >> Ignore(']');
+				}
+				add(u ^ sense, v ^ sense, ep);
+			}
+			assert(ss.eof());
+		}
+	}
+	return in;
+}
+
+/** Return the number of semicolons of the first line of an ADJ,
+ * DIST or FAI file: 2, 1 or 0 respectively.
+ */
+static inline unsigned countAdjSemicolons(const std::string& line)
+{
+	unsigned numSemicolons
+		= std::count(line.begin(), line.end(), ';');
+	if (numSemicolons > 2) {
+		std::cerr << "error: expected 0, 1 or 2 semicolons and saw "
+			<< numSemicolons << '\n';
+		exit(EXIT_FAILURE);
+	}
+	return numSemicolons;
+}
+
 /** Read a contig adjacency graph.
  * @param betterEP handle parallel edges
  */
@@ -110,19 +230,12 @@ std::istream& read_adj(std::istream& in, ContigGraph<Graph>& g,
 
 	typedef typename Graph::vertex_descriptor vertex_descriptor;
 	typedef typename Graph::vertex_property_type vertex_property_type;
-	typedef typename Graph::edge_property_type edge_property_type;
 
 	// Check for ADJ or DIST format.
 	std::string line;
 	getline(in, line);
 	assert(in);
-	unsigned numSemicolons
-		= std::count(line.begin(), line.end(), ';');
-	if (numSemicolons > 2) {
-		std::cerr << "error: expected 0, 1 or 2 semicolons and saw "
-			<< numSemicolons << '\n';
-		exit(EXIT_FAILURE);
-	}
+	unsigned numSemicolons = countAdjSemicolons(line);
 	bool faiFormat = numSemicolons == 0;
 	bool adjFormat = numSemicolons == 2;
 
@@ -132,19 +245,12 @@ std::istream& read_adj(std::istream& in, ContigGraph<Graph>& g,
 		in.clear();
 		in.seekg(0, std::ios::beg);
 		assert(in);
-		for (std::string uname; in >> uname;) {
-			vertex_property_type vp;
-			if (faiFormat) {
-				unsigned length;
-				in >> length;
-				put(vertex_length, vp, length);
-			} else
-				in >> vp;
-			in >> Ignore('\n');
-			assert(in);
+		auto add = [&g](const std::string& uname,
+				const vertex_property_type& vp) {
 			vertex_descriptor u = add_vertex(vp, g);
 			put(vertex_name, g, u, uname);
-		}
+		};
+		readAdjVertices<vertex_property_type>(in, faiFormat, add);
 		assert(in.eof());
 	}
 	assert(num_vertices(g) > 0);
@@ -157,37 +263,159 @@ std::istream& read_adj(std::istream& in, ContigGraph<Graph>& g,
 	in.clear();
 	in.seekg(0, std::ios::beg);
 	assert(in);
-	for (std::string name; in >> name;) {
-		if (adjFormat)
-			in >> Ignore(';');
-		vertex_descriptor u = find_vertex(name, false, g);
-		for (int sense = false; sense <= true; ++sense) {
-			std::string s;
-			getline(in, s, !sense ? ';' : '\n');
-			assert(in.good());
-			std::istringstream ss(s);
-			if (!adjFormat) {
-				readDistEdges(ss, g, u ^ sense, betterEP);
-			} else
-			for (std::string vname; ss >> vname;) {
-				ss >> std::ws;
-				vertex_descriptor v = find_vertex(vname, g);
-				assert(!edge(u ^ sense, v ^ sense, g).second);
-				if (ss.peek() == '[') {
-					ss.get();
-					edge_property_type ep;
-					ss >> ep >> Ignore(']');
-					g.Graph::add_edge(u ^ sense, v ^ sense, ep);
-				} else
-					g.Graph::add_edge(u ^ sense, v ^ sense);
-			}
-			assert(ss.eof());
-		}
+	if (adjFormat) {
+		AddAdjEdge<Graph> add(g);
+		readAdjEdges(in, g, adjFormat, add);
+	} else {
+		AddDistEdge<Graph, BetterEP> add(g, betterEP);
+		readAdjEdges(in, g, adjFormat, add);
 	}
 	assert(in.eof());
 	return in;
 }
 
+/** Split the range [first, last) into at most n ranges, each of at
+ * least minSize bytes, that begin at the start of a line.
+ * @return the n + 1 boundaries of the ranges
+ */
+static inline std::vector<const char*> splitLines(
+		const char* first, const char* last,
+		unsigned n, size_t minSize = 1 << 20)
+{
+	size_t size = last - first;
+	n = std::max<size_t>(1, std::min<size_t>(n, size / minSize));
+	std::vector<const char*> bounds;
+	bounds.reserve(n + 1);
+	bounds.push_back(first);
+	for (unsigned i = 1; i < n; ++i) {
+		const char* p = std::max(bounds.back(), first + size * i / n);
+		p = std::find(p, last, '\n');
+		if (p == last)
+			break;
+		bounds.push_back(p + 1);
+	}
+	bounds.push_back(last);
+	return bounds;
+}
+
+/** Read a contig adjacency graph from memory.
+ * The text is split into line-aligned ranges that are parsed in
+ * parallel in two passes. The first pass parses the vertices of each
+ * range, which are then added to the graph and the dictionary of
+ * contig names in the order of the file. The dictionary is locked
+ * and the second pass parses the edges, looking up names
+ * concurrently. A line of an ADJ file has only the out-edges of its
+ * own contig, so these edges are added by the parsing thread. The
+ * edges of a DIST file are collected per range and added in order,
+ * so that betterEP sees parallel edges in the order of the file.
+ * @param betterEP handle parallel edges
+ */
+template <typename Graph, typename BetterEP>
+void read_adj(const char* data, size_t size, ContigGraph<Graph>& g,
+		BetterEP betterEP)
+{
+	typedef typename Graph::vertex_descriptor vertex_descriptor;
+	typedef typename Graph::vertex_property_type vertex_property_type;
+	typedef typename Graph::edge_property_type edge_property_type;
+	typedef std::pair<std::string, vertex_property_type> NamedVertex;
+	typedef boost::tuple<vertex_descriptor, vertex_descriptor,
+			edge_property_type> DistEdge;
+
+	const char* last = data + size;
+	unsigned numSemicolons = countAdjSemicolons(
+			std::string(data, std::find(data, last, '\n')));
+	bool faiFormat = numSemicolons == 0;
+	bool adjFormat = numSemicolons == 2;
+
+	unsigned threads = 1;
+#if _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	std::vector<const char*> bounds = splitLines(data, last, 4 * threads);
+	int n = bounds.size() - 1;
+
+	// Read the vertex properties.
+	if (adjFormat || faiFormat) {
+		assert(num_vertices(g) == 0);
+		std::vector<std::vector<NamedVertex> > ranges(n);
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int i = 0; i < n; ++i) {
+			MemoryBuf buf(bounds[i], bounds[i + 1]);
+			std::istream in(&buf);
+			std::vector<NamedVertex>& vertices = ranges[i];
+			auto add = [&vertices](const std::string& uname,
+					const vertex_property_type& vp) {
+				vertices.push_back(NamedVertex(uname, vp));
+			};
+			readAdjVertices<vertex_property_type>(in, faiFormat, add);
+			assert(in.eof());
+		}
+
+		size_t numContigs = 0;
+		for (int i = 0; i < n; ++i)
+			numContigs += ranges[i].size();
+		g.reserve(2 * numContigs);
+		g_contigNames.reserve(numContigs);
+		for (int i = 0; i < n; ++i) {
+			for (typename std::vector<NamedVertex>::const_iterator
+					it = ranges[i].begin();
+					it != ranges[i].end(); ++it) {
+				vertex_descriptor u = add_vertex(it->second, g);
+				put(vertex_name, g, u, it->first);
+			}
+			std::vector<NamedVertex>().swap(ranges[i]);
+		}
+	}
+	assert(num_vertices(g) > 0);
+	g_contigNames.lock();
+
+	if (faiFormat)
+		return;
+
+	// Read the edges.
+	if (adjFormat) {
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int i = 0; i < n; ++i) {
+			MemoryBuf buf(bounds[i], bounds[i + 1]);
+			std::istream in(&buf);
+			AddAdjEdge<Graph> add(g);
+			readAdjEdges(in, g, adjFormat, add);
+			assert(in.eof());
+		}
+	} else {
+		std::vector<std::vector<DistEdge> > ranges(n);
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int i = 0; i < n; ++i) {
+			MemoryBuf buf(bounds[i], bounds[i + 1]);
+			std::istream in(&buf);
+			std::vector<DistEdge>& edges = ranges[i];
+			auto add = [&edges](const vertex_descriptor& u,
+					const vertex_descriptor& v,
+					const edge_property_type& ep) {
+				edges.push_back(DistEdge(u, v, ep));
+			};
+			readAdjEdges(in, g, adjFormat, add);
+			assert(in.eof());
+		}
+
+		AddDistEdge<Graph, BetterEP> add(g, betterEP);
+		for (int i = 0; i < n; ++i) {
+			for (typename std::vector<DistEdge>::const_iterator
+					it = ranges[i].begin();
+					it != ranges[i].end(); ++it)
+				add(boost::get<0>(*it), boost::get<1>(*it),
+						boost::get<2>(*it));
+			std::vector<DistEdge>().swap(ranges[i]);
+		}
+	}
+}
+
 template <typename Graph>
 class AdjWriter
 {
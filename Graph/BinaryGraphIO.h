@@ -0,0 +1,428 @@
+#ifndef BINARYGRAPHIO_H
+#define BINARYGRAPHIO_H 1
+
+#include "Common/ContigID.h" // for g_contigNames
+#include "Common/ContigNode.h"
+#include "Common/ContigProperties.h"
+#include "Common/Estimate.h"
+#include "Common/IOUtil.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/Options.h"
+#include "Graph/Properties.h"
+#include <boost/graph/graph_traits.hpp>
+#include <cassert>
+#include <climits> // for INT_MIN
+#include <cstdlib> // for exit
+#include <cstring> // for memcmp, memcpy
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using boost::graph_traits;
+
+/** The magic number that begins a binary graph. The first byte is
+ * not printable, so that a binary graph may be distinguished from
+ * the text graph formats.
+ */
+static const char BINARY_GRAPH_MAGIC[8] = {
+	'\x89', 'A', 'B', 'Y', 'S', 'S', 'G', '1' };
+
+/** The header of a binary graph.
+ *
+ * A binary graph consists of the header followed by these sections,
+ * each padded to a multiple of eight bytes:
+ * the offset of the name of each contig into the names and the total
+ * size of the names, as numContigs + 1 uint64_t;
+ * the names of the contigs, not terminated;
+ * the properties of each contig, as numContigs BinaryVertexProp;
+ * the removed flag of each contig, as numContigs uint8_t;
+ * the offset of the out-edges of each vertex into the edge arrays and
+ * the number of edges, as 2 * numContigs + 1 uint64_t;
+ * the target vertex of each edge, as numEdges uint32_t;
+ * the properties of each edge, as numEdges BinaryEdgeProp.
+ * The out-edges of vertex u are stored at the index u.index(), that
+ * is, the forward vertex of a contig followed by its reverse.
+ * All values are in the byte order of the host.
+ */
+struct BinaryGraphHeader {
+	char magic[8];
+	/** The properties stored, a combination of PropertyFlags */
+	uint32_t flags;
+	/** The size of a k-mer, or zero if unknown */
+	uint32_t k;
+	uint64_t numContigs;
+	uint64_t numEdges;
+	/** The total size of the contig names in bytes */
+	uint64_t namesSize;
+
+	enum PropertyFlags {
+		HAS_LENGTH = 1,
+		HAS_COVERAGE = 2,
+		HAS_DISTANCE = 4,
+		HAS_ESTIMATE = 8,
+	};
+};
+
+/** The properties of a contig of a binary graph. */
+struct BinaryVertexProp {
+	uint32_t length;
+	uint32_t coverage;
+};
+
+/** The properties of an edge of a binary graph. */
+struct BinaryEdgeProp {
+	int32_t distance;
+	uint32_t numPairs;
+	float stdDev;
+
+	/** The distance of an edge whose properties are the default,
+	 * which depends on the k-mer size of the reader, like an edge of
+	 * an ADJ file without properties. */
+	enum { DEFAULT_DISTANCE = INT_MIN };
+};
+
+/** Convert a vertex property to its binary representation.
+ * @return the fields stored, a combination of PropertyFlags
+ */
+template <typename VP>
+static inline uint32_t toBinary(const VP&, BinaryVertexProp& x)
+{
+	x.length = x.coverage = 0;
+	return 0;
+}
+
+static inline uint32_t toBinary(const Length& vp, BinaryVertexProp& x)
+{
+	x.length = vp.length;
+	x.coverage = 0;
+	return BinaryGraphHeader::HAS_LENGTH;
+}
+
+static inline uint32_t toBinary(const ContigProperties& vp,
+		BinaryVertexProp& x)
+{
+	x.length = vp.length;
+	x.coverage = vp.coverage;
+	return BinaryGraphHeader::HAS_LENGTH
+		| BinaryGraphHeader::HAS_COVERAGE;
+}
+
+/** Convert an edge property to its binary representation.
+ * @return the fields stored, a combination of PropertyFlags
+ */
+template <typename EP>
+static inline uint32_t toBinary(const EP&, BinaryEdgeProp& x)
+{
+	x.distance = 0;
+	x.numPairs = 0;
+	x.stdDev = 0;
+	return 0;
+}
+
+static inline uint32_t toBinary(const Distance& ep, BinaryEdgeProp& x)
+{
+	x.distance = ep == Distance()
+		? (int32_t)BinaryEdgeProp::DEFAULT_DISTANCE : ep.distance;
+	x.numPairs = 0;
+	x.stdDev = 0;
+	return BinaryGraphHeader::HAS_DISTANCE;
+}
+
+static inline uint32_t toBinary(const DistanceEst& ep,
+		BinaryEdgeProp& x)
+{
+	x.distance = ep == DistanceEst()
+		? (int32_t)BinaryEdgeProp::DEFAULT_DISTANCE : ep.distance;
+	x.numPairs = ep.numPairs;
+	x.stdDev = ep.stdDev;
+	return BinaryGraphHeader::HAS_DISTANCE
+		| BinaryGraphHeader::HAS_ESTIMATE;
+}
+
+/** Convert the binary representation of a vertex property. Fields
+ * that are not stored keep their default value. */
+template <typename VP>
+static inline void fromBinary(const BinaryVertexProp&, uint32_t, VP&)
+{
+}
+
+static inline void fromBinary(const BinaryVertexProp& x, uint32_t flags,
+		Length& vp)
+{
+	if (flags & BinaryGraphHeader::HAS_LENGTH)
+		vp.length = x.length;
+}
+
+static inline void fromBinary(const BinaryVertexProp& x, uint32_t flags,
+		ContigProperties& vp)
+{
+	if (flags & BinaryGraphHeader::HAS_LENGTH)
+		vp.length = x.length;
+	if (flags & BinaryGraphHeader::HAS_COVERAGE)
+		vp.coverage = x.coverage;
+}
+
+template <typename EP>
+static inline void fromBinary(const BinaryEdgeProp&, uint32_t, EP&)
+{
+}
+
+static inline void fromBinary(const BinaryEdgeProp& x, uint32_t flags,
+		Distance& ep)
+{
+	if ((flags & BinaryGraphHeader::HAS_DISTANCE)
+			&& x.distance != BinaryEdgeProp::DEFAULT_DISTANCE)
+		ep.distance = x.distance;
+}
+
+static inline void fromBinary(const BinaryEdgeProp& x, uint32_t flags,
+		DistanceEst& ep)
+{
+	if (x.distance == BinaryEdgeProp::DEFAULT_DISTANCE)
+		return;
+	if (flags & BinaryGraphHeader::HAS_DISTANCE)
+		ep.distance = x.distance;
+	if (flags & BinaryGraphHeader::HAS_ESTIMATE) {
+		ep.numPairs = x.numPairs;
+		ep.stdDev = x.stdDev;
+	} else
+		ep.numPairs = 0, ep.stdDev = 0;
+}
+
+/** Write n elements padded to a multiple of eight bytes. */
+template <typename T>
+static inline void writeBinarySection(std::ostream& out,
+		const T* p, size_t n)
+{
+	static const char padding[8] = { 0 };
+	size_t size = n * sizeof *p;
+	out.write(reinterpret_cast<const char*>(p), size);
+	out.write(padding, -size % 8);
+}
+
+/** Write a graph in binary format.
+ * @see BinaryGraphHeader
+ */
+template <typename Graph>
+std::ostream& write_binary_graph(std::ostream& out, const Graph& g)
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef typename graph_traits<Graph>::out_edge_iterator Eit;
+
+	uint64_t n = num_vertices(g) / 2;
+	BinaryGraphHeader header;
+	memcpy(header.magic, BINARY_GRAPH_MAGIC, sizeof header.magic);
+	header.flags = 0;
+	header.k = opt::k;
+	header.numContigs = n;
+	header.numEdges = num_edges(g);
+
+	std::vector<uint64_t> nameOffsets;
+	nameOffsets.reserve(n + 1);
+	std::string names;
+	std::vector<BinaryVertexProp> vertexProps(n);
+	std::vector<uint8_t> removed(n);
+	for (uint64_t i = 0; i < n; ++i) {
+		V u(i, false);
+		nameOffsets.push_back(names.size());
+		names += get(g_contigNames, i);
+		header.flags |= toBinary(g[u], vertexProps[i]);
+		removed[i] = get(vertex_removed, g, u);
+	}
+	nameOffsets.push_back(names.size());
+	header.namesSize = names.size();
+
+	std::vector<uint64_t> edgeOffsets;
+	edgeOffsets.reserve(2 * n + 1);
+	std::vector<uint32_t> targets;
+	targets.reserve(header.numEdges);
+	std::vector<BinaryEdgeProp> edgeProps;
+	edgeProps.reserve(header.numEdges);
+	for (uint64_t ui = 0; ui < 2 * n; ++ui) {
+		edgeOffsets.push_back(targets.size());
+		std::pair<Eit, Eit> adj = out_edges(V(ui), g);
+		for (Eit e = adj.first; e != adj.second; ++e) {
+			targets.push_back(get(vertex_index, g, target(*e, g)));
+			BinaryEdgeProp ep;
+			header.flags |= toBinary(get(edge_bundle, g, e), ep);
+			edgeProps.push_back(ep);
+		}
+	}
+	edgeOffsets.push_back(targets.size());
+	assert(targets.size() == header.numEdges);
+
+	writeBinarySection(out, &header, 1);
+	writeBinarySection(out, nameOffsets.data(), nameOffsets.size());
+	writeBinarySection(out, names.data(), names.size());
+	writeBinarySection(out, vertexProps.data(), vertexProps.size());
+	writeBinarySection(out, removed.data(), removed.size());
+	writeBinarySection(out, edgeOffsets.data(), edgeOffsets.size());
+	writeBinarySection(out, targets.data(), targets.size());
+	writeBinarySection(out, edgeProps.data(), edgeProps.size());
+	return out;
+}
+
+/** Parse a binary graph in memory.
+ * @see BinaryGraphHeader
+ */
+class BinaryGraphParser
+{
+  public:
+	BinaryGraphParser(const char* data, size_t size)
+		: m_p(data), m_end(data + size) { }
+
+	/** Return whether the specified data is a binary graph. */
+	static bool isBinary(const char* data, size_t size)
+	{
+		return size >= sizeof BINARY_GRAPH_MAGIC
+			&& memcmp(data, BINARY_GRAPH_MAGIC,
+					sizeof BINARY_GRAPH_MAGIC) == 0;
+	}
+
+	/** Return the next section of n elements. */
+	template <typename T>
+	const T* section(size_t n)
+	{
+		size_t avail = m_end - m_p;
+		size_t size = n * sizeof (T);
+		size_t padded = size + (-size % 8);
+		if (n > avail / sizeof (T) || avail < padded) {
+			std::cerr << "error: truncated binary graph\n";
+			exit(EXIT_FAILURE);
+		}
+		const T* p = reinterpret_cast<const T*>(m_p);
+		m_p += padded;
+		return p;
+	}
+
+	/** Return whether the entire graph has been parsed. */
+	bool eof() const { return m_p == m_end; }
+
+  private:
+	const char* m_p;
+	const char* m_end;
+};
+
+/** Read a binary graph from memory. Add the contigs to g if it is
+ * empty, and otherwise find the contigs of the binary graph in g.
+ * @param betterEP handle parallel edges
+ */
+template <typename Graph, typename BetterEP>
+void read_binary_graph(const char* data, size_t size,
+		ContigGraph<Graph>& g, BetterEP betterEP)
+{
+	typedef typename Graph::vertex_descriptor V;
+	typedef typename Graph::edge_descriptor E;
+	typedef typename Graph::vertex_property_type VP;
+	typedef typename Graph::edge_property_type EP;
+
+	if (!BinaryGraphParser::isBinary(data, size)) {
+		std::cerr << "error: not a binary graph\n";
+		exit(EXIT_FAILURE);
+	}
+	BinaryGraphParser parser(data, size);
+	const BinaryGraphHeader& header
+		= *parser.section<BinaryGraphHeader>(1);
+	if (header.k > 0) {
+		if (opt::k > 0 && header.k != opt::k) {
+			std::cerr << "error: the binary graph has k="
+				<< header.k << ", but k=" << opt::k
+				<< " was specified\n";
+			exit(EXIT_FAILURE);
+		}
+		opt::k = header.k;
+	}
+
+	uint64_t n = header.numContigs;
+	const uint64_t* nameOffsets = parser.section<uint64_t>(n + 1);
+	const char* names = parser.section<char>(header.namesSize);
+	const BinaryVertexProp* vertexProps
+		= parser.section<BinaryVertexProp>(n);
+	const uint8_t* removed = parser.section<uint8_t>(n);
+	const uint64_t* edgeOffsets = parser.section<uint64_t>(2 * n + 1);
+	const uint32_t* targets = parser.section<uint32_t>(header.numEdges);
+	const BinaryEdgeProp* edgeProps
+		= parser.section<BinaryEdgeProp>(header.numEdges);
+	bool corrupt = !parser.eof() || nameOffsets[0] != 0
+		|| nameOffsets[n] != header.namesSize
+		|| edgeOffsets[0] != 0
+		|| edgeOffsets[2 * n] != header.numEdges;
+	for (uint64_t i = 0; i < n && !corrupt; ++i)
+		corrupt = nameOffsets[i] > nameOffsets[i + 1];
+	for (uint64_t i = 0; i < 2 * n && !corrupt; ++i)
+		corrupt = edgeOffsets[i] > edgeOffsets[i + 1];
+	for (uint64_t i = 0; i < header.numEdges && !corrupt; ++i)
+		corrupt = targets[i] >= 2 * n;
+	if (corrupt) {
+		std::cerr << "error: corrupt binary graph\n";
+		exit(EXIT_FAILURE);
+	}
+
+	// Map the contigs of the binary graph to the vertices of g.
+	std::vector<V> vertices;
+	vertices.reserve(n);
+	bool addVertices = num_vertices(g) == 0;
+	if (addVertices) {
+		g.reserve(2 * n);
+		g_contigNames.reserve(n);
+	}
+	for (uint64_t i = 0; i < n; ++i) {
+		std::string name(names + nameOffsets[i],
+				names + nameOffsets[i + 1]);
+		if (addVertices) {
+			VP vp = VP();
+			fromBinary(vertexProps[i], header.flags, vp);
+			V u = add_vertex(vp, g);
+			put(g_contigNames, u.contigIndex(), name);
+			if (removed[i])
+				remove_vertex(u, g);
+			vertices.push_back(u);
+		} else
+			vertices.push_back(find_vertex(name, false, g));
+	}
+	g_contigNames.lock();
+
+	for (uint64_t ui = 0; ui < 2 * n; ++ui) {
+		V u = vertices[ui / 2] ^ (ui % 2);
+		for (uint64_t i = edgeOffsets[ui]; i < edgeOffsets[ui + 1];
+				++i) {
+			uint32_t vi = targets[i];
+			V v = vertices[vi / 2] ^ (vi % 2);
+			EP ep;
+			fromBinary(edgeProps[i], header.flags, ep);
+			if (addVertices) {
+				// The edges of a binary graph are unique.
+				g.Graph::add_edge(u, v, ep);
+				continue;
+			}
+			E e;
+			bool found;
+			boost::tie(e, found) = edge(u, v, g);
+			if (found) {
+				// Parallel edge
+				EP& ref = g[e];
+				ref = betterEP(ref, ep);
+			} else
+				g.Graph::add_edge(u, v, ep);
+		}
+	}
+}
+
+/** Read a binary graph from a stream.
+ * @param betterEP handle parallel edges
+ */
+template <typename Graph, typename BetterEP>
+std::istream& read_binary_graph(std::istream& in,
+		ContigGraph<Graph>& g, BetterEP betterEP)
+{
+	std::vector<char> data;
+	char buf[1 << 16];
+	while (in.read(buf, sizeof buf) || in.gcount() > 0)
+		data.insert(data.end(), buf, buf + in.gcount());
+	assert(in.eof());
+	read_binary_graph(data.data(), data.size(), g, betterEP);
+	return in;
+}
+
+#endif
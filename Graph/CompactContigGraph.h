@@ -0,0 +1,653 @@
+#ifndef COMPACTCONTIGGRAPH_H
+#define COMPACTCONTIGGRAPH_H 1
+
+#include "Common/ContigNode.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/DirectedGraph.h"
+#include "Graph/Properties.h"
+#include <cassert>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/** A read-only snapshot of a contig graph stored in compressed sparse
+ * row (CSR) form. The out-edges of all the vertices are stored in one
+ * contiguous array of targets and one contiguous array of edge
+ * properties, indexed by an array of offsets, rather than in one
+ * vector per vertex. The properties of a contig are stored once for
+ * both of its vertices. The in-edges of a vertex are the complements
+ * of the out-edges of its complement, as in ContigGraph. The graph is
+ * built once from a loaded ContigGraph and may not be modified, which
+ * allows it to be shared by threads without locking.
+ */
+template <typename VertexProp = no_property,
+		 typename EdgeProp = no_property>
+class CompactContigGraph
+{
+  public:
+	// Graph
+	typedef ContigNode vertex_descriptor;
+	typedef boost::directed_tag directed_category;
+	typedef boost::allow_parallel_edge_tag edge_parallel_category;
+	struct traversal_category
+		: boost::incidence_graph_tag,
+		boost::bidirectional_graph_tag,
+		boost::adjacency_graph_tag,
+		boost::vertex_list_graph_tag,
+		boost::edge_list_graph_tag { };
+
+	// IncidenceGraph
+	typedef std::pair<vertex_descriptor, vertex_descriptor>
+		edge_descriptor;
+	typedef unsigned degree_size_type;
+
+	// VertexListGraph
+	typedef unsigned vertices_size_type;
+
+	// EdgeListGraph
+	typedef unsigned edges_size_type;
+
+	// AdjacencyGraph
+	typedef const vertex_descriptor* adjacency_iterator;
+
+	// PropertyGraph
+	typedef VertexProp vertex_bundled;
+	typedef VertexProp vertex_property_type;
+	typedef EdgeProp edge_bundled;
+	typedef EdgeProp edge_property_type;
+
+/** Iterate through the vertices of this graph. */
+class vertex_iterator
+	: public std::iterator<std::input_iterator_tag,
+		const vertex_descriptor>
+{
+  public:
+	vertex_iterator() { }
+	explicit vertex_iterator(vertices_size_type v) : m_v(v) { }
+	const vertex_descriptor& operator*() const { return m_v; }
+
+	bool operator==(const vertex_iterator& it) const
+	{
+		return m_v == it.m_v;
+	}
+
+	bool operator!=(const vertex_iterator& it) const
+	{
+		return m_v != it.m_v;
+	}
+
+	vertex_iterator& operator++() { ++m_v; return *this; }
+	vertex_iterator operator++(int)
+	{
+		vertex_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+  private:
+	vertex_descriptor m_v;
+};
+
+/** Iterate through the out-edges. */
+class out_edge_iterator
+	: public std::iterator<std::input_iterator_tag, edge_descriptor>
+{
+  public:
+	out_edge_iterator() { }
+	out_edge_iterator(const CompactContigGraph* g, edges_size_type i,
+			vertex_descriptor src) : m_g(g), m_i(i), m_src(src) { }
+
+	edge_descriptor operator*() const
+	{
+		return edge_descriptor(m_src, m_g->m_targets[m_i]);
+	}
+
+	bool operator==(const out_edge_iterator& it) const
+	{
+		return m_i == it.m_i;
+	}
+
+	bool operator!=(const out_edge_iterator& it) const
+	{
+		return m_i != it.m_i;
+	}
+
+	out_edge_iterator& operator++() { ++m_i; return *this; }
+	out_edge_iterator operator++(int)
+	{
+		out_edge_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+	const edge_property_type& get_property() const
+	{
+		return m_g->m_edgeProps[m_i];
+	}
+
+  private:
+	const CompactContigGraph* m_g;
+	edges_size_type m_i;
+	vertex_descriptor m_src;
+};
+
+/** Iterate through the in-edges. */
+class in_edge_iterator
+	: public std::iterator<std::input_iterator_tag, edge_descriptor>
+{
+  public:
+	in_edge_iterator() { }
+	in_edge_iterator(const out_edge_iterator& it) : m_it(it) { }
+
+	/** Return the complement (~v, ~u) of the edge (u, v). */
+	edge_descriptor operator*() const
+	{
+		edge_descriptor e = *m_it;
+		return edge_descriptor(e.second ^ 1, e.first ^ 1);
+	}
+
+	bool operator==(const in_edge_iterator& it) const
+	{
+		return m_it == it.m_it;
+	}
+
+	bool operator!=(const in_edge_iterator& it) const
+	{
+		return m_it != it.m_it;
+	}
+
+	in_edge_iterator& operator++() { ++m_it; return *this; }
+	in_edge_iterator operator++(int)
+	{
+		in_edge_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+	const edge_property_type& get_property() const
+	{
+		return m_it.get_property();
+	}
+
+  private:
+	out_edge_iterator m_it;
+};
+
+/** Iterate through all the edges of this graph. */
+class edge_iterator
+	: public std::iterator<std::input_iterator_tag, edge_descriptor>
+{
+	/** Advance m_u to the source of edge m_i. */
+	void nextVertex()
+	{
+		vertices_size_type n = m_g->num_vertices();
+		while (m_u < n && m_g->m_offsets[m_u + 1] <= m_i)
+			++m_u;
+	}
+
+  public:
+	edge_iterator() { }
+
+	/** Construct an iterator to edge i, whose source is at least
+	 * vertex u. */
+	edge_iterator(const CompactContigGraph* g, edges_size_type i,
+			vertices_size_type u)
+		: m_g(g), m_i(i), m_u(u)
+	{
+		nextVertex();
+	}
+
+	edge_descriptor operator*() const
+	{
+		return edge_descriptor(ContigNode(m_u), m_g->m_targets[m_i]);
+	}
+
+	const edge_property_type& get_property() const
+	{
+		return m_g->m_edgeProps[m_i];
+	}
+
+	bool operator==(const edge_iterator& it) const
+	{
+		return m_i == it.m_i;
+	}
+
+	bool operator!=(const edge_iterator& it) const
+	{
+		return m_i != it.m_i;
+	}
+
+	edge_iterator& operator++()
+	{
+		++m_i;
+		nextVertex();
+		return *this;
+	}
+
+	edge_iterator operator++(int)
+	{
+		edge_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+  private:
+	const CompactContigGraph* m_g;
+	edges_size_type m_i;
+	vertices_size_type m_u;
+};
+
+  public:
+	/** Construct an empty graph. */
+	CompactContigGraph() : m_offsets(1, 0) { }
+
+	/** Construct a snapshot of the specified contig graph. */
+	template <typename G>
+	explicit CompactContigGraph(const ContigGraph<G>& g)
+	{
+		vertices_size_type n = g.num_vertices();
+		assert(n % 2 == 0);
+		m_offsets.reserve(n + 1);
+		m_targets.reserve(g.num_edges());
+		m_edgeProps.reserve(g.num_edges());
+		m_vertexProps.reserve(n / 2);
+		m_removed.resize(n);
+		m_offsets.push_back(0);
+		typedef typename graph_traits<G>::out_edge_iterator It;
+		for (vertices_size_type ui = 0; ui < n; ++ui) {
+			vertex_descriptor u = ContigNode(ui);
+			if (ui % 2 == 0)
+				m_vertexProps.push_back(g[u]);
+			m_removed[ui] = get(vertex_removed, g, u);
+			std::pair<It, It> adj = g.out_edges(u);
+			for (It e = adj.first; e != adj.second; ++e) {
+				m_targets.push_back(target(*e, g));
+				m_edgeProps.push_back(get(edge_bundle, g, e));
+			}
+			m_offsets.push_back(m_targets.size());
+		}
+	}
+
+	/** Swap this graph with graph x. */
+	void swap(CompactContigGraph& x)
+	{
+		m_offsets.swap(x.m_offsets);
+		m_targets.swap(x.m_targets);
+		m_edgeProps.swap(x.m_edgeProps);
+		m_vertexProps.swap(x.m_vertexProps);
+		m_removed.swap(x.m_removed);
+	}
+
+	/** Return the vertex specified by the given index. */
+	vertex_descriptor vertex(vertices_size_type ui) const
+	{
+		return ContigNode(ui);
+	}
+
+	/** Return the properties of vertex u. */
+	const vertex_property_type& operator[](vertex_descriptor u) const
+	{
+		assert(u.index() < num_vertices());
+		return m_vertexProps[u.index() / 2];
+	}
+
+	/** Return the properties of edge e. */
+	const edge_property_type& operator[](edge_descriptor e) const
+	{
+		edges_size_type i = find(e.first, e.second);
+		assert(i != NO_EDGE);
+		return m_edgeProps[i];
+	}
+
+	/** Return an iterator to the vertices of this graph. */
+	std::pair<vertex_iterator, vertex_iterator> vertices() const
+	{
+		return std::make_pair(vertex_iterator(0),
+				vertex_iterator(num_vertices()));
+	}
+
+	/** Return the number of vertices. */
+	vertices_size_type num_vertices() const
+	{
+		return m_offsets.size() - 1;
+	}
+
+	/** Return the number of edges. */
+	edges_size_type num_edges() const { return m_targets.size(); }
+
+	/** Return an iterator to the edges of this graph. */
+	std::pair<edge_iterator, edge_iterator> edges() const
+	{
+		return std::make_pair(edge_iterator(this, 0, 0),
+				edge_iterator(this, num_edges(), num_vertices()));
+	}
+
+	/** Return an iterator to the out-edges of vertex u. */
+	std::pair<out_edge_iterator, out_edge_iterator>
+	out_edges(vertex_descriptor u) const
+	{
+		unsigned ui = u.index();
+		assert(ui < num_vertices());
+		return std::make_pair(
+				out_edge_iterator(this, m_offsets[ui], u),
+				out_edge_iterator(this, m_offsets[ui + 1], u));
+	}
+
+	/** Return the out degree of vertex u. */
+	degree_size_type out_degree(vertex_descriptor u) const
+	{
+		unsigned ui = u.index();
+		assert(ui < num_vertices());
+		return m_offsets[ui + 1] - m_offsets[ui];
+	}
+
+	/** Return an iterator to the in-edges of vertex v. */
+	std::pair<in_edge_iterator, in_edge_iterator>
+	in_edges(vertex_descriptor v) const
+	{
+		std::pair<out_edge_iterator, out_edge_iterator> it
+			= out_edges(v ^ 1);
+		return std::make_pair(in_edge_iterator(it.first),
+				in_edge_iterator(it.second));
+	}
+
+	/** Return the in degree of vertex v. */
+	degree_size_type in_degree(vertex_descriptor v) const
+	{
+		return out_degree(v ^ 1);
+	}
+
+	/** Return an iterator to the vertices adjacent to vertex u. */
+	std::pair<adjacency_iterator, adjacency_iterator>
+	adjacent_vertices(vertex_descriptor u) const
+	{
+		unsigned ui = u.index();
+		assert(ui < num_vertices());
+		const vertex_descriptor* p = m_targets.data();
+		return std::make_pair(
+				p + m_offsets[ui], p + m_offsets[ui + 1]);
+	}
+
+	/** Return the edge (u,v) if it exists and a flag indicating
+	 * whether the edge exists.
+	 */
+	std::pair<edge_descriptor, bool> edge(
+			vertex_descriptor u, vertex_descriptor v) const
+	{
+		return std::make_pair(edge_descriptor(u, v),
+				find(u, v) != NO_EDGE);
+	}
+
+	/** Return true if this vertex has been removed. */
+	bool is_removed(vertex_descriptor u) const
+	{
+		return m_removed[u.index()];
+	}
+
+  private:
+	enum { NO_EDGE = ~0u };
+
+	/** Return the index of the edge (u,v) or NO_EDGE. */
+	edges_size_type find(vertex_descriptor u, vertex_descriptor v) const
+	{
+		unsigned ui = u.index();
+		assert(ui < num_vertices());
+		for (edges_size_type i = m_offsets[ui];
+				i < m_offsets[ui + 1]; ++i)
+			if (m_targets[i] == v)
+				return i;
+		return NO_EDGE;
+	}
+
+	/** The offset of the out-edges of each vertex into m_targets,
+	 * followed by the number of edges. */
+	std::vector<edges_size_type> m_offsets;
+
+	/** The target of each edge. */
+	std::vector<vertex_descriptor> m_targets;
+
+	/** The properties of each edge. */
+	std::vector<edge_property_type> m_edgeProps;
+
+	/** The properties of each contig. */
+	std::vector<vertex_property_type> m_vertexProps;
+
+	/** Flags indicating vertices that have been removed. */
+	std::vector<bool> m_removed;
+};
+
+// IncidenceGraph
+
+template <typename VP, typename EP>
+std::pair<
+	typename CompactContigGraph<VP, EP>::out_edge_iterator,
+	typename CompactContigGraph<VP, EP>::out_edge_iterator>
+out_edges(
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.out_edges(u);
+}
+
+template <typename VP, typename EP>
+typename CompactContigGraph<VP, EP>::degree_size_type
+out_degree(
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.out_degree(u);
+}
+
+// BidirectionalGraph
+
+template <typename VP, typename EP>
+std::pair<
+	typename CompactContigGraph<VP, EP>::in_edge_iterator,
+	typename CompactContigGraph<VP, EP>::in_edge_iterator>
+in_edges(
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.in_edges(u);
+}
+
+template <typename VP, typename EP>
+typename CompactContigGraph<VP, EP>::degree_size_type
+in_degree(
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.in_degree(u);
+}
+
+// AdjacencyGraph
+
+template <typename VP, typename EP>
+std::pair<
+	typename CompactContigGraph<VP, EP>::adjacency_iterator,
+	typename CompactContigGraph<VP, EP>::adjacency_iterator>
+adjacent_vertices(
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.adjacent_vertices(u);
+}
+
+// VertexListGraph
+
+template <typename VP, typename EP>
+typename CompactContigGraph<VP, EP>::vertices_size_type
+num_vertices(const CompactContigGraph<VP, EP>& g)
+{
+	return g.num_vertices();
+}
+
+template <typename VP, typename EP>
+typename CompactContigGraph<VP, EP>::vertex_descriptor
+vertex(typename CompactContigGraph<VP, EP>::vertices_size_type ui,
+		const CompactContigGraph<VP, EP>& g)
+{
+	return g.vertex(ui);
+}
+
+template <typename VP, typename EP>
+std::pair<typename CompactContigGraph<VP, EP>::vertex_iterator,
+	typename CompactContigGraph<VP, EP>::vertex_iterator>
+vertices(const CompactContigGraph<VP, EP>& g)
+{
+	return g.vertices();
+}
+
+// EdgeListGraph
+
+template <typename VP, typename EP>
+typename CompactContigGraph<VP, EP>::edges_size_type
+num_edges(const CompactContigGraph<VP, EP>& g)
+{
+	return g.num_edges();
+}
+
+template <typename VP, typename EP>
+std::pair<typename CompactContigGraph<VP, EP>::edge_iterator,
+	typename CompactContigGraph<VP, EP>::edge_iterator>
+edges(const CompactContigGraph<VP, EP>& g)
+{
+	return g.edges();
+}
+
+// AdjacencyMatrix
+
+template <typename VP, typename EP>
+std::pair<typename CompactContigGraph<VP, EP>::edge_descriptor, bool>
+edge(
+	typename CompactContigGraph<VP, EP>::vertex_descriptor u,
+	typename CompactContigGraph<VP, EP>::vertex_descriptor v,
+	const CompactContigGraph<VP, EP>& g)
+{
+	return g.edge(u, v);
+}
+
+// PropertyGraph
+
+/** Return true if this vertex has been removed. */
+template <typename VP, typename EP>
+bool get(vertex_removed_t, const CompactContigGraph<VP, EP>& g,
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u)
+{
+	return g.is_removed(u);
+}
+
+/** Return the edge properties of the edge iterator eit. */
+template <typename VP, typename EP>
+const EP&
+get(edge_bundle_t, const CompactContigGraph<VP, EP>&,
+		typename CompactContigGraph<VP, EP>::edge_iterator eit)
+{
+	return eit.get_property();
+}
+
+/** Return the edge properties of the out-edge iterator eit. */
+template <typename VP, typename EP>
+const EP&
+get(edge_bundle_t, const CompactContigGraph<VP, EP>&,
+		typename CompactContigGraph<VP, EP>::out_edge_iterator eit)
+{
+	return eit.get_property();
+}
+
+/** Return the edge properties of the in-edge iterator eit. */
+template <typename VP, typename EP>
+const EP&
+get(edge_bundle_t, const CompactContigGraph<VP, EP>&,
+		typename CompactContigGraph<VP, EP>::in_edge_iterator eit)
+{
+	return eit.get_property();
+}
+
+template <typename VP, typename EP>
+const VP&
+get(vertex_bundle_t, const CompactContigGraph<VP, EP>& g,
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u)
+{
+	return g[u];
+}
+
+template <typename VP, typename EP>
+const EP&
+get(edge_bundle_t, const CompactContigGraph<VP, EP>& g,
+		typename CompactContigGraph<VP, EP>::edge_descriptor e)
+{
+	return g[e];
+}
+
+// PropertyGraph vertex_index
+
+namespace boost {
+template <typename VP, typename EP>
+struct property_map<CompactContigGraph<VP, EP>, vertex_index_t>
+{
+	typedef ContigNodeIndexMap type;
+	typedef type const_type;
+};
+}
+
+template <typename VP, typename EP>
+ContigNodeIndexMap
+get(vertex_index_t, const CompactContigGraph<VP, EP>&)
+{
+	return ContigNodeIndexMap();
+}
+
+template <typename VP, typename EP>
+ContigNodeIndexMap::reference
+get(vertex_index_t tag, const CompactContigGraph<VP, EP>& g,
+		typename CompactContigGraph<VP, EP>::vertex_descriptor u)
+{
+	return get(get(tag, g), u);
+}
+
+/** Return the complement of the specified vertex. */
+template <typename VP, typename EP>
+ContigNode
+get(vertex_complement_t, const CompactContigGraph<VP, EP>&,
+		ContigNode u)
+{
+	return u ^ 1;
+}
+
+/** Return the contig index of the specified vertex. */
+template <typename VP, typename EP>
+ContigID
+get(vertex_contig_index_t, const CompactContigGraph<VP, EP>&,
+		ContigNode u)
+{
+	return u.contigIndex();
+}
+
+/** Return the sense of the specified vertex. */
+template <typename VP, typename EP>
+bool
+get(vertex_sense_t, const CompactContigGraph<VP, EP>&, ContigNode u)
+{
+	return u.sense();
+}
+
+// NamedGraph
+
+template <typename VP, typename EP>
+ContigNode
+find_vertex(const std::string& name,
+		const CompactContigGraph<VP, EP>&)
+{
+	return find_vertex(name, g_contigNames);
+}
+
+template <typename VP, typename EP>
+ContigNode
+find_vertex(const std::string& name, bool sense,
+		const CompactContigGraph<VP, EP>&)
+{
+	return find_vertex(name, sense, g_contigNames);
+}
+
+#endif
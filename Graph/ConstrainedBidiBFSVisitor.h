@@ -6,15 +6,85 @@
 #include "Common/IOUtil.h"
 #include "Graph/Path.h"
 #include "Graph/HashGraph.h"
+#include "Graph/TraversalGraph.h"
+#include "Graph/VertexTable.h"
 #include "Graph/BidirectionalBFSVisitor.h"
 #include "Graph/AllPathsSearch.h"
-#include "Common/MemUtils.h"
 #include <boost/graph/graph_traits.hpp>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
 
+/** A FIFO queue of vertices that keeps its storage when it is
+ * cleared. */
+template <typename V>
+class VertexQueue
+{
+  public:
+	VertexQueue() : m_head(0) { }
+
+	void clear() { m_queue.clear(); m_head = 0; }
+	bool empty() const { return m_head == m_queue.size(); }
+	size_t size() const { return m_queue.size() - m_head; }
+	const V& top() const { return m_queue[m_head]; }
+	void push(const V& v) { m_queue.push_back(v); }
+
+	void pop()
+	{
+		if (++m_head == m_queue.size())
+			clear();
+	}
+
+	/** Return the number of bytes used by the queue. */
+	size_t memUsage() const { return m_queue.size() * sizeof (V); }
+
+  private:
+	std::vector<V> m_queue;
+	size_t m_head;
+};
+
+/**
+ * The state of a bidirectional breadth-first search: the queues and
+ * colour maps of the forward and reverse traversals, the depth of
+ * each visited vertex and the traversal history. A search context
+ * may be reused by many searches, so that a thread that performs
+ * many small searches allocates memory only when a search is larger
+ * than every earlier one.
+ */
+template <typename V>
+struct BidiBFSSearchContext
+{
+	typedef unsigned short depth_t;
+
+	VertexQueue<V> queue[2];
+	VertexTableColorMap<V> color[2];
+	VertexTable<V, depth_t> depth[2];
+	TraversalGraph<V> traversal[2];
+
+	/** Reset the context for a new search. */
+	void clear()
+	{
+		for (unsigned i = 0; i < 2; ++i) {
+			queue[i].clear();
+			color[i].table.clear();
+			depth[i].clear();
+			traversal[i].clear();
+		}
+	}
+
+	/** Return the number of bytes used by the current search. */
+	size_t memUsage() const
+	{
+		size_t n = 0;
+		for (unsigned i = 0; i < 2; ++i) {
+			n += queue[i].memUsage() + color[i].table.memUsage()
+				+ depth[i].memUsage() + traversal[i].memUsage();
+		}
+		return n;
+	}
+};
+
 template <typename G>
 class ConstrainedBidiBFSVisitor : public BidirectionalBFSVisitor<G>
 {
@@ -25,7 +95,7 @@ protected:
 	typedef typename boost::graph_traits<G>::edge_descriptor E;
 	typedef unsigned short depth_t;
 	typedef std::vector< Path<V> > PathList;
-	typedef unordered_map<V, depth_t, hash<V> > DepthMap;
+	typedef BidiBFSSearchContext<V> SearchContext;
 
 	struct EdgeHash {
 		const G& m_g;
@@ -46,11 +116,12 @@ protected:
 	/** maximum number of paths to discover before aborting search */
 	unsigned m_maxPaths;
 
-	/** records history of forward/reverse traversals */
-	HashGraph<V> m_traversalGraph[2];
+	/** search state used when the caller does not provide one */
+	SearchContext m_ownContext;
 
-	/** records depth of vertices during forward/reverse traversal */
-	DepthMap m_depthMap[2];
+	/** records depth of vertices and history of forward/reverse
+	 * traversals */
+	SearchContext& m_context;
 
 	/** depth limits for forward/reverse traversal */
 	depth_t m_maxDepth[2];
@@ -104,12 +175,14 @@ public:
 		depth_t maxPathLength,
 		unsigned maxBranches,
 		unsigned maxCost,
-		size_t memLimit
+		size_t memLimit,
+		SearchContext* context = NULL
 		) :
 			m_graph(graph),
 			m_start(start),
 			m_goal(goal),
 			m_maxPaths(maxPaths),
+			m_context(context != NULL ? *context : m_ownContext),
 			m_minPathLength(minPathLength),
 			m_maxPathLength(maxPathLength),
 			m_maxBranches(maxBranches),
@@ -125,6 +198,7 @@ public:
 			m_numNodesVisited(0),
 			m_commonEdges(m_maxPaths, EdgeHash(m_graph))
 	{
+		m_context.clear();
 
 		depth_t maxDepth = maxPathLength - 1;
 		m_maxDepth[FORWARD] = maxDepth / 2 + maxDepth % 2;
@@ -214,7 +288,8 @@ public:
 
 		const V& parent = (dir == FORWARD) ? u : v;
 
-		if (m_depthMap[dir][parent] >= m_maxDepth[dir])
+		const depth_t* parentDepth = m_context.depth[dir].find(parent);
+		if ((parentDepth == NULL ? 0 : *parentDepth) >= m_maxDepth[dir])
 			return SKIP_ELEMENT;
 
 		return recordCommonEdge(e);
@@ -272,23 +347,22 @@ public:
 		return m_cost;
 	}
 
+	/** Return the number of bytes used by the search state. */
 	size_t approxMemUsage()
 	{
-		return
-			m_traversalGraph[FORWARD].approxMemSize() +
-			m_traversalGraph[REVERSE].approxMemSize() +
-			approxMemSize(m_depthMap[FORWARD]) +
-			approxMemSize(m_depthMap[REVERSE]);
+		return m_context.memUsage();
 	}
 
 	void getTraversalGraph(HashGraph<V>& traversalGraph)
 	{
-		typedef typename HashGraph<V>::vertex_iterator vertex_iterator;
-		typedef typename HashGraph<V>::adjacency_iterator adjacency_iterator;
+		typedef typename boost::graph_traits< TraversalGraph<V> >
+			::vertex_iterator vertex_iterator;
+		typedef typename boost::graph_traits< TraversalGraph<V> >
+			::adjacency_iterator adjacency_iterator;
 
 		Direction dir[] = { FORWARD, REVERSE };
 		for (unsigned i = 0; i < 2; i++) {
-			HashGraph<V>& g = m_traversalGraph[dir[i]];
+			const TraversalGraph<V>& g = m_context.traversal[dir[i]];
 			vertex_iterator vi, vi_end;
 			boost::tie(vi, vi_end) = vertices(g);
 			for(; vi != vi_end; vi++) {
@@ -367,9 +441,9 @@ protected:
 		V v = target(e, g);
 
 		if (dir == FORWARD)
-			add_edge(v, u, m_traversalGraph[FORWARD]);
+			add_edge(v, u, m_context.traversal[FORWARD]);
 		else
-			add_edge(u, v, m_traversalGraph[REVERSE]);
+			add_edge(u, v, m_context.traversal[REVERSE]);
 
 		return result;
 	}
@@ -384,12 +458,12 @@ protected:
 		const V& parent = (dir == FORWARD) ? source(e, g) : target(e, g);
 		const V& child = (dir == FORWARD) ? target(e, g) : source(e, g);
 
-		depth_t parentDepth = m_depthMap[dir][parent];
+		depth_t parentDepth = m_context.depth[dir][parent];
 		if (parentDepth == m_maxDepth[dir])
 			return false;
 
 		depth_t childDepth = parentDepth + 1;
-		m_depthMap[dir][child] = childDepth;
+		m_context.depth[dir][child] = childDepth;
 
 		if (childDepth > m_maxDepthVisited[dir])
 			m_maxDepthVisited[dir] = childDepth;
@@ -439,7 +513,7 @@ protected:
 		PathSearchResult resultCode;
 	
 		AllPathsSearchResult<V> leftResult = allPathsSearch(
-			m_traversalGraph[FORWARD], u, m_start, maxPathsToStart,
+			m_context.traversal[FORWARD], u, m_start, maxPathsToStart,
 			0, m_maxDepth[FORWARD], m_maxCost - m_cost);
 		m_cost += leftResult.cost;
 		resultCode = leftResult.resultCode;
@@ -452,7 +526,7 @@ protected:
 				(m_maxPaths - m_pathsFound.size()) / leftResult.paths.size();
 
 			AllPathsSearchResult<V> rightResult =
-				allPathsSearch(m_traversalGraph[REVERSE], v, m_goal,
+				allPathsSearch(m_context.traversal[REVERSE], v, m_goal,
 				maxPathsToGoal, 0, m_maxDepth[REVERSE], m_maxCost - m_cost);
 			m_cost += rightResult.cost;
 			resultCode = rightResult.resultCode;
@@ -6,10 +6,15 @@
 #include "Graph/ContigGraph.h"
 #include "Graph/DirectedGraph.h"
 #include "Graph/Properties.h"
+#include "Common/UnorderedMap.h"
+#include "Common/UnorderedSet.h"
 #include <algorithm>
 #include <climits> // for INT_MIN
 #include <cassert>
+#include <functional> // for greater
 #include <istream>
+#include <queue>
+#include <stdint.h>
 #include <utility>
 #include <vector>
 
@@ -144,4 +149,342 @@ bool constrainedSearch(const Graph& g,
 }
 
 
+/** Find paths through a graph that satisfy distance constraints.
+ * The search finds the same solutions in the same order as
+ * constrainedSearch, but it visits fewer vertices, so that fewer
+ * searches exceed opt::maxCost:
+ *
+ * - A branch is pruned as soon as the shortest distance from its
+ *   last vertex to the target of an unsatisfied constraint exceeds
+ *   that constraint. The shortest distances are found by a Dijkstra
+ *   search backward from each target, bounded by its constraint.
+ * - The states (vertex, distance, satisfied constraints) from which
+ *   no solution was found are remembered and not searched again.
+ *   States are remembered when there are at most 64 constraints.
+ * - The depth-first search uses an explicit stack.
+ *
+ * The graph is read-only, and one instance may be used by many
+ * threads at once.
+ */
+template <typename Graph>
+class ConstrainedSearch
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef typename graph_traits<Graph>::vertex_iterator
+		vertex_iterator;
+	typedef typename graph_traits<Graph>::out_edge_iterator
+		out_edge_iterator;
+	typedef typename graph_traits<Graph>::in_edge_iterator
+		in_edge_iterator;
+
+	/** The distance to a vertex from which a target is unreachable. */
+	enum { UNREACHABLE = INT_MAX };
+
+  public:
+	/** @param g the graph, which must not be modified while this
+	 * object is used */
+	explicit ConstrainedSearch(const Graph& g) : m_g(g), m_bounded(true)
+	{
+		// A shortest distance is a lower bound of the distance of any
+		// path only when no edge shortens a path.
+		std::pair<vertex_iterator, vertex_iterator> uit = vertices(g);
+		for (vertex_iterator u = uit.first; u != uit.second; ++u) {
+			std::pair<out_edge_iterator, out_edge_iterator>
+				adj = out_edges(*u, g);
+			for (out_edge_iterator e = adj.first; e != adj.second; ++e)
+				if (g[*u].length + get(edge_bundle, g, e).distance < 0)
+					m_bounded = false;
+		}
+	}
+
+	/** Find paths through the graph that satisfy the constraints.
+	 * @param cost [out] the number of vertices visited
+	 * @return false if the search exited early
+	 * @see constrainedSearch
+	 */
+	bool operator()(V origin, Constraints& constraints,
+			ContigPaths& solutions, unsigned& cost) const
+	{
+		if (constraints.empty())
+			return false;
+
+		// Sort the constraints by ID.
+		sort(constraints.begin(), constraints.end());
+
+		Search search(*this, origin, constraints, solutions, cost);
+		search.run();
+		return cost >= opt::maxCost ? false : !solutions.empty();
+	}
+
+  private:
+	/** A state of the depth-first search. */
+	struct State {
+		V v;
+		int distance;
+		uint64_t satisfied;
+
+		bool operator==(const State& o) const
+		{
+			return v == o.v && distance == o.distance
+				&& satisfied == o.satisfied;
+		}
+	};
+
+	struct HashState {
+		size_t operator()(const State& o) const
+		{
+			uint64_t x = ((uint64_t)hash_value(o.v) << 32)
+				^ (uint32_t)o.distance;
+			x = (x ^ (x >> 29)) * 0xbf58476d1ce4e5b9ULL
+				^ o.satisfied * 0x94d049bb133111ebULL;
+			return x ^ (x >> 32);
+		}
+	};
+
+	/** The vertex and the next out-edge of a frame of the stack. */
+	struct Frame {
+		V v;
+		/** The distance to the end of v. */
+		int end;
+		out_edge_iterator it, last;
+		/** The constraint satisfied by v, or UINT_MAX. */
+		unsigned satisfied;
+		/** The number of solutions found before v. */
+		size_t numSolutions;
+		State state;
+	};
+
+	/** The state of one search. */
+	class Search
+	{
+	  public:
+		Search(const ConstrainedSearch& engine, V origin,
+				const Constraints& constraints,
+				ContigPaths& solutions, unsigned& cost)
+			: m_g(engine.m_g), m_bounded(engine.m_bounded),
+			m_origin(origin), m_constraints(constraints),
+			m_solutions(solutions), m_cost(cost),
+			m_satisfied(constraints.size()), m_numSatisfied(0),
+			m_memoize(constraints.size() <= 64), m_satisfiedMask(0)
+		{
+			if (m_bounded)
+				findBounds();
+		}
+
+		/** Search the graph. */
+		void run()
+		{
+			pushFrame(m_origin, 0, UINT_MAX, State());
+			while (!m_stack.empty()) {
+				Frame& top = m_stack.back();
+				if (top.it == top.last) {
+					popFrame();
+					continue;
+				}
+				V v = target(*top.it, m_g);
+				int distance = top.end
+					+ get(edge_bundle, m_g, top.it).distance;
+				++top.it;
+				if (!visit(v, distance))
+					return;
+			}
+		}
+
+	  private:
+		/** Visit vertex v at the specified distance from the origin.
+		 * @return false if the search should exit early
+		 */
+		bool visit(V v, int distance)
+		{
+			unsigned satisfied = UINT_MAX;
+			unsigned i = findConstraint(v);
+			if (i != UINT_MAX && !m_satisfied[i]) {
+				if (distance > m_constraints[i].second)
+					return true; // This constraint cannot be met.
+				if (m_numSatisfied + 1 == m_constraints.size()) {
+					// All the constraints have been satisfied.
+					m_path.push_back(v);
+					m_solutions.push_back(m_path);
+					m_path.pop_back();
+					return m_solutions.size() <= opt::maxPaths;
+				}
+				// This constraint has been satisfied.
+				satisfied = i;
+				setSatisfied(i, true);
+			}
+
+			State state;
+			state.v = v;
+			state.distance = distance;
+			state.satisfied = m_memoize ? m_satisfiedMask : 0;
+			if ((m_memoize && m_dead.count(state) > 0)
+					|| !feasible(v, distance)) {
+				if (satisfied != UINT_MAX)
+					setSatisfied(satisfied, false);
+				return true;
+			}
+
+			if (++m_cost >= opt::maxCost)
+				return false; // Too complex.
+
+			m_path.push_back(v);
+			pushFrame(v, distance + m_g[v].length, satisfied, state);
+			return true;
+		}
+
+		/** Return whether every unsatisfied constraint may yet be met
+		 * from vertex v at the specified distance. */
+		bool feasible(V v, int distance) const
+		{
+			const int* bounds = NULL;
+			if (m_bounded) {
+				typename Bounds::const_iterator it
+					= m_bounds.find(hash_value(v));
+				if (it == m_bounds.end())
+					return false;
+				bounds = &it->second[0];
+			}
+			for (unsigned i = 0; i < m_constraints.size(); ++i) {
+				if (m_satisfied[i])
+					continue;
+				int bound = bounds == NULL ? 0 : bounds[i];
+				if (bound == UNREACHABLE
+						|| distance > m_constraints[i].second - bound)
+					return false;
+			}
+			return true;
+		}
+
+		void pushFrame(V v, int end, unsigned satisfied,
+				const State& state)
+		{
+			Frame frame;
+			frame.v = v;
+			frame.end = end;
+			std::pair<out_edge_iterator, out_edge_iterator>
+				adj = out_edges(v, m_g);
+			frame.it = adj.first;
+			frame.last = adj.second;
+			frame.satisfied = satisfied;
+			frame.numSolutions = m_solutions.size();
+			frame.state = state;
+			m_stack.push_back(frame);
+		}
+
+		/** Leave the vertex at the top of the stack, and remember its
+		 * state if no solution was found from it. */
+		void popFrame()
+		{
+			const Frame& top = m_stack.back();
+			bool isOrigin = m_stack.size() == 1;
+			if (m_memoize && !isOrigin
+					&& m_solutions.size() == top.numSolutions)
+				m_dead.insert(top.state);
+			if (top.satisfied != UINT_MAX)
+				setSatisfied(top.satisfied, false);
+			m_stack.pop_back();
+			if (!isOrigin)
+				m_path.pop_back();
+		}
+
+		void setSatisfied(unsigned i, bool satisfied)
+		{
+			m_satisfied[i] = satisfied;
+			m_numSatisfied += satisfied ? 1 : -1;
+			if (m_memoize)
+				m_satisfiedMask ^= (uint64_t)1 << i;
+		}
+
+		/** Return the index of the constraint of vertex v or
+		 * UINT_MAX. */
+		unsigned findConstraint(V v) const
+		{
+			Constraints::const_iterator it = lower_bound(
+					m_constraints.begin(), m_constraints.end(),
+					v, compareID);
+			return it != m_constraints.end() && it->first == v
+				? it - m_constraints.begin() : UINT_MAX;
+		}
+
+		/** Find the shortest distance from the start of each vertex
+		 * to the start of the target of each constraint. The search
+		 * from a target stops at the distance of its constraint,
+		 * allowing for the overlap of the edges of the origin.
+		 */
+		void findBounds()
+		{
+			int minDistance = 0;
+			std::pair<out_edge_iterator, out_edge_iterator>
+				adj = out_edges(m_origin, m_g);
+			for (out_edge_iterator e = adj.first; e != adj.second; ++e)
+				minDistance = std::min(minDistance,
+						get(edge_bundle, m_g, e).distance);
+
+			typedef std::pair<int, V> Entry;
+			typedef std::priority_queue<Entry, std::vector<Entry>,
+					std::greater<Entry> > Queue;
+			unsigned n = m_constraints.size();
+			for (unsigned i = 0; i < n; ++i) {
+				int maxBound = m_constraints[i].second - minDistance;
+				Queue queue;
+				queue.push(Entry(0, m_constraints[i].first));
+				while (!queue.empty()) {
+					Entry entry = queue.top();
+					queue.pop();
+					V v = entry.second;
+					std::vector<int>& bounds = boundsOf(v, n);
+					if (bounds[i] <= entry.first)
+						continue; // already settled
+					bounds[i] = entry.first;
+					std::pair<in_edge_iterator, in_edge_iterator>
+						in = in_edges(v, m_g);
+					for (in_edge_iterator e = in.first;
+							e != in.second; ++e) {
+						V u = source(*e, m_g);
+						int d = entry.first + m_g[u].length
+							+ m_g[*e].distance;
+						if (d <= maxBound)
+							queue.push(Entry(d, u));
+					}
+				}
+			}
+		}
+
+		std::vector<int>& boundsOf(V v, unsigned n)
+		{
+			std::vector<int>& bounds = m_bounds[hash_value(v)];
+			if (bounds.empty())
+				bounds.resize(n, UNREACHABLE);
+			return bounds;
+		}
+
+		typedef unordered_map<unsigned, std::vector<int> > Bounds;
+
+		const Graph& m_g;
+		bool m_bounded;
+		V m_origin;
+		const Constraints& m_constraints;
+		ContigPaths& m_solutions;
+		unsigned& m_cost;
+
+		/** The lower bound of the distance from each vertex to the
+		 * target of each constraint. */
+		Bounds m_bounds;
+
+		std::vector<bool> m_satisfied;
+		unsigned m_numSatisfied;
+		bool m_memoize;
+		uint64_t m_satisfiedMask;
+
+		/** The states from which no solution was found. */
+		unordered_set<State, HashState> m_dead;
+
+		std::vector<Frame> m_stack;
+		ContigPath m_path;
+	};
+
+	const Graph& m_g;
+	bool m_bounded;
+};
+
 #endif
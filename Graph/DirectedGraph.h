@@ -347,6 +347,9 @@ class Edge
 	/** Create a graph with n vertices and zero edges. */
 	DirectedGraph(vertices_size_type n) : m_vertices(n) { }
 
+	/** Reserve space for n vertices. */
+	void reserve(vertices_size_type n) { m_vertices.reserve(n); }
+
 	/** Swap this graph with graph x. */
 	void swap(DirectedGraph& x)
 	{
@@ -4,13 +4,18 @@
 #include "Graph/Options.h"
 #include "AdjIO.h"
 #include "AsqgIO.h"
+#include "BinaryGraphIO.h"
 #include "DistIO.h"
 #include "DotIO.h"
 #include "FastaIO.h"
 #include "GfaIO.h"
 #include "SAMIO.h"
 #include <cassert>
+#include <cctype> // for isprint, isspace
 #include <cstdlib> // for abort
+#include <cstring> // for strchr
+#include <fstream>
+#include <iostream>
 #include <istream>
 #include <ostream>
 #include <string>
@@ -27,6 +32,8 @@ std::ostream& write_graph(std::ostream& out, const Graph& g,
 		return out << adj_writer<Graph>(g);
 	  case ASQG:
 		return write_asqg(out, g);
+	  case BINARY:
+		return write_binary_graph(out, g);
 	  case DIST:
 		return write_dist(out, g);
 	  case DOT: case DOT_MEANCOV:
@@ -53,6 +60,8 @@ std::istream& read_graph(std::istream& in, ContigGraph<Graph>& g,
 	in >> std::ws;
 	assert(in);
 	switch (in.peek()) {
+	  case 0x89: // \x89ABYSSG: binary format
+		return read_binary_graph(in, g, betterEP);
 	  case '@': // @SQ: SAM format
 		return read_sam_header(in, g);
 	  case 'd': // digraph: GraphViz dot format (directed graph)
@@ -99,4 +108,45 @@ std::istream& operator>>(std::istream& in, ContigGraph<Graph>& g)
 	return read_graph(in, g, DisallowParallelEdges());
 }
 
+/** Read a graph from the specified file, or from standard input if
+ * the path is "-". A regular file is mapped into memory. A binary
+ * graph is read directly from memory, and an ADJ or DIST graph is
+ * parsed in parallel. Other formats are read through a stream.
+ */
+template <typename Graph, typename BetterEP>
+void read_graph_file(const std::string& path, ContigGraph<Graph>& g,
+		BetterEP betterEP)
+{
+	{
+		MappedFile file(path);
+		const char* p = file.data();
+		const char* last = p + file.size();
+		if (BinaryGraphParser::isBinary(p, file.size())) {
+			read_binary_graph(p, file.size(), g, betterEP);
+			return;
+		}
+		while (p != last && isspace((unsigned char)*p))
+			++p;
+		if (p != last && isprint((unsigned char)*p)
+				&& !strchr("@dgH>", *p)) {
+			read_adj(p, last - p, g, betterEP);
+			return;
+		}
+	}
+	std::ifstream fin;
+	if (path != "-")
+		fin.open(path.c_str());
+	std::istream& in = path == "-" ? std::cin : fin;
+	assert_good(in, path);
+	read_graph(in, g, betterEP);
+	assert(in.eof());
+}
+
+/** Read a graph from the specified file. */
+template <typename Graph>
+void read_graph_file(const std::string& path, ContigGraph<Graph>& g)
+{
+	read_graph_file(path, g, DisallowParallelEdges());
+}
+
 #endif
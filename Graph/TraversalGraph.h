@@ -0,0 +1,355 @@
+#ifndef TRAVERSALGRAPH_H
+#define TRAVERSALGRAPH_H 1
+
+#include "Graph/VertexTable.h"
+#include <boost/graph/graph_traits.hpp>
+#include <iterator>
+#include <limits>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * A directed graph that records the history of a graph search.
+ * The successors of each vertex are kept in a singly-linked list in
+ * the order in which they were added, and all lists share one edge
+ * pool. Clearing the graph keeps its storage, so that one graph may
+ * be reused by many searches without allocating memory.
+ */
+template <typename V>
+class TraversalGraph
+{
+  public:
+	typedef V vertex_descriptor;
+	typedef std::pair<V, V> edge_descriptor;
+	typedef unsigned degree_size_type;
+	typedef unsigned vertices_size_type;
+
+	/** The end of a list of successors. */
+	static const uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+	/** The list of successors of a vertex. */
+	struct Node {
+		uint32_t head;
+		uint32_t tail;
+		degree_size_type degree;
+		Node() : head(NIL), tail(NIL), degree(0) { }
+	};
+
+	/** An element of a list of successors. */
+	struct Edge {
+		V v;
+		uint32_t next;
+	};
+
+	typedef VertexTable<V, Node> VertexMap;
+
+	/** Remove all vertices and edges and keep the storage. */
+	void clear()
+	{
+		m_vertices.clear();
+		m_edges.clear();
+	}
+
+	/** Add the edge (u,v) unless it exists already.
+	 * @return the edge and whether it was inserted
+	 */
+	std::pair<edge_descriptor, bool> add_edge(const V& u, const V& v)
+	{
+		Node& node = *m_vertices.insert(u, Node()).first;
+		bool inserted = true;
+		for (uint32_t i = node.head; i != NIL; i = m_edges[i].next) {
+			if (m_edges[i].v == v) {
+				inserted = false;
+				break;
+			}
+		}
+		if (inserted) {
+			Edge edge = { v, NIL };
+			uint32_t i = m_edges.size();
+			m_edges.push_back(edge);
+			if (node.tail == NIL)
+				node.head = i;
+			else
+				m_edges[node.tail].next = i;
+			node.tail = i;
+			++node.degree;
+		}
+		m_vertices.insert(v, Node());
+		return std::make_pair(edge_descriptor(u, v), inserted);
+	}
+
+	/** Return the first successor of the specified vertex. */
+	uint32_t head(const V& u) const
+	{
+		const Node* node = m_vertices.find(u);
+		return node == NULL ? NIL : node->head;
+	}
+
+	/** Return the number of successors of the specified vertex. */
+	degree_size_type out_degree(const V& u) const
+	{
+		const Node* node = m_vertices.find(u);
+		return node == NULL ? 0 : node->degree;
+	}
+
+	/** Return the specified element of a list of successors. */
+	const Edge& edge(uint32_t i) const { return m_edges[i]; }
+
+	/** Return the vertex table. */
+	const VertexMap& vertexMap() const { return m_vertices; }
+
+	/** Return the number of vertices. */
+	vertices_size_type num_vertices() const { return m_vertices.size(); }
+
+	/** Return the number of edges. */
+	size_t num_edges() const { return m_edges.size(); }
+
+	/** Return the number of bytes used by the vertices and edges. */
+	size_t memUsage() const
+	{
+		return m_vertices.memUsage() + m_edges.size() * sizeof (Edge);
+	}
+
+  private:
+	VertexMap m_vertices;
+	std::vector<Edge> m_edges;
+};
+
+namespace boost {
+
+template <typename V>
+struct graph_traits< TraversalGraph<V> > {
+	typedef TraversalGraph<V> G;
+
+	// Graph
+	typedef V vertex_descriptor;
+	typedef std::pair<V, V> edge_descriptor;
+	typedef boost::directed_tag directed_category;
+	typedef boost::disallow_parallel_edge_tag edge_parallel_category;
+	struct traversal_category
+		: boost::incidence_graph_tag,
+		boost::adjacency_graph_tag,
+		boost::vertex_list_graph_tag { };
+
+	// IncidenceGraph
+	typedef unsigned degree_size_type;
+
+	// BidirectionalGraph
+	typedef void in_edge_iterator;
+
+	// VertexListGraph
+	typedef unsigned vertices_size_type;
+
+	// EdgeListGraph
+	typedef void edge_iterator;
+	typedef void edges_size_type;
+
+	/** Iterate through the successors of a vertex. */
+	class adjacency_iterator
+		: public std::iterator<std::input_iterator_tag, vertex_descriptor>
+	{
+	  public:
+		adjacency_iterator() : m_g(NULL), m_i(G::NIL) { }
+		adjacency_iterator(const G& g, uint32_t i) : m_g(&g), m_i(i) { }
+
+		const vertex_descriptor& operator*() const
+		{
+			return m_g->edge(m_i).v;
+		}
+
+		bool operator==(const adjacency_iterator& it) const
+		{
+			return m_i == it.m_i;
+		}
+
+		bool operator!=(const adjacency_iterator& it) const
+		{
+			return m_i != it.m_i;
+		}
+
+		adjacency_iterator& operator++()
+		{
+			m_i = m_g->edge(m_i).next;
+			return *this;
+		}
+
+		adjacency_iterator operator++(int)
+		{
+			adjacency_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+	  private:
+		const G* m_g;
+		uint32_t m_i;
+	};
+
+	/** Iterate through the out-edges of a vertex. */
+	class out_edge_iterator
+		: public std::iterator<std::input_iterator_tag, edge_descriptor>
+	{
+	  public:
+		out_edge_iterator() { }
+		out_edge_iterator(const G& g, const vertex_descriptor& u,
+				uint32_t i)
+			: m_u(u), m_it(g, i) { }
+
+		edge_descriptor operator*() const
+		{
+			return edge_descriptor(m_u, *m_it);
+		}
+
+		bool operator==(const out_edge_iterator& it) const
+		{
+			return m_it == it.m_it;
+		}
+
+		bool operator!=(const out_edge_iterator& it) const
+		{
+			return m_it != it.m_it;
+		}
+
+		out_edge_iterator& operator++()
+		{
+			++m_it;
+			return *this;
+		}
+
+		out_edge_iterator operator++(int)
+		{
+			out_edge_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+	  private:
+		vertex_descriptor m_u;
+		adjacency_iterator m_it;
+	};
+
+	/** Iterate through the vertices. */
+	class vertex_iterator
+		: public std::iterator<std::input_iterator_tag,
+			const vertex_descriptor>
+	{
+	  public:
+		vertex_iterator() : m_map(NULL), m_i(0) { }
+		vertex_iterator(const typename G::VertexMap& map, size_t i)
+			: m_map(&map), m_i(i)
+		{
+			skip();
+		}
+
+		const vertex_descriptor& operator*() const
+		{
+			return m_map->key(m_i);
+		}
+
+		bool operator==(const vertex_iterator& it) const
+		{
+			return m_i == it.m_i;
+		}
+
+		bool operator!=(const vertex_iterator& it) const
+		{
+			return m_i != it.m_i;
+		}
+
+		vertex_iterator& operator++()
+		{
+			++m_i;
+			skip();
+			return *this;
+		}
+
+		vertex_iterator operator++(int)
+		{
+			vertex_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+	  private:
+		/** Skip to the next occupied slot. */
+		void skip()
+		{
+			while (m_i < m_map->capacity() && !m_map->occupied(m_i))
+				++m_i;
+		}
+
+		const typename G::VertexMap* m_map;
+		size_t m_i;
+	};
+};
+
+} // namespace boost
+
+// IncidenceGraph
+
+template <typename V>
+std::pair<
+	typename boost::graph_traits< TraversalGraph<V> >::out_edge_iterator,
+	typename boost::graph_traits< TraversalGraph<V> >::out_edge_iterator>
+out_edges(const V& u, const TraversalGraph<V>& g)
+{
+	typedef typename boost::graph_traits< TraversalGraph<V> >
+		::out_edge_iterator out_edge_iterator;
+	return std::make_pair(out_edge_iterator(g, u, g.head(u)),
+			out_edge_iterator(g, u, TraversalGraph<V>::NIL));
+}
+
+template <typename V>
+unsigned
+out_degree(const V& u, const TraversalGraph<V>& g)
+{
+	return g.out_degree(u);
+}
+
+// AdjacencyGraph
+
+template <typename V>
+std::pair<
+	typename boost::graph_traits< TraversalGraph<V> >::adjacency_iterator,
+	typename boost::graph_traits< TraversalGraph<V> >::adjacency_iterator>
+adjacent_vertices(const V& u, const TraversalGraph<V>& g)
+{
+	typedef typename boost::graph_traits< TraversalGraph<V> >
+		::adjacency_iterator adjacency_iterator;
+	return std::make_pair(adjacency_iterator(g, g.head(u)),
+			adjacency_iterator(g, TraversalGraph<V>::NIL));
+}
+
+// VertexListGraph
+
+template <typename V>
+std::pair<
+	typename boost::graph_traits< TraversalGraph<V> >::vertex_iterator,
+	typename boost::graph_traits< TraversalGraph<V> >::vertex_iterator>
+vertices(const TraversalGraph<V>& g)
+{
+	typedef typename boost::graph_traits< TraversalGraph<V> >
+		::vertex_iterator vertex_iterator;
+	const typename TraversalGraph<V>::VertexMap& map = g.vertexMap();
+	return std::make_pair(vertex_iterator(map, 0),
+			vertex_iterator(map, map.capacity()));
+}
+
+template <typename V>
+unsigned
+num_vertices(const TraversalGraph<V>& g)
+{
+	return g.num_vertices();
+}
+
+// MutableGraph
+
+template <typename V>
+std::pair<std::pair<V, V>, bool>
+add_edge(const V& u, const V& v, TraversalGraph<V>& g)
+{
+	return g.add_edge(u, v);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef VERTEXTABLE_H
+#define VERTEXTABLE_H 1
+
+#include "Common/UnorderedMap.h" // for hash
+#include <boost/graph/properties.hpp>
+#include <cassert>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * An open-addressing hash table of vertices and their properties,
+ * which keeps its storage when it is cleared, so that one table may
+ * be reused by many graph searches. Each slot is stamped with the
+ * generation in which it was written, so that clear() takes constant
+ * time. Entries may not be erased.
+ */
+template <typename V, typename T, typename Hash = hash<V> >
+class VertexTable
+{
+  public:
+	typedef V key_type;
+	typedef T mapped_type;
+
+	VertexTable() : m_size(0), m_stamp(1), m_shift(64) { }
+
+	/** Remove all entries and keep the storage. */
+	void clear()
+	{
+		m_size = 0;
+		if (++m_stamp == 0) {
+			for (typename std::vector<Slot>::iterator it
+					= m_slots.begin(); it != m_slots.end(); ++it)
+				it->stamp = 0;
+			m_stamp = 1;
+		}
+	}
+
+	/** Return the number of entries. */
+	size_t size() const { return m_size; }
+
+	/** Return whether this table is empty. */
+	bool empty() const { return m_size == 0; }
+
+	/** Return the property of the specified vertex, or NULL if it
+	 * is not in this table. */
+	const T* find(const V& key) const
+	{
+		if (m_slots.empty())
+			return NULL;
+		const Slot& slot = m_slots[findSlot(key)];
+		return slot.stamp == m_stamp ? &slot.value : NULL;
+	}
+
+	/** Return the property of the specified vertex, or NULL if it
+	 * is not in this table. */
+	T* find(const V& key)
+	{
+		return const_cast<T*>(
+				static_cast<const VertexTable&>(*this).find(key));
+	}
+
+	/** Insert the specified vertex and property, unless the vertex
+	 * is in this table already.
+	 * @return the property of the vertex and whether it was inserted
+	 */
+	std::pair<T*, bool> insert(const V& key, const T& value)
+	{
+		if (2 * (m_size + 1) > m_slots.size())
+			rehash(m_slots.empty() ? 64 : 2 * m_slots.size());
+		Slot& slot = m_slots[findSlot(key)];
+		if (slot.stamp == m_stamp)
+			return std::make_pair(&slot.value, false);
+		slot.key = key;
+		slot.value = value;
+		slot.stamp = m_stamp;
+		++m_size;
+		return std::make_pair(&slot.value, true);
+	}
+
+	/** Return the property of the specified vertex, inserting a
+	 * default property if the vertex is not in this table. */
+	T& operator[](const V& key)
+	{
+		return *insert(key, T()).first;
+	}
+
+	/** Return the number of slots. */
+	size_t capacity() const { return m_slots.size(); }
+
+	/** Return whether the specified slot holds an entry. */
+	bool occupied(size_t i) const
+	{
+		return m_slots[i].stamp == m_stamp;
+	}
+
+	/** Return the vertex of the specified slot. */
+	const V& key(size_t i) const
+	{
+		assert(occupied(i));
+		return m_slots[i].key;
+	}
+
+	/** Return the property of the specified slot. */
+	const T& value(size_t i) const
+	{
+		assert(occupied(i));
+		return m_slots[i].value;
+	}
+
+	/** Return the number of bytes that the current entries would
+	 * occupy in a table at its maximum load factor. Unlike the
+	 * capacity, this size does not depend on earlier searches.
+	 */
+	size_t memUsage() const
+	{
+		return 2 * m_size * sizeof (Slot);
+	}
+
+  private:
+	struct Slot {
+		V key;
+		T value;
+		uint32_t stamp;
+		Slot() : value(), stamp(0) { }
+	};
+
+	/** Return the slot of the specified vertex, or the empty slot
+	 * where it would be inserted. */
+	size_t findSlot(const V& key) const
+	{
+		size_t mask = m_slots.size() - 1;
+		size_t i = (uint64_t)Hash()(key)
+			* UINT64_C(0x9e3779b97f4a7c15) >> m_shift;
+		while (m_slots[i].stamp == m_stamp && !(m_slots[i].key == key))
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	/** Resize the table to n slots, where n is a power of two. */
+	void rehash(size_t n)
+	{
+		std::vector<Slot> old(n);
+		old.swap(m_slots);
+		unsigned shift = 64;
+		for (size_t i = n; i > 1; i /= 2)
+			--shift;
+		m_shift = shift;
+		uint32_t stamp = m_stamp;
+		m_stamp = 1;
+		for (typename std::vector<Slot>::const_iterator it = old.begin();
+				it != old.end(); ++it) {
+			if (it->stamp != stamp)
+				continue;
+			Slot& slot = m_slots[findSlot(it->key)];
+			slot = *it;
+			slot.stamp = m_stamp;
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	size_t m_size;
+	uint32_t m_stamp;
+	unsigned m_shift;
+};
+
+/** A BFS color map stored in a VertexTable. Vertices that are not in
+ * the table are white. */
+template <typename V>
+struct VertexTableColorMap
+{
+	typedef V key_type;
+	typedef V& reference;
+	typedef boost::default_color_type value_type;
+	typedef boost::read_write_property_map_tag category;
+
+	VertexTable<V, value_type> table;
+};
+
+namespace boost {
+template <typename V>
+struct property_traits< VertexTableColorMap<V> > {
+	typedef typename VertexTableColorMap<V>::key_type key_type;
+	typedef typename VertexTableColorMap<V>::reference reference;
+	typedef typename VertexTableColorMap<V>::value_type value_type;
+	typedef typename VertexTableColorMap<V>::category category;
+};
+}
+
+template <typename V>
+boost::default_color_type
+get(const VertexTableColorMap<V>& colorMap, const V& key)
+{
+	const boost::default_color_type* p = colorMap.table.find(key);
+	return p != NULL ? *p : boost::white_color;
+}
+
+template <typename V>
+void
+put(VertexTableColorMap<V>& colorMap, const V& key,
+		boost::default_color_type value)
+{
+	colorMap.table[key] = value;
+}
+
+#endif
@@ -10,6 +10,9 @@
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -27,6 +30,7 @@ static const char USAGE_MESSAGE[] =
 "\n"
 " Options:\n"
 "\n"
+"  -j, --threads=N  use N parallel threads to read input [1]\n"
 "  -v, --verbose  display verbose output\n"
 "      --help     display this help and exit\n"
 "      --version  output version information and exit\n"
@@ -36,13 +40,17 @@ static const char USAGE_MESSAGE[] =
 namespace opt {
 	unsigned k; // used by DotIO
 	static int verbose;
+
+	/** Number of threads. */
+	static int threads = 1;
 }
 
-static const char shortopts[] = "v";
+static const char shortopts[] = "j:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
 static const struct option longopts[] = {
+	{ "threads", required_argument, NULL, 'j' },
 	{ "verbose", no_argument, NULL, 'v' },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
@@ -55,11 +63,7 @@ static void readGraph(const string& path, Graph& g, BetterEP betterEP)
 {
 	if (opt::verbose > 0)
 		cout << "Reading `" << path << "'...\n";
-	ifstream fin(path.c_str());
-	istream& in = path == "-" ? cin : fin;
-	assert_good(in, path);
-	read_graph(in, g, betterEP);
-	assert(in.eof());
+	read_graph_file(path, g, betterEP);
 	printGraphStats(cout, g);
 	g_contigNames.lock();
 }
@@ -83,6 +87,7 @@ int main(int argc, char** argv)
 		istringstream arg(optarg != NULL ? optarg : "");
 		switch (c) {
 		  case '?': die = true; break;
+		  case 'j': arg >> opt::threads; break;
 		  case 'v': opt::verbose++; break;
 		  case OPT_HELP:
 			cout << USAGE_MESSAGE;
@@ -104,6 +109,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	ContigGraph<DirectedGraph<NoProperty, NoProperty> > g;
 	readGraphs(g, argv + optind, argv + argc,
 			DisallowParallelEdges());
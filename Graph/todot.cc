@@ -15,6 +15,9 @@
 #include <iostream>
 #include <iterator> // for ostream_iterator
 #include <utility>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace std::rel_ops;
@@ -37,6 +40,7 @@ static const char USAGE_MESSAGE[] =
 "                 the sum k-mer coverage is reported\n"
 "      --adj             output the graph in adj format\n"
 "      --asqg            output the graph in asqg format\n"
+"      --bin             output the graph in binary format\n"
 "      --dist            output the graph in dist format\n"
 "      --dot             output the graph in GraphViz format [default]\n"
 "      --gv              output the graph in GraphViz format\n"
@@ -47,6 +51,7 @@ static const char USAGE_MESSAGE[] =
 "      --sam             output the graph in SAM format\n"
 "  -e, --estimate output distance estimates\n"
 "      --add-complements add missing complementary edges\n"
+"  -j, --threads=N  use N parallel threads to read input [1]\n"
 "  -v, --verbose  display verbose output\n"
 "      --help     display this help and exit\n"
 "      --version  output version information and exit\n"
@@ -57,6 +62,9 @@ namespace opt {
  	unsigned k; // used by Distance
 	static int verbose;
 
+	/** Number of threads. */
+	static int threads = 1;
+
 	/** Output distance estimates. */
 	bool estimate;
 
@@ -69,13 +77,14 @@ namespace opt {
 	int format = DOT; // used by ContigProperties
 }
 
-static const char shortopts[] = "ek:v";
+static const char shortopts[] = "ej:k:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
 static const struct option longopts[] = {
 	{ "adj",     no_argument,       &opt::format, ADJ },
 	{ "asqg",    no_argument,       &opt::format, ASQG },
+	{ "bin",     no_argument,       &opt::format, BINARY },
 	{ "dist",    no_argument,       &opt::format, DIST },
 	{ "dot",     no_argument,       &opt::format, DOT },
 	{ "gv",      no_argument,       &opt::format, DOT },
@@ -87,6 +96,7 @@ static const struct option longopts[] = {
 	{ "estimate", no_argument,      NULL, 'e' },
 	{ "add-complements", no_argument, &opt::addComplementaryEdges, true },
 	{ "kmer",    required_argument, NULL, 'k' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "verbose", no_argument,       NULL, 'v' },
 	{ "help",    no_argument,       NULL, OPT_HELP },
 	{ "version", no_argument,       NULL, OPT_VERSION },
@@ -99,11 +109,7 @@ static void readGraph(const string& path, Graph& g, BetterEP betterEP)
 {
 	if (opt::verbose > 0)
 		cerr << "Reading `" << path << "'...\n";
-	ifstream fin(path.c_str());
-	istream& in = path == "-" ? cin : fin;
-	assert_good(in, path);
-	read_graph(in, g, betterEP);
-	assert(in.eof());
+	read_graph_file(path, g, betterEP);
 	if (opt::verbose > 0)
 		printGraphStats(cerr, g);
 	g_contigNames.lock();
@@ -147,6 +153,7 @@ int main(int argc, char** argv)
 		switch (c) {
 		  case '?': die = true; break;
 		  case 'e': opt::estimate = true; break;
+		  case 'j': arg >> opt::threads; break;
 		  case 'k': arg >> opt::k; break;
 		  case 'v': opt::verbose++; break;
 		  case OPT_HELP:
@@ -174,6 +181,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (opt::estimate) {
 		// GFA outputs only the canonical edges, so
 		// both complementary edges must be present.
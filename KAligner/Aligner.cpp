@@ -1,10 +1,12 @@
 #include "Aligner.h"
+#include "Common/Options.h"
 #include "Iterator.h"
 #include "SAM.h"
 #include "Sequence.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <iterator>
 #include <utility>
 
@@ -119,6 +121,157 @@ void Aligner<SeqPosHashMap>::alignKmer(
 	}
 }
 
+template <>
+void Aligner<SortedKmerIndex>::addReferenceSequence(
+		const StringID& idString, const Sequence& seq)
+{
+	unsigned id = contigIDToIndex(idString);
+	assert(id == m_target.numSequences());
+	(void)id;
+	m_target.addSequence(seq, m_hashSize);
+}
+
+/** Sort the k-mer of the target, and report a duplicate k-mer as
+ * specified by opt::multimap. */
+template <>
+void Aligner<SortedKmerIndex>::finalize()
+{
+	m_target.build();
+	if (opt::multimap == opt::ERROR && m_target.duplicates() > 0) {
+		pair<uint32_t, uint32_t> dup = m_target.firstDuplicate();
+		pair<uint32_t, uint32_t> first = m_target.locate(dup.first);
+		pair<uint32_t, uint32_t> second = m_target.locate(dup.second);
+		Position(first.first, first.second).setDuplicate(
+				contigIndexToID(first.first),
+				contigIndexToID(second.first),
+				m_target.str(dup.second));
+	}
+}
+
+/** The magic number that begins a sorted k-mer index file. The last
+ * character is the version of the format. */
+static const char SORTED_INDEX_MAGIC[8] = {
+	'\x89', 'A', 'B', 'Y', 'S', 'S', 'K', '2' };
+
+/** The header of a sorted k-mer index file. */
+struct SortedIndexHeader
+{
+	char magic[sizeof SORTED_INDEX_MAGIC];
+	IndexFingerprint fingerprint;
+	uint32_t k;
+	uint32_t numContigs;
+	uint8_t colourSpace;
+	uint8_t multimap;
+	uint16_t reserved;
+};
+
+template <>
+void Aligner<SortedKmerIndex>::save(ostream& out,
+		const IndexFingerprint& fingerprint) const
+{
+	SortedIndexHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, SORTED_INDEX_MAGIC, sizeof header.magic);
+	header.fingerprint = fingerprint;
+	header.k = m_hashSize;
+	header.numContigs = m_dict.size();
+	header.colourSpace = opt::colourSpace;
+	header.multimap = opt::multimap;
+	out.write(reinterpret_cast<const char*>(&header), sizeof header);
+	for (vector<const_string>::const_iterator it = m_dict.begin();
+			it != m_dict.end(); ++it) {
+		uint32_t n = strlen(*it);
+		out.write(reinterpret_cast<const char*>(&n), sizeof n);
+		out.write(*it, n);
+	}
+	m_target.write(out);
+}
+
+template <>
+bool Aligner<SortedKmerIndex>::load(istream& in,
+		const IndexFingerprint& fingerprint, ostream& sam)
+{
+	assert(m_dict.empty());
+	SortedIndexHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof header);
+	const unsigned version = sizeof header.magic - 1;
+	if (in.gcount() < (streamsize)sizeof header.magic
+			|| memcmp(header.magic, SORTED_INDEX_MAGIC, version) != 0) {
+		cerr << "error: not a KAligner k-mer index\n";
+		exit(EXIT_FAILURE);
+	}
+	if (header.magic[version] != SORTED_INDEX_MAGIC[version])
+		return false;
+	if (!in) {
+		cerr << "error: the k-mer index is corrupt\n";
+		exit(EXIT_FAILURE);
+	}
+	if (!(header.fingerprint == fingerprint)
+			|| header.k != (unsigned)m_hashSize
+			|| header.multimap != opt::multimap)
+		return false;
+	opt::colourSpace = header.colourSpace;
+
+	string name;
+	for (uint32_t i = 0; i < header.numContigs; ++i) {
+		uint32_t n = 0;
+		in.read(reinterpret_cast<char*>(&n), sizeof n);
+		if (!in)
+			break;
+		name.resize(n);
+		in.read(&name[0], n);
+		if (!in)
+			break;
+		contigIDToIndex(name);
+	}
+	if (!in) {
+		cerr << "error: the k-mer index is corrupt\n";
+		exit(EXIT_FAILURE);
+	}
+	m_target.read(in, m_hashSize);
+	if (m_target.numSequences() != header.numContigs) {
+		cerr << "error: the k-mer index is corrupt\n";
+		exit(EXIT_FAILURE);
+	}
+	for (unsigned i = 0; i < header.numContigs; ++i)
+		sam << "@SQ\tSN:" << m_dict[i]
+			<< "\tLN:" << m_target.length(i) << '\n';
+	return true;
+}
+
+/** Store all alignments for a given Kmer in the parameter aligns.
+ *  @param[out] aligns Map of contig IDs to alignment vectors.
+ */
+template <>
+void Aligner<SortedKmerIndex>::alignKmer(
+		AlignmentSet& aligns, const Sequence& seq,
+		bool isRC, bool good, int read_ind, int seqLen)
+{
+	assert(read_ind >= 0);
+	if (!good && Sequence(seq, read_ind, m_hashSize)
+			.find_first_not_of("ACGT0123") != string::npos)
+		return;
+
+	SortedKmerIndex::Code code;
+	pair<SortedKmerIndex::const_iterator,
+		SortedKmerIndex::const_iterator> range
+		= m_target.equal_range(
+			m_target.encode(seq.data() + read_ind, code));
+
+	for (SortedKmerIndex::const_iterator it = range.first;
+			it != range.second; ++it) {
+		if (!m_target.matches(*it, code))
+			continue;
+		int read_pos = !isRC ? read_ind
+			: Alignment::calculateReverseReadStart(
+					read_ind, seqLen, m_hashSize);
+		pair<uint32_t, uint32_t> pos = m_target.locate(*it);
+		Alignment align(string(), pos.second, read_pos, m_hashSize,
+				seqLen, isRC);
+		aligns[pos.first].push_back(align);
+	}
+}
+
 template <class SeqPosHashMap>
 typename Aligner<SeqPosHashMap>::AlignmentSet
 Aligner<SeqPosHashMap>::getAlignmentsInternal(
@@ -228,6 +381,16 @@ template void Aligner<SeqPosHashMultiMap>::addReferenceSequence(
 template void Aligner<SeqPosHashUniqueMap>::addReferenceSequence(
 		const StringID& id, const Sequence& seq);
 
+template void Aligner<SortedKmerIndex>::
+alignRead<affix_ostream_iterator<Alignment> >(
+		const string& qid, const Sequence& seq,
+		affix_ostream_iterator<Alignment> dest);
+
+template void Aligner<SortedKmerIndex>::
+alignRead<ostream_iterator<SAMRecord> >(
+		const string& qid, const Sequence& seq,
+		ostream_iterator<SAMRecord> dest);
+
 template void Aligner<SeqPosHashMultiMap>::
 alignRead<affix_ostream_iterator<Alignment> >(
 		const string& qid, const Sequence& seq,
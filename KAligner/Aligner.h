@@ -6,6 +6,7 @@
 #include "Functional.h"
 #include "KAligner/Options.h"
 #include "Kmer.h"
+#include "SortedKmerIndex.h"
 #include "UnorderedMap.h"
 #include "config.h"
 #include <cassert>
@@ -50,6 +51,22 @@ struct Position
 	bool isDuplicate() const { return contig == std::numeric_limits<uint32_t>::max(); }
 };
 
+/** The target file and the section of it from which an index is
+ * built. A saved index is reused only when its fingerprint matches. */
+struct IndexFingerprint
+{
+	uint64_t size;
+	int64_t mtime;
+	uint32_t section;
+	uint32_t nsections;
+
+	bool operator==(const IndexFingerprint& o) const
+	{
+		return size == o.size && mtime == o.mtime
+			&& section == o.section && nsections == o.nsections;
+	}
+};
+
 typedef unordered_multimap<Kmer, Position, hash<Kmer>> SeqPosHashMultiMap;
 
 #if HAVE_GOOGLE_SPARSE_HASH_MAP
@@ -87,6 +104,22 @@ class Aligner
 	void addReferenceSequence(const StringID& id, const Sequence& seq);
 	void addReferenceSequence(const Kmer& kmer, Position pos);
 
+	/** Finish indexing the target. */
+	void finalize() {}
+
+	/** Write the index of the target, which was built from the
+	 * target described by fingerprint. */
+	void save(std::ostream& out, const IndexFingerprint& fingerprint)
+		const;
+
+	/** Read an index of the target written by save, and write the
+	 * SAM header of the target to sam.
+	 * @return false and read nothing more when the index was built
+	 * with different options or from a different target
+	 */
+	bool load(std::istream& in, const IndexFingerprint& fingerprint,
+			std::ostream& sam);
+
 	template<class oiterator>
 	void alignRead(const std::string& qid, const Sequence& seq, oiterator dest);
 
@@ -147,4 +180,14 @@ class Aligner
 	}
 };
 
+template<>
+void Aligner<SortedKmerIndex>::finalize();
+
+template<>
+inline size_t Aligner<SortedKmerIndex>::countDuplicates() const
+{
+	assert(opt::multimap == opt::IGNORE);
+	return m_target.duplicates();
+}
+
 #endif
@@ -9,8 +9,7 @@
 #include "SAM.h"
 #include "StringUtil.h" // for toSI
 #include "Uncompress.h"
-#include "Pipe.h"
-#include "PipeMux.h"
+#include "WorkStealingScheduler.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
@@ -25,6 +24,9 @@
 #include <string>
 #include <sys/stat.h>
 #include <sys/time.h>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -50,7 +52,15 @@ static const char USAGE_MESSAGE[] =
 "                        [default]\n"
 "  -m, --multimap        allow duplicate k-mer in the target\n"
 "      --no-multimap     disallow duplicate k-mer in the target\n"
-"  -j, --threads=N       use N threads [2] up to one per query file\n"
+"      --sorted-index    index the target with a sorted array of\n"
+"                        k-mer, which uses less memory than a hash\n"
+"                        table\n"
+"      --index=FILE      read the sorted k-mer index of the target\n"
+"                        from FILE if it exists and was built from\n"
+"                        the same target with the same options, and\n"
+"                        otherwise build it and write it to FILE.\n"
+"                        Implies --sorted-index\n"
+"  -j, --threads=N       use N threads [2]\n"
 "                        or if N is 0 use one thread per query file\n"
 "  -v, --verbose         display verbose output\n"
 "      --no-sam          output the results in KAligner format\n"
@@ -71,6 +81,12 @@ namespace opt {
 	static unsigned section = 1;
 	static unsigned nsections = 1;
 
+	/** Index the target with a sorted array of k-mer. */
+	static int sortedIndex;
+
+	/** The file of the sorted k-mer index. */
+	static string indexPath;
+
 	/** Output formats */
 	static int format;
 }
@@ -78,7 +94,7 @@ namespace opt {
 static const char shortopts[] = "ij:k:l:mo:s:v";
 
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC, OPT_INDEX };
 
 static const struct option longopts[] = {
 	{ "kmer",        required_argument, NULL, 'k' },
@@ -86,6 +102,8 @@ static const struct option longopts[] = {
 	{ "no-multi",    no_argument,     &opt::multimap, opt::ERROR },
 	{ "multimap",    no_argument,     &opt::multimap, opt::MULTIMAP },
 	{ "ignore-multimap", no_argument, &opt::multimap, opt::IGNORE },
+	{ "sorted-index", no_argument,      &opt::sortedIndex, 1 },
+	{ "index",       required_argument, NULL, OPT_INDEX },
 	{ "threads",     required_argument,	NULL, 'j' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "no-sam",      no_argument,       &opt::format, KALIGNER },
@@ -165,18 +183,35 @@ static size_t countKmer(const string& path)
 			" from `" << path << "'. "
 			"Expecting " << kmer << " k-mer.\n";
 		cerr << "Index will use at least "
-			<< toSI(kmer * sizeof(pair<Kmer, Position>))
+			<< toSI(kmer * (opt::sortedIndex
+						? sizeof(uint64_t) + sizeof(uint32_t)
+						: sizeof(pair<Kmer, Position>)))
 			<< "B.\n";
 	}
 	assert(bases > overlaps);
 	return kmer;
 }
 
+/** Describe the target file and the section of it to index.
+ * @return false if the target is not a regular file
+ */
+static bool getFingerprint(const string& path,
+		IndexFingerprint& fingerprint)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode))
+		return false;
+	fingerprint.size = st.st_size;
+	fingerprint.mtime = st.st_mtime;
+	fingerprint.section = opt::section;
+	fingerprint.nsections = opt::nsections;
+	return true;
+}
+
 template <class SeqPosHashMap>
 static void readContigsIntoDB(string refFastaFile,
 		Aligner<SeqPosHashMap>& aligner);
-static void *alignReadsToDB(void *arg);
-static void *readFile(void *arg);
+static void* alignReadsToDB(void* arg);
 
 /** Unique aligner using map */
 static Aligner<SeqPosHashUniqueMap> *g_aligner_u;
@@ -184,109 +219,75 @@ static Aligner<SeqPosHashUniqueMap> *g_aligner_u;
 /** Multimap aligner using multimap */
 static Aligner<SeqPosHashMultiMap> *g_aligner_m;
 
+/** Aligner using a sorted k-mer index */
+static Aligner<SortedKmerIndex> *g_aligner_s;
+
 /** Number of reads. */
-static unsigned g_readCount;
+static size_t g_readCount;
 
 /** Number of reads that aligned. */
-static unsigned g_alignedCount;
+static size_t g_alignedCount;
 
 /** Guard cerr. */
 static pthread_mutex_t g_mutexCerr = PTHREAD_MUTEX_INITIALIZER;
 
-/** Stores the output string and the read index number for an
- * alignment. */
-struct OutData
+/** The number of reads in a batch. */
+static const size_t BATCH_SIZE = 1024;
+
+/** The maximum number of batches per thread queued, running or
+ * awaiting output. */
+static const size_t MAX_PENDING_BATCHES = 4;
+
+/** A batch of reads and its sequence number. */
+struct ReadBatch
 {
-	string s;
 	size_t index;
+	vector<FastaRecord>* reads;
 
-	OutData(string s = string(), size_t index = 0)
-		: s(s), index(index) { }
-
-	/** Operator needed for sorting priority queue. */
-	bool operator<(const OutData& a) const
-	{
-		// Smaller index number has higher priority.
-		return index > a.index;
-	}
+	ReadBatch(size_t index = 0, vector<FastaRecord>* reads = NULL)
+		: index(index), reads(reads) { }
 };
 
-/** Shares data between workers and the output thread. */
-static Pipe<OutData> g_pipeOut(1<<7);
-
-/** Shares data between producer and worker threads. */
-static PipeMux<FastaRecord> g_pipeMux(1);
+/** Schedules batches of reads on the worker threads. */
+static WorkStealingScheduler<ReadBatch>* g_scheduler;
 
-/** Notification of the current size of the g_pqueue. */
-static size_t g_pqSize;
-static const size_t MAX_PQ_SIZE = 1000;
+/** Writes the alignments of each batch in the order of the input. */
+static OrderedWriter g_writer(cout);
 
-/** Conditional variable used to block workers until the g_pqueue has
- * become small enough. */
-static pthread_cond_t g_pqSize_cv = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t g_mutexPqSize = PTHREAD_MUTEX_INITIALIZER;
+/** The argument of a worker thread. */
+struct WorkerArg
+{
+	unsigned id;
+	WorkerArg(unsigned id = 0) : id(id) { }
+};
 
-static void* printAlignments(void*)
+/** Read the query files in batches and schedule the batches. */
+static void readFiles(char** first, char** last)
 {
-	priority_queue<OutData> pqueue;
-	size_t index = 1;
-	for (pair<OutData, size_t> p = g_pipeOut.pop();
-			p.second > 0; p = g_pipeOut.pop()) {
-		pqueue.push(p.first);
-		while (!pqueue.empty()) {
-			const OutData& rec = pqueue.top();
-			if (index == rec.index) {
-				// Print the record at the current index.
-				index++;
-				assert(rec.index > 0);
-				cout << rec.s;
-				assert_good(cout, "stdout");
-				pqueue.pop();
-			} else if (g_pipeMux.invalidEntry(index)) {
-				// Skip this index since it is invalid.
-				index++;
-			} else {
-				// The record for this index has not been added, get
-				// another record from the pipe.
+	size_t index = 0;
+	for (char** it = first; it != last; ++it) {
+		if (opt::verbose > 0) {
+			pthread_mutex_lock(&g_mutexCerr);
+			cerr << "Reading `" << *it << "'...\n";
+			pthread_mutex_unlock(&g_mutexCerr);
+		}
+
+		FastaReader in(*it, FastaReader::FOLD_CASE);
+		for (;;) {
+			vector<FastaRecord>* reads = new vector<FastaRecord>;
+			reads->reserve(BATCH_SIZE);
+			for (FastaRecord rec;
+					reads->size() < BATCH_SIZE && in >> rec;)
+				reads->push_back(rec);
+			if (reads->empty()) {
+				delete reads;
 				break;
 			}
+			g_scheduler->push(ReadBatch(index++, reads));
 		}
-
-		// Let waiting workers continue if the pqueue is small enough.
-		pthread_mutex_lock(&g_mutexPqSize);
-		g_pqSize = pqueue.size();
-		if (g_pqSize < MAX_PQ_SIZE)
-			pthread_cond_broadcast(&g_pqSize_cv);
-		pthread_mutex_unlock(&g_mutexPqSize);
-	}
-	return NULL;
-}
-
-/** Store a FastaReader and Pipe. */
-struct WorkerArg {
-	FastaReader& in;
-	Pipe<FastaRecord>& out;
-	WorkerArg(FastaReader& in, Pipe<FastaRecord>& out)
-		: in(in), out(out) { }
-	~WorkerArg() { delete &in; }
-};
-
-static pthread_t getReadFiles(const char *readsFile)
-{
-	if (opt::verbose > 0) {
-		pthread_mutex_lock(&g_mutexCerr);
-		cerr << "Reading `" << readsFile << "'...\n";
-		pthread_mutex_unlock(&g_mutexCerr);
+		assert(in.eof());
 	}
-
-	FastaReader* in = new FastaReader(
-			readsFile, FastaReader::FOLD_CASE);
-	WorkerArg* arg = new WorkerArg(*in, *g_pipeMux.addPipe());
-
-	pthread_t thread;
-	pthread_create(&thread, NULL, readFile, static_cast<void*>(arg));
-
-	return thread;
+	g_scheduler->close();
 }
 
 int main(int argc, char** argv)
@@ -316,6 +317,10 @@ int main(int argc, char** argv)
 			case 'v': opt::verbose++; break;
 			case 's': arg >> opt::section >> delim >>
 					  opt::nsections; break;
+			case OPT_INDEX:
+				arg >> opt::indexPath;
+				opt::sortedIndex = true;
+				break;
 			case OPT_HELP:
 				cout << USAGE_MESSAGE;
 				exit(EXIT_SUCCESS);
@@ -358,18 +363,62 @@ int main(int argc, char** argv)
 	int numQuery = argc - optind;
 	if (opt::threads <= 0)
 		opt::threads = numQuery;
+#if _OPENMP
+	omp_set_num_threads(opt::threads);
+#endif
 
 	// SAM headers.
 	cout << "@HD\tVN:1.0\n"
 		"@PG\tID:" PROGRAM "\tVN:" VERSION "\t"
 		"CL:" << commandLine << '\n';
 
-	size_t numKmer = countKmer(refFastaFile);
-	if (opt::multimap == opt::MULTIMAP) {
+	if (opt::sortedIndex) {
+		g_aligner_s = new Aligner<SortedKmerIndex>(opt::k, 0);
+		IndexFingerprint fingerprint = IndexFingerprint();
+		bool loaded = false;
+		ifstream in;
+		if (!opt::indexPath.empty()
+				&& getFingerprint(refFastaFile, fingerprint))
+			in.open(opt::indexPath.c_str(), ios::binary);
+		if (in.is_open()) {
+			if (opt::verbose > 0)
+				cerr << "Reading the k-mer index `"
+					<< opt::indexPath << "'..." << endl;
+			loaded = g_aligner_s->load(in, fingerprint, cout);
+			if (!loaded && opt::verbose > 0)
+				cerr << "The k-mer index `" << opt::indexPath
+					<< "' was built from a different target or "
+					"with different options. Rebuilding it..."
+					<< endl;
+			in.close();
+		}
+		if (!loaded) {
+			delete g_aligner_s;
+			g_aligner_s = new Aligner<SortedKmerIndex>(opt::k,
+					countKmer(refFastaFile));
+			readContigsIntoDB(refFastaFile, *g_aligner_s);
+			if (!opt::indexPath.empty()) {
+				if (opt::verbose > 0)
+					cerr << "Writing the k-mer index `"
+						<< opt::indexPath << "'..." << endl;
+				ofstream out(opt::indexPath.c_str(), ios::binary);
+				assert_good(out, opt::indexPath);
+				g_aligner_s->save(out, fingerprint);
+				out.flush();
+				assert_good(out, opt::indexPath);
+			}
+		}
+		if (opt::verbose > 0)
+			cerr << "The k-mer index has " << g_aligner_s->size()
+				<< " k-mer and uses "
+				<< toSI(getMemoryUsage()) << "B." << endl;
+	} else if (opt::multimap == opt::MULTIMAP) {
+		size_t numKmer = countKmer(refFastaFile);
 		g_aligner_m = new Aligner<SeqPosHashMultiMap>(opt::k,
 				numKmer);
 		readContigsIntoDB(refFastaFile, *g_aligner_m);
 	} else {
+		size_t numKmer = countKmer(refFastaFile);
 #if HAVE_GOOGLE_SPARSE_HASH_MAP
 		g_aligner_u = new Aligner<SeqPosHashUniqueMap>(opt::k,
 				numKmer, 0.3);
@@ -381,39 +430,37 @@ int main(int argc, char** argv)
 	}
 
 	g_readCount = 0;
+	opt::chastityFilter = false;
+	opt::trimMasked = false;
 
-	vector<pthread_t> producer_threads;
-	transform(argv + optind, argv + argc,
-			back_inserter(producer_threads), getReadFiles);
-
+	g_scheduler = new WorkStealingScheduler<ReadBatch>(
+			opt::threads, MAX_PENDING_BATCHES * opt::threads);
+	vector<WorkerArg> args(opt::threads);
 	vector<pthread_t> threads;
 	for (int i = 0; i < opt::threads; i++) {
+		args[i].id = i;
 		pthread_t thread;
-		pthread_create(&thread, NULL, alignReadsToDB, NULL);
+		pthread_create(&thread, NULL, alignReadsToDB, &args[i]);
 		threads.push_back(thread);
 	}
 
-	pthread_t out_thread;
-	pthread_create(&out_thread, NULL, printAlignments, NULL);
+	// Read the query files in this thread.
+	readFiles(argv + optind, argv + argc);
 
 	void *status;
 	// Wait for all threads to finish.
-	for (size_t i = 0; i < producer_threads.size(); i++)
-		pthread_join(producer_threads[i], &status);
 	for (size_t i = 0; i < threads.size(); i++)
 		pthread_join(threads[i], &status);
-	g_pipeOut.close();
-	pthread_join(out_thread, &status);
+	delete g_scheduler;
 
 	if (opt::verbose > 0)
 		cerr << "Aligned " << g_alignedCount
 			<< " of " << g_readCount << " reads ("
 			<< (float)100 * g_alignedCount / g_readCount << "%)\n";
 
-	if (opt::multimap == opt::MULTIMAP)
-		delete g_aligner_m;
-	else
-		delete g_aligner_u;
+	delete g_aligner_s;
+	delete g_aligner_m;
+	delete g_aligner_u;
 
 	return 0;
 }
@@ -430,6 +477,14 @@ static void printProgress(const Aligner<SeqPosHashMap>& align,
 		<< " using " << toSI(getMemoryUsage()) << "B." << endl;
 }
 
+static void printProgress(const Aligner<SortedKmerIndex>& align,
+		unsigned count)
+{
+	cerr << "Read " << count << " contigs. "
+		"Found " << align.size() << " k-mer"
+		" using " << toSI(getMemoryUsage()) << "B." << endl;
+}
+
 template <class SeqPosHashMap>
 static void readContigsIntoDB(string refFastaFile,
 		Aligner<SeqPosHashMap>& aligner)
@@ -463,6 +518,7 @@ static void readContigsIntoDB(string refFastaFile,
 	assert(in.eof());
 	if (opt::verbose > 0)
 		printProgress(aligner, count);
+	aligner.finalize();
 
 	if (opt::multimap == opt::IGNORE) {
 		// Count the number of duplicate k-mer in the target.
@@ -474,24 +530,6 @@ static void readContigsIntoDB(string refFastaFile,
 	}
 }
 
-/** Read each fasta record from 'in', and add it to 'pipe'. */
-static void readFile(FastaReader& in, Pipe<FastaRecord>& pipe)
-{
-	for (FastaRecord rec; in >> rec;)
-		pipe.push(rec);
-	assert(in.eof());
-	pipe.close();
-}
-
-/** Producer thread. */
-static void* readFile(void* arg)
-{
-	WorkerArg* p = static_cast<WorkerArg*>(arg);
-	readFile(p->in, p->out);
-	delete p;
-	return NULL;
-}
-
 /** @Returns the time in seconds between [start, end]. */
 static double timeDiff(const timeval& start, const timeval& end)
 {
@@ -502,88 +540,103 @@ static double timeDiff(const timeval& start, const timeval& end)
 	return result;
 }
 
-static void* alignReadsToDB(void*)
+/** Align the specified read using the aligner of the target. */
+template <class oiterator>
+static void alignRead(const string& id, const Sequence& seq,
+		oiterator dest)
 {
-	opt::chastityFilter = false;
-	opt::trimMasked = false;
-	static timeval start, end;
+	if (opt::sortedIndex)
+		g_aligner_s->alignRead(id, seq, dest);
+	else if (opt::multimap == opt::MULTIMAP)
+		g_aligner_m->alignRead(id, seq, dest);
+	else
+		g_aligner_u->alignRead(id, seq, dest);
+}
 
-	pthread_mutex_lock(&g_mutexCerr);
-	gettimeofday(&start, NULL);
-	pthread_mutex_unlock(&g_mutexCerr);
+/** Align the specified read and write its alignments to out.
+ * @return whether the read aligned
+ */
+static bool alignRead(const FastaRecord& rec, ostream& out)
+{
+	const Sequence& seq = rec.seq;
+	ostringstream output;
+	if (seq.find_first_not_of("ACGT0123") == string::npos) {
+		if (opt::colourSpace)
+			assert(isdigit(seq[0]));
+		else
+			assert(isalpha(seq[0]));
+	}
+
+	switch (opt::format) {
+	  case KALIGNER:
+		alignRead(rec.id, seq,
+				affix_ostream_iterator<Alignment>(output, "\t"));
+		break;
+	  case SAM:
+		alignRead(rec.id, seq,
+				ostream_iterator<SAMRecord>(output, "\n"));
+		break;
+	}
 
-	for (pair<FastaRecord, size_t> recPair = g_pipeMux.nextValue();
-			recPair.second > 0; recPair = g_pipeMux.nextValue()) {
-		const FastaRecord& rec = recPair.first;
-		const Sequence& seq = rec.seq;
-		ostringstream output;
-		if (seq.find_first_not_of("ACGT0123") == string::npos) {
+	string s = output.str();
+	switch (opt::format) {
+	  case KALIGNER:
+		out << rec.id;
+		if (opt::printSeq) {
+			out << ' ';
 			if (opt::colourSpace)
-				assert(isdigit(seq[0]));
-			else
-				assert(isalpha(seq[0]));
+				out << rec.anchor;
+			out << seq;
 		}
+		out << s << '\n';
+		break;
+	  case SAM:
+		out << s;
+		break;
+	}
+	return !s.empty();
+}
 
-		switch (opt::format) {
-		  case KALIGNER:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			break;
-		  case SAM:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			break;
-		}
+/** Worker thread. Align batches of reads until none remain. */
+static void* alignReadsToDB(void* arg)
+{
+	unsigned id = static_cast<WorkerArg*>(arg)->id;
+	static timeval start, end;
 
-		ostringstream out;
-		string s = output.str();
-		switch (opt::format) {
-		  case KALIGNER:
-			out << rec.id;
-			if (opt::printSeq) {
-				out << ' ';
-				if (opt::colourSpace)
-					out << rec.anchor;
-				out << seq;
-			}
-			out << s << '\n';
-			break;
-		  case SAM:
-			out << s;
-			break;
-		}
-		g_pipeOut.push(OutData(out.str(), recPair.second));
+	pthread_mutex_lock(&g_mutexCerr);
+	gettimeofday(&start, NULL);
+	pthread_mutex_unlock(&g_mutexCerr);
 
-		// Prevent the priority_queue from growing too large by
-		// waiting for threads going far too slow.
-		pthread_mutex_lock(&g_mutexPqSize);
-		if (g_pqSize >= MAX_PQ_SIZE)
-			pthread_cond_wait(&g_pqSize_cv, &g_mutexPqSize);
-		pthread_mutex_unlock(&g_mutexPqSize);
+	string s;
+	for (ReadBatch batch; g_scheduler->pop(id, batch);) {
+		ostringstream out;
+		size_t aligned = 0;
+		for (vector<FastaRecord>::const_iterator it
+				= batch.reads->begin();
+				it != batch.reads->end(); ++it)
+			aligned += alignRead(*it, out);
+		size_t n = batch.reads->size();
+		delete batch.reads;
+
+		s = out.str();
+		// Release the slots of the batches once they are written, so
+		// that batches finished out of order count against the limit.
+		g_scheduler->done(g_writer.write(batch.index, s));
 
-		if (opt::verbose > 0) {
-			pthread_mutex_lock(&g_mutexCerr);
-			if (!s.empty())
-				g_alignedCount++;
-			if (++g_readCount % 1000000 == 0) {
-				gettimeofday(&end, NULL);
-				double result = timeDiff(start, end);
-				cerr << "Aligned " << g_readCount << " reads at "
-					<< (int)(1000000 / result) << " reads/sec.\n";
-				start = end;
-			}
-			pthread_mutex_unlock(&g_mutexCerr);
+		pthread_mutex_lock(&g_mutexCerr);
+		g_alignedCount += aligned;
+		size_t before = g_readCount;
+		g_readCount += n;
+		if (opt::verbose > 0
+				&& g_readCount / 1000000 != before / 1000000) {
+			gettimeofday(&end, NULL);
+			double result = timeDiff(start, end);
+			cerr << "Aligned " << g_readCount << " reads at "
+				<< (int)(1000000 / result)
+				<< " reads/sec.\n";
+			start = end;
 		}
+		pthread_mutex_unlock(&g_mutexCerr);
 	}
 	return NULL;
 }
@@ -0,0 +1,407 @@
+#include "SortedKmerIndex.h"
+#include "Common/Options.h"
+#include "KAligner/Options.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+/** The number of most significant bits of the hash by which the
+ * positions are partitioned before sorting each partition. */
+static const unsigned PARTITION_BITS = 12;
+
+/** The number of chunks of positions counted and scattered in
+ * parallel when partitioning. */
+static const unsigned NUM_CHUNKS = 64;
+
+/** The target number of positions per bucket of the offset table. */
+static const unsigned BUCKET_SIZE = 16;
+
+/** A position marked as a duplicate k-mer. */
+static const uint32_t DUPLICATE = numeric_limits<uint32_t>::max();
+
+/** Mix the bits of x. This function is a bijection. */
+static inline uint64_t mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/** Return the hash of the specified k-mer code. When k <= 32 the
+ * hash is a bijection of the k-mer. */
+uint64_t SortedKmerIndex::hash(const Code& code) const
+{
+	uint64_t h = 0;
+	for (unsigned i = 0; i < (m_k + 31) / 32; ++i)
+		h = mix(h ^ code.words[i]);
+	return h;
+}
+
+uint64_t SortedKmerIndex::encode(const char* kmer, Code& code) const
+{
+	for (unsigned i = 0; i < (m_k + 31) / 32; ++i) {
+		uint64_t x = 0;
+		unsigned n = min(32u, m_k - 32 * i);
+		for (unsigned j = 0; j < n; ++j)
+			x |= (uint64_t)baseToCode(kmer[32 * i + j]) << 2 * j;
+		code.words[i] = x;
+	}
+	return hash(code);
+}
+
+/** Return the hash of the k-mer at the specified position. */
+uint64_t SortedKmerIndex::keyAt(uint64_t offset) const
+{
+	Code code;
+	for (unsigned i = 0; i < (m_k + 31) / 32; ++i)
+		code.words[i] = word(offset + 32 * i) & mask(i);
+	return hash(code);
+}
+
+/** Return the hash and the code of the reverse complement of the
+ * k-mer at the specified position. */
+uint64_t SortedKmerIndex::reverseComplementKeyAt(uint64_t offset,
+		Code& code) const
+{
+	fill(code.words, code.words + MAX_WORDS, 0);
+	uint64_t complement = opt::colourSpace ? 0 : 3;
+	for (unsigned i = 0; i < m_k; ++i) {
+		uint64_t x = offset + m_k - 1 - i;
+		uint64_t base = (m_seq[x / 32] >> 2 * (x % 32)) & 3;
+		code.words[i / 32] |= (base ^ complement) << 2 * (i % 32);
+	}
+	return hash(code);
+}
+
+Sequence SortedKmerIndex::str(uint32_t offset) const
+{
+	Sequence s(m_k, 'N');
+	for (unsigned i = 0; i < m_k; ++i) {
+		uint64_t x = (uint64_t)offset + i;
+		s[i] = codeToBase((m_seq[x / 32] >> 2 * (x % 32)) & 3);
+	}
+	return s;
+}
+
+void SortedKmerIndex::addSequence(const Sequence& seq, unsigned k)
+{
+	assert(m_keys.empty());
+	assert(k > 0);
+	assert(m_k == 0 || m_k == k);
+	m_k = k;
+
+	uint64_t start = m_starts.back();
+	uint64_t end = start + seq.size();
+	if (end >= numeric_limits<uint32_t>::max()) {
+		cerr << "error: the target is larger than 4 Gbp, which is "
+			"the limit of a sorted k-mer index. Use -s to split "
+			"the target into sections.\n";
+		exit(EXIT_FAILURE);
+	}
+	m_starts.push_back(end);
+	m_seq.resize((end + 31) / 32 + 1);
+
+	// Pack the bases and add the position of each k-mer that
+	// consists entirely of ACGT.
+	unsigned run = 0;
+	for (size_t i = 0; i < seq.size(); ++i) {
+		char c = seq[i];
+		uint64_t x = start + i;
+		if (c == 'A' || c == 'C' || c == 'G' || c == 'T'
+				|| (c >= '0' && c <= '3')) {
+			m_seq[x / 32] |= (uint64_t)baseToCode(c) << 2 * (x % 32);
+			if (++run >= m_k)
+				m_positions.push_back(x + 1 - m_k);
+		} else
+			run = 0;
+	}
+}
+
+/** Sort the positions by hash and then by position. The positions
+ * are partitioned by the most significant bits of their hash in
+ * parallel with a stable counting sort, and then each partition is
+ * sorted in parallel.
+ */
+void SortedKmerIndex::sortPositions()
+{
+	size_t n = m_positions.size();
+	m_keys.resize(n);
+#pragma omp parallel for schedule(static)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+		m_keys[i] = keyAt(m_positions[i]);
+
+	const unsigned numPartitions = 1 << PARTITION_BITS;
+	const unsigned shift = 64 - PARTITION_BITS;
+	vector<uint64_t> counts(NUM_CHUNKS * numPartitions);
+#pragma omp parallel for schedule(static)
+	for (int chunk = 0; chunk < (int)NUM_CHUNKS; ++chunk) {
+		uint64_t* count = &counts[chunk * numPartitions];
+		for (size_t i = n * chunk / NUM_CHUNKS,
+				end = n * (chunk + 1) / NUM_CHUNKS; i < end; ++i)
+			++count[m_keys[i] >> shift];
+	}
+
+	// Convert the counts to the offset of each chunk of each
+	// partition, and record the start of each partition.
+	vector<uint64_t> partitions(numPartitions + 1);
+	uint64_t sum = 0;
+	for (unsigned p = 0; p < numPartitions; ++p) {
+		partitions[p] = sum;
+		for (unsigned chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+			uint64_t& count = counts[chunk * numPartitions + p];
+			uint64_t x = count;
+			count = sum;
+			sum += x;
+		}
+	}
+	partitions[numPartitions] = sum;
+	assert(sum == n);
+
+	vector<uint64_t> keys(n);
+	vector<uint32_t> positions(n);
+#pragma omp parallel for schedule(static)
+	for (int chunk = 0; chunk < (int)NUM_CHUNKS; ++chunk) {
+		uint64_t* offset = &counts[chunk * numPartitions];
+		for (size_t i = n * chunk / NUM_CHUNKS,
+				end = n * (chunk + 1) / NUM_CHUNKS; i < end; ++i) {
+			uint64_t j = offset[m_keys[i] >> shift]++;
+			keys[j] = m_keys[i];
+			positions[j] = m_positions[i];
+		}
+	}
+	vector<uint64_t>().swap(counts);
+	m_keys.swap(keys);
+	m_positions.swap(positions);
+	vector<uint64_t>().swap(keys);
+	vector<uint32_t>().swap(positions);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int p = 0; p < (int)numPartitions; ++p) {
+		size_t first = partitions[p], last = partitions[p + 1];
+		if (last - first < 2)
+			continue;
+		vector<pair<uint64_t, uint32_t> > v;
+		v.reserve(last - first);
+		for (size_t i = first; i < last; ++i)
+			v.push_back(make_pair(m_keys[i], m_positions[i]));
+		sort(v.begin(), v.end());
+		for (size_t i = first; i < last; ++i) {
+			m_keys[i] = v[i - first].first;
+			m_positions[i] = v[i - first].second;
+		}
+	}
+}
+
+/** Mark the positions of members, whose k-mer are equal, as
+ * duplicates when that k-mer occurs more than once in the target, or
+ * when its reverse complement, other than itself, occurs in the
+ * target. Count the duplicate k-mer, and update the first duplicate in
+ * the order of the target.
+ */
+void SortedKmerIndex::markDuplicate(const vector<size_t>& members,
+		vector<uint8_t>& duplicate, size_t& count,
+		pair<uint32_t, uint32_t>& first) const
+{
+	assert(!members.empty());
+	uint32_t pos = m_positions[members.front()];
+	Code rc;
+	uint64_t rcKey = reverseComplementKeyAt(pos, rc);
+	bool palindrome = rcKey == m_keys[members.front()]
+		&& matches(pos, rc);
+	bool rcFound = false;
+	uint32_t rcPos = DUPLICATE;
+	if (!palindrome) {
+		vector<uint64_t>::const_iterator it = lower_bound(
+				m_keys.begin(), m_keys.end(), rcKey);
+		for (; it != m_keys.end() && *it == rcKey; ++it) {
+			uint32_t x = m_positions[it - m_keys.begin()];
+			if (matches(x, rc)) {
+				rcFound = true;
+				rcPos = x;
+				break;
+			}
+		}
+	}
+
+	if (members.size() > 1 || rcFound) {
+		for (vector<size_t>::const_iterator it = members.begin();
+				it != members.end(); ++it)
+			duplicate[*it] = true;
+		count += rcFound ? 1 : 2;
+		pair<uint32_t, uint32_t> dup = members.size() > 1
+			? make_pair(pos, m_positions[members[1]])
+			: make_pair(min(pos, rcPos), max(pos, rcPos));
+		if (dup.second < first.second)
+			first = dup;
+	}
+}
+
+/** Mark the duplicate k-mer, and find the first duplicate in the
+ * order of the target. */
+void SortedKmerIndex::markDuplicates(vector<uint8_t>& duplicate)
+{
+	size_t n = m_keys.size();
+	duplicate.assign(n, false);
+	const unsigned numPartitions = 1 << PARTITION_BITS;
+	const unsigned shift = 64 - PARTITION_BITS;
+
+	// Count each duplicate k-mer twice, so that a k-mer and its
+	// reverse complement sum to two.
+	size_t count = 0;
+	pair<uint32_t, uint32_t> firstDuplicate(DUPLICATE, DUPLICATE);
+#pragma omp parallel for schedule(dynamic) reduction(+:count)
+	for (int p = 0; p < (int)numPartitions; ++p) {
+		uint64_t lo = (uint64_t)p << shift;
+		size_t i = lower_bound(m_keys.begin(), m_keys.end(), lo)
+			- m_keys.begin();
+		pair<uint32_t, uint32_t> first(DUPLICATE, DUPLICATE);
+		vector<size_t> members, others, rest;
+		while (i < n && m_keys[i] >> shift == (uint64_t)p) {
+			size_t j = i + 1;
+			while (j < n && m_keys[j] == m_keys[i])
+				++j;
+
+			// When k > 32 the hashes of different k-mer may be equal.
+			// Split the positions of such a hash by k-mer.
+			members.clear();
+			others.clear();
+			for (size_t x = i; x < j; ++x) {
+				if (m_k <= 32 || equal(m_positions[i], m_positions[x]))
+					members.push_back(x);
+				else
+					others.push_back(x);
+			}
+			markDuplicate(members, duplicate, count, first);
+			while (!others.empty()) {
+				members.clear();
+				rest.clear();
+				for (size_t x = 0; x < others.size(); ++x) {
+					if (equal(m_positions[others[0]],
+								m_positions[others[x]]))
+						members.push_back(others[x]);
+					else
+						rest.push_back(others[x]);
+				}
+				markDuplicate(members, duplicate, count, first);
+				others.swap(rest);
+			}
+			i = j;
+		}
+		if (opt::multimap == opt::ERROR && first.second != DUPLICATE) {
+#pragma omp critical(firstDuplicate)
+			if (first.second < firstDuplicate.second)
+				firstDuplicate = first;
+		}
+	}
+	m_duplicates = count / 2;
+	m_firstDuplicate = firstDuplicate;
+}
+
+/** Build the table of the offset of each bucket of hash values. */
+void SortedKmerIndex::buildTable()
+{
+	size_t n = m_keys.size();
+	unsigned bits = 1;
+	while (bits < 32 && (n >> bits) > BUCKET_SIZE)
+		++bits;
+	m_shift = 64 - bits;
+	size_t numBuckets = (size_t)1 << bits;
+	m_table.resize(numBuckets + 1);
+#pragma omp parallel for schedule(static)
+	for (ptrdiff_t b = 0; b < (ptrdiff_t)numBuckets; ++b)
+		m_table[b] = lower_bound(m_keys.begin(), m_keys.end(),
+				(uint64_t)b << m_shift) - m_keys.begin();
+	m_table[numBuckets] = n;
+}
+
+void SortedKmerIndex::build()
+{
+	assert(m_table.empty());
+	sortPositions();
+
+	if (opt::multimap != opt::MULTIMAP) {
+		vector<uint8_t> duplicate;
+		markDuplicates(duplicate);
+		if (opt::multimap == opt::IGNORE && m_duplicates > 0) {
+			// Remove the duplicate k-mer, which never align.
+			size_t j = 0;
+			for (size_t i = 0; i < m_keys.size(); ++i) {
+				if (duplicate[i])
+					continue;
+				m_keys[j] = m_keys[i];
+				m_positions[j] = m_positions[i];
+				++j;
+			}
+			m_keys.resize(j);
+			m_positions.resize(j);
+			vector<uint64_t>(m_keys).swap(m_keys);
+			vector<uint32_t>(m_positions).swap(m_positions);
+		}
+	}
+	buildTable();
+}
+
+/** Write a vector preceded by its size. */
+template <typename T>
+static void writeVector(ostream& out, const vector<T>& v)
+{
+	uint64_t n = v.size();
+	out.write(reinterpret_cast<const char*>(&n), sizeof n);
+	out.write(reinterpret_cast<const char*>(v.data()), n * sizeof(T));
+}
+
+/** Read a vector written by writeVector. */
+template <typename T>
+static void readVector(istream& in, vector<T>& v)
+{
+	uint64_t n = 0;
+	in.read(reinterpret_cast<char*>(&n), sizeof n);
+	if (!in)
+		return;
+	v.resize(n);
+	in.read(reinterpret_cast<char*>(v.data()), n * sizeof(T));
+}
+
+void SortedKmerIndex::write(ostream& out) const
+{
+	assert(!m_table.empty());
+	uint64_t duplicates = m_duplicates;
+	uint32_t shift = m_shift;
+	out.write(reinterpret_cast<const char*>(&duplicates),
+			sizeof duplicates);
+	out.write(reinterpret_cast<const char*>(&shift), sizeof shift);
+	writeVector(out, m_starts);
+	writeVector(out, m_seq);
+	writeVector(out, m_keys);
+	writeVector(out, m_positions);
+	writeVector(out, m_table);
+}
+
+void SortedKmerIndex::read(istream& in, unsigned k)
+{
+	uint64_t duplicates = 0;
+	uint32_t shift = 0;
+	in.read(reinterpret_cast<char*>(&duplicates), sizeof duplicates);
+	in.read(reinterpret_cast<char*>(&shift), sizeof shift);
+	readVector(in, m_starts);
+	readVector(in, m_seq);
+	readVector(in, m_keys);
+	readVector(in, m_positions);
+	readVector(in, m_table);
+	if (!in || m_starts.empty() || m_keys.size() != m_positions.size()
+			|| m_table.size() != ((size_t)1 << (64 - shift)) + 1
+			|| m_seq.size() != (m_starts.back() + 31) / 32 + 1) {
+		cerr << "error: the k-mer index is corrupt\n";
+		exit(EXIT_FAILURE);
+	}
+	m_k = k;
+	m_duplicates = duplicates;
+	m_shift = shift;
+}
@@ -0,0 +1,206 @@
+#ifndef SORTEDKMERINDEX_H
+#define SORTEDKMERINDEX_H 1
+
+#include "Sequence.h"
+#include "config.h" // for MAX_KMER
+#include <algorithm>
+#include <cassert>
+#include <istream>
+#include <ostream>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/** An index of the k-mer of a target, which is an array of the
+ * (k-mer hash, position) pairs of the target sorted by hash, and a
+ * table of the offset of each bucket of hash values into that array.
+ * The index uses 12 bytes per position plus two bits per base of the
+ * target, much less than a hash table of k-mer, and may be written to
+ * and read from a file.
+ *
+ * A position is an offset into the concatenation of the target
+ * sequences. The target is stored packed two bits per base, which is
+ * used to verify the k-mer of a hit when k > 32 and the hash is not
+ * a bijection of the k-mer.
+ */
+class SortedKmerIndex
+{
+  public:
+	typedef const uint32_t* const_iterator;
+	typedef const_iterator iterator;
+
+	/** The number of 64-bit words of a k-mer of at most MAX_KMER. */
+	static const unsigned MAX_WORDS = (MAX_KMER + 31) / 32;
+
+	/** The 2-bit code of a k-mer, 32 bases per word. */
+	struct Code {
+		uint64_t words[MAX_WORDS];
+	};
+
+	/** @param expected the expected number of positions */
+	explicit SortedKmerIndex(size_t expected = 0) : m_k(0), m_shift(0),
+		m_duplicates(0)
+	{
+		m_positions.reserve(expected);
+		m_starts.push_back(0);
+	}
+
+	/** Add a target sequence, whose index is the number of sequences
+	 * added before it. */
+	void addSequence(const Sequence& seq, unsigned k);
+
+	/** Sort the positions and remove or report the duplicate k-mer
+	 * of the target as specified by opt::multimap. */
+	void build();
+
+	/** Return the number of positions. */
+	size_t size() const { return m_positions.size(); }
+
+	/** Return the number of buckets of the offset table. */
+	size_t bucket_count() const
+	{
+		return m_table.empty() ? 0 : m_table.size() - 1;
+	}
+
+	/** Return the number of duplicate k-mer, counting a k-mer and its
+	 * reverse complement once. */
+	size_t duplicates() const { return m_duplicates; }
+
+	/** Return the number of target sequences. */
+	unsigned numSequences() const { return m_starts.size() - 1; }
+
+	/** Return the length of the specified target sequence. */
+	unsigned length(unsigned id) const
+	{
+		assert(id + 1 < m_starts.size());
+		return m_starts[id + 1] - m_starts[id];
+	}
+
+	/** Return the index of the target sequence and the position in
+	 * that sequence of the specified position of the index. */
+	std::pair<uint32_t, uint32_t> locate(uint32_t offset) const
+	{
+		std::vector<uint64_t>::const_iterator it = std::upper_bound(
+				m_starts.begin(), m_starts.end(), offset) - 1;
+		return std::make_pair(it - m_starts.begin(), offset - *it);
+	}
+
+	/** Encode the specified k-mer, which consists of ACGT or 0123.
+	 * @return the hash of the k-mer
+	 */
+	uint64_t encode(const char* kmer, Code& code) const;
+
+	/** Return the positions of the k-mer whose hash is key. When k >
+	 * 32 the k-mer of the positions must be checked with matches. */
+	std::pair<const_iterator, const_iterator> equal_range(uint64_t key)
+		const
+	{
+		assert(!m_table.empty());
+		const uint32_t* positions = m_positions.data();
+		if (m_keys.empty())
+			return std::make_pair(positions, positions);
+		const uint64_t* keys = m_keys.data();
+		size_t bucket = key >> m_shift;
+		std::pair<const uint64_t*, const uint64_t*> range
+			= std::equal_range(keys + m_table[bucket],
+					keys + m_table[bucket + 1], key);
+		return std::make_pair(positions + (range.first - keys),
+				positions + (range.second - keys));
+	}
+
+	/** Return whether the k-mer at the specified position is code. */
+	bool matches(uint32_t offset, const Code& code) const
+	{
+		if (m_k <= 32)
+			return true;
+		unsigned n = (m_k + 31) / 32;
+		for (unsigned i = 0; i < n; ++i)
+			if ((word(offset + 32 * i) & mask(i)) != code.words[i])
+				return false;
+		return true;
+	}
+
+	/** Return whether the k-mer at the two positions are equal. */
+	bool equal(uint32_t a, uint32_t b) const
+	{
+		unsigned n = (m_k + 31) / 32;
+		for (unsigned i = 0; i < n; ++i)
+			if (((word(a + 32 * i) ^ word(b + 32 * i)) & mask(i)) != 0)
+				return false;
+		return true;
+	}
+
+	/** Return the k-mer at the specified position. */
+	Sequence str(uint32_t offset) const;
+
+	/** Return the first pair of positions of a duplicate k-mer in
+	 * the order of the target, which is set when opt::multimap is
+	 * opt::ERROR. */
+	std::pair<uint32_t, uint32_t> firstDuplicate() const
+	{
+		return m_firstDuplicate;
+	}
+
+	/** Write this index. */
+	void write(std::ostream& out) const;
+
+	/** Read an index written by write. */
+	void read(std::istream& in, unsigned k);
+
+  private:
+	/** Return the 2-bit code of the 32 bases starting at offset. */
+	uint64_t word(uint64_t offset) const
+	{
+		size_t i = offset / 32;
+		unsigned shift = 2 * (offset % 32);
+		uint64_t x = m_seq[i] >> shift;
+		if (shift > 0)
+			x |= m_seq[i + 1] << (64 - shift);
+		return x;
+	}
+
+	/** Return the mask of the bases of word i of a k-mer. */
+	uint64_t mask(unsigned i) const
+	{
+		unsigned n = std::min(32u, m_k - 32 * i);
+		return n == 32 ? ~(uint64_t)0 : ((uint64_t)1 << 2 * n) - 1;
+	}
+
+	uint64_t hash(const Code& code) const;
+	uint64_t keyAt(uint64_t offset) const;
+	uint64_t reverseComplementKeyAt(uint64_t offset, Code& code) const;
+	void sortPositions();
+	void markDuplicates(std::vector<uint8_t>& duplicate);
+	void markDuplicate(const std::vector<size_t>& members,
+			std::vector<uint8_t>& duplicate, size_t& count,
+			std::pair<uint32_t, uint32_t>& first) const;
+	void buildTable();
+
+	/** The length of a k-mer. */
+	unsigned m_k;
+
+	/** The target packed two bits per base followed by a padding
+	 * word. */
+	std::vector<uint64_t> m_seq;
+
+	/** The start of each target sequence and the total length. */
+	std::vector<uint64_t> m_starts;
+
+	/** The hash of each k-mer, sorted. */
+	std::vector<uint64_t> m_keys;
+
+	/** The position of each k-mer. */
+	std::vector<uint32_t> m_positions;
+
+	/** The offset into m_keys of the first k-mer of each bucket of
+	 * hash values, followed by the number of k-mer. */
+	std::vector<uint32_t> m_table;
+
+	/** The bucket of a hash is its most significant bits. */
+	unsigned m_shift;
+
+	size_t m_duplicates;
+	std::pair<uint32_t, uint32_t> m_firstDuplicate;
+};
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * de Bruijn Graph data structure using a Bloom filter of k-mers
+ * hashed by ntHash
+ */
+
+#ifndef ROLLINGDBGBLOOM_H
+#define ROLLINGDBGBLOOM_H 1
+
+#include "Bloom/RollingBloomFilter.h"
+#include "Konnector/DBGBloom.h"
+
+/**
+ * A de Bruijn graph whose vertices are the k-mers of a Bloom filter
+ * hashed by ntHash, such as Konnector::RollingBloomFilter. The
+ * neighbours of a vertex are found by hashing the vertex once and
+ * rolling its hash values to each of its neighbours, rather than by
+ * hashing each neighbour from scratch.
+ */
+template <typename BF>
+class RollingDBGBloom : public DBGBloom<BF> {
+  public:
+
+	RollingDBGBloom(const BF& bloom) : DBGBloom<BF>(bloom) { }
+
+	RollingDBGBloom(const BF& bloom, unsigned depthThresh)
+		: DBGBloom<BF>(bloom, depthThresh) { }
+
+	/** Return whether the k-mer with these hash values exists. */
+	bool contains(const RollingKmerHash& h) const
+	{
+		return this->m_bloom[h] > this->m_depthThresh;
+	}
+
+	/**
+	 * Return a bit mask of the neighbours of u in the specified
+	 * direction that exist in the graph. Bit i is set if the
+	 * neighbour that adds base i exists.
+	 */
+	unsigned neighbours(const Kmer& u, extDirection dir) const
+	{
+		RollingKmerHash h(u);
+		unsigned char charOut = RollingKmerHash::baseChar(
+				dir == SENSE ? u.front() : u.back());
+		unsigned mask = 0;
+		for (unsigned i = 0; i < NUM_BASES; ++i) {
+			if (contains(h.rolled(dir, charOut,
+							RollingKmerHash::baseChar(i))))
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+  private:
+	/** Copy constructor. */
+	RollingDBGBloom(const RollingDBGBloom<BF>&);
+
+}; // class RollingDBGBloom
+
+// Graph
+
+namespace boost {
+
+/** Graph traits */
+template <typename BF>
+struct graph_traits< RollingDBGBloom<BF> >
+	: graph_traits< DBGBloom<BF> >
+{
+	typedef Kmer vertex_descriptor;
+	typedef std::pair<vertex_descriptor, vertex_descriptor>
+		edge_descriptor;
+
+// AdjacencyGraph
+
+/** Iterate through the adjacent vertices of a vertex. */
+struct adjacency_iterator
+	: public std::iterator<std::input_iterator_tag, vertex_descriptor>
+{
+	/** Skip to the next edge that is present. */
+	void next()
+	{
+		for (; m_i < NUM_BASES; ++m_i) {
+			if (m_mask & 1 << m_i) {
+				m_v.setLastBase(SENSE, m_i);
+				break;
+			}
+		}
+	}
+
+  public:
+	adjacency_iterator(const RollingDBGBloom<BF>&)
+		: m_mask(0), m_i(NUM_BASES) { }
+
+	adjacency_iterator(const RollingDBGBloom<BF>& g, vertex_descriptor u)
+		: m_v(u), m_mask(g.neighbours(u, SENSE)), m_i(0)
+	{
+		m_v.shift(SENSE);
+		next();
+	}
+
+	const vertex_descriptor& operator*() const
+	{
+		assert(m_i < NUM_BASES);
+		return m_v;
+	}
+
+	bool operator==(const adjacency_iterator& it) const
+	{
+		return m_i == it.m_i;
+	}
+
+	bool operator!=(const adjacency_iterator& it) const
+	{
+		return !(*this == it);
+	}
+
+	adjacency_iterator& operator++()
+	{
+		assert(m_i < NUM_BASES);
+		++m_i;
+		next();
+		return *this;
+	}
+
+  private:
+	vertex_descriptor m_v;
+	unsigned m_mask;
+	short unsigned m_i;
+}; // adjacency_iterator
+
+/** IncidenceGraph */
+struct out_edge_iterator
+	: public std::iterator<std::input_iterator_tag, edge_descriptor>
+{
+	/** Skip to the next edge that is present. */
+	void next()
+	{
+		for (; m_i < NUM_BASES; ++m_i) {
+			if (m_mask & 1 << m_i) {
+				m_v.setLastBase(SENSE, m_i);
+				break;
+			}
+		}
+	}
+
+  public:
+	out_edge_iterator() { }
+
+	out_edge_iterator(const RollingDBGBloom<BF>&)
+		: m_mask(0), m_i(NUM_BASES) { }
+
+	out_edge_iterator(const RollingDBGBloom<BF>& g, vertex_descriptor u)
+		: m_u(u), m_v(u), m_mask(g.neighbours(u, SENSE)), m_i(0)
+	{
+		m_v.shift(SENSE);
+		next();
+	}
+
+	edge_descriptor operator*() const
+	{
+		assert(m_i < NUM_BASES);
+		return edge_descriptor(m_u, m_v);
+	}
+
+	bool operator==(const out_edge_iterator& it) const
+	{
+		return m_i == it.m_i;
+	}
+
+	bool operator!=(const out_edge_iterator& it) const
+	{
+		return !(*this == it);
+	}
+
+	out_edge_iterator& operator++()
+	{
+		assert(m_i < NUM_BASES);
+		++m_i;
+		next();
+		return *this;
+	}
+
+	out_edge_iterator operator++(int)
+	{
+		out_edge_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+  private:
+	vertex_descriptor m_u;
+	vertex_descriptor m_v;
+	unsigned m_mask;
+	unsigned m_i;
+}; // out_edge_iterator
+
+/** BidirectionalGraph */
+struct in_edge_iterator
+	: public std::iterator<std::input_iterator_tag, edge_descriptor>
+{
+	/** Skip to the next edge that is present. */
+	void next()
+	{
+		for (; m_i < NUM_BASES; ++m_i) {
+			if (m_mask & 1 << m_i) {
+				m_v.setLastBase(ANTISENSE, m_i);
+				break;
+			}
+		}
+	}
+
+  public:
+	in_edge_iterator() { }
+
+	in_edge_iterator(const RollingDBGBloom<BF>&)
+		: m_mask(0), m_i(NUM_BASES) { }
+
+	in_edge_iterator(const RollingDBGBloom<BF>& g, vertex_descriptor u)
+		: m_u(u), m_v(u), m_mask(g.neighbours(u, ANTISENSE)), m_i(0)
+	{
+		m_v.shift(ANTISENSE);
+		next();
+	}
+
+	edge_descriptor operator*() const
+	{
+		assert(m_i < NUM_BASES);
+		return edge_descriptor(m_v, m_u);
+	}
+
+	bool operator==(const in_edge_iterator& it) const
+	{
+		return m_i == it.m_i;
+	}
+
+	bool operator!=(const in_edge_iterator& it) const
+	{
+		return !(*this == it);
+	}
+
+	in_edge_iterator& operator++()
+	{
+		assert(m_i < NUM_BASES);
+		++m_i;
+		next();
+		return *this;
+	}
+
+	in_edge_iterator operator++(int)
+	{
+		in_edge_iterator it = *this;
+		++*this;
+		return it;
+	}
+
+  private:
+	vertex_descriptor m_u;
+	vertex_descriptor m_v;
+	unsigned m_mask;
+	unsigned m_i;
+}; // in_edge_iterator
+
+}; // graph_traits<RollingDBGBloom>
+
+} // namespace boost
+
+#endif
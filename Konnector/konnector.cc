@@ -8,6 +8,7 @@
 #include "konnector.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "DBGBloom.h"
+#include "RollingDBGBloom.h"
 #include "DBGBloomAlgorithms.h"
 
 #include "Align/alignGlobal.h"
@@ -26,6 +27,8 @@
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <sstream>
+#include <sys/time.h>
 
 #if _OPENMP
 # include <omp.h>
@@ -34,6 +37,7 @@
 
 using namespace std;
 using Konnector::BloomFilter;
+using Konnector::RollingBloomFilter;
 
 #define PROGRAM "konnector"
 
@@ -110,6 +114,13 @@ static const char USAGE_MESSAGE[] =
 "                             by konnector; only relevant when --fastq is\n"
 "                             in effect [40]\n"
 "  -r, --read-name=STR        only process reads with names that contain STR\n"
+"      --rolling-hash         hash k-mers with ntHash when building the Bloom\n"
+"                             filter, so that the neighbours of a k-mer are\n"
+"                             looked up without rehashing them. The hash\n"
+"                             function of a Bloom filter loaded with -i is\n"
+"                             detected from its file, which must have been\n"
+"                             built with ntHash if this option is given\n"
+"                             [disabled]\n"
 "  -s, --search-mem=N         mem limit for graph searches; multiply by the\n"
 "                             number of threads (-j) to get the total mem used\n"
 "                             for graph traversal [500M]\n"
@@ -216,6 +227,9 @@ namespace opt {
 	 */
 	static bool preserveReads = false;
 
+	/** Hash k-mers with ntHash when building the Bloom filter. */
+	static bool rollingHash = false;
+
 	/**
 	 * Output separate sequence for each alternate path
 	 * between read pairs
@@ -289,7 +303,8 @@ static struct {
 
 static const char shortopts[] = "b:B:c:C:d:D:eEf:F:i:Ij:k:lm:M:no:p:P:q:Q:r:s:t:vx:X:";
 
-enum { OPT_FASTQ = 1, OPT_HELP, OPT_PRESERVE_READS, OPT_VERSION };
+enum { OPT_FASTQ = 1, OPT_HELP, OPT_PRESERVE_READS, OPT_ROLLING_HASH,
+	OPT_VERSION };
 
 static const struct option longopts[] = {
 	{ "bloom-size",       required_argument, NULL, 'b' },
@@ -331,6 +346,7 @@ static const struct option longopts[] = {
 	{ "fastq",            no_argument, NULL, OPT_FASTQ },
 	{ "help",             no_argument, NULL, OPT_HELP },
 	{ "preserve-reads",   no_argument, NULL, OPT_PRESERVE_READS },
+	{ "rolling-hash",     no_argument, NULL, OPT_ROLLING_HASH },
 	{ "version",          no_argument, NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
 };
@@ -339,8 +355,9 @@ static const struct option longopts[] = {
  * Return true if the Bloom filter contains all of the
  * "good" kmers in the given sequence.
  */
+template <typename BloomT>
 static inline bool isSeqRedundant(const BloomFilter& assembledKmers,
-	const BloomFilter& goodKmers, Sequence seq)
+	const BloomT& goodKmers, Sequence seq)
 {
 	flattenAmbiguityCodes(seq, false);
 	for (KmerIterator it(seq, opt::k); it != KmerIterator::end(); ++it) {
@@ -353,8 +370,9 @@ static inline bool isSeqRedundant(const BloomFilter& assembledKmers,
 /**
  * Load the kmers of a given sequence into a Bloom filter.
  */
+template <typename BloomT>
 static inline void addKmers(BloomFilter& bloom,
-	const BloomFilter& goodKmers, unsigned k,
+	const BloomT& goodKmers, unsigned k,
 	const Sequence& seq)
 {
 	if (containsAmbiguityCodes(seq)) {
@@ -734,33 +752,73 @@ static inline bool correctAndExtend(FastqRecord& read,
 	return corrected;
 }
 
-/** Connect a read pair. */
-template <typename Graph, typename Bloom>
-static void connectPair(const Graph& g,
-	const Bloom& bloom,
-	FastqRecord& read1,
-	FastqRecord& read2,
-	const ConnectPairsParams& params,
-	ofstream& mergedStream,
-	ofstream& read1Stream,
-	ofstream& read2Stream,
-	ofstream& traceStream)
+/** A read pair and its output, which is formatted by the graph
+ * search stage and written in input order by the output stage. */
+struct ReadPair {
+	FastqRecord read1;
+	FastqRecord read2;
+	/** true if the pair was skipped by the -r option */
+	bool skipped;
+	/** true if the pair needs a graph search */
+	bool search;
+	PairAnchors anchors;
+	ConnectPairsResult result;
+	/** records for the merged, read 1, read 2 and trace files */
+	string merged, unmerged1, unmerged2, trace;
+};
+
+/**
+ * Find the anchor k-mers of a read pair, which is the first stage of
+ * connecting a read pair.
+ */
+template <typename Graph>
+static void findAnchors(const Graph& g, ReadPair& pair,
+	const ConnectPairsParams& params)
 {
+	pair.result = ConnectPairsResult();
+	pair.anchors = PairAnchors();
+	pair.merged.clear();
+	pair.unmerged1.clear();
+	pair.unmerged2.clear();
+	pair.trace.clear();
+
 	/*
 	 * Implements the -r option, which is used to only
 	 * process a subset of the input read pairs.
 	 */
-	if (!opt::readName.empty() &&
-		read1.id.find(opt::readName) == string::npos) {
+	pair.skipped = !opt::readName.empty() &&
+		pair.read1.id.find(opt::readName) == string::npos;
+	if (pair.skipped) {
+		pair.search = false;
+		return;
+	}
+
+	pair.search = findPairAnchors(opt::k, pair.read1, pair.read2, g,
+		params, pair.anchors, pair.result);
+}
+
+/** Connect a read pair whose anchor k-mers have been found. */
+template <typename Graph, typename Bloom>
+static void connectPair(const Graph& g,
+	const Bloom& bloom,
+	ReadPair& pair,
+	const ConnectPairsParams& params)
+{
+	if (pair.skipped) {
 #pragma omp atomic
 		++g_count.skipped;
 		return;
 	}
 
+	FastqRecord& read1 = pair.read1;
+	FastqRecord& read2 = pair.read2;
+	ConnectPairsResult& result = pair.result;
+
 	/* Search for connecting paths between read pair */
 
-	ConnectPairsResult result =
-		connectPairs(opt::k, read1, read2, g, params);
+	if (pair.search)
+		connectPairAnchors(opt::k, read1, read2, g, params,
+			pair.anchors, result);
 
 	/* Calculate quality strings for merged reads */
 
@@ -853,60 +911,105 @@ static void connectPair(const Graph& g,
 		}
 	}
 
-	if (!opt::tracefilePath.empty())
-#pragma omp critical(tracefile)
-	{
-		traceStream << result;
-		assert_good(traceStream, opt::tracefilePath);
+	if (!opt::tracefilePath.empty()) {
+		ostringstream trace;
+		trace << result;
+		pair.trace = trace.str();
 	}
 
 	/* update stats regarding merge successes / failures */
 
 	updateCounters(params, result);
 
-	/* output merged / unmerged reads */
+	/* format merged / unmerged reads */
 
+	ostringstream merged, unmerged1, unmerged2;
 	if (result.pathResult == FOUND_PATH &&
 		!exceedsMismatchThresholds(params, result)) {
 		assert(!paths.empty());
 		if (opt::altPathsMode) {
-#pragma omp critical(mergedStream)
 			for (unsigned i = 0; i < paths.size(); ++i) {
 				if (opt::dupBloomSize == 0 || !pathRedundant.at(i))
-					outputRead(paths.at(i), mergedStream, opt::fastq);
+					outputRead(paths.at(i), merged, opt::fastq);
 			}
 		} else if (opt::dupBloomSize == 0 || !pathRedundant.front()) {
-#pragma omp critical(mergedStream)
-			outputRead(consensus, mergedStream, opt::fastq);
+			outputRead(consensus, merged, opt::fastq);
 		}
 	} else {
 		if (opt::extend) {
-			if (outputRead1 || outputRead2)
-#pragma omp critical(mergedStream)
-			{
-				if (outputRead1)
-					outputRead(read1, mergedStream, opt::fastq);
-				if (outputRead2)
-					outputRead(read2, mergedStream, opt::fastq);
-			}
-			if (!outputRead1 || !outputRead2)
-#pragma omp critical(readStream)
-			{
-				if (!outputRead1)
-					read1Stream << read1;
-				if (!outputRead2)
-					read2Stream << read2;
-			}
-		} else
-#pragma omp critical(readStream)
-		{
-			read1Stream << read1;
-			read2Stream << read2;
+			if (outputRead1)
+				outputRead(read1, merged, opt::fastq);
+			if (outputRead2)
+				outputRead(read2, merged, opt::fastq);
+			if (!outputRead1)
+				unmerged1 << read1;
+			if (!outputRead2)
+				unmerged2 << read2;
+		} else {
+			unmerged1 << read1;
+			unmerged2 << read2;
 		}
 	}
+	pair.merged = merged.str();
+	pair.unmerged1 = unmerged1.str();
+	pair.unmerged2 = unmerged2.str();
+}
+
+/** Return the wall-clock time in seconds. */
+static inline double wallTime()
+{
+	timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec / 1e6;
 }
 
-/** Connect read pairs. */
+/** The number of read pairs connected in parallel at a time. */
+static const size_t BATCH_SIZE = 4096;
+
+/** Read pair counts and timings of the stages of connectPairs. */
+static struct {
+	/** pairs that needed a graph search */
+	size_t searched;
+	/** seconds spent in each stage */
+	double anchorTime;
+	double searchTime;
+	double outputTime;
+} g_stages;
+
+/** Compare read pairs by the cost of their graph search. */
+struct CompareSearchCost {
+	const vector<ReadPair>& m_batch;
+	const ConnectPairsParams& m_params;
+	CompareSearchCost(const vector<ReadPair>& batch,
+			const ConnectPairsParams& params)
+		: m_batch(batch), m_params(params) { }
+
+	/** Return the depth limit of the graph search of a pair, or 0
+	 * if the pair needs no graph search. */
+	unsigned cost(size_t i) const
+	{
+		const ReadPair& pair = m_batch[i];
+		return pair.search
+			? maxConnectingPathLength(opt::k, m_params, pair.anchors)
+			: 0;
+	}
+
+	bool operator()(size_t a, size_t b) const
+	{
+		unsigned costA = cost(a), costB = cost(b);
+		return costA != costB ? costA > costB : a < b;
+	}
+};
+
+/**
+ * Connect read pairs. The pairs are read in batches, and each batch
+ * is processed in three stages. The first stage finds the anchor
+ * k-mers of each pair in parallel, and resolves the pairs that have
+ * none without a graph search. The second stage searches the graph
+ * for the remaining pairs with a dynamic schedule, starting with the
+ * pairs whose search has the largest depth limit. The third stage
+ * writes the batch in the order of the input.
+ */
 template <typename Graph, typename FastaStream, typename Bloom>
 static void connectPairs(const Graph& g,
 	const Bloom& bloom,
@@ -917,196 +1020,67 @@ static void connectPairs(const Graph& g,
 	ofstream& read2Stream,
 	ofstream& traceStream)
 {
-#pragma omp parallel
-	for (FastqRecord a, b;;) {
-		bool good;
-#pragma omp critical(in)
-		good = in >> a >> b;
-		if (good) {
-			connectPair(g, bloom, a, b, params, mergedStream, read1Stream,
-				read2Stream, traceStream);
-#pragma omp atomic
-			g_count.readPairsProcessed++;
-			if (opt::verbose >= 2)
-#pragma omp critical(cerr)
-			{
-				if(g_count.readPairsProcessed % g_progressStep == 0)
-					printProgressMessage();
-			}
-		} else {
+	vector<ReadPair> batch(BATCH_SIZE);
+	vector<size_t> order;
+	for (bool good = true; good;) {
+		size_t n = 0;
+		while (n < batch.size()
+				&& (good = in >> batch[n].read1 >> batch[n].read2))
+			n++;
+		if (n == 0)
 			break;
+
+		double t0 = wallTime();
+#pragma omp parallel for schedule(dynamic, 64)
+		for (size_t i = 0; i < n; i++)
+			findAnchors(g, batch[i], params);
+
+		double t1 = wallTime();
+		order.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			order[i] = i;
+			if (batch[i].search)
+				g_stages.searched++;
 		}
-	}
-}
+		sort(order.begin(), order.end(), CompareSearchCost(batch, params));
+#pragma omp parallel for schedule(dynamic)
+		for (size_t i = 0; i < n; i++)
+			connectPair(g, bloom, batch[order[i]], params);
+
+		double t2 = wallTime();
+		for (size_t i = 0; i < n; i++) {
+			const ReadPair& pair = batch[i];
+			if (!opt::tracefilePath.empty())
+				traceStream << pair.trace;
+			mergedStream << pair.merged;
+			read1Stream << pair.unmerged1;
+			read2Stream << pair.unmerged2;
+			g_count.readPairsProcessed++;
+			if (opt::verbose >= 2
+					&& g_count.readPairsProcessed % g_progressStep == 0)
+				printProgressMessage();
+		}
+		if (!opt::tracefilePath.empty())
+			assert_good(traceStream, opt::tracefilePath);
+		double t3 = wallTime();
 
-/**
- * Set the value for a commandline option, using "nolimit"
- * to represent NO_LIMIT.
- */
-static inline void setMaxOption(unsigned& arg, istream& in)
-{
-	string str;
-	getline(in, str);
-	if (!in.fail() && str.compare("nolimit")==0) {
-		arg = NO_LIMIT;
-	} else {
-		istringstream ss(str);
-		ss >> arg;
-		// copy state bits (fail, bad, eof) to
-		// original stream
-		in.clear(ss.rdstate());
+		g_stages.anchorTime += t1 - t0;
+		g_stages.searchTime += t2 - t1;
+		g_stages.outputTime += t3 - t2;
 	}
 }
 
 /**
- * Connect pairs using a Bloom filter de Bruijn graph
+ * Load or build a Bloom filter of type BloomT and connect the read
+ * pairs using the de Bruijn graph Graph of that Bloom filter.
  */
-int main(int argc, char** argv)
+template <typename BloomT, typename Graph>
+static void connectReadPairs(int argc, char** argv)
 {
-	bool die = false;
-	bool minCovOptUsed = false;
-
-	for (int c; (c = getopt_long(argc, argv,
-					shortopts, longopts, NULL)) != -1;) {
-		istringstream arg(optarg != NULL ? optarg : "");
-		switch (c) {
-		  case '?':
-			die = true; break;
-		  case 'b':
-			opt::bloomSize = SIToBytes(arg); break;
-		  case 'B':
-			setMaxOption(opt::maxBranches, arg); break;
-		  case 'c':
-			arg >> opt::minCoverage;
-			minCovOptUsed = true;
-			break;
-		  case 'C':
-			arg >> opt::maxCost;
-			break;
-		  case 'd':
-			arg >> opt::dotPath; break;
-		  case 'D':
-			opt::dupBloomSize = SIToBytes(arg); break;
-		  case 'e':
-			opt::fixErrors = true; break;
-		  case 'E':
-			opt::extend = true; break;
-		  case 'f':
-			arg >> opt::minFrag; break;
-		  case 'F':
-			arg >> opt::maxFrag; break;
-		  case 'i':
-			arg >> opt::inputBloomPath; break;
-		  case 'I':
-			opt::interleaved = true; break;
-		  case 'j':
-			arg >> opt::threads; break;
-		  case 'k':
-			arg >> opt::k; break;
-		  case 'm':
-			setMaxOption(opt::maxReadMismatches, arg); break;
-		  case 'n':
-			opt::maxBranches = NO_LIMIT;
-			opt::maxReadMismatches = NO_LIMIT;
-			opt::maxMismatches = NO_LIMIT;
-			opt::maxPaths = NO_LIMIT;
-			break;
-		  case 'M':
-			setMaxOption(opt::maxMismatches, arg); break;
-		  case 'o':
-			arg >> opt::outputPrefix; break;
-		  case 'p':
-			opt::altPathsMode = true; break;
-		  case 'P':
-			setMaxOption(opt::maxPaths, arg); break;
-		  case 'q':
-			arg >> opt::qualityThreshold; break;
-		  case 'Q':
-			arg >> opt::correctedQual; break;
-		  case 'r':
-			arg >> opt::readName; break;
-		  case 's':
-			opt::searchMem = SIToBytes(arg); break;
-		  case 't':
-			arg >> opt::tracefilePath; break;
-		  case 'x':
-			arg >> opt::minReadIdentity; break;
-		  case 'X':
-			arg >> opt::minPathIdentity; break;
-		  case 'v':
-			opt::verbose++; break;
-		  case OPT_FASTQ:
-			opt::fastq = true; break;
-		  case OPT_HELP:
-			cout << USAGE_MESSAGE;
-			exit(EXIT_SUCCESS);
-		  case OPT_PRESERVE_READS:
-			opt::preserveReads = true; break;
-		  case OPT_VERSION:
-			cout << VERSION_MESSAGE;
-			exit(EXIT_SUCCESS);
-		}
-		if (optarg != NULL && (!arg.eof() || arg.fail())) {
-			cerr << PROGRAM ": invalid option: `-"
-				<< (char)c << optarg << "'\n";
-			exit(EXIT_FAILURE);
-		}
-	}
-
-	if (opt::k == 0) {
-		cerr << PROGRAM ": missing mandatory option `-k'\n";
-		die = true;
-	}
+	typedef BasicCascadingBloomFilter<BloomT> CascadingBloomT;
 
-	if (opt::outputPrefix.empty()) {
-		cerr << PROGRAM ": missing mandatory option `-o'\n";
-		die = true;
-	}
-
-	if (argc - optind < 1) {
-		cerr << PROGRAM ": missing input file arguments\n";
-		die = true;
-	}
-
-	if (die) {
-		cerr << "Try `" << PROGRAM
-			<< " --help' for more information.\n";
-		exit(EXIT_FAILURE);
-	}
-
-	if (!opt::inputBloomPath.empty() && minCovOptUsed) {
-		cerr << PROGRAM ": warning: -c option has no effect when "
-			" using a pre-built Bloom filter (-i option)\n";
-	}
-
-
-#if _OPENMP
-	if (opt::threads > 0)
-		omp_set_num_threads(opt::threads);
-#endif
-
-	Kmer::setLength(opt::k);
-
-#if USESEQAN
-	seqanTests();
-#endif
-
-	/*
-	 * We need to set a default quality score offset
-	 * in order to generate quality scores
-	 * for bases that are corrected/inserted by
-	 * konnector (--fastq option).
-	 */
-	if (opt::qualityOffset == 0)
-		opt::qualityOffset = 33;
-
-	assert(opt::bloomSize > 0);
-
-	if (opt::dupBloomSize > 0)
-		g_dupBloom.resize(opt::dupBloomSize * 8);
-
-	BloomFilter* bloom;
-	CascadingBloomFilter* cascadingBloom = NULL;
+	BloomT* bloom;
+	CascadingBloomT* cascadingBloom = NULL;
 
 	if (!opt::inputBloomPath.empty()) {
 
@@ -1114,7 +1088,7 @@ int main(int argc, char** argv)
 			std::cerr << "Loading bloom filter from `"
 				<< opt::inputBloomPath << "'...\n";
 
-		bloom = new BloomFilter();
+		bloom = new BloomT();
 
 		const char* inputPath = opt::inputBloomPath.c_str();
 		ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
@@ -1133,9 +1107,9 @@ int main(int argc, char** argv)
 		// of levels in cascading Bloom filter.
 
 		size_t bits = opt::bloomSize * 8 / opt::minCoverage;
-		cascadingBloom = new CascadingBloomFilter(bits, opt::minCoverage);
+		cascadingBloom = new CascadingBloomT(bits, opt::minCoverage);
 #ifdef _OPENMP
-		ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom, 1000);
+		ConcurrentBloomFilter<CascadingBloomT> cbf(*cascadingBloom, 1000);
 		for (int i = optind; i < argc; i++)
 			Bloom::loadFile(cbf, opt::k, string(argv[i]), opt::verbose);
 #else
@@ -1169,7 +1143,7 @@ int main(int argc, char** argv)
 		assert_good(traceStream, opt::tracefilePath);
 	}
 
-	DBGBloom<BloomFilter> g(*bloom);
+	Graph g(*bloom);
 
 	/*
 	 * read pairs that were successfully connected
@@ -1289,7 +1263,17 @@ int main(int argc, char** argv)
 			"Skipped: " << g_count.skipped
 				<< " (" << setprecision(3) << (float)100
 					* g_count.skipped / g_count.readPairsProcessed
-				<< "%)\n";
+				<< "%)\n"
+			"Searched the graph: " << g_stages.searched
+				<< " (" << setprecision(3) << (float)100
+					* g_stages.searched / g_count.readPairsProcessed
+				<< "%)\n"
+			"Time finding start/goal kmers: " << setprecision(3)
+				<< g_stages.anchorTime << " s\n"
+			"Time searching the graph: " << setprecision(3)
+				<< g_stages.searchTime << " s\n"
+			"Time writing output: " << setprecision(3)
+				<< g_stages.outputTime << " s\n";
 			if (opt::extend) {
 				cerr << "Unmerged reads corrected/extended: "
 					<< g_count.singleEndExtended
@@ -1323,6 +1307,192 @@ int main(int argc, char** argv)
 		assert_good(traceStream, opt::tracefilePath);
 		traceStream.close();
 	}
+}
+
+/**
+ * Set the value for a commandline option, using "nolimit"
+ * to represent NO_LIMIT.
+ */
+static inline void setMaxOption(unsigned& arg, istream& in)
+{
+	string str;
+	getline(in, str);
+	if (!in.fail() && str.compare("nolimit")==0) {
+		arg = NO_LIMIT;
+	} else {
+		istringstream ss(str);
+		ss >> arg;
+		// copy state bits (fail, bad, eof) to
+		// original stream
+		in.clear(ss.rdstate());
+	}
+}
+
+/**
+ * Connect pairs using a Bloom filter de Bruijn graph
+ */
+int main(int argc, char** argv)
+{
+	bool die = false;
+	bool minCovOptUsed = false;
+
+	for (int c; (c = getopt_long(argc, argv,
+					shortopts, longopts, NULL)) != -1;) {
+		istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) {
+		  case '?':
+			die = true; break;
+		  case 'b':
+			opt::bloomSize = SIToBytes(arg); break;
+		  case 'B':
+			setMaxOption(opt::maxBranches, arg); break;
+		  case 'c':
+			arg >> opt::minCoverage;
+			minCovOptUsed = true;
+			break;
+		  case 'C':
+			arg >> opt::maxCost;
+			break;
+		  case 'd':
+			arg >> opt::dotPath; break;
+		  case 'D':
+			opt::dupBloomSize = SIToBytes(arg); break;
+		  case 'e':
+			opt::fixErrors = true; break;
+		  case 'E':
+			opt::extend = true; break;
+		  case 'f':
+			arg >> opt::minFrag; break;
+		  case 'F':
+			arg >> opt::maxFrag; break;
+		  case 'i':
+			arg >> opt::inputBloomPath; break;
+		  case 'I':
+			opt::interleaved = true; break;
+		  case 'j':
+			arg >> opt::threads; break;
+		  case 'k':
+			arg >> opt::k; break;
+		  case 'm':
+			setMaxOption(opt::maxReadMismatches, arg); break;
+		  case 'n':
+			opt::maxBranches = NO_LIMIT;
+			opt::maxReadMismatches = NO_LIMIT;
+			opt::maxMismatches = NO_LIMIT;
+			opt::maxPaths = NO_LIMIT;
+			break;
+		  case 'M':
+			setMaxOption(opt::maxMismatches, arg); break;
+		  case 'o':
+			arg >> opt::outputPrefix; break;
+		  case 'p':
+			opt::altPathsMode = true; break;
+		  case 'P':
+			setMaxOption(opt::maxPaths, arg); break;
+		  case 'q':
+			arg >> opt::qualityThreshold; break;
+		  case 'Q':
+			arg >> opt::correctedQual; break;
+		  case 'r':
+			arg >> opt::readName; break;
+		  case 's':
+			opt::searchMem = SIToBytes(arg); break;
+		  case 't':
+			arg >> opt::tracefilePath; break;
+		  case 'x':
+			arg >> opt::minReadIdentity; break;
+		  case 'X':
+			arg >> opt::minPathIdentity; break;
+		  case 'v':
+			opt::verbose++; break;
+		  case OPT_FASTQ:
+			opt::fastq = true; break;
+		  case OPT_HELP:
+			cout << USAGE_MESSAGE;
+			exit(EXIT_SUCCESS);
+		  case OPT_PRESERVE_READS:
+			opt::preserveReads = true; break;
+		  case OPT_ROLLING_HASH:
+			opt::rollingHash = true; break;
+		  case OPT_VERSION:
+			cout << VERSION_MESSAGE;
+			exit(EXIT_SUCCESS);
+		}
+		if (optarg != NULL && (!arg.eof() || arg.fail())) {
+			cerr << PROGRAM ": invalid option: `-"
+				<< (char)c << optarg << "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (opt::k == 0) {
+		cerr << PROGRAM ": missing mandatory option `-k'\n";
+		die = true;
+	}
+
+	if (opt::outputPrefix.empty()) {
+		cerr << PROGRAM ": missing mandatory option `-o'\n";
+		die = true;
+	}
+
+	if (argc - optind < 1) {
+		cerr << PROGRAM ": missing input file arguments\n";
+		die = true;
+	}
+
+	if (die) {
+		cerr << "Try `" << PROGRAM
+			<< " --help' for more information.\n";
+		exit(EXIT_FAILURE);
+	}
+
+	if (!opt::inputBloomPath.empty() && minCovOptUsed) {
+		cerr << PROGRAM ": warning: -c option has no effect when "
+			" using a pre-built Bloom filter (-i option)\n";
+	}
+
+
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
+	Kmer::setLength(opt::k);
+
+#if USESEQAN
+	seqanTests();
+#endif
+
+	/*
+	 * We need to set a default quality score offset
+	 * in order to generate quality scores
+	 * for bases that are corrected/inserted by
+	 * konnector (--fastq option).
+	 */
+	if (opt::qualityOffset == 0)
+		opt::qualityOffset = 33;
+
+	assert(opt::bloomSize > 0);
+
+	if (opt::dupBloomSize > 0)
+		g_dupBloom.resize(opt::dupBloomSize * 8);
+
+	bool rollingHash = opt::rollingHash;
+	if (!opt::inputBloomPath.empty()) {
+		rollingHash = Bloom::readVersion(opt::inputBloomPath)
+			== Bloom::ROLLING_BLOOM_VERSION;
+		if (opt::rollingHash && !rollingHash) {
+			cerr << PROGRAM ": --rolling-hash was specified, but the "
+				"Bloom filter `" << opt::inputBloomPath
+				<< "' was not built with ntHash\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (rollingHash)
+		connectReadPairs<RollingBloomFilter,
+			RollingDBGBloom<RollingBloomFilter> >(argc, argv);
+	else
+		connectReadPairs<BloomFilter, DBGBloom<BloomFilter> >(argc, argv);
 
 	return 0;
 }
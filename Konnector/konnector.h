@@ -231,15 +231,45 @@ static inline void writeDot(
 	assert_good(*params.dotStream, params.dotPath);
 };
 
+/**
+ * The start and goal k-mers of a read pair, which are found by the
+ * first stage of connectPairs.
+ */
+struct PairAnchors
+{
+	/** the reads, if corrected by the fixErrors option */
+	FastaRecord correctedRead1;
+	FastaRecord correctedRead2;
+	bool corrected1;
+	bool corrected2;
+	unsigned startKmerPos;
+	unsigned goalKmerPos;
+
+	PairAnchors() :
+		corrected1(false),
+		corrected2(false),
+		startKmerPos(NO_MATCH),
+		goalKmerPos(NO_MATCH)
+	{}
+};
+
+/**
+ * Find the start and goal k-mers of a read pair in the graph.
+ * This first stage of connectPairs tests only the k-mers of the
+ * reads, and is cheap compared to the graph search.
+ * @return true if a graph search is needed, or false if the pair
+ * cannot be connected, in which case result.pathResult is NO_PATH
+ */
 template <typename Graph>
-static inline ConnectPairsResult connectPairs(
+static inline bool findPairAnchors(
 	unsigned k,
 	const FastaRecord& read1,
 	const FastaRecord& read2,
 	const Graph& g,
-	const ConnectPairsParams& params)
+	const ConnectPairsParams& params,
+	PairAnchors& anchors,
+	ConnectPairsResult& result)
 {
-	ConnectPairsResult result;
 	result.k = k;
 	result.readNamePrefix = read1.id.substr(0, read1.id.find_last_of("/"));
 
@@ -253,7 +283,7 @@ static inline ConnectPairsResult connectPairs(
 
 	if (read1.seq.length() < k || read2.seq.length() < k) {
 		result.pathResult = NO_PATH;
-		return result;
+		return false;
 	}
 
 	const unsigned numMatchesThreshold = 3;
@@ -264,47 +294,80 @@ static inline ConnectPairsResult connectPairs(
 	unsigned goalKmerPos = getStartKmerPos(read2, k, FORWARD, g,
 		numMatchesThreshold, params.preserveReads);
 
-	const FastaRecord* pRead1 = &read1;
-	const FastaRecord* pRead2 = &read2;
-	FastaRecord correctedRead1;
-	FastaRecord correctedRead2;
 	size_t unused;
 
 	if (startKmerPos == NO_MATCH && params.fixErrors) {
-		correctedRead1 = read1;
-		if (correctSingleBaseError(g, k, correctedRead1, unused)) {
-			startKmerPos = getStartKmerPos(correctedRead1, k, FORWARD, g,
-				params.kmerMatchesThreshold);
+		anchors.correctedRead1 = read1;
+		if (correctSingleBaseError(g, k, anchors.correctedRead1, unused)) {
+			startKmerPos = getStartKmerPos(anchors.correctedRead1, k,
+				FORWARD, g, params.kmerMatchesThreshold);
 			assert(startKmerPos != NO_MATCH);
-			pRead1 = &correctedRead1;
+			anchors.corrected1 = true;
 		}
 	}
 
 	if (goalKmerPos == NO_MATCH && params.fixErrors) {
-		correctedRead2 = read2;
-		if (correctSingleBaseError(g, k, correctedRead2, unused)) {
-			goalKmerPos = getStartKmerPos(correctedRead2, k, FORWARD, g,
-				params.kmerMatchesThreshold);
+		anchors.correctedRead2 = read2;
+		if (correctSingleBaseError(g, k, anchors.correctedRead2, unused)) {
+			goalKmerPos = getStartKmerPos(anchors.correctedRead2, k,
+				FORWARD, g, params.kmerMatchesThreshold);
 			assert(goalKmerPos != NO_MATCH);
-			pRead2 = &correctedRead2;
+			anchors.corrected2 = true;
 		}
 	}
 
 	if (startKmerPos == NO_MATCH || goalKmerPos == NO_MATCH) {
 		result.pathResult = NO_PATH;
-		return result;
-	} else {
-		result.startKmerPos = startKmerPos;
-		result.foundStartKmer = true;
-		result.goalKmerPos = goalKmerPos;
-		result.foundGoalKmer = true;
+		return false;
 	}
 
+	anchors.startKmerPos = startKmerPos;
+	anchors.goalKmerPos = goalKmerPos;
+	result.startKmerPos = startKmerPos;
+	result.foundStartKmer = true;
+	result.goalKmerPos = goalKmerPos;
+	result.foundGoalKmer = true;
+	return true;
+}
+
+/**
+ * Return the maximum length in k-mers of a path that connects the
+ * anchors of a read pair, which bounds the depth of its graph search.
+ */
+static inline unsigned maxConnectingPathLength(unsigned k,
+	const ConnectPairsParams& params, const PairAnchors& anchors)
+{
+	return params.maxMergedSeqLen - k + 1
+		- anchors.startKmerPos - anchors.goalKmerPos;
+}
+
+/**
+ * Search for the paths that connect the anchors of a read pair and
+ * build the merged sequences. This is the second stage of
+ * connectPairs.
+ */
+template <typename Graph>
+static inline void connectPairAnchors(
+	unsigned k,
+	const FastaRecord& read1,
+	const FastaRecord& read2,
+	const Graph& g,
+	const ConnectPairsParams& params,
+	const PairAnchors& anchors,
+	ConnectPairsResult& result)
+{
+	const FastaRecord* pRead1
+		= anchors.corrected1 ? &anchors.correctedRead1 : &read1;
+	const FastaRecord* pRead2
+		= anchors.corrected2 ? &anchors.correctedRead2 : &read2;
+	unsigned startKmerPos = anchors.startKmerPos;
+	unsigned goalKmerPos = anchors.goalKmerPos;
+
 	Kmer startKmer(pRead1->seq.substr(startKmerPos, k));
 	Kmer goalKmer(pRead2->seq.substr(goalKmerPos, k));
 	goalKmer.reverseComplement();
 
-	unsigned maxPathLen = params.maxMergedSeqLen - k + 1 - startKmerPos - goalKmerPos;
+	unsigned maxPathLen = maxConnectingPathLength(k, params, anchors);
 	assert(maxPathLen <= params.maxMergedSeqLen - k + 1);
 
 	unsigned minPathLen = (unsigned)std::max((int)0,
@@ -314,10 +377,15 @@ static inline ConnectPairsResult connectPairs(
 				pRead1->seq.length() - k + 1 - startKmerPos,
 				pRead2->seq.length() - k + 1 - goalKmerPos));
 
+	/* reuse the search state of earlier searches by this thread */
+	static thread_local BidiBFSSearchContext<Kmer> context;
+
 	ConstrainedBidiBFSVisitor<Graph> visitor(g, startKmer, goalKmer,
 			params.maxPaths, minPathLen, maxPathLen, params.maxBranches,
-			params.maxCost, params.memLimit);
-	bidirectionalBFS(g, startKmer, goalKmer, visitor);
+			params.maxCost, params.memLimit, &context);
+	bidirectionalBFS(g, startKmer, goalKmer,
+			context.queue[FORWARD], context.queue[REVERSE], visitor,
+			context.color[FORWARD], context.color[REVERSE]);
 
 	std::vector< Path<Kmer> > paths;
 	result.pathResult = visitor.pathsToGoal(paths);
@@ -349,7 +417,7 @@ static inline ConnectPairsResult connectPairs(
 				 */
 				if (trimLeft + trimRight > connectingSeq.length()) {
 					result.pathResult = NO_PATH;
-					return result;
+					return;
 				}
 				connectingSeq = connectingSeq.substr(trimLeft,
 					connectingSeq.length() - trimLeft - trimRight);
@@ -433,7 +501,21 @@ static inline ConnectPairsResult connectPairs(
 # pragma omp critical(cerr)
 	std::cerr << result;
 #endif
+}
 
+/** Search for the paths that connect a read pair. */
+template <typename Graph>
+static inline ConnectPairsResult connectPairs(
+	unsigned k,
+	const FastaRecord& read1,
+	const FastaRecord& read2,
+	const Graph& g,
+	const ConnectPairsParams& params)
+{
+	ConnectPairsResult result;
+	PairAnchors anchors;
+	if (findPairAnchors(k, read1, read2, g, params, anchors, result))
+		connectPairAnchors(k, read1, read2, g, params, anchors, result);
 	return result;
 }
 
@@ -4,8 +4,7 @@
  */
 
 #include "config.h"
-#include "plc.h"
-#include "CountingBloomFilter.h"
+#include "Bloom/KmerSpectrum.h"
 
 #include "Common/IOUtil.h"
 #include "Common/Options.h"
@@ -32,9 +31,12 @@ PROGRAM " (" PACKAGE_NAME ") " VERSION "\n"
 
 static const char USAGE_MESSAGE[] =
 "Usage: " PROGRAM " [OPTION]... [READS]...\n"
+"Count the k-mers of the reads approximately, and write the k-mer\n"
+"count histogram to standard output.\n"
+"\n"
 "  -j, --threads=N            use N parallel threads [1]\n"
 "  -k, --kmer=N               the size of a k-mer\n"
-"  -s, --seed=N               the seed value used\n"
+"  -s, --seed=N               the seed of the probabilistic counts [0]\n"
 "  -b, --bloom-size=N         size of bloom filter [500M]\n"
 "      --chastity             discard unchaste reads [default]\n"
 "      --no-chastity          do not discard unchaste reads\n"
@@ -74,7 +76,7 @@ namespace opt {
 //static struct {
 //} g_count;
 
-static const char shortopts[] = "j:k:s:q:v";
+static const char shortopts[] = "b:j:k:s:q:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -148,17 +150,26 @@ int main(int argc, char** argv)
 		omp_set_num_threads(opt::threads);
 #endif
 
-	//set seed
-	srand (opt::s);
-
 	Kmer::setLength(opt::k);
 
 	assert(opt::bloomSize > 0);
 
-	//size determined by
-	CountingBloomFilter<plc> bloom(opt::bloomSize, 1);
+	KmerSpectrum spectrum(opt::bloomSize, 1, opt::s);
+	size_t batches = 0;
 	for (int i = optind; i < argc; i++)
-		Bloom::loadFile(bloom, opt::k, string(argv[i]), opt::verbose);
+		spectrum.loadFile(opt::k, string(argv[i]), batches, opt::verbose);
+
+	Histogram h = spectrum.histogram();
+	if (opt::verbose > 0) {
+		cerr << "Counted " << spectrum.distinct() << " distinct k-mers"
+			<< " in " << spectrum.size() << " cells"
+			<< " (FPR " << 100 * spectrum.FPR() << "%)\n";
+		if (!h.empty())
+			cerr << "The first local minimum of the k-mer coverage is "
+				<< h.firstLocalMinimum() << '\n';
+	}
+	cout << h;
+	assert_good(cout, "stdout");
 
 	return 0;
 }
@@ -28,6 +28,9 @@
 #include <iostream>
 #include <limits>
 #include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -56,6 +59,7 @@ static const char USAGE_MESSAGE[] =
     "  -k, --kmer=KMER_SIZE  k-mer size\n"
     "  -o, --out=FILE        output the merged contigs to FILE [stdout]\n"
     "  -g, --graph=FILE      write the contig overlap graph to FILE\n"
+    "  -j, --threads=N       use N parallel threads to read input [1]\n"
     "      --merged          output only merged contigs\n"
     "      --adj             output the graph in adj format\n"
     "      --dot             output the graph in dot format [default]\n"
@@ -98,9 +102,12 @@ static unsigned minOverlap = 20;
 
 /** Minimum alignment identity. */
 static float minIdentity = 0.9;
+
+/** Number of threads. */
+static int threads = 1;
 }
 
-static const char shortopts[] = "g:k:o:v";
+static const char shortopts[] = "g:j:k:o:v";
 
 enum
 {
@@ -122,6 +129,7 @@ static const struct option longopts[] = { { "adj", no_argument, &opt::format, AD
 	                                      { "gv", no_argument, &opt::format, DOT },
 	                                      { "sam", no_argument, &opt::format, SAM },
 	                                      { "graph", required_argument, NULL, 'g' },
+	                                      { "threads", required_argument, NULL, 'j' },
 	                                      { "kmer", required_argument, NULL, 'k' },
 	                                      { "merged", no_argument, &opt::onlyMerged, 1 },
 	                                      { "out", required_argument, NULL, 'o' },
@@ -138,6 +146,7 @@ static const struct option longopts[] = { { "adj", no_argument, &opt::format, AD
 /* A contig sequence. */
 struct Contig
 {
+	Contig() {}
 	Contig(const string& comment, const string& seq)
 	  : comment(comment)
 	  , seq(seq)
@@ -458,6 +467,9 @@ main(int argc, char** argv)
 		case 'g':
 			arg >> opt::graphPath;
 			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'k':
 			arg >> opt::k;
 			break;
@@ -518,6 +530,11 @@ main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (!opt::db.empty()) {
 		init(db, opt::db, opt::verbose, PROGRAM, opt::getCommand(argc, argv), opt::metaVars);
 		addToDb(db, "K", opt::k);
@@ -532,10 +549,7 @@ main(int argc, char** argv)
 		// Read the contig adjacency graph.
 		if (opt::verbose > 0)
 			cerr << "Reading `" << adjPath << "'..." << endl;
-		ifstream fin(adjPath.c_str());
-		assert_good(fin, adjPath);
-		fin >> g;
-		assert(fin.eof());
+		read_graph_file(adjPath, g);
 		if (opt::verbose > 0)
 			cerr << "Read " << num_vertices(g)
 			     << " vertices. "
@@ -554,24 +568,45 @@ main(int argc, char** argv)
 		if (opt::verbose > 0)
 			cerr << "Reading `" << contigFile << "'..." << endl;
 		unsigned count = 0;
-		FastaReader in(contigFile, FastaReader::NO_FOLD_CASE);
-		for (FastaRecord rec; in >> rec;) {
-			if (!adjPath.empty() && g_contigNames.count(rec.id) == 0)
-				continue;
-			if (adjPath.empty()) {
+		if (adjPath.empty()) {
+			FastaReader in(contigFile, FastaReader::NO_FOLD_CASE);
+			for (FastaRecord rec; in >> rec;) {
 				graph_traits<Graph>::vertex_descriptor u =
 				    add_vertex(ContigProperties(rec.seq.length(), 0), g);
 				put(vertex_name, g, u, rec.id);
+				assert(get(g_contigNames, rec.id) == contigs.size());
+				contigs.push_back(rec);
+
+				++count;
+				if (opt::verbose > 1 && count % 1000000 == 0)
+					cerr << "Read " << count
+					     << " sequences. "
+					        "Using "
+					     << toSI(getMemoryUsage()) << "B of memory.\n";
+			}
+			assert(in.eof());
+		} else {
+			// The contigs are numbered by the graph, so that the
+			// sections of the file may be read in parallel.
+			contigs.resize(g_contigNames.size());
+			readFastaSections<FastaRecord>(
+			    contigFile, FastaReader::NO_FOLD_CASE, [&](FastaRecord& rec) {
+				    if (g_contigNames.count(rec.id) == 0)
+					    return;
+				    Contig& contig = contigs[get(g_contigNames, rec.id)];
+				    assert(contig.seq.empty());
+				    contig.comment.swap(rec.comment);
+				    contig.seq.swap(rec.seq);
+#pragma omp atomic
+				    ++count;
+			    });
+			for (size_t i = 0; i < contigs.size(); ++i) {
+				if (contigs[i].seq.empty()) {
+					cerr << PROGRAM ": error: contig `" << get(g_contigNames, i)
+					     << "' not found in `" << contigFile << "'\n";
+					exit(EXIT_FAILURE);
+				}
 			}
-			assert(get(g_contigNames, rec.id) == contigs.size());
-			contigs.push_back(rec);
-
-			++count;
-			if (opt::verbose > 1 && count % 1000000 == 0)
-				cerr << "Read " << count
-				     << " sequences. "
-				        "Using "
-				     << toSI(getMemoryUsage()) << "B of memory.\n";
 		}
 		if (opt::verbose > 0)
 			cerr << "Read " << count
@@ -580,7 +615,6 @@ main(int argc, char** argv)
 			     << toSI(getMemoryUsage()) << "B of memory.\n";
 		if (!opt::db.empty())
 			addToDb(db, "Init_seq", count);
-		assert(in.eof());
 		assert(!contigs.empty());
 		opt::colourSpace = isdigit(contigs[0].seq[0]);
 		g_contigNames.lock();
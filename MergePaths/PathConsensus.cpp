@@ -701,6 +701,7 @@ static ContigPath align(const Graph& g, const vector<Path>& sequences,
 
 /** Return the consensus sequence of the specified gap. */
 static ContigPath fillGap(const Graph& g,
+		const ConstrainedSearch<Graph>& constrainedSearch,
 		const AmbPathConstraint& apConstraint,
 		vector<bool>& seen,
 		ofstream& outFasta)
@@ -717,7 +718,7 @@ static ContigPath fillGap(const Graph& g,
 
 	ContigPaths solutions;
 	unsigned numVisited = 0;
-	constrainedSearch(g, apConstraint.source,
+	constrainedSearch(apConstraint.source,
 			constraints, solutions, numVisited);
 	bool tooComplex = numVisited >= opt::maxCost;
 
@@ -909,12 +910,14 @@ int main(int argc, char** argv)
 
 	// Contigs that were seen in a consensus.
 	vector<bool> seen(contigs.size());
+	ConstrainedSearch<Graph> constrainedSearch(g);
 
 	// resolve ambiguous paths recorded in g_ambpath_contig
 	g_contigNames.unlock();
 	for (AmbPath2Contig::iterator ambIt = g_ambpath_contig.begin();
 			ambIt != g_ambpath_contig.end(); ambIt++)
-		ambIt->second = fillGap(g, ambIt->first, seen, fa);
+		ambIt->second = fillGap(g, constrainedSearch, ambIt->first,
+				seen, fa);
 	g_contigNames.lock();
 	assert_good(fa, opt::consensusPath);
 	fa.close();
@@ -4,19 +4,23 @@
 #include "Histogram.h"
 #include "IOUtil.h"
 #include "MemoryUtil.h"
+#include "PairedAlignment.h"
 #include "SAM.h"
 #include "StringUtil.h"
 #include "Uncompress.h"
 #include "UnorderedMap.h"
+#include "city.h"
 #include <algorithm>
 #include <boost/unordered_map.hpp>
 #include <climits>
+#include <cstdio> // for remove
 #include <cstdlib>
 #include <fstream>
 #include <functional>
 #include <getopt.h>
 #include <iomanip>
 #include <iostream>
+#include <unistd.h> // for getpid
 
 using namespace std;
 
@@ -43,10 +47,22 @@ static const char USAGE_MESSAGE[] =
     "      --all             print all alignments\n"
     "      --diff            print alignments that align to different\n"
     "                        contigs [default]\n"
+    "      --bin             write alignments that align to different\n"
+    "                        contigs as a binary stream partitioned by\n"
+    "                        contig, which DistanceEst reads without\n"
+    "                        sorting\n"
     "  -l, --min-align=N     the minimal alignment size [1]\n"
     "  -s, --same=SAME       write properly-paired reads to this file\n"
     "  -h, --hist=FILE       write the fragment size histogram to FILE\n"
     "  -c, --cov=FILE        write the physical coverage to FILE\n"
+    "  -m, --max-mem=N       spill unpaired alignments, and the binary\n"
+    "                        alignments of --bin, to disk when either\n"
+    "                        uses more than N bytes of memory.\n"
+    "                        Units k, M and G may be given. [unlimited]\n"
+    "      --tmpdir=DIR      write spilled alignments to DIR\n"
+    "                        [$TMPDIR or /tmp]\n"
+    "      --buckets=N       partition spilled alignments into N files\n"
+    "                        by query name [64]\n"
     "  -v, --verbose         display verbose output\n"
     "      --help            display this help and exit\n"
     "      --version         output version information and exit\n"
@@ -66,13 +82,23 @@ static string covPath;
 static int qname;
 static int verbose;
 static int print_all;
+static int binary;
+
+/** Spill unpaired alignments to disk above this many bytes. */
+static size_t maxMem;
+
+/** The directory of the spill files. */
+static string tmpDir;
+
+/** The number of spill files. */
+static unsigned numBuckets = 64;
 }
 
 // for sqlite params
 static vector<string> keys;
 static vector<int> vals;
 
-static const char shortopts[] = "h:c:l:s:v";
+static const char shortopts[] = "h:c:l:m:s:v";
 
 enum
 {
@@ -81,17 +107,23 @@ enum
 	OPT_DB,
 	OPT_LIBRARY,
 	OPT_STRAIN,
-	OPT_SPECIES
+	OPT_SPECIES,
+	OPT_TMPDIR,
+	OPT_BUCKETS
 };
 
 static const struct option longopts[] = { { "qname", no_argument, &opt::qname, 1 },
 	                                      { "no-qname", no_argument, &opt::qname, 0 },
 	                                      { "all", no_argument, &opt::print_all, 1 },
 	                                      { "diff", no_argument, &opt::print_all, 0 },
+	                                      { "bin", no_argument, &opt::binary, 1 },
 	                                      { "min-align", required_argument, NULL, 'l' },
 	                                      { "hist", required_argument, NULL, 'h' },
 	                                      { "cov", required_argument, NULL, 'c' },
 	                                      { "same", required_argument, NULL, 's' },
+	                                      { "max-mem", required_argument, NULL, 'm' },
+	                                      { "tmpdir", required_argument, NULL, OPT_TMPDIR },
+	                                      { "buckets", required_argument, NULL, OPT_BUCKETS },
 	                                      { "verbose", no_argument, NULL, 'v' },
 	                                      { "help", no_argument, NULL, OPT_HELP },
 	                                      { "version", no_argument, NULL, OPT_VERSION },
@@ -108,12 +140,113 @@ static struct
 	size_t oneUnaligned;
 	size_t numDifferent;
 	size_t numFF;
+	size_t mateless;
+	size_t spills;
 } stats;
 
 static ofstream g_fragFile;
 static Histogram g_histogram;
 static ofstream g_covFile;
 static vector<vector<int>> g_contigCov;
+static vector<unsigned> g_contigLengths;
+
+/** Alignments to different contigs to write with --bin. */
+static vector<PairedAlignment> g_pairedAlignments;
+
+/** The files of spilled binary alignments, each partitioned by
+ * contig. */
+static vector<string> g_pairSpillPaths;
+
+/** The number of spilled binary alignments to each contig. */
+static vector<uint64_t> g_pairSpillCounts;
+
+/** Return the directory of the spill files. */
+static string
+spillDir()
+{
+	if (!opt::tmpDir.empty())
+		return opt::tmpDir;
+	const char* tmpdir = getenv("TMPDIR");
+	return tmpdir != NULL && *tmpdir != '\0' ? tmpdir : "/tmp";
+}
+
+/** Write the binary alignments to a new spill file, partitioned by
+ * contig. */
+static void
+spillPairedAlignments()
+{
+	ostringstream path;
+	path << spillDir() << '/' << PROGRAM "." << getpid() << ".pairs." << g_pairSpillPaths.size()
+	     << ".bin";
+	if (opt::verbose > 0)
+		cerr << "Spilling " << g_pairedAlignments.size() << " binary alignments to disk." << endl;
+
+	vector<uint64_t> counts;
+	partitionPairedAlignments(g_pairedAlignments, g_contigLengths.size(), counts);
+	g_pairSpillCounts.resize(counts.size());
+	for (size_t i = 0; i < counts.size(); ++i)
+		g_pairSpillCounts[i] += counts[i];
+
+	ofstream out(path.str().c_str(), ios::binary);
+	assert_good(out, path.str());
+	out.write(
+	    reinterpret_cast<const char*>(g_pairedAlignments.data()),
+	    g_pairedAlignments.size() * sizeof g_pairedAlignments[0]);
+	assert_good(out, path.str());
+	g_pairSpillPaths.push_back(path.str());
+	g_pairedAlignments.clear();
+	stats.spills++;
+}
+
+/** Write the binary alignments, merging the spill files contig by
+ * contig with the alignments that remain in memory. */
+static void
+writeBinaryAlignments(ostream& out)
+{
+	if (g_pairSpillPaths.empty()) {
+		writePairedAlignments(out, g_contigLengths, g_pairedAlignments);
+		return;
+	}
+
+	uint32_t n = g_contigLengths.size();
+	vector<uint64_t> memCounts;
+	partitionPairedAlignments(g_pairedAlignments, n, memCounts);
+	vector<uint64_t> counts(memCounts);
+	for (uint32_t i = 0; i < n; ++i)
+		counts[i] += g_pairSpillCounts[i];
+	writePairedAlignmentHeader(out, g_contigLengths, counts);
+
+	// Each spill file is partitioned by contig, so that each is read
+	// once from start to end.
+	size_t numFiles = g_pairSpillPaths.size();
+	vector<ifstream*> ins(numFiles);
+	vector<PairedAlignment> heads(numFiles);
+	for (size_t j = 0; j < numFiles; ++j) {
+		ins[j] = new ifstream(g_pairSpillPaths[j].c_str(), ios::binary);
+		assert_good(*ins[j], g_pairSpillPaths[j]);
+		ins[j]->read(reinterpret_cast<char*>(&heads[j]), sizeof heads[j]);
+	}
+	const PairedAlignment* mem = g_pairedAlignments.data();
+	for (uint32_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < numFiles; ++j) {
+			while (*ins[j] && heads[j].contig == i) {
+				out.write(reinterpret_cast<const char*>(&heads[j]), sizeof heads[j]);
+				ins[j]->read(reinterpret_cast<char*>(&heads[j]), sizeof heads[j]);
+			}
+		}
+		out.write(reinterpret_cast<const char*>(mem), memCounts[i] * sizeof *mem);
+		mem += memCounts[i];
+	}
+	assert_good(out, "-");
+
+	for (size_t j = 0; j < numFiles; ++j) {
+		assert(ins[j]->eof());
+		delete ins[j];
+		remove(g_pairSpillPaths[j].c_str());
+	}
+	g_pairSpillPaths.clear();
+	vector<PairedAlignment>().swap(g_pairedAlignments);
+}
 
 static void
 incrementRange(SAMRecord& a)
@@ -131,8 +264,8 @@ static void
 handlePair(SAMRecord& a0, SAMRecord& a1)
 {
 	if ((a0.isRead1() && a1.isRead1()) || (a0.isRead2() && a1.isRead2())) {
-		cerr << "error: duplicate read ID `" << a0.qname << (a0.isRead1() ? "/1" : "")
-		     << (a0.isRead2() ? "/2" : "") << "'\n";
+		cerr << "error: duplicate read ID `" << a1.qname << (a1.isRead1() ? "/1" : "")
+		     << (a1.isRead2() ? "/2" : "") << "'\n";
 		exit(EXIT_FAILURE);
 	}
 
@@ -151,7 +284,19 @@ handlePair(SAMRecord& a0, SAMRecord& a1)
 		stats.numDifferent++;
 		// Set the mapping quality of both reads to their minimum.
 		a0.mapq = a1.mapq = min(a0.mapq, a1.mapq);
-		if (!opt::print_all)
+		if (opt::binary) {
+			if (opt::maxMem > 0) {
+				// Reserve the buffer once and spill it when it is
+				// full, so that it never grows beyond the limit.
+				if (g_pairedAlignments.capacity() == 0)
+					g_pairedAlignments.reserve(
+					    max(opt::maxMem / sizeof (PairedAlignment), size_t(2)));
+				if (g_pairedAlignments.size() + 2 > g_pairedAlignments.capacity())
+					spillPairedAlignments();
+			}
+			g_pairedAlignments.push_back(PairedAlignment(a0));
+			g_pairedAlignments.push_back(PairedAlignment(a1));
+		} else if (!opt::print_all)
 			cout << a0 << '\n' << a1 << '\n';
 	} else if (a0.isReverse() == a1.isReverse()) {
 		// Same target, FF orientation.
@@ -181,8 +326,9 @@ typedef boost::unordered_map<string, SAMRecord> Alignments;
 typedef boost::unordered_map<string, SAMAlignment> Alignments;
 #endif
 
+template<typename Map>
 static void
-printProgress(const Alignments& map)
+printProgress(const Map& map)
 {
 	if (opt::verbose == 0)
 		return;
@@ -228,6 +374,181 @@ handleAlignment(SAMRecord& sam, Alignments& map)
 	printProgress(map);
 }
 
+/** A 128-bit hash of a query name. */
+typedef pair<uint64_t, uint64_t> QNameHash;
+
+/** Unpaired alignments keyed by the hash of their query name, used
+ * when the memory of the unpaired alignments is bounded. */
+typedef boost::unordered_map<QNameHash, SAMRecord> HashedAlignments;
+
+static HashedAlignments g_hashedAlignments;
+
+/** The estimated memory used by g_hashedAlignments in bytes. */
+static size_t g_hashedBytes;
+
+/** The files of spilled unpaired alignments. */
+static vector<string> g_spillPaths;
+static vector<ofstream*> g_spillFiles;
+
+/** Remove the spill files that remain when the program exits, such
+ * as when it exits with an error. */
+static struct SpillFilesGuard
+{
+	~SpillFilesGuard()
+	{
+		for (unsigned i = 0; i < g_spillFiles.size(); ++i)
+			delete g_spillFiles[i];
+		for (unsigned i = 0; i < g_spillPaths.size(); ++i)
+			remove(g_spillPaths[i].c_str());
+		for (unsigned i = 0; i < g_pairSpillPaths.size(); ++i)
+			remove(g_pairSpillPaths[i].c_str());
+	}
+} g_spillFilesGuard;
+
+static QNameHash
+hashQName(const string& qname)
+{
+	uint128 h = CityHash128(qname.data(), qname.size());
+	return QNameHash(Uint128Low64(h), Uint128High64(h));
+}
+
+/** Return the heap memory used by the specified string. */
+static size_t
+stringBytes(const string& s)
+{
+	// Short strings are stored within the string object.
+	return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+/** Return the estimated memory used by an unpaired alignment. */
+static size_t
+entryBytes(const SAMRecord& sam)
+{
+	// The hash table node, its bucket and allocator overhead.
+	size_t n = sizeof (HashedAlignments::value_type) + 3 * sizeof (void*);
+	n += stringBytes(sam.qname) + stringBytes(sam.rname) + stringBytes(sam.cigar) +
+	     stringBytes(sam.mrnm);
+#if SAM_SEQ_QUAL
+	n += stringBytes(sam.seq) + stringBytes(sam.qual) + stringBytes(sam.tags);
+#endif
+	return n;
+}
+
+/** Open the spill files. */
+static void
+openSpillFiles()
+{
+	string dir = spillDir();
+	for (unsigned i = 0; i < opt::numBuckets; ++i) {
+		ostringstream path;
+		path << dir << '/' << PROGRAM "." << getpid() << '.' << i << ".sam";
+		g_spillPaths.push_back(path.str());
+		g_spillFiles.push_back(new ofstream(path.str().c_str()));
+		assert_good(*g_spillFiles.back(), path.str());
+	}
+}
+
+/** Write the unpaired alignments to the spill files, partitioned by
+ * the hash of their query name, so that both reads of a pair are
+ * written to the same file.
+ */
+static void
+spillAlignments(HashedAlignments& map)
+{
+	if (g_spillFiles.empty())
+		openSpillFiles();
+	if (opt::verbose > 0)
+		cerr << "Spilling " << map.size() << " unpaired alignments using "
+		     << toSI(g_hashedBytes) << "B to disk." << endl;
+	for (HashedAlignments::const_iterator it = map.begin(); it != map.end(); ++it) {
+		ofstream& out = *g_spillFiles[it->first.first % opt::numBuckets];
+		out << it->first.first << '\t' << it->first.second << '\t' << it->second << '\n';
+	}
+	for (unsigned i = 0; i < g_spillFiles.size(); ++i)
+		assert_good(*g_spillFiles[i], g_spillPaths[i]);
+	HashedAlignments().swap(map);
+	g_hashedBytes = 0;
+	stats.spills++;
+}
+
+/** Pair the specified alignment with its mate, or store it until its
+ * mate is found.
+ * @param key the hash of the query name
+ * @param spill whether to spill the unpaired alignments to disk when
+ * they exceed the memory limit
+ */
+static void
+handleHashedAlignment(
+    const QNameHash& key, SAMRecord& sam, HashedAlignments& map, bool spill)
+{
+	HashedAlignments::iterator it = map.find(key);
+	if (it == map.end()) {
+		// The query name is needed only to print it.
+		if (!opt::qname && !opt::print_all)
+			sam.qname = "*";
+		g_hashedBytes += entryBytes(sam);
+		map.insert(make_pair(key, sam));
+		if (spill && g_hashedBytes > opt::maxMem)
+			spillAlignments(map);
+	} else {
+		SAMRecord& a0 = it->second;
+		g_hashedBytes -= entryBytes(a0);
+		handlePair(a0, sam);
+		map.erase(it);
+	}
+}
+
+/** Print and count the alignments whose mate was not found. */
+static void
+printMateless(HashedAlignments& map)
+{
+	stats.mateless += map.size();
+	if (!opt::print_all)
+		return;
+	for (HashedAlignments::iterator it = map.begin(); it != map.end(); ++it) {
+		SAMRecord& a0 = it->second;
+		a0.noMate();
+		cout << a0 << '\n';
+		assert(cout.good());
+	}
+}
+
+/** Pair the alignments of each spill file in turn. */
+static void
+joinSpilledAlignments()
+{
+	HashedAlignments& map = g_hashedAlignments;
+	if (g_spillFiles.empty()) {
+		printMateless(map);
+		return;
+	}
+
+	spillAlignments(map);
+	for (unsigned i = 0; i < g_spillFiles.size(); ++i) {
+		g_spillFiles[i]->close();
+		delete g_spillFiles[i];
+	}
+	g_spillFiles.clear();
+
+	for (unsigned i = 0; i < g_spillPaths.size(); ++i) {
+		const string& path = g_spillPaths[i];
+		if (opt::verbose > 1)
+			cerr << "Reading `" << path << "'..." << endl;
+		ifstream in(path.c_str());
+		assert_good(in, path);
+		QNameHash key;
+		for (SAMRecord sam; in >> key.first >> key.second >> sam;)
+			handleHashedAlignment(key, sam, map, false);
+		assert_eof(in, path);
+		in.close();
+		remove(path.c_str());
+		printMateless(map);
+		HashedAlignments().swap(map);
+		g_hashedBytes = 0;
+	}
+	g_spillPaths.clear();
+}
+
 static void
 assert_eof(istream& in)
 {
@@ -280,8 +601,10 @@ parseTag(string line)
 
 	assert(length > 0);
 	assert(id.size() > 0);
-	put(g_contigNames, g_contigCov.size(), id);
-	g_contigCov.push_back(vector<int>(length));
+	put(g_contigNames, g_contigLengths.size(), id);
+	g_contigLengths.push_back(length);
+	if (!opt::covPath.empty())
+		g_contigCov.push_back(vector<int>(length));
 }
 
 static void
@@ -293,14 +616,21 @@ readAlignments(istream& in, Alignments* pMap)
 			getline(in, line);
 			assert(in);
 
-			if (!opt::covPath.empty())
+			if (!opt::covPath.empty() || opt::binary)
 				parseTag(line);
 
-			cout << line << '\n';
+			if (!opt::binary)
+				cout << line << '\n';
 			if (!opt::fragPath.empty())
 				g_fragFile << line << '\n';
-		} else if (in >> sam)
-			handleAlignment(sam, *pMap);
+		} else if (in >> sam) {
+			if (opt::maxMem > 0) {
+				handleHashedAlignment(hashQName(sam.qname), sam, g_hashedAlignments, true);
+				stats.alignments++;
+				printProgress(g_hashedAlignments);
+			} else
+				handleAlignment(sam, *pMap);
+		}
 	}
 	if (!opt::covPath.empty())
 		printCov(opt::covPath);
@@ -395,6 +725,15 @@ main(int argc, char* const* argv)
 		case 's':
 			arg >> opt::fragPath;
 			break;
+		case 'm':
+			opt::maxMem = SIToBytes(arg);
+			break;
+		case OPT_TMPDIR:
+			arg >> opt::tmpDir;
+			break;
+		case OPT_BUCKETS:
+			arg >> opt::numBuckets;
+			break;
 		case 'h':
 			arg >> opt::histPath;
 			break;
@@ -429,6 +768,16 @@ main(int argc, char* const* argv)
 		}
 	}
 
+	if (opt::numBuckets == 0) {
+		cerr << PROGRAM ": --buckets must be at least 1\n";
+		die = true;
+	}
+
+	if (opt::binary && opt::print_all) {
+		cerr << PROGRAM ": --bin and --all are mutually exclusive\n";
+		die = true;
+	}
+
 	if (die) {
 		cerr << "Try `" << PROGRAM << " --help' for more information.\n";
 		exit(EXIT_FAILURE);
@@ -452,12 +801,16 @@ main(int argc, char* const* argv)
 			cerr << "Reading from standard input..." << endl;
 		readAlignments(cin, &alignments);
 	}
+	if (opt::maxMem > 0)
+		joinSpilledAlignments();
 	if (opt::verbose > 0)
 		cerr << "Read " << stats.alignments << " alignments" << endl;
 	if (!opt::db.empty())
 		addToDb(db, "read_alignments_initial", stats.alignments);
 
 	// Print the unpaired alignments.
+	if (opt::maxMem == 0)
+		stats.mateless = alignments.size();
 	if (opt::print_all) {
 		for (Alignments::iterator it = alignments.begin(); it != alignments.end(); it++) {
 #if SAM_SEQ_QUAL
@@ -473,9 +826,9 @@ main(int argc, char* const* argv)
 
 	unsigned numRF = g_histogram.count(INT_MIN, 0);
 	unsigned numFR = g_histogram.count(1, INT_MAX);
-	size_t sum = alignments.size() + stats.bothUnaligned + stats.oneUnaligned + numFR + numRF +
+	size_t sum = stats.mateless + stats.bothUnaligned + stats.oneUnaligned + numFR + numRF +
 	             stats.numFF + stats.numDifferent;
-	cerr << "Mateless   " << percent(alignments.size(), sum)
+	cerr << "Mateless   " << percent(stats.mateless, sum)
 	     << "\n"
 	        "Unaligned  "
 	     << percent(stats.bothUnaligned, sum)
@@ -497,9 +850,12 @@ main(int argc, char* const* argv)
 	     << "\n"
 	        "Total      "
 	     << sum << endl;
+	if (stats.spills > 0)
+		cerr << "Spilled alignments to disk " << stats.spills << " times" << endl;
+	cerr << "Peak RSS: " << toSI(getPeakMemoryUsage()) << "B" << endl;
 
 	if (!opt::db.empty()) {
-		vals = make_vector<int>() << alignments.size() << stats.bothUnaligned << stats.oneUnaligned
+		vals = make_vector<int>() << stats.mateless << stats.bothUnaligned << stats.oneUnaligned
 		                          << numFR << numRF << stats.numFF << stats.numDifferent << sum;
 
 		keys = make_vector<string>() << "Mateless"
@@ -515,7 +871,7 @@ main(int argc, char* const* argv)
 			addToDb(db, keys[i], vals[i]);
 	}
 
-	if (alignments.size() == sum) {
+	if (stats.mateless == sum) {
 		cerr << PROGRAM ": error: All reads are mateless. This "
 		                "can happen when first and second read IDs do not match."
 		     << endl;
@@ -533,6 +889,16 @@ main(int argc, char* const* argv)
 		histFile.close();
 	}
 
+	// Write the binary alignments after the histogram, because
+	// DistanceEst reads the histogram once its input is available.
+	if (opt::binary) {
+		if (opt::verbose > 0)
+			cerr << "Writing " << g_pairedAlignments.size()
+			     << " binary alignments to " << g_contigLengths.size() << " contigs" << endl;
+		writeBinaryAlignments(cout);
+		cout.flush();
+	}
+
 	if (opt::verbose > 0) {
 		size_t numTotal = numFR + numRF;
 
@@ -22,6 +22,9 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -64,6 +67,7 @@ static const char* USAGE_MESSAGE =
     "      --sam             output the graph in SAM format\n"
     "      --SS              expect contigs to be oriented correctly\n"
     "      --no-SS           no assumption about contig orientation [default]\n"
+    "  -j, --threads=N       use N parallel threads to read input [1]\n"
     "  -v, --verbose         display verbose output\n"
     "      --help            display this help and exit\n"
     "      --version         output version information and exit\n"
@@ -104,9 +108,12 @@ enum
 static int mode;
 
 static int verbose;
+
+/** Number of threads. */
+static int threads = 1;
 }
 
-static const char* shortopts = "g:k:r:v";
+static const char* shortopts = "g:j:k:r:v";
 
 enum
 {
@@ -121,6 +128,7 @@ enum
 
 static const struct option longopts[] = { { "graph", required_argument, NULL, 'g' },
 	                                      { "kmer", required_argument, NULL, 'k' },
+	                                      { "threads", required_argument, NULL, 'j' },
 	                                      { "assemble", no_argument, &opt::mode, opt::ASSEMBLE },
 	                                      { "overlap", no_argument, &opt::mode, opt::OVERLAP },
 	                                      { "trim", no_argument, &opt::mode, opt::TRIM },
@@ -596,6 +604,9 @@ main(int argc, char** argv)
 		case 'g':
 			arg >> opt::graphPath;
 			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'k':
 			arg >> opt::k;
 			break;
@@ -648,13 +659,16 @@ main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	const char* adjPath = argv[optind++];
 	if (opt::verbose > 0)
 		cerr << "Reading `" << adjPath << "'..." << endl;
-	ifstream fin(adjPath);
-	assert_good(fin, adjPath);
 	Graph g;
-	fin >> g;
+	read_graph_file(adjPath, g);
 	Vertex::s_offset = g.num_vertices() / 2;
 
 	string pathsFile(argv[optind++]);
@@ -5,7 +5,6 @@
 
 #include "Graph/PopBubbles.h"
 #include "Common/Options.h"
-#include "ConstString.h"
 #include "ContigPath.h"
 #include "ContigProperties.h"
 #include "FastaReader.h"
@@ -19,6 +18,7 @@
 #include "Sequence.h"
 #include "Uncompress.h"
 #include "alignGlobal.h"
+#include "editDistance.h"
 #include "config.h"
 #include <algorithm>
 #include <boost/lambda/bind.hpp>
@@ -203,16 +203,13 @@ popBubble(Graph& g, vertex_descriptor v, vertex_descriptor tail)
 	pair<adjacency_iterator, adjacency_iterator> adj = g.adjacent_vertices(v);
 	copy(adj.first, adj.second, sorted.begin());
 	sort(sorted.begin(), sorted.end(), CompareCoverage(g));
-	if (opt::bubbleGraph)
-#pragma omp critical(cout)
-	{
+	if (opt::bubbleGraph) {
 		cout << '"' << get(vertex_name, g, v) << "\" -> {";
 		for (vector<vertex_descriptor>::const_iterator it = sorted.begin(); it != sorted.end();
 		     ++it)
 			cout << " \"" << get(vertex_name, g, *it) << '"';
 		cout << " } -> \"" << get(vertex_name, g, tail) << "\"\n";
 	}
-#pragma omp critical(g_popped)
 	transform(sorted.begin() + 1, sorted.end(), back_inserter(g_popped), [](const ContigNode& c) {
 		return c.contigIndex();
 	});
@@ -230,7 +227,7 @@ static struct
 } g_count;
 
 /** Contig sequences. */
-typedef vector<const_string> Contigs;
+typedef vector<string> Contigs;
 static Contigs g_contigs;
 
 /** Return the sequence of vertex u. */
@@ -250,10 +247,13 @@ getLength(const Graph* g, vertex_descriptor v)
 	return (*g)[v].length;
 }
 
-/** Align the sequences of [first,last).
+/** Align the sequences of [first,last). A bubble of two branches is
+ * scored by the edit distance of the branches, counting the longer
+ * branch as the consensus.
  * @param t the vertex to the left of the bubble
  * @param v the vertex to the right of the bubble
- * @return the identity of the global alignment
+ * @return the identity of the global alignment, which is a lower
+ * bound when it is less than opt::identity
  */
 template<typename It>
 static float
@@ -298,67 +298,99 @@ getAlignmentIdentity(const Graph& g, vertex_descriptor t, vertex_descriptor v, I
 	}
 
 	unsigned matches, consensusSize;
-	tie(matches, consensusSize) = align(seqs);
+	if (nbranches == 2) {
+		// Score a two-branch bubble by its edit distance, and stop
+		// early when the minimum identity cannot be reached.
+		unsigned overlap = max_in_overlap + max_out_overlap;
+		consensusSize = max(seqs[0].size(), seqs[1].size());
+		unsigned maxEdits = 1 + (unsigned)((1 - opt::identity) * (consensusSize + overlap));
+		unsigned edits = editDistance(seqs[0], seqs[1], maxEdits);
+		matches = consensusSize - min(edits, consensusSize);
+	} else
+		tie(matches, consensusSize) = align(seqs);
 	return (float)(matches + max_in_overlap + max_out_overlap) /
 	       (consensusSize + max_in_overlap + max_out_overlap);
 }
 
-/** Pop the specified bubble if it is a simple bubble.
- * @return whether the bubble is popped
+/** The outcome of evaluating a bubble. */
+struct BubbleEvaluation
+{
+	enum Outcome
+	{
+		NOT_SIMPLE,
+		TOO_MANY,
+		TOO_LONG,
+		DISSIMILAR,
+		SIMILAR
+	};
+	Outcome outcome;
+
+	/** The vertex to the right of the bubble. */
+	vertex_descriptor tail;
+
+	/** The vertices whose out-edges and in-edges, respectively,
+	 * determine the outcome. */
+	vector<vertex_descriptor> outInspected, inInspected;
+
+	/** The verbose output of the evaluation. */
+	string log;
+
+	BubbleEvaluation()
+	  : outcome(NOT_SIMPLE)
+	{}
+};
+
+/** Evaluate whether the bubble starting at vertex v is a simple
+ * bubble whose branches are similar. The graph is not modified, so
+ * that bubbles may be evaluated in parallel.
  */
-static bool
-popSimpleBubble(Graph* pg, vertex_descriptor v)
+static void
+evaluateSimpleBubble(const Graph& g, vertex_descriptor v, BubbleEvaluation& e)
 {
-	Graph& g = *pg;
 	unsigned nbranches = g.out_degree(v);
 	assert(nbranches >= 2);
-	vertex_descriptor v1 = *g.adjacent_vertices(v).first;
-	if (g.out_degree(v1) != 1) {
-#pragma omp atomic
-		g_count.notSimple++;
-		return false;
-	}
+	pair<adjacency_iterator, adjacency_iterator> adj = g.adjacent_vertices(v);
+	e.outInspected.push_back(v);
+	e.outInspected.insert(e.outInspected.end(), adj.first, adj.second);
+	e.inInspected.insert(e.inInspected.end(), adj.first, adj.second);
+	e.outcome = BubbleEvaluation::NOT_SIMPLE;
+
+	vertex_descriptor v1 = *adj.first;
+	if (g.out_degree(v1) != 1)
+		return;
 	vertex_descriptor tail = *g.adjacent_vertices(v1).first;
+	e.tail = tail;
+	e.inInspected.push_back(tail);
 	if (v == get(vertex_complement, g, tail) // Palindrome
-	    || g.in_degree(tail) != nbranches) {
-#pragma omp atomic
-		g_count.notSimple++;
-		return false;
-	}
+	    || g.in_degree(tail) != nbranches)
+		return;
 
 	// Check that every branch is simple and ends at the same node.
-	pair<adjacency_iterator, adjacency_iterator> adj = g.adjacent_vertices(v);
 	for (adjacency_iterator it = adj.first; it != adj.second; ++it) {
-		if (g.out_degree(*it) != 1 || g.in_degree(*it) != 1) {
-#pragma omp atomic
-			g_count.notSimple++;
-			return false;
-		}
+		if (g.out_degree(*it) != 1 || g.in_degree(*it) != 1)
+			return;
 		if (*g.adjacent_vertices(*it).first != tail) {
 			// The branches do not merge back to the same node.
-#pragma omp atomic
-			g_count.notSimple++;
-			return false;
+			return;
 		}
 	}
 
-	if (opt::verbose > 2)
-#pragma omp critical(cerr)
-	{
-		cerr << "\n* " << get(vertex_name, g, v) << " ->";
+	ostringstream log;
+	log.precision(cerr.precision());
+	if (opt::verbose > 2) {
+		log << "\n* " << get(vertex_name, g, v) << " ->";
 		for (adjacency_iterator it = adj.first; it != adj.second; ++it)
-			cerr << ' ' << get(vertex_name, g, *it);
-		cerr << " -> " << get(vertex_name, g, tail) << '\n';
+			log << ' ' << get(vertex_name, g, *it);
+		log << " -> " << get(vertex_name, g, tail) << '\n';
 	}
 
 	if (nbranches > opt::maxBranches) {
 		// Too many branches.
-#pragma omp atomic
-		g_count.tooMany++;
+		e.outcome = BubbleEvaluation::TOO_MANY;
 		if (opt::verbose > 1)
-#pragma omp critical(cerr)
-			cerr << nbranches << " paths (too many)\n";
-		return false;
+			log << nbranches << " paths (too many)\n";
+		e.log = log.str();
+		return;
 	}
 
 	vector<unsigned> lengths(nbranches);
@@ -369,31 +401,49 @@ popSimpleBubble(Graph* pg, vertex_descriptor v)
 	unsigned maxLength = *max_element(lengths.begin(), lengths.end());
 	if (maxLength >= opt::maxLength) {
 		// This branch is too long.
-#pragma omp atomic
-		g_count.tooLong++;
+		e.outcome = BubbleEvaluation::TOO_LONG;
 		if (opt::verbose > 1)
-#pragma omp critical(cerr)
-			cerr << minLength << '\t' << maxLength << "\t0\t(too long)\n";
-		return false;
+			log << minLength << '\t' << maxLength << "\t0\t(too long)\n";
+		e.log = log.str();
+		return;
 	}
 
 	float identity =
 	    opt::identity == 0 ? 0 : getAlignmentIdentity(g, v, tail, adj.first, adj.second);
 	bool dissimilar = identity < opt::identity;
 	if (opt::verbose > 1)
-#pragma omp critical(cerr)
-		cerr << minLength << '\t' << maxLength << '\t' << identity
-		     << (dissimilar ? "\t(dissimilar)" : "") << '\n';
-	if (dissimilar) {
+		log << minLength << '\t' << maxLength << '\t' << identity
+		    << (dissimilar ? "\t(dissimilar)" : "") << '\n';
+	e.outcome = dissimilar ? BubbleEvaluation::DISSIMILAR : BubbleEvaluation::SIMILAR;
+	e.log = log.str();
+}
+
+/** Pop the specified bubble if it is a simple bubble.
+ * @return whether the bubble is popped
+ */
+static bool
+popSimpleBubble(Graph& g, vertex_descriptor v, const BubbleEvaluation& e)
+{
+	cerr << e.log;
+	switch (e.outcome) {
+	case BubbleEvaluation::NOT_SIMPLE:
+		g_count.notSimple++;
+		return false;
+	case BubbleEvaluation::TOO_MANY:
+		g_count.tooMany++;
+		return false;
+	case BubbleEvaluation::TOO_LONG:
+		g_count.tooLong++;
+		return false;
+	case BubbleEvaluation::DISSIMILAR:
 		// Insufficient identity.
-#pragma omp atomic
 		g_count.dissimilar++;
 		return false;
+	case BubbleEvaluation::SIMILAR:
+		break;
 	}
-
-#pragma omp atomic
 	g_count.popped++;
-	popBubble(g, v, tail);
+	popBubble(g, v, e.tail);
 	return true;
 }
 
@@ -447,8 +497,9 @@ longestPath(const Graph& g, const Bubble& topo)
 /** Scaffold over the bubble between vertices u and w.
  * Add an edge (u,w) with the distance property set to the length of
  * the largest branch of the bubble.
+ * @return whether an edge is added
  */
-static void
+static bool
 scaffoldBubble(Graph& g, const Bubble& bubble)
 {
 	typedef graph_traits<Graph>::vertex_descriptor V;
@@ -458,7 +509,7 @@ scaffoldBubble(Graph& g, const Bubble& bubble)
 	V u = bubble.front(), w = bubble.back();
 	if (edge(u, w, g).second) {
 		// Already scaffolded.
-		return;
+		return false;
 	}
 	assert(isBubble(g, bubble.begin(), bubble.end()));
 
@@ -469,21 +520,78 @@ scaffoldBubble(Graph& g, const Bubble& bubble)
 		g_popped.push_back(it->contigIndex());
 
 	add_edge(u, w, max(longestPath(g, bubble), 1), g);
+	return true;
 }
 
-/** Pop the specified bubble if it is simple, otherwise scaffold. */
+/** Pop the specified bubble if it is simple, otherwise scaffold.
+ * @param outModified the vertices whose out-edges have been changed
+ * by scaffolding, which is updated
+ * @param inModified the vertices whose in-edges have been changed by
+ * scaffolding, which is updated
+ */
 static void
-popOrScaffoldBubble(Graph& g, const Bubble& bubble)
+popOrScaffoldBubble(
+    Graph& g,
+    const Bubble& bubble,
+    const BubbleEvaluation& e,
+    vector<bool>& outModified,
+    vector<bool>& inModified)
 {
-#pragma omp atomic
 	g_count.bubbles++;
-	if (!popSimpleBubble(&g, bubble.front()) && opt::scaffold) {
-#pragma omp atomic
+	if (!popSimpleBubble(g, bubble.front(), e) && opt::scaffold) {
 		g_count.scaffold++;
-		scaffoldBubble(g, bubble);
+		if (scaffoldBubble(g, bubble)) {
+			vertex_descriptor u = bubble.front(), w = bubble.back();
+			outModified[u.index()] = true;
+			inModified[w.index()] = true;
+			outModified[get(vertex_complement, g, w).index()] = true;
+			inModified[get(vertex_complement, g, u).index()] = true;
+		}
 	}
 }
 
+/** Return whether any of the specified vertices is modified. */
+static bool
+isModified(const vector<vertex_descriptor>& vertices, const vector<bool>& modified)
+{
+	for (vector<vertex_descriptor>::const_iterator it = vertices.begin(); it != vertices.end();
+	     ++it)
+		if (modified[it->index()])
+			return true;
+	return false;
+}
+
+/** Pop or scaffold the specified bubbles. The bubbles are evaluated
+ * in parallel, which aligns the sequences of their branches, and then
+ * the outcomes are applied to the graph in order. Scaffolding a bubble
+ * adds an edge to the graph, so a bubble whose evaluation inspected an
+ * edge list that has since changed is evaluated again. The
+ * result is the same as evaluating and applying each bubble in turn.
+ */
+static void
+popOrScaffoldBubbles(Graph& g, const Bubbles& bubbles)
+{
+	vector<BubbleEvaluation> evaluations(bubbles.size());
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)bubbles.size(); ++i)
+		evaluateSimpleBubble(g, bubbles[i].front(), evaluations[i]);
+
+	vector<bool> outModified(num_vertices(g)), inModified(num_vertices(g));
+	unsigned reevaluated = 0;
+	for (size_t i = 0; i < bubbles.size(); ++i) {
+		BubbleEvaluation& e = evaluations[i];
+		if (isModified(e.outInspected, outModified) || isModified(e.inInspected, inModified)) {
+			e = BubbleEvaluation();
+			evaluateSimpleBubble(g, bubbles[i].front(), e);
+			reevaluated++;
+		}
+		popOrScaffoldBubble(g, bubbles[i], e, outModified, inModified);
+		e = BubbleEvaluation();
+	}
+	if (opt::verbose > 1 && reevaluated > 0)
+		cerr << "Evaluated " << reevaluated << " bubbles again after scaffolding.\n";
+}
+
 /** Return the length of the specified vertex in k-mer. */
 static unsigned
 getKmerLength(const ContigProperties& vp)
@@ -617,17 +725,19 @@ main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	const char* contigsPath(argv[optind++]);
 	string adjPath(argv[optind++]);
 
 	// Read the contig adjacency graph.
 	if (opt::verbose > 0)
 		cerr << "Reading `" << adjPath << "'...\n";
-	ifstream fin(adjPath.c_str());
-	assert_good(fin, adjPath);
 	Graph g;
-	fin >> g;
-	assert(fin.eof());
+	read_graph_file(adjPath, g);
 	g_contigNames.lock();
 	if (opt::verbose > 0)
 		printGraphStats(cerr, g);
@@ -637,14 +747,24 @@ main(int argc, char** argv)
 	if (opt::identity > 0) {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << contigsPath << "'...\n";
-		FastaReader in(contigsPath, FastaReader::NO_FOLD_CASE);
-		for (FastaRecord rec; in >> rec;) {
+		contigs.resize(g_contigNames.size());
+		readFastaSections<FastaRecord>(contigsPath,
+				FastaReader::NO_FOLD_CASE,
+				[&contigs](FastaRecord& rec) {
 			if (g_contigNames.count(rec.id) == 0)
-				continue;
-			assert(contigs.size() == get(g_contigNames, rec.id));
-			contigs.push_back(rec.seq);
+				return;
+			string& seq = contigs[get(g_contigNames, rec.id)];
+			assert(seq.empty());
+			seq.swap(rec.seq);
+		});
+		for (size_t i = 0; i < contigs.size(); ++i) {
+			if (contigs[i].empty()) {
+				cerr << PROGRAM ": error: contig `"
+					<< get(g_contigNames, i) << "' not found in `"
+					<< contigsPath << "'\n";
+				exit(EXIT_FAILURE);
+			}
 		}
-		assert(in.eof());
 		assert(!contigs.empty());
 		opt::colourSpace = isdigit(contigs.front()[0]);
 	}
@@ -657,8 +777,7 @@ main(int argc, char** argv)
 		cout << "digraph bubbles {\n";
 
 	Bubbles bubbles = discoverBubbles(g);
-	for (Bubbles::const_iterator it = bubbles.begin(); it != bubbles.end(); ++it)
-		popOrScaffoldBubble(g, *it);
+	popOrScaffoldBubbles(g, bubbles);
 
 	// Each bubble should be identified twice. Remove the duplicate.
 	sort(g_popped.begin(), g_popped.end());
@@ -12,6 +12,7 @@
 #include <cmath>
 #include <random>
 #include <iomanip>
+#include <utility>
 
 btllib::KmerBloomFilter *g_vanillaBloom = nullptr;
 btllib::SeedBloomFilter *g_spacedSeedsBloom = nullptr;
@@ -136,8 +137,23 @@ QCSpacedSeedsPatterns(const std::vector<std::string>& patterns)
 	std::cerr << std::flush;
 }
 
+/** The Bloom filters of one read size and r value. */
+struct FilterSet
+{
+	int readSize;
+	int r;
+	btllib::KmerBloomFilter* vanillaBloom;
+	btllib::SeedBloomFilter* spacedSeedsBloom;
+};
+
+/** The filters built by buildAllFilters. */
+static std::vector<FilterSet> g_filterSets;
+
+/** Insert the reads into the filters of the sets whose read size is
+ * the size of the read. The files are read once, however many sets
+ * there are. */
 static void
-loadReads(const std::vector<std::string>& readFilepaths, int r)
+loadReads(const std::vector<std::string>& readFilepaths, const std::vector<FilterSet>& sets)
 {
 	const size_t LOAD_PROGRESS_STEP = 100000;
 	const size_t PARALLEL_IO_SIZE = 100;
@@ -171,22 +187,26 @@ loadReads(const std::vector<std::string>& readFilepaths, int r)
 				uint64_t readCount = 0;
 #pragma omp parallel num_threads(threads_per_task)
 				for (btllib::SeqReader::Record record; (record = reader.read());) {
-					if (int(record.seq.size()) != ReadSize::current.size) {
-						continue;
-					}
-					std::string seq = record.seq.substr(0, r + opt::extract - 1);
-					if (seq.size() >= g_vanillaBloom->get_k()) {
-						g_vanillaBloom->insert(seq);
-						if (opt::errorCorrection) {
-							g_spacedSeedsBloom->insert(seq);
+					bool loaded = false;
+					for (const auto& set : sets) {
+						if (int(record.seq.size()) != set.readSize) {
+							continue;
 						}
-						if (opt::verbose)
-#pragma omp critical(cerr)
-						{
-							readCount++;
-							if (readCount % LOAD_PROGRESS_STEP == 0) {
-								std::cerr << "\rLoaded " << readCount << " reads into Bloom filter.";
+						const size_t len = std::min(size_t(set.r + opt::extract - 1), record.seq.size());
+						if (len >= set.vanillaBloom->get_k()) {
+							set.vanillaBloom->insert(record.seq.data(), len);
+							if (opt::errorCorrection) {
+								set.spacedSeedsBloom->insert(record.seq.data(), len);
 							}
+							loaded = true;
+						}
+					}
+					if (opt::verbose && loaded)
+#pragma omp critical(cerr)
+					{
+						readCount++;
+						if (readCount % LOAD_PROGRESS_STEP == 0) {
+							std::cerr << "\rLoaded " << readCount << " reads into Bloom filter.";
 						}
 					}
 				}
@@ -202,6 +222,81 @@ loadReads(const std::vector<std::string>& readFilepaths, int r)
 	}
 }
 
+/** Allocate the Bloom filters of one r value, splitting the memory
+ * between the vanilla and spaced seeds filters. */
+static FilterSet
+allocateFilters(const int readSize, const int r, const size_t bloomBytesTotal)
+{
+	size_t bloomBytesVanilla = size_t(bloomBytesTotal);
+	size_t bloomBytesSpacedSeeds = 0;
+
+	if (opt::errorCorrection) {
+		double vanillaRatio =
+		    VANILLA_TO_SEEDS_MEM_RATIO * double(HASH_NUM) /
+		    (double(HASH_NUM) + double(SPACED_SEEDS_COUNT * SPACED_SEEDS_HASHES_PER_SEED));
+		bloomBytesVanilla = size_t(vanillaRatio * bloomBytesTotal);
+		bloomBytesSpacedSeeds = bloomBytesTotal - bloomBytesVanilla;
+	}
+
+	if (opt::verbose > 1) {
+		if (opt::errorCorrection) {
+			std::cerr << "Total Bloom filter memory = " << bytesToSI(bloomBytesTotal) << '\n';
+			std::cerr << "Vanilla Bloom filter memory = " << bytesToSI(bloomBytesVanilla)
+			          << '\n';
+			std::cerr << "Spaced seeds Bloom filter memory = "
+			          << bytesToSI(bloomBytesSpacedSeeds) << '\n';
+		} else {
+			std::cerr << "Vanilla Bloom filter memory = " << bytesToSI(bloomBytesVanilla)
+			          << '\n';
+		}
+	}
+
+	FilterSet set = { readSize, r, nullptr, nullptr };
+	set.vanillaBloom = new btllib::KmerBloomFilter(bloomBytesVanilla, HASH_NUM, r);
+	if (opt::errorCorrection) {
+		const auto patterns =
+			generateSpacedSeedsPatterns(SPACED_SEEDS_COUNT, r, SPACED_SEEDS_MISSES);
+		for (const auto& pattern : patterns) {
+			assert(pattern.size() == size_t(r));
+		}
+		if (SPACED_SEEDS_QC) {
+			QCSpacedSeedsPatterns(patterns);
+		}
+		set.spacedSeedsBloom = new btllib::SeedBloomFilter(bloomBytesSpacedSeeds, r, patterns, SPACED_SEEDS_HASHES_PER_SEED);
+	}
+	return set;
+}
+
+static void
+printFilterStats(const FilterSet& set)
+{
+	const auto vanillaFPR = set.vanillaBloom->get_fpr();
+
+	std::cerr << "Vanilla Bloom filter (k = "
+	          << std::to_string(set.vanillaBloom->get_k()) << std::setprecision(3)
+	          << ") occupancy = "
+	          << set.vanillaBloom->get_occupancy() * 100.0
+	          << "%"
+	          << ", FPR = " << vanillaFPR * 100.0 << "%" << std::endl;
+
+	if (opt::errorCorrection) {
+		std::cerr << "FPR for base substitution = "
+		          << (1 - std::pow(
+		                      1 - vanillaFPR,
+		                      3 * set.vanillaBloom->get_k() / SPACED_SEEDS_COUNT *
+		                          SPACED_SEEDS_SNP_FRACTION)) *
+		                 100.0
+		          << "%" << std::endl;
+
+		std::cerr << "Spaced seeds Bloom filter (k = "
+		          << std::to_string(set.spacedSeedsBloom->get_k()) << std::setprecision(3)
+		          << ") occupancy = "
+		          << set.spacedSeedsBloom->get_occupancy() * 100.0
+		          << "%"
+		          << ", FPR = " << set.spacedSeedsBloom->get_fpr() * 100.0 << "%" << std::endl;
+	}
+}
+
 void
 buildFilters(
     const std::vector<std::string>& readFilepaths,
@@ -209,6 +304,7 @@ buildFilters(
     const size_t bloomBytesTotal)
 {
 	assert(bloomBytesTotal > 0);
+	assert(g_filterSets.empty());
 	try {
 		if (opt::verbose) {
 			std::cerr << "Building Bloom filter(s) for r value " << r << '\n';
@@ -217,70 +313,68 @@ buildFilters(
 		delete g_vanillaBloom;
 		delete g_spacedSeedsBloom;
 
-		size_t bloomBytesVanilla = size_t(bloomBytesTotal);
-		size_t bloomBytesSpacedSeeds = 0;
+		const auto set = allocateFilters(ReadSize::current.size, r, bloomBytesTotal);
+		g_vanillaBloom = set.vanillaBloom;
+		g_spacedSeedsBloom = set.spacedSeedsBloom;
 
-		if (opt::errorCorrection) {
-			double vanillaRatio =
-			    VANILLA_TO_SEEDS_MEM_RATIO * double(HASH_NUM) /
-			    (double(HASH_NUM) + double(SPACED_SEEDS_COUNT * SPACED_SEEDS_HASHES_PER_SEED));
-			bloomBytesVanilla = size_t(vanillaRatio * bloomBytesTotal);
-			bloomBytesSpacedSeeds = bloomBytesTotal - bloomBytesVanilla;
-		}
+		loadReads(readFilepaths, { set });
 
 		if (opt::verbose > 1) {
-			if (opt::errorCorrection) {
-				std::cerr << "Total Bloom filter memory = " << bytesToSI(bloomBytesTotal) << '\n';
-				std::cerr << "Vanilla Bloom filter memory = " << bytesToSI(bloomBytesVanilla)
-				          << '\n';
-				std::cerr << "Spaced seeds Bloom filter memory = "
-				          << bytesToSI(bloomBytesSpacedSeeds) << '\n';
-			} else {
-				std::cerr << "Vanilla Bloom filter memory = " << bytesToSI(bloomBytesVanilla)
-				          << '\n';
-			}
+			printFilterStats(set);
 		}
+	} catch (const std::bad_alloc& e) {
+		std::cerr << "Bloom filter allocation failed: " << e.what() << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
 
-		g_vanillaBloom = new btllib::KmerBloomFilter(bloomBytesVanilla, HASH_NUM, r);
-		if (opt::errorCorrection) {
-			const auto patterns =
-				generateSpacedSeedsPatterns(SPACED_SEEDS_COUNT, r, SPACED_SEEDS_MISSES);
-			for (const auto& pattern : patterns) {
-				assert(pattern.size() == size_t(r));
+void
+buildAllFilters(const std::vector<std::string>& readFilepaths, const size_t bloomBytesTotal)
+{
+	assert(bloomBytesTotal > 0);
+	assert(g_filterSets.empty());
+	try {
+		// The distinct pairs of read size and r value. A pair that is
+		// repeated shares one set of filters.
+		std::vector<std::pair<int, int>> pairs;
+		std::vector<double> fractions;
+		for (const auto& batch : ReadSize::readSizes) {
+			for (int r : batch.rValues) {
+				const auto pair = std::make_pair(batch.size, r);
+				if (r < int(opt::k) ||
+				    std::find(pairs.begin(), pairs.end(), pair) != pairs.end()) {
+					continue;
+				}
+				pairs.push_back(pair);
+				fractions.push_back(batch.getFractionOfTotal());
 			}
-			if (SPACED_SEEDS_QC) {
-				QCSpacedSeedsPatterns(patterns);
+		}
+
+		// Every read contributes opt::extract r-mers to each filter of
+		// its read size, so split the memory in proportion to the
+		// number of reads of each size, for an equal FPR.
+		double weightTotal = 0;
+		for (double fraction : fractions) {
+			weightTotal += fraction;
+		}
+		for (size_t i = 0; i < pairs.size(); i++) {
+			const int readSize = pairs[i].first, r = pairs[i].second;
+			const size_t bytes = size_t(bloomBytesTotal * (fractions[i] / weightTotal));
+			if (opt::verbose) {
+				std::cerr << "Building Bloom filter(s) for read size " << readSize
+				          << ", r value " << r << '\n';
 			}
-			g_spacedSeedsBloom = new btllib::SeedBloomFilter(bloomBytesSpacedSeeds, r, patterns, SPACED_SEEDS_HASHES_PER_SEED);
+			g_filterSets.push_back(allocateFilters(readSize, r, bytes));
+		}
+		if (g_filterSets.empty()) {
+			return;
 		}
 
-		loadReads(readFilepaths, r);
+		loadReads(readFilepaths, g_filterSets);
 
 		if (opt::verbose > 1) {
-			const auto vanillaFPR = g_vanillaBloom->get_fpr();
-
-			std::cerr << "Vanilla Bloom filter (k = "
-			          << std::to_string(g_vanillaBloom->get_k()) << std::setprecision(3)
-			          << ") occupancy = "
-			          << g_vanillaBloom->get_occupancy() * 100.0
-			          << "%"
-			          << ", FPR = " << vanillaFPR * 100.0 << "%" << std::endl;
-
-			if (opt::errorCorrection) {
-				std::cerr << "FPR for base substitution = "
-				          << (1 - std::pow(
-				                      1 - vanillaFPR,
-				                      3 * g_vanillaBloom->get_k() / SPACED_SEEDS_COUNT *
-				                          SPACED_SEEDS_SNP_FRACTION)) *
-				                 100.0
-				          << "%" << std::endl;
-
-				std::cerr << "Spaced seeds Bloom filter (k = "
-				          << std::to_string(g_spacedSeedsBloom->get_k()) << std::setprecision(3)
-				          << ") occupancy = "
-				          << g_spacedSeedsBloom->get_occupancy() * 100.0
-				          << "%"
-				          << ", FPR = " << g_spacedSeedsBloom->get_fpr() * 100.0 << "%" << std::endl;
+			for (const auto& set : g_filterSets) {
+				printFilterStats(set);
 			}
 		}
 	} catch (const std::bad_alloc& e) {
@@ -288,3 +382,18 @@ buildFilters(
 		exit(EXIT_FAILURE);
 	}
 }
+
+void
+useFilters(const int readSize, const int r)
+{
+	for (const auto& set : g_filterSets) {
+		if (set.readSize == readSize && set.r == r) {
+			g_vanillaBloom = set.vanillaBloom;
+			g_spacedSeedsBloom = set.spacedSeedsBloom;
+			return;
+		}
+	}
+	std::cerr << "error: no Bloom filters were built for read size " << readSize
+	          << " and r value " << r << '\n';
+	exit(EXIT_FAILURE);
+}
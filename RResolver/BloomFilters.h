@@ -31,4 +31,14 @@ buildFilters(
     const int r,
     const size_t bloom_bytes_total);
 
+/** Build the Bloom filters of every read size and r value in one pass
+ * over the reads, splitting the memory between them. */
+void
+buildAllFilters(const std::vector<std::string>& read_filepaths, const size_t bloom_bytes_total);
+
+/** Make the filters of the specified read size and r value, built by
+ * buildAllFilters, the current filters. */
+void
+useFilters(const int read_size, const int r);
+
 #endif
@@ -93,10 +93,7 @@ loadContigGraph(const std::string& contigGraphPath)
 {
 	if (opt::verbose)
 		std::cerr << "Loading contig graph from `" << contigGraphPath << "'...\n";
-	std::ifstream fin(contigGraphPath);
-	assert_good(fin, contigGraphPath);
-	fin >> g_contigGraph;
-	assert(fin.eof());
+	read_graph_file(contigGraphPath, g_contigGraph);
 	g_contigNames.lock();
 	if (opt::verbose) {
 		std::cerr << "Contig graph loaded.\n";
@@ -109,16 +106,26 @@ loadContigs(const std::string& contigsPath)
 {
 	if (opt::verbose)
 		std::cerr << "Loading contigs from `" << contigsPath << "'...\n";
-	FastaReader in(contigsPath.c_str(), FastaReader::NO_FOLD_CASE);
-	for (FastaRecord rec; in >> rec;) {
-		if (g_contigNames.count(rec.id) == 0)
-			continue;
-		assert(g_contigSequences.size() / 2 == get(g_contigNames, rec.id));
-		g_contigComments.push_back(rec.comment);
-		g_contigSequences.push_back(rec.seq);
-		g_contigSequences.push_back(reverseComplement(rec.seq));
+	// Read the sections of the file in parallel, and store each
+	// contig and its reverse complement at the index of the graph.
+	std::vector<std::string> seqs(2 * g_contigNames.size());
+	g_contigComments.resize(g_contigNames.size());
+	readFastaSections<FastaRecord>(
+	    contigsPath.c_str(), FastaReader::NO_FOLD_CASE, [&seqs](FastaRecord& rec) {
+		    if (g_contigNames.count(rec.id) == 0)
+			    return;
+		    const unsigned i = get(g_contigNames, rec.id);
+		    assert(seqs[2 * i].empty());
+		    g_contigComments[i].swap(rec.comment);
+		    seqs[2 * i + 1] = reverseComplement(rec.seq);
+		    seqs[2 * i].swap(rec.seq);
+	    });
+	g_contigSequences.reserve(seqs.size());
+	for (auto& seq : seqs) {
+		assert(!seq.empty());
+		g_contigSequences.push_back(seq);
+		std::string().swap(seq);
 	}
-	assert(in.eof());
 	assert(!g_contigSequences.empty());
 	opt::colourSpace = isdigit(g_contigSequences.front()[0]);
 	if (opt::verbose) {
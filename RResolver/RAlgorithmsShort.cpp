@@ -1,5 +1,6 @@
 #include "RAlgorithmsShort.h"
 #include "RUtils.h"
+#include "SegmentHashes.h"
 #include "SequenceTree.h"
 
 #include "btllib/include/btllib/seq_reader.hpp"
@@ -260,58 +261,103 @@ determineShortReadStats(const std::vector<std::string>& readFilenames)
 	return true;
 }
 
-static Support
-testSequence(const Sequence& sequence)
+/** Count the windows of a sequence that has a base other than ACGT
+ * that are in the vanilla filter, possibly with one substitution. */
+static int
+countSubstitutionHitsSlow(const Sequence& sequence)
 {
 	static unsigned char BASES[] = { 'A', 'C', 'T', 'G' };
 	int found = 0;
-	int tests = 0;
-	unsigned r = g_vanillaBloom->get_k();
-	if (sequence.size() >= r) {
-		tests = sequence.size() - r + 1;
-		int offset = 0;
-		if (opt::errorCorrection) {
-			btllib::NtHash nthash(sequence, r, g_vanillaBloom->get_hash_num());
-			for (const auto& hitSeeds : g_spacedSeedsBloom->contains(sequence)) {
-				nthash.roll();
-				if (hitSeeds.size() > 0) {
-					nthash.sub({}, {});
-					if (g_vanillaBloom->contains(nthash.hashes())) {
-						found++;
-					} else {
-						bool success = false;
-						for (const auto& hitSeed : hitSeeds) {
-							const auto seed = g_spacedSeedsBloom->get_parsed_seeds()[hitSeed];
-							for (auto seedIt =
-							         (seed.begin() +
-							          std::round(
-							              seed.size() * (1.00 - SPACED_SEEDS_SNP_FRACTION)));
-							     seedIt != seed.end();
-							     ++seedIt) {
-								const auto pos = *seedIt;
-								for (auto base : BASES) {
-									if (base == (unsigned char)(sequence[offset + pos])) {
-										continue;
-									}
-									nthash.sub({ pos }, { base });
-									if (g_vanillaBloom->contains(nthash.hashes())) {
-										success = true;
-										found++;
-										break;
-									}
-								}
-								if (success) {
-									break;
-								}
+	int offset = 0;
+	btllib::NtHash nthash(sequence, g_vanillaBloom->get_k(), g_vanillaBloom->get_hash_num());
+	for (const auto& hitSeeds : g_spacedSeedsBloom->contains(sequence)) {
+		nthash.roll();
+		if (hitSeeds.size() > 0) {
+			nthash.sub({}, {});
+			if (g_vanillaBloom->contains(nthash.hashes())) {
+				found++;
+			} else {
+				bool success = false;
+				for (const auto& hitSeed : hitSeeds) {
+					const auto seed = g_spacedSeedsBloom->get_parsed_seeds()[hitSeed];
+					for (auto seedIt =
+					         (seed.begin() +
+					          std::round(
+					              seed.size() * (1.00 - SPACED_SEEDS_SNP_FRACTION)));
+					     seedIt != seed.end();
+					     ++seedIt) {
+						const auto pos = *seedIt;
+						for (auto base : BASES) {
+							if (base == (unsigned char)(sequence[offset + pos])) {
+								continue;
 							}
-							if (success) {
+							nthash.sub({ pos }, { base });
+							if (g_vanillaBloom->contains(nthash.hashes())) {
+								success = true;
+								found++;
 								break;
 							}
 						}
+						if (success) {
+							break;
+						}
+					}
+					if (success) {
+						break;
 					}
 				}
-				offset++;
 			}
+		}
+		offset++;
+	}
+	return found;
+}
+
+/** Count the windows of a sequence that are in the vanilla filter,
+ * possibly with one substitution at a position that a hit spaced seed
+ * tolerates. */
+static int
+countSubstitutionHits(const Sequence& sequence)
+{
+	const SegmentHashes hashes(sequence);
+	if (!hashes.valid()) {
+		return countSubstitutionHitsSlow(sequence);
+	}
+
+	const auto& seeds = g_spacedSeedsBloom->get_parsed_seeds();
+	static thread_local std::vector<unsigned> positions;
+	int found = 0;
+	size_t offset = 0;
+	for (const auto& hitSeeds : g_spacedSeedsBloom->contains(sequence)) {
+		if (hitSeeds.size() > 0) {
+			positions.clear();
+			for (const auto& hitSeed : hitSeeds) {
+				const auto& seed = seeds[hitSeed];
+				positions.insert(
+				    positions.end(),
+				    seed.begin() +
+				        std::round(seed.size() * (1.00 - SPACED_SEEDS_SNP_FRACTION)),
+				    seed.end());
+			}
+			if (containsSubstitution(hashes, sequence, offset, positions, *g_vanillaBloom)) {
+				found++;
+			}
+		}
+		offset++;
+	}
+	return found;
+}
+
+static Support
+testSequence(const Sequence& sequence)
+{
+	int found = 0;
+	int tests = 0;
+	unsigned r = g_vanillaBloom->get_k();
+	if (sequence.size() >= r) {
+		tests = sequence.size() - r + 1;
+		if (opt::errorCorrection) {
+			found = countSubstitutionHits(sequence);
 		} else {
 			found = g_vanillaBloom->contains(sequence);
 		}
@@ -324,7 +370,9 @@ testCombination(
     const std::string& head,
     const std::string& repeat,
     const std::string& tail,
-    const int requestedTests)
+    const int requestedTests,
+    const SegmentHashes* headRepeatHashes = nullptr,
+    const SegmentHashes* tailHashes = nullptr)
 {
 	const auto windowSize = g_vanillaBloom->get_k();
 
@@ -352,20 +400,30 @@ testCombination(
 		return Support(Support::UnknownReason::TAIL_SHORTER_THAN_MARGIN);
 	}
 
-	Sequence sequence;
+	size_t start = 0;
+	size_t end = head.size() + repeat.size() + tail.size();
 	if (possibleTests > plannedTests + 1) {
 		assert(long(head.size()) > margin || long(tail.size()) > margin);
-		sequence = head.substr(head.size() - margin) + repeat + tail.substr(0, margin);
-	} else {
-		sequence = head + repeat + tail;
+		start = head.size() - margin;
+		end = head.size() + repeat.size() + margin;
 	}
-	possibleTests = sequence.size() - windowSize + 1;
+	const int sequenceSize = end - start;
+	possibleTests = sequenceSize - windowSize + 1;
 
 	assert(plannedTests <= possibleTests);
 	assert(possibleTests <= plannedTests + 1);
-	assert(int(sequence.size()) >= MIN_MARGIN + int(repeat.size()) + MIN_MARGIN);
-	assert(int(sequence.size()) < int(windowSize) * 2);
+	assert(sequenceSize >= MIN_MARGIN + int(repeat.size()) + MIN_MARGIN);
+	assert(sequenceSize < int(windowSize) * 2);
+
+	if (headRepeatHashes != nullptr && tailHashes != nullptr && headRepeatHashes->valid() &&
+	    tailHashes->valid() && possibleTests > 0) {
+		return Support(
+		    countConcatenationHits(*headRepeatHashes, *tailHashes, start, end, *g_vanillaBloom),
+		    possibleTests);
+	}
 
+	const Sequence sequence =
+	    head.substr(start) + repeat + tail.substr(0, end - head.size() - repeat.size());
 	return testSequence(sequence);
 }
 
@@ -463,17 +521,36 @@ determinePathSupport(const ContigPath& path)
 		}
 	}
 
+	// Hash every head and tail once, rather than once per combination.
+	// Error correction substitutes bases of each window, so its
+	// windows are hashed one sequence at a time.
+	std::vector<SegmentHashes> headHashes, tailHashes;
+	if (!opt::errorCorrection) {
+		headHashes.reserve(heads.size());
+		for (const auto& head : heads) {
+			headHashes.emplace_back(head + repeat);
+		}
+		tailHashes.reserve(tails.size());
+		for (const auto& tail : tails) {
+			tailHashes.emplace_back(tail);
+		}
+	}
+	const auto testHeadTail = [&](size_t i, size_t j) {
+		if (opt::errorCorrection) {
+			return testCombination(heads[i], repeat, tails[j], requiredTests);
+		}
+		return testCombination(
+		    heads[i], repeat, tails[j], requiredTests, &headHashes[i], &tailHashes[j]);
+	};
+	const size_t numHeads = heads.size();
+	const size_t numTails = tails.size();
+
 	Support maxSupport(calculatedTests, Support::UnknownReason::UNDETERMINED);
 	bool unknown = false;
 
 	if (combinations >= PATH_COMBINATIONS_MULTITHREAD_THRESHOLD) {
 		bool end = false;
-#if _OPENMP
-		for (const auto& h : heads) {
-			const auto head = h;
-#else
-		for (const auto& head : heads) {
-#endif
+		for (size_t i = 0; i < numHeads; i++) {
 #pragma omp critical(maxSupport)
 			{
 				if (unknown) {
@@ -484,10 +561,10 @@ determinePathSupport(const ContigPath& path)
 				break;
 			}
 
-#pragma omp task firstprivate(head) shared(maxSupport, unknown)
+#pragma omp task firstprivate(i) shared(maxSupport, unknown)
 			{
 				bool end = false;
-				for (const auto& tail : tails) {
+				for (size_t j = 0; j < numTails; j++) {
 #pragma omp critical(maxSupport)
 					{
 						if (unknown) {
@@ -498,7 +575,7 @@ determinePathSupport(const ContigPath& path)
 						break;
 					}
 
-					auto support = testCombination(head, repeat, tail, requiredTests);
+					auto support = testHeadTail(i, j);
 
 #pragma omp critical(maxSupport)
 					{
@@ -519,17 +596,17 @@ determinePathSupport(const ContigPath& path)
 			}
 		}
 	} else {
-		for (const auto& head : heads) {
+		for (size_t i = 0; i < numHeads; i++) {
 			if (unknown) {
 				break;
 			}
 
-			for (const auto& tail : tails) {
+			for (size_t j = 0; j < numTails; j++) {
 				if (unknown) {
 					break;
 				}
 
-				auto support = testCombination(head, repeat, tail, requiredTests);
+				auto support = testHeadTail(i, j);
 
 				if (support.unknown()) {
 					unknown = true;
@@ -638,7 +715,6 @@ static Resolution
 resolveRepeats()
 {
 	long total = (num_vertices(g_contigGraph) - num_vertices_removed(g_contigGraph)) / 2;
-	long repeats = 0;
 	long pathsSupported = 0, pathsUnsupported = 0;
 	std::vector<Support> supports;
 
@@ -647,47 +723,38 @@ resolveRepeats()
 
 	Resolution resolution(ReadSize::current, g_vanillaBloom->get_k());
 
+	// Number the repeats in graph order, so that the histogram sample
+	// and the repeat cases limit do not depend on the thread schedule.
+	std::vector<ContigNode> repeatNodes;
 	Graph::vertex_iterator vertexStart, vertexEnd;
-	boost::tie(vertexStart, vertexEnd) = vertices(g_contigGraph);
-
-	iteratorMultithreading(
-	    vertexStart,
-	    vertexEnd,
-	    [&](const ContigNode& node) {
-		    if (!get(vertex_removed, g_contigGraph, node)) {
-			    if (isSmallRepeat(node)) {
-				    return true;
-			    } else {
-#pragma omp critical(cerr)
-				    progressUpdate();
-				    return false;
-			    }
-		    }
-		    return false;
-	    },
-	    [&](const ContigNode& node) {
-		    bool inHistSample;
-		    bool skip = false;
-#pragma omp critical(resolution)
-		    {
-			    repeats++;
-			    inHistSample = (repeats <= HIST_SAMPLE_SIZE);
-			    skip = (repeats > REPEAT_CASES_LIMIT);
-		    }
-
-		    if (!skip) {
-			    auto supportMap = buildRepeatSupportMap(node);
-
-#pragma omp critical(resolution)
-			    {
-				    resolution.repeatSupportMap[node.index()] = supportMap;
-				    updateStats(resolution, supports, supportMap, inHistSample);
-			    }
-		    }
+	for (boost::tie(vertexStart, vertexEnd) = vertices(g_contigGraph); vertexStart != vertexEnd;
+	     ++vertexStart) {
+		const ContigNode& node = *vertexStart;
+		if (!get(vertex_removed, g_contigGraph, node)) {
+			if (isSmallRepeat(node)) {
+				repeatNodes.push_back(node);
+			} else {
+				progressUpdate();
+			}
+		}
+	}
+	const long repeats = repeatNodes.size();
+
+	// Each repeat writes only its own element, so no lock is needed.
+	std::vector<SupportMap> supportMaps(repeatNodes.size());
+#pragma omp parallel for schedule(dynamic)
+	for (long i = 0; i < repeats; i++) {
+		if (i < REPEAT_CASES_LIMIT) {
+			supportMaps[i] = buildRepeatSupportMap(repeatNodes[i]);
+		}
+		progressUpdate();
+	}
 
-#pragma omp critical(cerr)
-		    progressUpdate();
-	    });
+	for (long i = 0; i < repeats && i < REPEAT_CASES_LIMIT; i++) {
+		const bool inHistSample = i < HIST_SAMPLE_SIZE;
+		updateStats(resolution, supports, supportMaps[i], inHistSample);
+		resolution.repeatSupportMap[repeatNodes[i].index()] = std::move(supportMaps[i]);
+	}
 
 	long pathsKnown = 0, pathsUnknown = 0, pathsTotal = 0;
 	static const std::string unknownReasonLabels[] = { "Undetermined", "Too many combinations", "Over max tests", "Possible tests < planned tests", "Window not long enough", "Head shorter than margin", "Tail shorter than margin", "Different culprit" };
@@ -915,7 +982,6 @@ processGraph(
 			    }
 		    }
 
-#pragma omp critical(cerr)
 		    progressUpdate();
 	    },
 	    std::min(4, threads));
@@ -1095,7 +1161,6 @@ processGraph(
 			    }
 		    }
 
-#pragma omp critical(cerr)
 		    progressUpdate();
 	    });
 
@@ -1196,6 +1261,10 @@ resolveShort(
 	assert(g_contigSequences.size() / 2 == g_contigComments.size());
 	assert(ReadSize::readSizes.size() > 0);
 
+	if (opt::singlePass) {
+		buildAllFilters(readFilepaths, opt::bloomSize);
+	}
+
 	std::vector<std::pair<int, Histogram>> histograms;
 	for (auto batch : ReadSize::readSizes) {
 		ReadSize::current = batch;
@@ -1211,7 +1280,11 @@ resolveShort(
 				std::cerr << "\nRead size = " << batch.size << ", r = " << r << " ...\n\n";
 			}
 
-			buildFilters(readFilepaths, r, opt::bloomSize);
+			if (opt::singlePass) {
+				useFilters(batch.size, r);
+			} else {
+				buildFilters(readFilepaths, r, opt::bloomSize);
+			}
 
 			for (size_t j = 0; j < MAX_SUBITERATIONS; j++) {
 				if (opt::verbose) {
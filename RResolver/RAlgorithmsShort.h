@@ -72,6 +72,9 @@ extern int readQualityThreshold;
 /** Flag indicating whether error correction is enabled */
 extern int errorCorrection;
 
+/** Flag indicating whether the filters of all r values are built in one pass */
+extern int singlePass;
+
 /** Name of the file to write supported paths to */
 extern std::string outputSupportedPathsPath;
 
@@ -52,6 +52,8 @@ static const char USAGE_MESSAGE[] =
 		"  -a, --approx-factor         explicitly set coverage approximation factor.\n"
 		"  -q, --quality--threshold=N  minimum quality all bases in rmers should have, on average. [35] (UNUSED)\n"
     "  -e, --error-correction      enable correction of a 1bp error in kmers. [false]\n"
+    "  -s, --single-pass           load the reads into the Bloom filters of all r values in one pass.\n"
+    "                              The Bloom filter size is then split between the filters. [false]\n"
     "  -S, --supported=FILE        write supported paths to FILE.\n"
     "  -U, --unsupported=FILE      write unsupported paths to FILE.\n"
     "                              Used for path sequence quality check.\n"
@@ -113,6 +115,9 @@ int readQualityThreshold = 35;
 /** Flag indicating whether error correction is enabled */
 int errorCorrection = 0;
 
+/** Flag indicating whether the filters of all r values are built in one pass */
+int singlePass = 0;
+
 /** Name of the file to write supported paths to */
 std::string outputSupportedPathsPath;
 
@@ -125,7 +130,7 @@ int format; // used by ContigProperties
 
 }
 
-static const char shortopts[] = "b:j:g:c:k:h:t:x:m:M:n:r:a:q:eS:U:v";
+static const char shortopts[] = "b:j:g:c:k:h:t:x:m:M:n:r:a:q:esS:U:v";
 
 enum
 {
@@ -149,6 +154,7 @@ static const struct option longopts[] = {
 	{ "approx-factor", required_argument, NULL, 'a' },
 	{ "quality-threshold", required_argument, NULL, 'q' },
 	{ "error-correction", no_argument, &opt::errorCorrection, 1 },
+	{ "single-pass", no_argument, &opt::singlePass, 1 },
 	{ "supported", required_argument, NULL, 'S' },
 	{ "unsupported", required_argument, NULL, 'U' },
 	{ "adj", no_argument, &opt::format, ADJ },
@@ -326,6 +332,12 @@ main(int argc, char** argv)
 		case 'q':
 		  arg >> opt::readQualityThreshold;
 			break;
+		case 'e':
+			opt::errorCorrection = 1;
+			break;
+		case 's':
+			opt::singlePass = 1;
+			break;
 		case 'S':
 			arg >> opt::outputSupportedPathsPath;
 			break;
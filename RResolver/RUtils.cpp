@@ -2,6 +2,7 @@
 
 #include "Common/Options.h"
 
+#include <atomic>
 #include <cassert>
 #include <iomanip>
 #include <iostream>
@@ -9,9 +10,9 @@
 static std::string progressName;
 static unsigned progressNumber = 0;
 static unsigned progressTotal;
-static unsigned progressUpdates;
-static unsigned progressLastPrinted;
-static bool progressRunning = false;
+static std::atomic<unsigned> progressUpdates;
+static std::atomic<unsigned> progressLastPrinted;
+static std::atomic<bool> progressRunning(false);
 
 void
 progressStart(const std::string& name, unsigned total)
@@ -30,24 +31,28 @@ progressStart(const std::string& name, unsigned total)
 	}
 }
 
+/** Count one unit of work. Threads may call this concurrently without
+ * a lock. Only the thread that claims a percentage prints it. */
 void
 progressUpdate()
 {
 	if (opt::verbose) {
 		assert(progressRunning);
-		progressUpdates++;
-		assert(progressUpdates <= progressTotal);
-		double fraction = double(progressUpdates) / progressTotal;
+		const unsigned updates = ++progressUpdates;
+		assert(updates <= progressTotal);
 
-		if (progressUpdates == progressTotal) {
+		if (updates == progressTotal) {
 			std::cerr << "\rProgress: 100%\n" << progressName << " done." << std::endl;
 			progressRunning = false;
-		} else if (
-		    double(progressUpdates - progressLastPrinted) / progressTotal >=
-		        PROGRESS_PRINT_FRACTION &&
-		    progressUpdates < progressTotal) {
+			return;
+		}
+
+		unsigned lastPrinted = progressLastPrinted;
+		if (updates > lastPrinted &&
+		    double(updates - lastPrinted) / progressTotal >= PROGRESS_PRINT_FRACTION &&
+		    progressLastPrinted.compare_exchange_strong(lastPrinted, updates)) {
+			double fraction = double(updates) / progressTotal;
 			std::cerr << "\rProgress: " << int(fraction * 100.0) << "%" << std::flush;
-			progressLastPrinted = progressUpdates;
 		}
 	}
 }
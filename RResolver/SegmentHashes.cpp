@@ -0,0 +1,175 @@
+#include "SegmentHashes.h"
+
+#include "btllib/nthash.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+/** Rotate the low 33 bits and the high 31 bits of a hash left by n,
+ * which is n applications of the ntHash rotation. */
+static inline uint64_t
+srol(uint64_t x, unsigned n)
+{
+	return (btllib::rol31(x >> 33, n) << 33) | btllib::rol33(x & 0x1FFFFFFFF, n);
+}
+
+/** Rotate the low 33 bits and the high 31 bits of a hash right by n,
+ * which undoes srol(x, n). */
+static inline uint64_t
+sror(uint64_t x, unsigned n)
+{
+	return (btllib::rol31(x >> 33, 31 - n % 31) << 33) | btllib::rol33(x & 0x1FFFFFFFF, 33 - n % 33);
+}
+
+SegmentHashes::SegmentHashes(const std::string& seq)
+  : forward(seq.size() + 1)
+  , reverse(seq.size() + 1)
+  , isValid(true)
+{
+	forward[0] = 0;
+	reverse[0] = 0;
+	for (size_t i = 0; i < seq.size(); i++) {
+		const auto c = (unsigned char)seq[i];
+		if (btllib::SEED_TAB[c] == btllib::SEED_N) {
+			isValid = false;
+		}
+		forward[i + 1] = srol(forward[i], 1) ^ btllib::SEED_TAB[c];
+		reverse[i + 1] = reverse[i] ^ srol(btllib::SEED_TAB[c & btllib::CP_OFF], i);
+	}
+}
+
+void
+SegmentHashes::kmerHashes(size_t pos, unsigned k, uint64_t& fh, uint64_t& rh) const
+{
+	assert(pos + k <= size());
+	fh = forward[pos + k] ^ srol(forward[pos], k);
+	rh = sror(reverse[pos + k] ^ reverse[pos], pos);
+}
+
+/** Return the canonical hash and its multi-hashes. */
+static inline void
+multiHashes(uint64_t fh, uint64_t rh, unsigned k, unsigned hashNum, uint64_t* hashes)
+{
+	const uint64_t h = rh < fh ? rh : fh;
+	hashes[0] = h;
+	for (unsigned j = 1; j < hashNum; j++) {
+		hashes[j] = btllib::nte64(h, k, j);
+	}
+}
+
+unsigned
+countConcatenationHits(
+    const SegmentHashes& left,
+    const SegmentHashes& right,
+    size_t start,
+    size_t end,
+    const btllib::KmerBloomFilter& bloom)
+{
+	const unsigned k = bloom.get_k();
+	const unsigned hashNum = bloom.get_hash_num();
+	const size_t a = left.size();
+	assert(left.valid() && right.valid());
+	assert(end <= a + right.size());
+
+	static thread_local std::vector<uint64_t> hashes;
+	hashes.resize(hashNum);
+
+	const auto forwardPrefix = [&](size_t n) {
+		return n <= a ? left.forward[n] : srol(left.forward[a], n - a) ^ right.forward[n - a];
+	};
+	const auto reversePrefix = [&](size_t n) {
+		return n <= a ? left.reverse[n] : left.reverse[a] ^ srol(right.reverse[n - a], a);
+	};
+
+	unsigned found = 0;
+	for (size_t i = start; i + k <= end; i++) {
+		const uint64_t fh = forwardPrefix(i + k) ^ srol(forwardPrefix(i), k);
+		const uint64_t rh = sror(reversePrefix(i + k) ^ reversePrefix(i), i);
+		multiHashes(fh, rh, k, hashNum, hashes.data());
+		if (bloom.contains(hashes.data())) {
+			found++;
+		}
+	}
+	return found;
+}
+
+/** Return the hash of a base at the specified distance from the end
+ * of a k-mer, which is its contribution to the hash of the k-mer. */
+static inline uint64_t
+baseHash(unsigned char c, unsigned distance)
+{
+	return btllib::MS_TAB_31L[c][distance % 31] | btllib::MS_TAB_33R[c][distance % 33];
+}
+
+bool
+containsSubstitution(
+    const SegmentHashes& hashes,
+    const std::string& seq,
+    size_t pos,
+    std::vector<unsigned>& positions,
+    const btllib::KmerBloomFilter& bloom)
+{
+	static const unsigned char BASES[] = { 'A', 'C', 'T', 'G' };
+	const unsigned k = bloom.get_k();
+	const unsigned hashNum = bloom.get_hash_num();
+
+	uint64_t fh, rh;
+	hashes.kmerHashes(pos, k, fh, rh);
+
+	static thread_local std::vector<uint64_t> candidates;
+	candidates.resize(hashNum);
+	multiHashes(fh, rh, k, hashNum, candidates.data());
+	if (bloom.contains(candidates.data())) {
+		return true;
+	}
+
+	// A position that several seeds tolerate is tried once.
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+	// Derive the forward and reverse hashes of every substitution by
+	// replacing the contribution of the old base by that of the new.
+	static thread_local std::vector<uint64_t> forwards, reverses;
+	forwards.clear();
+	reverses.clear();
+	for (const auto p : positions) {
+		assert(p < k);
+		const auto old = (unsigned char)seq[pos + p];
+		const uint64_t oldForward = fh ^ baseHash(old, k - 1 - p);
+		const uint64_t oldReverse = rh ^ baseHash(old & btllib::CP_OFF, p);
+		for (const auto base : BASES) {
+			if (base == old) {
+				continue;
+			}
+			forwards.push_back(oldForward ^ baseHash(base, k - 1 - p));
+			reverses.push_back(oldReverse ^ baseHash(base & btllib::CP_OFF, p));
+		}
+	}
+
+	// Compute the multi-hashes of all the substitutions, one hash
+	// function at a time, so that the loops may be vectorized.
+	const size_t n = forwards.size();
+	candidates.resize(n * hashNum);
+	uint64_t* const h0 = candidates.data();
+	for (size_t i = 0; i < n; i++) {
+		h0[i] = reverses[i] < forwards[i] ? reverses[i] : forwards[i];
+	}
+	for (unsigned j = 1; j < hashNum; j++) {
+		uint64_t* const hj = candidates.data() + j * n;
+		for (size_t i = 0; i < n; i++) {
+			hj[i] = btllib::nte64(h0[i], k, j);
+		}
+	}
+
+	static thread_local std::vector<uint64_t> probe;
+	probe.resize(hashNum);
+	for (size_t i = 0; i < n; i++) {
+		for (unsigned j = 0; j < hashNum; j++) {
+			probe[j] = candidates[j * n + i];
+		}
+		if (bloom.contains(probe.data())) {
+			return true;
+		}
+	}
+	return false;
+}
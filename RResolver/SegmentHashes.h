@@ -0,0 +1,76 @@
+#ifndef RRESOLVER_SEGMENTHASHES_H
+#define RRESOLVER_SEGMENTHASHES_H 1
+
+#include "btllib/bloom_filter.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The ntHash values of every prefix of a sequence. The ntHash of a
+ * k-mer is a sum over its bases of rotated seeds, so the hash of any
+ * window of a concatenation of segments can be computed from the
+ * prefix hashes of the segments without rehashing the window. This
+ * allows each head, repeat and tail of a path to be hashed once,
+ * regardless of how many combinations of them are tested.
+ */
+class SegmentHashes
+{
+  public:
+	SegmentHashes() = default;
+	SegmentHashes(const std::string& seq);
+
+	/** Return the length of the segment. */
+	size_t size() const { return forward.size() - 1; }
+
+	/** Return whether every base of the segment is one of ACGT. The
+	 * windows of a segment that is not are hashed as a sequence. */
+	bool valid() const { return isValid; }
+
+	/** Compute the forward and reverse-complement hashes of the k-mer
+	 * that starts at pos. */
+	void kmerHashes(size_t pos, unsigned k, uint64_t& fh, uint64_t& rh) const;
+
+	/** The forward hash of every prefix. forward[n] is the hash of
+	 * the first n bases. */
+	std::vector<uint64_t> forward;
+
+	/** The reverse-complement hash of every prefix, where the last
+	 * base of the prefix is the first base of the hash. */
+	std::vector<uint64_t> reverse;
+
+  private:
+	bool isValid = false;
+};
+
+/**
+ * Count the windows of the concatenation of two segments that are in
+ * the Bloom filter. The windows tested are those that start at
+ * [start, end - k], where k is the window size of the Bloom filter.
+ * The result is identical to hashing the sequence with btllib::NtHash.
+ */
+unsigned
+countConcatenationHits(
+    const SegmentHashes& left,
+    const SegmentHashes& right,
+    size_t start,
+    size_t end,
+    const btllib::KmerBloomFilter& bloom);
+
+/**
+ * Return whether the k-mer of seq at pos, or a k-mer that differs from
+ * it by one base substitution at one of the specified positions of the
+ * k-mer, is in the Bloom filter. The hashes of all the substitutions
+ * are derived from the hashes of the k-mer in one batch, before any of
+ * them is looked up. The positions are sorted and made unique.
+ */
+bool
+containsSubstitution(
+    const SegmentHashes& hashes,
+    const std::string& seq,
+    size_t pos,
+    std::vector<unsigned>& positions,
+    const btllib::KmerBloomFilter& bloom);
+
+#endif
@@ -25,7 +25,11 @@
 #include <functional>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
 #include <utility>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace std::rel_ops;
@@ -63,6 +67,9 @@ static const char USAGE_MESSAGE[] =
     "                        that maximizes the scaffold N50.\n"
     "      --grid            optimize using a grid search [default]\n"
     "      --line            optimize using a line search\n"
+    "      --incremental     filter the graph of a larger n from that\n"
+    "                        of a smaller n [default]\n"
+    "      --no-incremental  filter the graph of each n from the input\n"
     "  -k, --kmer=N          length of a k-mer\n"
     "  -G, --genome-size=N   expected genome size. Used to calculate NG50\n"
     "                        and associated stats [disabled]\n"
@@ -74,6 +81,7 @@ static const char USAGE_MESSAGE[] =
     "      --no-SS           no assumption about contig orientation [default]\n"
     "  -o, --out=FILE        write the paths to FILE\n"
     "  -g, --graph=FILE      write the graph to FILE\n"
+    "  -j, --threads=N       use N parallel threads [1]\n"
     "  -v, --verbose         display verbose output\n"
     "      --help            display this help and exit\n"
     "      --version         output version information and exit\n"
@@ -93,6 +101,10 @@ unsigned k; // used by ContigProperties
 /** Optimization search strategy. */
 static int searchStrategy;
 
+/** Filter the graph of a larger minimum number of pairs from the
+ * graph of a smaller one. */
+static int incremental = 1;
+
 /** Minimum number of pairs. */
 static unsigned minEdgeWeight;
 static unsigned minEdgeWeightEnd;
@@ -129,9 +141,12 @@ int format = DOT; // used by DistanceEst
 
 /** Remove complex transitive edges */
 static int comp_trans;
+
+/** Number of threads. */
+static int threads = 1;
 }
 
-static const char shortopts[] = "G:g:k:n:o:s:v";
+static const char shortopts[] = "G:g:j:k:n:o:s:v";
 
 enum
 {
@@ -155,6 +170,7 @@ enum
 
 static const struct option longopts[] = {
 	{ "graph", no_argument, NULL, 'g' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "kmer", required_argument, NULL, 'k' },
 	{ "genome-size", required_argument, NULL, 'G' },
 	{ "min-gap", required_argument, NULL, OPT_MIN_GAP },
@@ -162,6 +178,8 @@ static const struct option longopts[] = {
 	{ "npairs", required_argument, NULL, 'n' },
 	{ "grid", no_argument, &opt::searchStrategy, GRID_SEARCH },
 	{ "line", no_argument, &opt::searchStrategy, LINE_SEARCH },
+	{ "incremental", no_argument, &opt::incremental, 1 },
+	{ "no-incremental", no_argument, &opt::incremental, 0 },
 	{ "out", required_argument, NULL, 'o' },
 	{ "seed-length", required_argument, NULL, 's' },
 	{ "complex", no_argument, &opt::comp_trans, 1 },
@@ -216,15 +234,44 @@ struct PoorSupport
 	unsigned m_minEdgeWeight;
 };
 
-/** Remove short vertices and unsupported edges from the graph. */
+/** The stream to which the steps of scaffolding are logged. */
+static std::ostream* g_log = &std::cerr;
+
+/** The statistics of the steps of scaffolding, or NULL to add them
+ * to the database directly. */
+static dbMap* g_stats = NULL;
+
+#if _OPENMP
+#pragma omp threadprivate(g_log, g_stats)
+#endif
+
+/** Return the log of the scaffolding run of this thread. */
+static std::ostream&
+scaffoldLog()
+{
+	return *g_log;
+}
+
+/** Add a statistic of the scaffolding run of this thread. */
 static void
-filterGraph(Graph& g, unsigned minEdgeWeight, unsigned minContigLength)
+addStat(const std::string& key, int value)
+{
+	if (g_stats != NULL)
+		g_stats->push_back(key, value);
+	else
+		addToDb(db, key, value);
+}
+
+/** Remove short contigs from the graph.
+ * @return the number of vertices removed
+ */
+static unsigned
+removeShortContigs(Graph& g, unsigned minContigLength)
 {
 	typedef graph_traits<Graph> GTraits;
 	typedef GTraits::vertex_descriptor V;
 	typedef GTraits::vertex_iterator Vit;
 
-	// Remove short contigs.
 	unsigned numRemovedV = 0;
 	std::pair<Vit, Vit> urange = vertices(g);
 	for (Vit uit = urange.first; uit != urange.second; ++uit) {
@@ -236,18 +283,83 @@ filterGraph(Graph& g, unsigned minEdgeWeight, unsigned minContigLength)
 			numRemovedV++;
 		}
 	}
+	return numRemovedV;
+}
+
+/** A graph filtered by removeShortContigs and PoorSupport, from
+ * which the graph of a larger minimum number of pairs is filtered
+ * incrementally. Removing poorly-supported edges from this graph
+ * yields the same graph as filtering the input graph.
+ */
+struct FilteredGraph
+{
+	FilteredGraph()
+	  : minEdgeWeight(0)
+	  , minContigLength(0)
+	  , numRemovedV(0)
+	  , numEdges(0)
+	{}
+
+	Graph g;
+	unsigned minEdgeWeight;
+	unsigned minContigLength;
+
+	/** The number of vertices removed from the input graph. */
+	unsigned numRemovedV;
+
+	/** The number of edges after removing short contigs. */
+	unsigned numEdges;
+};
+
+/** Filter the graph g0 into base. */
+static void
+filterGraph(
+    FilteredGraph& base,
+    const Graph& g0,
+    unsigned minEdgeWeight,
+    unsigned minContigLength)
+{
+	base.g = g0;
+	base.minEdgeWeight = minEdgeWeight;
+	base.minContigLength = minContigLength;
+	base.numRemovedV = removeShortContigs(base.g, minContigLength);
+	base.numEdges = num_edges(base.g);
+	remove_edge_if(PoorSupport(base.g, minEdgeWeight), static_cast<DG&>(base.g));
+}
+
+/** Remove short vertices and unsupported edges from the graph.
+ * @param base if not NULL, g is a copy of base, whose short contigs
+ * and poorly-supported edges of fewer pairs are already removed
+ */
+static void
+filterGraph(
+    Graph& g,
+    unsigned minEdgeWeight,
+    unsigned minContigLength,
+    const FilteredGraph* base)
+{
+	// Remove short contigs.
+	unsigned numRemovedV, numBefore;
+	if (base == NULL) {
+		numRemovedV = removeShortContigs(g, minContigLength);
+		numBefore = num_edges(g);
+	} else {
+		assert(base->minContigLength == minContigLength);
+		assert(base->minEdgeWeight <= minEdgeWeight);
+		numRemovedV = base->numRemovedV;
+		numBefore = base->numEdges;
+	}
 	if (opt::verbose > 0)
-		cerr << "Removed " << numRemovedV << " vertices.\n";
+		scaffoldLog() << "Removed " << numRemovedV << " vertices.\n";
 
 	// Remove poorly-supported edges.
-	unsigned numBefore = num_edges(g);
 	remove_edge_if(PoorSupport(g, minEdgeWeight), static_cast<DG&>(g));
 	unsigned numRemovedE = numBefore - num_edges(g);
 	if (opt::verbose > 0)
-		cerr << "Removed " << numRemovedE << " edges.\n";
+		scaffoldLog() << "Removed " << numRemovedE << " edges.\n";
 	if (!opt::db.empty()) {
-		addToDb(db, "V_removed", numRemovedV);
-		addToDb(db, "E_removed", numRemovedE);
+		addStat("V_removed", numRemovedV);
+		addStat("E_removed", numRemovedE);
 	}
 }
 
@@ -277,12 +389,12 @@ removeCycles(Graph& g)
 	/** Remove the cycles. */
 	remove_edges(g, cycles.begin(), cycles.end());
 	if (opt::verbose > 0) {
-		cerr << "Removed " << cycles.size() << " cyclic edges.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Removed " << cycles.size() << " cyclic edges.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 
 	if (!opt::db.empty())
-		addToDb(db, "E_removed_cyclic", cycles.size());
+		addStat("E_removed_cyclic", cycles.size());
 }
 
 /** Find edges in g0 that resolve forks in g.
@@ -318,7 +430,7 @@ resolveForks(Graph& g, const Graph& g0)
 				pair<E, bool> e21 = edge(v2, v1, g0);
 				if (e12.second && e21.second) {
 					if (opt::verbose > 1)
-						cerr << "cycle: " << get(vertex_name, g, v1) << ' '
+						scaffoldLog() << "cycle: " << get(vertex_name, g, v1) << ' '
 						     << get(vertex_name, g, v2) << '\n';
 				} else if (e12.second || e21.second) {
 					E e = e12.second ? e12.first : e21.first;
@@ -326,16 +438,16 @@ resolveForks(Graph& g, const Graph& g0)
 					add_edge(v, w, g0[e], g);
 					numEdges++;
 					if (opt::verbose > 1)
-						cerr << get(vertex_name, g, u) << " -> " << get(vertex_name, g, v) << " -> "
+						scaffoldLog() << get(vertex_name, g, u) << " -> " << get(vertex_name, g, v) << " -> "
 						     << get(vertex_name, g, w) << " [" << g0[e] << "]\n";
 				}
 			}
 		}
 	}
 	if (opt::verbose > 0)
-		cerr << "Added " << numEdges << " edges to ambiguous vertices.\n";
+		scaffoldLog() << "Added " << numEdges << " edges to ambiguous vertices.\n";
 	if (!opt::db.empty())
-		addToDb(db, "E_added_ambig", numEdges);
+		addStat("E_added_ambig", numEdges);
 }
 
 /** Remove tips.
@@ -350,12 +462,12 @@ pruneTips(Graph& g)
 	pruneTips(g, CountingOutputIterator(n));
 
 	if (opt::verbose > 0) {
-		cerr << "Removed " << n << " tips.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Removed " << n << " tips.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 
 	if (!opt::db.empty())
-		addToDb(db, "Tips_removed", n);
+		addStat("Tips_removed", n);
 }
 
 /** Remove repetitive vertices from this graph.
@@ -400,10 +512,10 @@ removeRepeats(Graph& g)
 	sort(repeats.begin(), repeats.end());
 	repeats.erase(unique(repeats.begin(), repeats.end()), repeats.end());
 	if (opt::verbose > 1) {
-		cerr << "Ambiguous:";
+		scaffoldLog() << "Ambiguous:";
 		for (vector<V>::const_iterator it = repeats.begin(); it != repeats.end(); ++it)
-			cerr << ' ' << get(vertex_name, g, *it);
-		cerr << '\n';
+			scaffoldLog() << ' ' << get(vertex_name, g, *it);
+		scaffoldLog() << '\n';
 	}
 
 	// Remove the repetitive vertices.
@@ -419,13 +531,13 @@ removeRepeats(Graph& g)
 	}
 
 	if (opt::verbose > 0) {
-		cerr << "Cleared " << repeats.size() << " ambiguous vertices.\n"
+		scaffoldLog() << "Cleared " << repeats.size() << " ambiguous vertices.\n"
 		     << "Removed " << numRemoved << " ambiguous vertices.\n";
-		printGraphStats(cerr, g);
+		printGraphStats(scaffoldLog(), g);
 	}
 	if (!opt::db.empty()) {
-		addToDb(db, "V_cleared_ambg", repeats.size());
-		addToDb(db, "V_removed_ambg", numRemoved);
+		addStat("V_cleared_ambg", repeats.size());
+		addStat("V_removed_ambg", numRemoved);
 	}
 }
 
@@ -492,21 +604,21 @@ removeWeakEdges(Graph& g)
 	}
 
 	if (opt::verbose > 1) {
-		cerr << "Weak edges:\n";
+		scaffoldLog() << "Weak edges:\n";
 		for (vector<E>::const_iterator it = weak.begin(); it != weak.end(); ++it) {
 			E e = *it;
-			cerr << '\t' << get(edge_name, g, e) << " [" << g[e] << "]\n";
+			scaffoldLog() << '\t' << get(edge_name, g, e) << " [" << g[e] << "]\n";
 		}
 	}
 
 	/** Remove the weak edges. */
 	remove_edges(g, weak.begin(), weak.end());
 	if (opt::verbose > 0) {
-		cerr << "Removed " << weak.size() << " weak edges.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Removed " << weak.size() << " weak edges.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 	if (!opt::db.empty())
-		addToDb(db, "E_removed_weak", weak.size());
+		addStat("E_removed_weak", weak.size());
 }
 
 static void
@@ -581,11 +693,7 @@ readGraph(const string& path, Graph& g)
 {
 	if (opt::verbose > 0)
 		cerr << "Reading `" << path << "'...\n";
-	ifstream fin(path.c_str());
-	istream& in = path == "-" ? cin : fin;
-	assert_good(in, path);
-	read_graph(in, g, BetterDistanceEst());
-	assert(in.eof());
+	read_graph_file(path, g, BetterDistanceEst());
 	if (opt::verbose > 0)
 		printGraphStats(cerr, g);
 
@@ -678,7 +786,7 @@ addCntgStatsToDb(const Histogram h, const unsigned min)
 	                                            << "NG50";
 	if (!opt::db.empty()) {
 		for (unsigned i = 0; i < vals.size(); i++)
-			addToDb(db, keys[i], vals[i]);
+			addStat(keys[i], vals[i]);
 	}
 }
 
@@ -721,19 +829,103 @@ struct ScaffoldResult : ScaffoldParam
 	std::string metrics;
 };
 
+/** The filtered graphs from which the graphs of larger n are
+ * filtered. Each is filtered when its first run starts and freed when
+ * its last run ends, so that only the graphs of the runs in progress
+ * are kept. The graphs may be used by concurrent threads.
+ */
+class FilteredGraphs
+{
+  public:
+	/** @param uses the number of runs that use each graph */
+	FilteredGraphs(
+	    const Graph& g0,
+	    const vector<ScaffoldParam>& params,
+	    const vector<unsigned>& uses)
+	  : m_g0(g0)
+	  , m_params(params)
+	  , m_graphs(params.size())
+	  , m_uses(uses)
+	  , m_locks(params.size())
+	{
+		assert(uses.size() == params.size());
+#if _OPENMP
+		for (unsigned i = 0; i < m_locks.size(); ++i)
+			omp_init_lock(&m_locks[i]);
+#endif
+	}
+
+	~FilteredGraphs()
+	{
+#if _OPENMP
+		for (unsigned i = 0; i < m_locks.size(); ++i)
+			omp_destroy_lock(&m_locks[i]);
+#endif
+	}
+
+	/** Return graph i, filtering it if it is not yet filtered. */
+	const FilteredGraph& acquire(unsigned i)
+	{
+		lock(i);
+		if (!m_graphs[i]) {
+			m_graphs[i].reset(new FilteredGraph);
+			filterGraph(*m_graphs[i], m_g0, m_params[i].n, m_params[i].s);
+		}
+		const FilteredGraph& g = *m_graphs[i];
+		unlock(i);
+		return g;
+	}
+
+	/** Release graph i, and free it if this run is its last. */
+	void release(unsigned i)
+	{
+		lock(i);
+		assert(m_uses[i] > 0);
+		if (--m_uses[i] == 0)
+			m_graphs[i].reset();
+		unlock(i);
+	}
+
+  private:
+	FilteredGraphs(const FilteredGraphs&);
+	FilteredGraphs& operator=(const FilteredGraphs&);
+
+#if _OPENMP
+	void lock(unsigned i) { omp_set_lock(&m_locks[i]); }
+	void unlock(unsigned i) { omp_unset_lock(&m_locks[i]); }
+	typedef omp_lock_t Lock;
+#else
+	void lock(unsigned) {}
+	void unlock(unsigned) {}
+	typedef int Lock;
+#endif
+
+	const Graph& m_g0;
+	const vector<ScaffoldParam>& m_params;
+	vector<std::unique_ptr<FilteredGraph> > m_graphs;
+	vector<unsigned> m_uses;
+	vector<Lock> m_locks;
+};
+
 /** Build scaffold paths.
  * @param output write the results
+ * @param base if not NULL, filter the graph from base rather than g0
  * @return the scaffold N50
  */
 ScaffoldResult
-scaffold(const Graph& g0, unsigned minEdgeWeight, unsigned minContigLength, bool output)
+scaffold(
+    const Graph& g0,
+    unsigned minEdgeWeight,
+    unsigned minContigLength,
+    bool output,
+    const FilteredGraph* base = NULL)
 {
-	Graph g(g0);
+	Graph g(base != NULL ? base->g : g0);
 
 	// Filter the graph.
-	filterGraph(g, minEdgeWeight, minContigLength);
+	filterGraph(g, minEdgeWeight, minContigLength, base);
 	if (opt::verbose > 0)
-		printGraphStats(cerr, g);
+		printGraphStats(scaffoldLog(), g);
 
 	// Remove cycles.
 	removeCycles(g);
@@ -755,12 +947,12 @@ scaffold(const Graph& g0, unsigned minEdgeWeight, unsigned minContigLength, bool
 		numTransitive = remove_transitive_edges(g);
 
 	if (opt::verbose > 0) {
-		cerr << "Removed " << numTransitive << " transitive edges.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Removed " << numTransitive << " transitive edges.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 
 	if (!opt::db.empty())
-		addToDb(db, "Edges_transitive", numTransitive);
+		addStat("Edges_transitive", numTransitive);
 
 	// Prune tips.
 	pruneTips(g);
@@ -769,18 +961,18 @@ scaffold(const Graph& g0, unsigned minEdgeWeight, unsigned minContigLength, bool
 	typedef graph_traits<Graph>::vertex_descriptor V;
 	vector<V> popped = popBubbles(g);
 	if (opt::verbose > 0) {
-		cerr << "Removed " << popped.size() << " vertices in bubbles.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Removed " << popped.size() << " vertices in bubbles.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 
 	if (!opt::db.empty())
-		addToDb(db, "Vertices_bubblePopped", popped.size());
+		addStat("Vertices_bubblePopped", popped.size());
 
 	if (opt::verbose > 1) {
-		cerr << "Popped:";
+		scaffoldLog() << "Popped:";
 		for (vector<V>::const_iterator it = popped.begin(); it != popped.end(); ++it)
-			cerr << ' ' << get(vertex_name, g, *it);
-		cerr << '\n';
+			scaffoldLog() << ' ' << get(vertex_name, g, *it);
+		scaffoldLog() << '\n';
 	}
 
 	// Remove weak edges.
@@ -798,13 +990,13 @@ scaffold(const Graph& g0, unsigned minEdgeWeight, unsigned minContigLength, bool
 	if (opt::verbose > 0) {
 		for (ContigPaths::const_iterator it = paths.begin(); it != paths.end(); ++it)
 			n += it->size();
-		cerr << "Assembled " << n << " contigs in " << paths.size() << " scaffolds.\n";
-		printGraphStats(cerr, g);
+		scaffoldLog() << "Assembled " << n << " contigs in " << paths.size() << " scaffolds.\n";
+		printGraphStats(scaffoldLog(), g);
 	}
 
 	if (!opt::db.empty()) {
-		addToDb(db, "contigs_assembled", n);
-		addToDb(db, "scaffolds_assembled", paths.size());
+		addStat("contigs_assembled", n);
+		addStat("scaffolds_assembled", paths.size());
 	}
 
 	if (output) {
@@ -842,72 +1034,236 @@ scaffold(const Graph& g0, unsigned minEdgeWeight, unsigned minContigLength, bool
 	    metrics);
 }
 
-/** Memoize the optimization results so far. */
-typedef unordered_map<ScaffoldParam, ScaffoldResult> ScaffoldMemo;
+/** Memoize the optimization results so far.
+ * The memo may be used by concurrent threads.
+ */
+class ScaffoldMemo
+{
+  public:
+	/** Find the result of the specified parameters.
+	 * @return whether the result was found
+	 */
+	bool find(const ScaffoldParam& param, ScaffoldResult& result) const
+	{
+		bool found;
+#pragma omp critical(ScaffoldMemo)
+		{
+			Map::const_iterator it = m_map.find(param);
+			found = it != m_map.end();
+			if (found)
+				result = it->second;
+		}
+		return found;
+	}
 
-/** Build scaffold paths, memoized. */
-ScaffoldResult
-scaffold_memoized(const Graph& g, unsigned n, unsigned s, ScaffoldMemo& memo)
+	/** Add the result of scaffolding. */
+	void insert(const ScaffoldResult& result)
+	{
+#pragma omp critical(ScaffoldMemo)
+		m_map[result] = result;
+	}
+
+	/** Return the number of results. */
+	size_t size() const
+	{
+		size_t n;
+#pragma omp critical(ScaffoldMemo)
+		n = m_map.size();
+		return n;
+	}
+
+  private:
+	typedef unordered_map<ScaffoldParam, ScaffoldResult> Map;
+	Map m_map;
+};
+
+/** Build scaffold paths for each of the specified parameters,
+ * memoized. The parameters are evaluated concurrently, each on its
+ * own copy of the graph. The log of each run is printed and its
+ * statistics are added to the database in the order of the
+ * parameters.
+ */
+static vector<ScaffoldResult>
+scaffold_memoized(const Graph& g, const vector<ScaffoldParam>& params, ScaffoldMemo& memo)
 {
-	ScaffoldParam param(n, s);
-	ScaffoldMemo::const_iterator it = memo.find(param);
-	if (it != memo.end()) {
-		// Clear the metrics string, so that this result is not listed
-		// multiple times in the final table of metrics.
-		ScaffoldResult result(it->second);
-		result.metrics.clear();
-		return result;
+	// Find the parameters that have not been evaluated.
+	vector<ScaffoldParam> todo;
+	for (vector<ScaffoldParam>::const_iterator it = params.begin(); it != params.end(); ++it) {
+		ScaffoldResult result;
+		if (!memo.find(*it, result) && find(todo.begin(), todo.end(), *it) == todo.end())
+			todo.push_back(*it);
 	}
 
-	if (opt::verbose > 0)
-		std::cerr << "\nScaffolding with n=" << n << " s=" << s << "\n\n";
-	ScaffoldResult result = scaffold(g, n, s, false);
-	memo[param] = result;
+	// The verbose log of popBubbles is not redirected, so at that
+	// verbosity evaluate serially in the order of the parameters,
+	// logging directly. Otherwise, buffer the log and the statistics
+	// of each run, and print them in the order of the parameters.
+	const bool direct = opt::verbose > 3;
+
+	// Filter the graph of the smallest n of each s once, and the
+	// graphs of larger n from it.
+	vector<unsigned> baseIndex(todo.size(), UINT_MAX);
+	vector<ScaffoldParam> baseParams;
+	vector<unsigned> baseUses;
+	if (opt::incremental && !direct) {
+		typedef unordered_map<unsigned, unsigned> Map;
+		Map minN, numN, index;
+		for (vector<ScaffoldParam>::const_iterator it = todo.begin(); it != todo.end(); ++it) {
+			Map::iterator m = minN.find(it->s);
+			if (m == minN.end())
+				minN[it->s] = it->n;
+			else
+				m->second = min(m->second, it->n);
+			numN[it->s]++;
+		}
+		for (unsigned i = 0; i < todo.size(); ++i) {
+			unsigned s = todo[i].s;
+			if (numN[s] < 2)
+				continue;
+			Map::iterator m = index.find(s);
+			if (m == index.end()) {
+				m = index.insert(make_pair(s, (unsigned)baseParams.size())).first;
+				baseParams.push_back(ScaffoldParam(minN[s], s));
+				baseUses.push_back(numN[s]);
+			}
+			baseIndex[i] = m->second;
+		}
+	}
+	FilteredGraphs bases(g, baseParams, baseUses);
+
+	// Evaluate the runs of each filtered graph consecutively, so that
+	// few filtered graphs are kept at once.
+	vector<unsigned> order;
+	order.reserve(todo.size());
+	vector<bool> ordered(baseParams.size());
+	for (unsigned i = 0; i < todo.size(); ++i) {
+		unsigned b = baseIndex[i];
+		if (b == UINT_MAX) {
+			order.push_back(i);
+		} else if (!ordered[b]) {
+			ordered[b] = true;
+			for (unsigned j = i; j < todo.size(); ++j)
+				if (baseIndex[j] == b)
+					order.push_back(j);
+		}
+	}
+	assert(order.size() == todo.size());
+
+	// Estimate's operator<< sets the format of its stream, so start
+	// the log of each run with the format of std::cerr.
+	const std::ios_base::fmtflags flags = std::cerr.flags();
+	const std::streamsize precision = std::cerr.precision();
+
+	vector<std::string> logs(todo.size());
+	vector<dbMap> stats(todo.size());
+	vector<bool> finished(todo.size());
+	unsigned nextLog = 0;
+#pragma omp parallel for schedule(dynamic) if (!direct)
+	for (int k = 0; k < (int)order.size(); ++k) {
+		unsigned i = order[k];
+		unsigned n = todo[i].n, s = todo[i].s;
+		std::ostringstream buf;
+		if (!direct) {
+			g_log = &buf;
+			g_stats = &stats[i];
+		}
+		std::ostream& out = scaffoldLog();
+		out.flags(flags);
+		out.precision(precision);
+		if (opt::verbose > 0)
+			out << "\nScaffolding with n=" << n << " s=" << s << "\n\n";
+		unsigned b = baseIndex[i];
+		ScaffoldResult result = scaffold(
+		    g, n, s, false, b == UINT_MAX ? NULL : &bases.acquire(b));
+		if (b != UINT_MAX)
+			bases.release(b);
+		memo.insert(result);
+
+		// Print assembly metrics.
+		if (opt::verbose > 0) {
+			out << '\n';
+			const unsigned STATS_MIN_LENGTH = opt::minContigLength;
+			printContiguityStatsHeader(out, STATS_MIN_LENGTH, "\t", opt::genomeSize);
+		}
+		out << result.metrics;
+		if (opt::verbose > 0)
+			out << '\n';
+		out.flags(flags);
+		out.precision(precision);
+		g_log = &std::cerr;
+		g_stats = NULL;
+		if (direct)
+			continue;
 
-	// Print assembly metrics.
-	if (opt::verbose > 0) {
-		std::cerr << '\n';
-		const unsigned STATS_MIN_LENGTH = opt::minContigLength;
-		printContiguityStatsHeader(std::cerr, STATS_MIN_LENGTH, "\t", opt::genomeSize);
+		// Print the logs of the runs that are finished in order.
+#pragma omp critical(scaffoldLog)
+		{
+			logs[i] = buf.str();
+			finished[i] = true;
+			for (; nextLog < todo.size() && finished[nextLog]; ++nextLog) {
+				std::cerr << logs[nextLog];
+				std::string().swap(logs[nextLog]);
+				if (!opt::db.empty())
+					addToDb(db, stats[nextLog]);
+			}
+		}
 	}
-	std::cerr << result.metrics;
-	if (opt::verbose > 0)
-		cerr << '\n';
-	return result;
+
+	vector<ScaffoldResult> results;
+	results.reserve(params.size());
+	for (vector<ScaffoldParam>::const_iterator it = params.begin(); it != params.end(); ++it) {
+		ScaffoldResult result;
+		bool found = memo.find(*it, result);
+		assert(found);
+		(void)found;
+		// Clear the metrics string of a result that was evaluated
+		// previously, so that this result is not listed multiple
+		// times in the final table of metrics.
+		vector<ScaffoldParam>::iterator todoIt = find(todo.begin(), todo.end(), *it);
+		if (todoIt == todo.end())
+			result.metrics.clear();
+		else
+			todo.erase(todoIt);
+		results.push_back(result);
+	}
+	return results;
 }
 
-/** Find the value of n that maximizes the scaffold N50. */
+/** Return the result that maximizes the scaffold N50, and the table
+ * of metrics of all the results.
+ * @param best the initial result, which is returned if no result has
+ * a larger scaffold N50
+ */
 static ScaffoldResult
-optimize_n(
-    const Graph& g,
-    std::pair<unsigned, unsigned> minEdgeWeight,
-    unsigned minContigLength,
-    ScaffoldMemo& memo)
+best_result(const vector<ScaffoldResult>& results, ScaffoldResult best)
 {
 	std::string metrics_table;
-	unsigned bestn = 0, bestN50 = 0;
-	for (unsigned n = minEdgeWeight.first; n <= minEdgeWeight.second; n += opt::minEdgeWeightStep) {
-		ScaffoldResult result = scaffold_memoized(g, n, minContigLength, memo);
-		metrics_table += result.metrics;
-		if (result.n50 > bestN50) {
-			bestN50 = result.n50;
-			bestn = n;
-		}
+	for (vector<ScaffoldResult>::const_iterator it = results.begin(); it != results.end(); ++it) {
+		metrics_table += it->metrics;
+		if (it->n50 > best.n50)
+			best = *it;
 	}
+	best.metrics = metrics_table;
+	return best;
+}
 
-	return ScaffoldResult(bestn, minContigLength, bestN50, metrics_table);
+/** Return the values of n in the specified range. */
+static vector<unsigned>
+edge_weights(std::pair<unsigned, unsigned> minEdgeWeight)
+{
+	vector<unsigned> ns;
+	for (unsigned n = minEdgeWeight.first; n <= minEdgeWeight.second; n += opt::minEdgeWeightStep)
+		ns.push_back(n);
+	return ns;
 }
 
-/** Find the value of s that maximizes the scaffold N50. */
-static ScaffoldResult
-optimize_s(
-    const Graph& g,
-    unsigned minEdgeWeight,
-    std::pair<unsigned, unsigned> minContigLength,
-    ScaffoldMemo& memo)
+/** Return the values of s in the specified range,
+ * three steps per decade.
+ */
+static vector<unsigned>
+contig_lengths(std::pair<unsigned, unsigned> minContigLength)
 {
-	std::string metrics_table;
-	unsigned bests = 0, bestN50 = 0;
+	vector<unsigned> ss;
 	const double STEP = cbrt(10); // Three steps per decade.
 	unsigned ilast = (unsigned)round(log(minContigLength.second) / log(STEP));
 	for (unsigned i = (unsigned)round(log(minContigLength.first) / log(STEP)); i <= ilast; ++i) {
@@ -916,16 +1272,41 @@ optimize_s(
 		// Round to 1 figure.
 		double nearestDecade = pow(10, floor(log10(s)));
 		s = unsigned(round(s / nearestDecade) * nearestDecade);
-
-		ScaffoldResult result = scaffold_memoized(g, minEdgeWeight, s, memo);
-		metrics_table += result.metrics;
-		if (result.n50 > bestN50) {
-			bestN50 = result.n50;
-			bests = s;
-		}
+		ss.push_back(s);
 	}
+	return ss;
+}
+
+/** Find the value of n that maximizes the scaffold N50. */
+static ScaffoldResult
+optimize_n(
+    const Graph& g,
+    std::pair<unsigned, unsigned> minEdgeWeight,
+    unsigned minContigLength,
+    ScaffoldMemo& memo)
+{
+	vector<unsigned> ns = edge_weights(minEdgeWeight);
+	vector<ScaffoldParam> params;
+	for (vector<unsigned>::const_iterator it = ns.begin(); it != ns.end(); ++it)
+		params.push_back(ScaffoldParam(*it, minContigLength));
+	return best_result(
+	    scaffold_memoized(g, params, memo), ScaffoldResult(0, minContigLength, 0, ""));
+}
 
-	return ScaffoldResult(minEdgeWeight, bests, bestN50, metrics_table);
+/** Find the value of s that maximizes the scaffold N50. */
+static ScaffoldResult
+optimize_s(
+    const Graph& g,
+    unsigned minEdgeWeight,
+    std::pair<unsigned, unsigned> minContigLength,
+    ScaffoldMemo& memo)
+{
+	vector<unsigned> ss = contig_lengths(minContigLength);
+	vector<ScaffoldParam> params;
+	for (vector<unsigned>::const_iterator it = ss.begin(); it != ss.end(); ++it)
+		params.push_back(ScaffoldParam(minEdgeWeight, *it));
+	return best_result(
+	    scaffold_memoized(g, params, memo), ScaffoldResult(minEdgeWeight, 0, 0, ""));
 }
 
 /** Find the values of n and s that maximizes the scaffold N50. */
@@ -939,11 +1320,22 @@ optimize_grid_search(
 	if (opt::verbose == 0)
 		printContiguityStatsHeader(std::cerr, STATS_MIN_LENGTH, "\t", opt::genomeSize);
 
+	// Evaluate every point of the grid concurrently.
+	vector<unsigned> ns = edge_weights(minEdgeWeight);
+	vector<unsigned> ss = contig_lengths(minContigLength);
+	vector<ScaffoldParam> params;
+	for (vector<unsigned>::const_iterator n = ns.begin(); n != ns.end(); ++n)
+		for (vector<unsigned>::const_iterator s = ss.begin(); s != ss.end(); ++s)
+			params.push_back(ScaffoldParam(*n, *s));
 	ScaffoldMemo memo;
+	vector<ScaffoldResult> results = scaffold_memoized(g, params, memo);
+
 	std::string metrics_table;
 	ScaffoldResult best(0, 0, 0, "");
-	for (unsigned n = minEdgeWeight.first; n <= minEdgeWeight.second; n += opt::minEdgeWeightStep) {
-		ScaffoldResult result = optimize_s(g, n, minContigLength, memo);
+	for (unsigned i = 0; i < ns.size(); ++i) {
+		vector<ScaffoldResult>::const_iterator first = results.begin() + i * ss.size();
+		ScaffoldResult result = best_result(
+		    vector<ScaffoldResult>(first, first + ss.size()), ScaffoldResult(ns[i], 0, 0, ""));
 		metrics_table += result.metrics;
 		if (result.n50 > best.n50)
 			best = result;
@@ -1027,6 +1419,9 @@ main(int argc, char** argv)
 		case 'g':
 			arg >> opt::graphPath;
 			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'n':
 			arg >> opt::minEdgeWeight;
 			if (arg.peek() == '-') {
@@ -1100,6 +1495,12 @@ main(int argc, char** argv)
 		cerr << "Try `" << PROGRAM << " --help' for more information.\n";
 		exit(EXIT_FAILURE);
 	}
+
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (!opt::db.empty()) {
 		init(db, opt::db, opt::verbose, PROGRAM, opt::getCommand(argc, argv), opt::metaVars);
 		addToDb(db, "K", opt::k);
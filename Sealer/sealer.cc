@@ -8,6 +8,7 @@
 #include "Konnector/konnector.h"
 #include "Konnector/DBGBloom.h"
 #include "Konnector/DBGBloomAlgorithms.h"
+#include "Konnector/RollingDBGBloom.h"
 #include "Bloom/CascadingBloomFilter.h"
 
 #include "Align/alignGlobal.h"
@@ -47,6 +48,7 @@
 
 using namespace std;
 using Konnector::BloomFilter;
+using Konnector::RollingBloomFilter;
 #if USESEQAN
 using namespace seqan;
 #endif
@@ -106,6 +108,13 @@ static const char USAGE_MESSAGE[] =
 "      --illumina-quality       zero quality is `@' (64)\n"
 "                               default for qseq and export files\n"
 "  -r, --read-name=STR          only process reads with names that contain STR\n"
+"      --rolling-hash           hash k-mers with ntHash when building Bloom\n"
+"                               filters, so that the neighbours of a k-mer are\n"
+"                               looked up without rehashing them. The hash\n"
+"                               function of a Bloom filter loaded with -i is\n"
+"                               detected from its file, which must have been\n"
+"                               built with ntHash if this option is given\n"
+"                               [disabled]\n"
 "  -s, --search-mem=N           mem limit for graph searches; multiply by the\n"
 "                               number of threads (-j) to get the total mem used\n"
 "                               for graph traversal [500M]\n"
@@ -226,6 +235,9 @@ namespace opt {
 
 	/** Output detailed stats */
 	static int detailedStats = 0;
+
+	/** Hash k-mers with ntHash when building Bloom filters */
+	static int rollingHash = 0;
 }
 
 /** Counters */
@@ -284,6 +296,7 @@ static const struct option longopts[] = {
 	{ "standard-quality", no_argument, &opt::qualityOffset, 33 },
 	{ "illumina-quality", no_argument, &opt::qualityOffset, 64 },
 	{ "read-name",        required_argument, NULL, 'r' },
+	{ "rolling-hash",     no_argument, &opt::rollingHash, 1 },
 	{ "search-mem",       required_argument, NULL, 's' },
 	{ "trace-file",       required_argument, NULL, 't' },
 	{ "gap-file",         required_argument, NULL, 'g' },
@@ -741,6 +754,80 @@ void findFlanks(FastaRecord &record,
 	}
 }
 
+/**
+ * Load or build the Bloom filter of type BloomT for the i-th k-mer
+ * size, and close gaps using the de Bruijn graph Graph of that Bloom
+ * filter.
+ */
+template <typename BloomT, typename Graph>
+static void bloomRun(unsigned i, int argc, char** argv,
+	const ConnectPairsParams& params,
+	map<string, map<int, ClosedGap> > &allmerged,
+	map<FastaRecord, map<FastaRecord, Gap> > &flanks,
+	unsigned &gapsclosed,
+	ofstream &logStream,
+	ofstream &traceStream,
+	ofstream &gapStream)
+{
+	string temp;
+
+	typedef BasicCascadingBloomFilter<BloomT> CascadingBloomT;
+
+	BloomT* bloom;
+	CascadingBloomT* cascadingBloom = NULL;
+
+	if (!opt::bloomFilterPaths.empty() && i < opt::bloomFilterPaths.size()) {
+
+		temp = "Loading bloom filter from `" + opt::bloomFilterPaths.at(i) + "'...\n";
+		printLog(logStream, temp);
+
+		bloom = new BloomT();
+
+		const char* inputPath = opt::bloomFilterPaths.at(i).c_str();
+		ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
+		assert_good(inputBloom, inputPath);
+		inputBloom >> *bloom;
+		assert_good(inputBloom, inputPath);
+		inputBloom.close();
+	} else {
+		printLog(logStream, "Building bloom filter\n");
+
+		size_t bits = opt::bloomSize * 8 / 2;
+		cascadingBloom = new CascadingBloomT(bits, opt::max_count);
+#ifdef _OPENMP
+		ConcurrentBloomFilter<CascadingBloomT> cbf(*cascadingBloom, 1000);
+		for (int j = optind; j < argc; j++)
+			Bloom::loadFile(cbf, opt::k, argv[j], opt::verbose >= 2);
+#else
+		for (int j = optind; j < argc; j++)
+			Bloom::loadFile(*cascadingBloom, opt::k, argv[j], opt::verbose >= 2);
+#endif
+		bloom = &cascadingBloom->getBloomFilter(opt::max_count - 1);
+	}
+
+	assert(bloom != NULL);
+
+	if (opt::verbose)
+		cerr << "Bloom filter FPR: " << setprecision(3)
+			<< 100 * bloom->FPR() << "%\n";
+
+	Graph g(*bloom);
+
+	temp = "Starting K run with k = " + IntToString(opt::k) + "\n";
+	printLog(logStream, temp);
+
+	kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream, gapStream);
+
+	temp = "k" + IntToString(opt::k) + " run complete\n"
+			+ "Total gaps closed so far = " + IntToString(gapsclosed) + "\n\n";
+	printLog(logStream, temp);
+
+	if (cascadingBloom == NULL)
+		delete bloom;
+	else
+		delete cascadingBloom;
+}
+
 /**
  * Connect pairs using a Bloom filter de Bruijn graph
  */
@@ -888,6 +975,18 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (opt::rollingHash) {
+		for (unsigned i = 0; i < opt::bloomFilterPaths.size(); i++) {
+			if (Bloom::readVersion(opt::bloomFilterPaths[i])
+					!= Bloom::ROLLING_BLOOM_VERSION) {
+				cerr << PROGRAM ": --rolling-hash was specified, but the "
+					"Bloom filter `" << opt::bloomFilterPaths[i]
+					<< "' was not built with ntHash\n";
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
 #if _OPENMP
 	if (opt::threads > 0)
 		omp_set_num_threads(opt::threads);
@@ -1030,59 +1129,18 @@ int main(int argc, char** argv)
 		opt::k = opt::kvector.at(i);
 		Kmer::setLength(opt::k);
 
-		BloomFilter* bloom;
-		CascadingBloomFilter* cascadingBloom = NULL;
-
-		if (!opt::bloomFilterPaths.empty() && i < opt::bloomFilterPaths.size()) {
-
-			temp = "Loading bloom filter from `" + opt::bloomFilterPaths.at(i) + "'...\n";
-			printLog(logStream, temp);
-
-			bloom = new BloomFilter();
-
-			const char* inputPath = opt::bloomFilterPaths.at(i).c_str();
-			ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
-			assert_good(inputBloom, inputPath);
-			inputBloom >> *bloom;
-			assert_good(inputBloom, inputPath);
-			inputBloom.close();
-		} else {
-			printLog(logStream, "Building bloom filter\n");
-
-			size_t bits = opt::bloomSize * 8 / 2;
-			cascadingBloom = new CascadingBloomFilter(bits, opt::max_count);
-#ifdef _OPENMP
-			ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom, 1000);
-			for (int i = optind; i < argc; i++)
-				Bloom::loadFile(cbf, opt::k, argv[i], opt::verbose >= 2);
-#else
-			for (int i = optind; i < argc; i++)
-				Bloom::loadFile(*cascadingBloom, opt::k, argv[i], opt::verbose >= 2);
-#endif
-			bloom = &cascadingBloom->getBloomFilter(opt::max_count - 1);
-		}
-
-		assert(bloom != NULL);
-
-		if (opt::verbose)
-			cerr << "Bloom filter FPR: " << setprecision(3)
-				<< 100 * bloom->FPR() << "%\n";
-
-		DBGBloom<BloomFilter> g(*bloom);
-
-		temp = "Starting K run with k = " + IntToString(opt::k) + "\n";
-		printLog(logStream, temp);
-
-		kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream, gapStream);
-
-		temp = "k" + IntToString(opt::k) + " run complete\n"
-				+ "Total gaps closed so far = " + IntToString(gapsclosed) + "\n\n";
-		printLog(logStream, temp);
-
-		if (!opt::inputBloomPath.empty())
-			delete bloom;
+		bool rollingHash = opt::rollingHash;
+		if (i < opt::bloomFilterPaths.size())
+			rollingHash = Bloom::readVersion(opt::bloomFilterPaths[i])
+				== Bloom::ROLLING_BLOOM_VERSION;
+		if (rollingHash)
+			bloomRun<RollingBloomFilter, RollingDBGBloom<RollingBloomFilter> >(
+				i, argc, argv, params, allmerged, flanks, gapsclosed,
+				logStream, traceStream, gapStream);
 		else
-			delete cascadingBloom;
+			bloomRun<BloomFilter, DBGBloom<BloomFilter> >(
+				i, argc, argv, params, allmerged, flanks, gapsclosed,
+				logStream, traceStream, gapStream);
 	}
 
 	printLog(logStream, "K sweep complete\nCreating new scaffold with gaps closed...\n");
@@ -3,6 +3,8 @@
 #include "Estimate.h"
 #include "IOUtil.h"
 #include "Uncompress.h"
+#include "WorkStealingScheduler.h"
+#include "Graph/CompactContigGraph.h"
 #include "Graph/ConstrainedSearch.h"
 #include "Graph/ContigGraph.h"
 #include "Graph/ContigGraphAlgorithms.h"
@@ -116,7 +118,12 @@ static const struct option longopts[] = {
 	{ NULL, 0, NULL, 0 }
 };
 
-typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
+typedef ContigGraph<DirectedGraph<ContigProperties, Distance> >
+	InputGraph;
+
+/** A read-only snapshot of the graph shared by the worker threads. */
+typedef CompactContigGraph<ContigProperties, Distance> Graph;
+
 static void generatePathsThroughEstimates(const Graph& g,
 		const string& estPath);
 
@@ -205,15 +212,22 @@ int main(int argc, char** argv)
 	ifstream fin(adjFile.c_str());
 	assert_good(fin, adjFile);
 	Graph g;
-	fin >> g;
-	assert(fin.eof());
+	{
+		InputGraph ig;
+		fin >> ig;
+		assert(fin.eof());
+
+		if (opt::verbose > 0)
+			printGraphStats(cout, ig);
+		if (!opt::db.empty()) {
+			addToDb(db, "K", opt::k);
+			addToDb(db, "V",
+					num_vertices(ig) - num_vertices_removed(ig));
+			addToDb(db, "E", num_edges(ig));
+		}
 
-	if (opt::verbose > 0)
-		printGraphStats(cout, g);
-	if (!opt::db.empty()) {
-		addToDb(db, "K", opt::k);
-		addToDb(db, "V", (num_vertices(g) - num_vertices_removed(g)));
-		addToDb(db, "E", num_edges(g));
+		// Replace the adjacency lists by a compact snapshot.
+		Graph(ig).swap(g);
 	}
 
 	// try to find paths that match the distance estimates
@@ -253,13 +267,9 @@ static set<ContigID> findRepeats(ContigID seed,
 	return repeats;
 }
 
-/** The fewest number of pairs in a distance estimate. */
-static unsigned g_minNumPairs = UINT_MAX;
-
-/** The fewest number of pairs used in a path. */
-static unsigned g_minNumPairsUsed = UINT_MAX;
-
-static struct {
+/** Statistics of the seeds and their paths. */
+struct Stats
+{
 	unsigned seedTooShort;
 	unsigned noEdges;
 	unsigned edgesRemoved;
@@ -271,7 +281,40 @@ static struct {
 	unsigned multiEnd;
 	unsigned tooManySolutions;
 	unsigned tooComplex;
-} stats;
+
+	/** The fewest number of pairs in a distance estimate. */
+	unsigned minNumPairs;
+
+	/** The fewest number of pairs used in a path. */
+	unsigned minNumPairsUsed;
+
+	Stats() : seedTooShort(0), noEdges(0), edgesRemoved(0),
+		totalAttempted(0), uniqueEnd(0), noPossiblePaths(0),
+		noValidPaths(0), repeat(0), multiEnd(0),
+		tooManySolutions(0), tooComplex(0),
+		minNumPairs(UINT_MAX), minNumPairsUsed(UINT_MAX) { }
+
+	Stats& operator+=(const Stats& o)
+	{
+		seedTooShort += o.seedTooShort;
+		noEdges += o.noEdges;
+		edgesRemoved += o.edgesRemoved;
+		totalAttempted += o.totalAttempted;
+		uniqueEnd += o.uniqueEnd;
+		noPossiblePaths += o.noPossiblePaths;
+		noValidPaths += o.noValidPaths;
+		repeat += o.repeat;
+		multiEnd += o.multiEnd;
+		tooManySolutions += o.tooManySolutions;
+		tooComplex += o.tooComplex;
+		minNumPairs = min(minNumPairs, o.minNumPairs);
+		minNumPairsUsed = min(minNumPairsUsed, o.minNumPairsUsed);
+		return *this;
+	}
+};
+
+/** The statistics of all the seeds. */
+static Stats g_stats;
 
 typedef graph_traits<Graph>::vertex_descriptor vertex_descriptor;
 
@@ -454,10 +497,13 @@ typedef std::vector<std::pair<ContigNode, DistanceEst> > Estimates;
 
 /** Find a path for the specified distance estimates.
  * @param out [out] the solution path
+ * @param log [out] the verbose output
+ * @param stats [in,out] the statistics of the batch of estimates
  */
 static void handleEstimate(const Graph& g,
+		const ConstrainedSearch<Graph>& constrainedSearch,
 		const EstimateRecord& er, bool dirIdx,
-		ContigPath& out)
+		ContigPath& out, string& log, Stats& stats)
 {
 	if (er.estimates[dirIdx].empty())
 		return;
@@ -486,7 +532,7 @@ static void handleEstimate(const Graph& g,
 
 	ContigPaths solutions;
 	unsigned numVisited = 0;
-	constrainedSearch(g, origin, constraints, solutions, numVisited);
+	constrainedSearch(origin, constraints, solutions, numVisited);
 	bool tooComplex = numVisited >= opt::maxCost;
 	bool tooManySolutions = solutions.size() > opt::maxPaths;
 
@@ -597,11 +643,8 @@ static void handleEstimate(const Graph& g,
 			<< " sumdiff: " << sumDiff << '\n';
 	}
 
-	/** Lock the debugging stream. */
-	static pthread_mutex_t coutMutex = PTHREAD_MUTEX_INITIALIZER;
-	pthread_mutex_lock(&coutMutex);
 	stats.totalAttempted++;
-	g_minNumPairs = min(g_minNumPairs, minNumPairs);
+	stats.minNumPairs = min(stats.minNumPairs, minNumPairs);
 
 	if (tooComplex) {
 		stats.tooComplex++;
@@ -623,8 +666,8 @@ static void handleEstimate(const Graph& g,
 			vout << path << '\n';
 			if (opt::scaffold) {
 				out.insert(out.end(), path.begin(), path.end());
-				g_minNumPairsUsed
-					= min(g_minNumPairsUsed, minNumPairs);
+				stats.minNumPairsUsed
+					= min(stats.minNumPairsUsed, minNumPairs);
 			}
 		}
 		stats.multiEnd++;
@@ -638,12 +681,11 @@ static void handleEstimate(const Graph& g,
 			extend(g, path.back(), back_inserter(path));
 		out.insert(out.end(), path.begin(), path.end());
 		stats.uniqueEnd++;
-		g_minNumPairsUsed = min(g_minNumPairsUsed, minNumPairs);
+		stats.minNumPairsUsed = min(stats.minNumPairsUsed, minNumPairs);
 	}
-	cout << vout_ss.str();
+	log += vout_ss.str();
 	if (!out.empty())
 		assert(!out.back().ambiguous());
-	pthread_mutex_unlock(&coutMutex);
 }
 
 /** Return whether the specified edge has sufficient support. */
@@ -656,82 +698,133 @@ struct PoorSupport {
 	const unsigned m_minEdgeWeight;
 };
 
+/** The number of estimates in a batch. */
+static const size_t BATCH_SIZE = 64;
+
+/** The maximum number of batches per thread queued, running or
+ * awaiting output. */
+static const size_t MAX_PENDING_BATCHES = 4;
+
+/** A batch of distance estimates and its sequence number. */
+struct EstimateBatch
+{
+	size_t index;
+	vector<EstimateRecord>* records;
+
+	EstimateBatch(size_t index = 0,
+			vector<EstimateRecord>* records = NULL)
+		: index(index), records(records) { }
+};
+
+/** Schedules batches of estimates on the worker threads. */
+static WorkStealingScheduler<EstimateBatch>* g_scheduler;
+
+/** The argument of a worker thread. */
 struct WorkerArg {
-	istream* in;
-	ostream* out;
+	unsigned id;
 	const Graph* graph;
-	WorkerArg(istream* in, ostream* out, const Graph* g)
-		: in(in), out(out), graph(g) { }
+	const ConstrainedSearch<Graph>* search;
+	OrderedWriter* out;
+	OrderedWriter* vout;
+	WorkerArg() : id(0), graph(NULL), search(NULL),
+		out(NULL), vout(NULL) { }
 };
 
-static void* worker(void* pArg)
+/** Find the paths of the seed of the specified distance estimates.
+ * @param out [out] the path output
+ * @param log [out] the verbose output
+ * @param stats [in,out] the statistics of the batch of estimates
+ */
+static void handleRecord(const Graph& g,
+		const ConstrainedSearch<Graph>& search,
+		EstimateRecord& er, string& out, string& log, Stats& stats)
 {
-	WorkerArg& arg = *static_cast<WorkerArg*>(pArg);
-	unsigned countSeedTooShort = 0;
-	unsigned countNoEdges = 0;
-	unsigned countEdgesRemoved = 0;
-	for (;;) {
-		/** Lock the input stream. */
-		static pthread_mutex_t inMutex = PTHREAD_MUTEX_INITIALIZER;
-		pthread_mutex_lock(&inMutex);
-		EstimateRecord er;
-		bool good = bool((*arg.in) >> er);
-		pthread_mutex_unlock(&inMutex);
-		if (!good)
-			break;
-		if ((*arg.graph)[ContigNode(er.refID, false)].length < opt::minSeedLength) {
-			++countSeedTooShort;
-			continue;
-		}
+	if (g[ContigNode(er.refID, false)].length < opt::minSeedLength) {
+		++stats.seedTooShort;
+		return;
+	}
 
-		// Remove edges with insufficient support.
-		for (unsigned i = 0; i < 2; ++i) {
-			Estimates& estimates = er.estimates[i];
-			if (estimates.empty())
-				continue;
-			unsigned sizeBefore = estimates.size();
-			estimates.erase(
-				remove_if(estimates.begin(), estimates.end(), PoorSupport(opt::minEdgeWeight)),
-				estimates.end());
-			unsigned sizeAfter = estimates.size();
-			unsigned edgesRemoved = sizeBefore - sizeAfter;
-			countEdgesRemoved += edgesRemoved;
-			if (sizeAfter == 0)
-				++countNoEdges;
-		}
+	// Remove edges with insufficient support.
+	for (unsigned i = 0; i < 2; ++i) {
+		Estimates& estimates = er.estimates[i];
+		if (estimates.empty())
+			continue;
+		unsigned sizeBefore = estimates.size();
+		estimates.erase(
+			remove_if(estimates.begin(), estimates.end(), PoorSupport(opt::minEdgeWeight)),
+			estimates.end());
+		unsigned sizeAfter = estimates.size();
+		unsigned edgesRemoved = sizeBefore - sizeAfter;
+		stats.edgesRemoved += edgesRemoved;
+		if (sizeAfter == 0)
+			++stats.noEdges;
+	}
 
-		// Flip the anterior distance estimates.
-		for (Estimates::iterator it = er.estimates[1].begin();
-				it != er.estimates[1].end(); ++it)
-			it->first ^= 1;
-
-		ContigPath path;
-		handleEstimate(*arg.graph, er, true, path);
-		reverseComplement(path.begin(), path.end());
-		path.push_back(ContigNode(er.refID, false));
-		handleEstimate(*arg.graph, er, false, path);
-		if (path.size() > 1) {
-			/** Lock the output stream. */
-			static pthread_mutex_t outMutex
-				= PTHREAD_MUTEX_INITIALIZER;
-			pthread_mutex_lock(&outMutex);
-			*arg.out << get(g_contigNames, er.refID)
-				<< '\t' << path << '\n';
-			assert(arg.out->good());
-			pthread_mutex_unlock(&outMutex);
-		}
+	// Flip the anterior distance estimates.
+	for (Estimates::iterator it = er.estimates[1].begin();
+			it != er.estimates[1].end(); ++it)
+		it->first ^= 1;
+
+	ContigPath path;
+	handleEstimate(g, search, er, true, path, log, stats);
+	reverseComplement(path.begin(), path.end());
+	path.push_back(ContigNode(er.refID, false));
+	handleEstimate(g, search, er, false, path, log, stats);
+	if (path.size() > 1) {
+		ostringstream ss;
+		ss << get(g_contigNames, er.refID) << '\t' << path << '\n';
+		out += ss.str();
 	}
+}
 
+/** Worker thread. Find the paths of batches of estimates until none
+ * remain. */
+static void* worker(void* pArg)
+{
+	WorkerArg& arg = *static_cast<WorkerArg*>(pArg);
 	static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
-	pthread_mutex_lock(&statsMutex);
-	stats.seedTooShort += countSeedTooShort;
-	stats.noEdges += countNoEdges;
-	stats.edgesRemoved += countEdgesRemoved;
-	pthread_mutex_unlock(&statsMutex);
-
+	string out, log;
+	for (EstimateBatch batch; g_scheduler->pop(arg.id, batch);) {
+		Stats stats;
+		for (vector<EstimateRecord>::iterator it
+				= batch.records->begin();
+				it != batch.records->end(); ++it)
+			handleRecord(*arg.graph, *arg.search, *it, out, log,
+					stats);
+		delete batch.records;
+
+		pthread_mutex_lock(&statsMutex);
+		g_stats += stats;
+		pthread_mutex_unlock(&statsMutex);
+
+		// A batch is written to vout before out, so when out has
+		// written a batch, so has vout. Release the slots of the
+		// batches once out has written them.
+		arg.vout->write(batch.index, log);
+		g_scheduler->done(arg.out->write(batch.index, out));
+	}
 	return NULL;
 }
 
+/** Read the distance estimates in batches and schedule the batches. */
+static void readEstimates(istream& in)
+{
+	for (size_t index = 0;; ++index) {
+		vector<EstimateRecord>* records = new vector<EstimateRecord>;
+		records->reserve(BATCH_SIZE);
+		for (EstimateRecord er;
+				records->size() < BATCH_SIZE && in >> er;)
+			records->push_back(er);
+		if (records->empty()) {
+			delete records;
+			break;
+		}
+		g_scheduler->push(EstimateBatch(index, records));
+	}
+	assert(in.eof());
+	g_scheduler->close();
+}
+
 static void generatePathsThroughEstimates(const Graph& g,
 		const string& estPath)
 {
@@ -744,46 +837,61 @@ static void generatePathsThroughEstimates(const Graph& g,
 	assert(outStream.is_open());
 
 	// Create the worker threads.
+	if (opt::threads == 0)
+		opt::threads = 1;
+	g_scheduler = new WorkStealingScheduler<EstimateBatch>(
+			opt::threads, MAX_PENDING_BATCHES * opt::threads);
+	ConstrainedSearch<Graph> search(g);
+	OrderedWriter out(outStream), vout(cout);
+	vector<WorkerArg> args(opt::threads);
 	vector<pthread_t> threads;
 	threads.reserve(opt::threads);
-	WorkerArg arg(&inStream, &outStream, &g);
 	for (unsigned i = 0; i < opt::threads; i++) {
+		args[i].id = i;
+		args[i].graph = &g;
+		args[i].search = &search;
+		args[i].out = &out;
+		args[i].vout = &vout;
 		pthread_t thread;
-		pthread_create(&thread, NULL, worker, &arg);
+		pthread_create(&thread, NULL, worker, &args[i]);
 		threads.push_back(thread);
 	}
 
+	// Read the distance estimates in this thread.
+	readEstimates(inStream);
+
 	// Wait for the worker threads to finish.
 	for (vector<pthread_t>::const_iterator it = threads.begin();
 			it != threads.end(); ++it) {
 		void* status;
 		pthread_join(*it, &status);
 	}
+	delete g_scheduler;
 	if (opt::verbose > 0)
 		cout << '\n';
 
 	cout <<
-		"Seed too short: " << stats.seedTooShort << "\n"
-		"Seeds with no edges: " << stats.noEdges << "\n"
-		"Edges removed: " << stats.edgesRemoved << "\n"
-		"Total paths attempted: " << stats.totalAttempted << "\n"
-		"Unique path: " << stats.uniqueEnd << "\n"
-		"No possible paths: " << stats.noPossiblePaths << "\n"
-		"No valid paths: " << stats.noValidPaths << "\n"
-		"Repetitive: " << stats.repeat << "\n"
-		"Multiple valid paths: " << stats.multiEnd << "\n"
-		"Too many solutions: " << stats.tooManySolutions << "\n"
-		"Too complex: " << stats.tooComplex << "\n";
+		"Seed too short: " << g_stats.seedTooShort << "\n"
+		"Seeds with no edges: " << g_stats.noEdges << "\n"
+		"Edges removed: " << g_stats.edgesRemoved << "\n"
+		"Total paths attempted: " << g_stats.totalAttempted << "\n"
+		"Unique path: " << g_stats.uniqueEnd << "\n"
+		"No possible paths: " << g_stats.noPossiblePaths << "\n"
+		"No valid paths: " << g_stats.noValidPaths << "\n"
+		"Repetitive: " << g_stats.repeat << "\n"
+		"Multiple valid paths: " << g_stats.multiEnd << "\n"
+		"Too many solutions: " << g_stats.tooManySolutions << "\n"
+		"Too complex: " << g_stats.tooComplex << "\n";
 
 	vector<int> vals = make_vector<int>()
-		<< stats.totalAttempted
-		<< stats.uniqueEnd
-		<< stats.noPossiblePaths
-		<< stats.noValidPaths
-		<< stats.repeat
-		<< stats.multiEnd
-		<< stats.tooManySolutions
-		<< stats.tooComplex;
+		<< g_stats.totalAttempted
+		<< g_stats.uniqueEnd
+		<< g_stats.noPossiblePaths
+		<< g_stats.noValidPaths
+		<< g_stats.repeat
+		<< g_stats.multiEnd
+		<< g_stats.tooManySolutions
+		<< g_stats.tooComplex;
 
 	vector<string> keys = make_vector<string>()
 		<< "stat_attempted_path_total"
@@ -800,19 +908,19 @@ static void generatePathsThroughEstimates(const Graph& g,
 
 	cout << "\n"
 		"The minimum number of pairs in a distance estimate is "
-		<< g_minNumPairs << ".\n";
-	if (g_minNumPairsUsed != UINT_MAX) {
+		<< g_stats.minNumPairs << ".\n";
+	if (g_stats.minNumPairsUsed != UINT_MAX) {
 		cout << "The minimum number of pairs used in a path is "
-			<< g_minNumPairsUsed << ".\n";
-		if (g_minNumPairs < g_minNumPairsUsed)
+			<< g_stats.minNumPairsUsed << ".\n";
+		if (g_stats.minNumPairs < g_stats.minNumPairsUsed)
 			cout << "Consider increasing the number of pairs "
-				"threshold parameter, n, to " << g_minNumPairsUsed
+				"threshold parameter, n, to " << g_stats.minNumPairsUsed
 				<< ".\n";
 	}
 
 	vals += make_vector<int>()
-		<< g_minNumPairs
-		<< g_minNumPairsUsed;
+		<< g_stats.minNumPairs
+		<< g_stats.minNumPairsUsed;
 
 	keys += make_vector<string>()
 		<< "minPairNum_DistanceEst"
@@ -0,0 +1,98 @@
+#include "Align/editDistance.h"
+#include "Common/Sequence.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Return the edit distance of a and b by dynamic programming. */
+static unsigned editDistanceDP(const string& a, const string& b)
+{
+	vector<unsigned> prev(b.size() + 1), cur(b.size() + 1);
+	for (unsigned j = 0; j <= b.size(); ++j)
+		prev[j] = j;
+	for (unsigned i = 1; i <= a.size(); ++i) {
+		cur[0] = i;
+		for (unsigned j = 1; j <= b.size(); ++j) {
+			char c = ambiguityOr(a[i - 1], b[j - 1]);
+			bool match = a[i - 1] == b[j - 1]
+				|| c == a[i - 1] || c == b[j - 1];
+			cur[j] = min(prev[j - 1] + !match,
+					min(prev[j], cur[j - 1]) + 1);
+		}
+		prev.swap(cur);
+	}
+	return prev[b.size()];
+}
+
+/** Return a random sequence of the specified length. */
+static string randomSequence(unsigned n)
+{
+	string s(n, 'A');
+	for (unsigned i = 0; i < n; ++i)
+		s[i] = "ACGT"[rand() % 4];
+	return s;
+}
+
+/** Return a copy of s with random substitutions and indels. */
+static string mutate(const string& s, unsigned edits)
+{
+	string t = s;
+	for (unsigned i = 0; i < edits && !t.empty(); ++i) {
+		unsigned pos = rand() % t.size();
+		switch (rand() % 3) {
+		  case 0: t[pos] = "ACGT"[rand() % 4]; break;
+		  case 1: t.erase(pos, 1); break;
+		  case 2: t.insert(pos, 1, "ACGT"[rand() % 4]); break;
+		}
+	}
+	return t;
+}
+
+TEST(editDistance, base_cases)
+{
+	EXPECT_EQ(0u, editDistance("", ""));
+	EXPECT_EQ(3u, editDistance("", "ACG"));
+	EXPECT_EQ(3u, editDistance("ACG", ""));
+	EXPECT_EQ(0u, editDistance("ACGT", "ACGT"));
+	EXPECT_EQ(1u, editDistance("ACGT", "AGGT"));
+	EXPECT_EQ(1u, editDistance("ACGT", "ACT"));
+	EXPECT_EQ(1u, editDistance("ACGT", "ACGGT"));
+	EXPECT_EQ(0u, editDistance("ACNT", "ACGT"));
+	EXPECT_EQ(0u, editDistance("ACRT", "ACGT"));
+	EXPECT_EQ(1u, editDistance("ACYT", "ACGT"));
+}
+
+TEST(editDistance, random)
+{
+	srand(1);
+	for (unsigned n = 1; n < 300; n += 7) {
+		string a = randomSequence(n);
+		for (unsigned edits = 0; edits < 20; edits += 3) {
+			string b = mutate(a, edits);
+			EXPECT_EQ(editDistanceDP(a, b), editDistance(a, b));
+			EXPECT_EQ(editDistanceDP(b, a), editDistance(b, a));
+		}
+		string b = randomSequence(rand() % 300);
+		EXPECT_EQ(editDistanceDP(a, b), editDistance(a, b));
+	}
+}
+
+TEST(editDistance, maxDistance)
+{
+	srand(2);
+	for (unsigned n = 50; n < 500; n += 50) {
+		string a = randomSequence(n);
+		string b = mutate(a, n / 10);
+		unsigned d = editDistanceDP(a, b);
+		EXPECT_EQ(d, editDistance(a, b, d));
+		EXPECT_EQ(d, editDistance(a, b, d + 10));
+		if (d > 0) {
+			EXPECT_GT(editDistance(a, b, d - 1), d - 1);
+		}
+		EXPECT_GT(editDistance(a, b, 0), 0u);
+	}
+}
@@ -0,0 +1,59 @@
+#include "Common/Dictionary.h"
+#include "gtest/gtest.h"
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static string name(unsigned i)
+{
+	ostringstream ss;
+	ss << "contig" << i;
+	return ss.str();
+}
+
+TEST(Dictionary, insert)
+{
+	Dictionary d;
+	EXPECT_TRUE(d.empty());
+	EXPECT_EQ(0u, d.count("a"));
+	EXPECT_EQ(0u, d.insert("a"));
+	EXPECT_EQ(1u, d.insert("b"));
+	EXPECT_EQ(2u, d.size());
+	EXPECT_EQ(1u, d.count("a"));
+	EXPECT_EQ(0u, d.count("c"));
+	EXPECT_EQ(1u, d.getIndex("b"));
+	EXPECT_EQ(string("a"), d.getName(0).c_str());
+	EXPECT_EQ(string("b"), d.back().c_str());
+	d.put(1, "b");
+	d.put(2, "c");
+	EXPECT_EQ(2u, d.getIndex("c"));
+}
+
+/** The names remain found as the table grows. */
+TEST(Dictionary, rehash)
+{
+	const unsigned n = 100000;
+	Dictionary d;
+	for (unsigned i = 0; i < n; ++i)
+		ASSERT_EQ(i, d.insert(name(i)));
+	Dictionary r;
+	r.reserve(n);
+	for (unsigned i = 0; i < n; ++i)
+		ASSERT_EQ(i, r.insert(name(i)));
+	for (unsigned i = 0; i < n; ++i) {
+		ASSERT_EQ(i, d.getIndex(name(i)));
+		ASSERT_EQ(i, r.getIndex(name(i)));
+		ASSERT_EQ(name(i), d.getName(i).c_str());
+	}
+	EXPECT_EQ(0u, d.count(name(n)));
+	EXPECT_EQ(0u, r.count(""));
+}
+
+TEST(Dictionary, duplicate)
+{
+	Dictionary d;
+	d.insert("a");
+	EXPECT_DEATH(d.insert("a"), "duplicate ID");
+	EXPECT_DEATH(d.getIndex("b"), "unexpected ID");
+}
@@ -0,0 +1,130 @@
+#include "Common/PairedAlignment.h"
+#include "gtest/gtest.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** Verify the binary stream of abyss-fixmate --bin */
+
+using namespace std;
+
+static PairedAlignment makeAlignment(unsigned contig,
+		unsigned mateContig, int pos, int isize, bool rc)
+{
+	PairedAlignment a;
+	a.contig = contig;
+	a.mateContig = mateContig;
+	a.pos = pos;
+	a.isize = isize;
+	a.flag = rc ? PairedAlignment::FREVERSE
+		: PairedAlignment::FMREVERSE;
+	a.mapq = 60;
+	a.reserved = 0;
+	return a;
+}
+
+TEST(PairedAlignment, from_sam)
+{
+	g_contigNames.unlock();
+	if (g_contigNames.empty()) {
+		put(g_contigNames, 0, "0");
+		put(g_contigNames, 1, "1");
+		put(g_contigNames, 2, "2");
+	}
+
+	istringstream in("r/1\t99\t0\t11\t60\t5S20M\t2\t31\t0\t*\t*\n");
+	SAMRecord sam;
+	in >> sam;
+	ASSERT_FALSE(in.fail());
+	sam.isize = 300;
+	PairedAlignment a(sam);
+	EXPECT_EQ(0U, a.contig);
+	EXPECT_EQ(2U, a.mateContig);
+	EXPECT_EQ(sam.targetAtQueryStart(), a.targetAtQueryStart());
+	EXPECT_EQ(sam.mateTargetAtQueryStart(),
+			a.mateTargetAtQueryStart());
+	EXPECT_FALSE(a.isReverse());
+	EXPECT_TRUE(a.isMateReverse());
+	EXPECT_EQ(60, a.mapq);
+}
+
+TEST(PairedAlignment, round_trip)
+{
+	g_contigNames.unlock();
+	if (g_contigNames.empty()) {
+		put(g_contigNames, 0, "0");
+		put(g_contigNames, 1, "1");
+		put(g_contigNames, 2, "2");
+	}
+	vector<unsigned> lengths;
+	lengths.push_back(100);
+	lengths.push_back(200);
+	lengths.push_back(300);
+
+	vector<PairedAlignment> v;
+	v.push_back(makeAlignment(2, 0, 10, 5, false));
+	v.push_back(makeAlignment(0, 2, 20, -5, true));
+	v.push_back(makeAlignment(2, 1, 30, 7, true));
+
+	ostringstream out;
+	writePairedAlignments(out, lengths, v);
+	EXPECT_TRUE(v.empty());
+
+	istringstream in(out.str());
+	ASSERT_TRUE(PairedAlignmentReader::isBinary(in));
+	g_contigNames = Dictionary();
+	vector<unsigned> readLengths;
+	PairedAlignmentReader reader(in);
+	EXPECT_EQ(3U, reader.readHeader(readLengths));
+	EXPECT_EQ(lengths, readLengths);
+	EXPECT_EQ("1", string(get(g_contigNames, 1)));
+
+	// The alignments are partitioned by contig.
+	vector<PairedAlignment> bucket;
+	ASSERT_TRUE(reader.read(bucket));
+	ASSERT_EQ(1U, bucket.size());
+	EXPECT_EQ(0U, bucket[0].contig);
+	EXPECT_EQ(20, bucket[0].targetAtQueryStart());
+	EXPECT_EQ(15, bucket[0].mateTargetAtQueryStart());
+	EXPECT_TRUE(bucket[0].isReverse());
+
+	bucket.clear();
+	ASSERT_TRUE(reader.read(bucket));
+	ASSERT_EQ(2U, bucket.size());
+	EXPECT_EQ(2U, bucket[0].contig);
+	EXPECT_EQ(0U, bucket[0].mateContig);
+	EXPECT_EQ(2U, bucket[1].contig);
+	EXPECT_EQ(1U, bucket[1].mateContig);
+
+	bucket.clear();
+	EXPECT_FALSE(reader.read(bucket));
+	EXPECT_TRUE(in.eof());
+}
+
+TEST(PairedAlignment, partition)
+{
+	vector<PairedAlignment> v;
+	for (int i = 0; i < 100; ++i)
+		v.push_back(makeAlignment(i * 7 % 5, 0, i, 0, false));
+
+	vector<uint64_t> counts;
+	partitionPairedAlignments(v, 6, counts);
+	ASSERT_EQ(100U, v.size());
+	EXPECT_EQ(0U, counts[5]);
+	size_t i = 0;
+	for (unsigned contig = 0; contig < counts.size(); ++contig) {
+		if (contig < 5) {
+			EXPECT_EQ(20U, counts[contig]);
+		}
+		for (uint64_t j = 0; j < counts[contig]; ++j, ++i) {
+			EXPECT_EQ(contig, v[i].contig);
+			EXPECT_EQ((int)contig, v[i].pos * 7 % 5);
+		}
+	}
+}
+
+TEST(PairedAlignment, not_binary)
+{
+	istringstream in("@HD\tVN:1.4\n");
+	EXPECT_FALSE(PairedAlignmentReader::isBinary(in));
+}
@@ -0,0 +1,64 @@
+#include "Common/ContigNode.h"
+#include "Common/ContigProperties.h"
+#include "Common/Estimate.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/DirectedGraph.h"
+#include "Graph/GraphIO.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace opt {
+	unsigned k = 31;
+	int format = ADJ;
+}
+
+typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
+
+TEST(AdjIO, splitLines)
+{
+	string s = "a\nbb\nccc\n\ndddd\n";
+	const char* first = s.data();
+	const char* last = first + s.size();
+	for (unsigned n = 1; n <= 8; ++n) {
+		vector<const char*> bounds = splitLines(first, last, n, 1);
+		ASSERT_GE(bounds.size(), 2u);
+		ASSERT_LE(bounds.size(), n + 1);
+		EXPECT_EQ(first, bounds.front());
+		EXPECT_EQ(last, bounds.back());
+		for (unsigned i = 1; i < bounds.size() - 1; ++i) {
+			EXPECT_LT(bounds[i - 1], bounds[i]);
+			EXPECT_EQ('\n', bounds[i][-1]);
+		}
+	}
+	EXPECT_EQ(2u, splitLines(first, last, 8).size());
+}
+
+/** A graph read from memory in several ranges is written back
+ * unchanged. */
+TEST(AdjIO, readMemory)
+{
+	ostringstream adj;
+	const unsigned n = 150000;
+	for (unsigned i = 0; i < n; ++i) {
+		adj << i << ' ' << 100 + i % 50 << ' ' << i % 7 << "\t;";
+		if (i + 1 < n)
+			adj << ' ' << i + 1 << '+';
+		if (i % 3 == 0 && i + 2 < n)
+			adj << ' ' << i + 2 << "- [d=" << -(int)(i % 20) << ']';
+		adj << "\t;";
+		if (i > 0)
+			adj << ' ' << i - 1 << '-';
+		adj << '\n';
+	}
+	string data = adj.str();
+
+	Graph g;
+	read_adj(data.data(), data.size(), g, DisallowParallelEdges());
+	ASSERT_EQ(2 * n, num_vertices(g));
+	ostringstream actual;
+	write_adj(actual, g);
+	EXPECT_EQ(data, actual.str());
+}
@@ -0,0 +1,114 @@
+#include "Common/ContigNode.h"
+#include "Common/ContigProperties.h"
+#include "Graph/BinaryGraphIO.h"
+#include "Graph/GraphIO.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/DirectedGraph.h"
+#include "Graph/DotIO.h"
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace opt {
+	unsigned k = 31;
+	int format = DOT;
+}
+
+typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
+
+/** A binary graph reads back to the same graph. */
+TEST(BinaryGraphIO, roundTrip)
+{
+	srand(1);
+	Graph g;
+	const unsigned n = 50;
+	for (unsigned i = 0; i < n; ++i) {
+		add_vertex(ContigProperties(31 + rand() % 200, rand() % 100), g);
+		ostringstream name;
+		name << "contig" << i;
+		put(g_contigNames, i, name.str());
+	}
+	for (unsigned i = 0; i < 120; ++i) {
+		ContigNode u(rand() % n, rand() % 2), v(rand() % n, rand() % 2);
+		if (!edge(u, v, g).second)
+			add_edge(u, v, Distance(i % 2 ? -30 : rand() % 100), g);
+	}
+	clear_vertex(ContigNode(7, false), g);
+	remove_vertex(ContigNode(7, false), g);
+
+	ostringstream bin;
+	write_binary_graph(bin, g);
+	string data = bin.str();
+	ASSERT_EQ(0, memcmp(data.data(), BINARY_GRAPH_MAGIC,
+				sizeof BINARY_GRAPH_MAGIC));
+
+	ostringstream expected;
+	write_dot(expected, g);
+
+	// Read into an empty graph.
+	Graph g1;
+	read_binary_graph(data.data(), data.size(), g1,
+			DisallowParallelEdges());
+	ASSERT_EQ(num_vertices(g), num_vertices(g1));
+	ASSERT_EQ(num_edges(g), num_edges(g1));
+	EXPECT_TRUE(get(vertex_removed, g1, ContigNode(7, false)));
+	ostringstream actual;
+	write_dot(actual, g1);
+	EXPECT_EQ(expected.str(), actual.str());
+
+	// Merge into a graph that already has the vertices.
+	Graph g2;
+	for (unsigned i = 0; i < n; ++i)
+		add_vertex(g[ContigNode(i, false)], g2);
+	read_binary_graph(data.data(), data.size(), g2,
+			DisallowParallelEdges());
+	EXPECT_EQ(num_edges(g), num_edges(g2));
+}
+
+/** A corrupt binary graph is reported rather than read. */
+TEST(BinaryGraphIO, corrupt)
+{
+	Graph g;
+	const unsigned n = 3;
+	for (unsigned i = 0; i < n; ++i) {
+		add_vertex(ContigProperties(100, 10), g);
+		ostringstream name;
+		name << "contig" << i;
+		put(g_contigNames, i, name.str());
+	}
+	add_edge(ContigNode(0, false), ContigNode(1, false), Distance(-30), g);
+	add_edge(ContigNode(1, false), ContigNode(2, true), Distance(-30), g);
+
+	ostringstream bin;
+	write_binary_graph(bin, g);
+	const string data = bin.str();
+	const BinaryGraphHeader& header
+		= *reinterpret_cast<const BinaryGraphHeader*>(data.data());
+	size_t namesSize = header.namesSize + (-header.namesSize % 8);
+	size_t nameOffsets = sizeof header;
+	size_t targets = nameOffsets + (n + 1) * 8 + namesSize
+		+ n * sizeof (BinaryVertexProp) + 8 + (2 * n + 1) * 8;
+
+	Graph g1;
+	string s = data;
+	reinterpret_cast<uint64_t*>(&s[nameOffsets])[1] = 1000;
+	EXPECT_DEATH(read_binary_graph(s.data(), s.size(), g1,
+				DisallowParallelEdges()), "corrupt binary graph");
+
+	s = data;
+	reinterpret_cast<uint32_t*>(&s[targets])[0] = 2 * n;
+	EXPECT_DEATH(read_binary_graph(s.data(), s.size(), g1,
+				DisallowParallelEdges()), "corrupt binary graph");
+
+	s = data.substr(0, data.size() - 8);
+	EXPECT_DEATH(read_binary_graph(s.data(), s.size(), g1,
+				DisallowParallelEdges()), "truncated binary graph");
+
+	opt::k = 25;
+	EXPECT_DEATH(read_binary_graph(data.data(), data.size(), g1,
+				DisallowParallelEdges()), "binary graph has k=31");
+	opt::k = 31;
+}
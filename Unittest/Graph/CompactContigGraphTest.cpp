@@ -0,0 +1,115 @@
+#include "Common/ContigNode.h"
+#include "Common/ContigProperties.h"
+#include "Graph/CompactContigGraph.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/DirectedGraph.h"
+#include "Graph/DotIO.h"
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace opt {
+	unsigned k = 31;
+	int format = DOT;
+}
+
+typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
+typedef CompactContigGraph<ContigProperties, Distance> Compact;
+
+/** Build a random graph of n contigs. */
+static void randomGraph(Graph& g, unsigned n, unsigned numEdges)
+{
+	for (unsigned i = 0; i < n; ++i)
+		add_vertex(ContigProperties(31 + rand() % 200, rand() % 100),
+				g);
+	for (unsigned i = 0; i < numEdges; ++i) {
+		ContigNode u(rand() % n, rand() % 2), v(rand() % n, rand() % 2);
+		if (!edge(u, v, g).second)
+			add_edge(u, v, Distance(-(rand() % 30)), g);
+	}
+}
+
+TEST(CompactContigGraph, empty)
+{
+	Compact g;
+	EXPECT_EQ(0u, num_vertices(g));
+	EXPECT_EQ(0u, num_edges(g));
+	EXPECT_TRUE(vertices(g).first == vertices(g).second);
+	EXPECT_TRUE(edges(g).first == edges(g).second);
+}
+
+/** The snapshot has the same vertices, edges and properties as the
+ * graph from which it was built. */
+TEST(CompactContigGraph, snapshot)
+{
+	typedef graph_traits<Graph>::out_edge_iterator OutIt;
+	typedef graph_traits<Graph>::in_edge_iterator InIt;
+	typedef graph_traits<Graph>::edge_iterator EdgeIt;
+	typedef graph_traits<Compact>::out_edge_iterator COutIt;
+	typedef graph_traits<Compact>::in_edge_iterator CInIt;
+	typedef graph_traits<Compact>::edge_iterator CEdgeIt;
+	typedef graph_traits<Compact>::adjacency_iterator CAdjIt;
+
+	srand(1);
+	Graph g;
+	randomGraph(g, 50, 120);
+	clear_vertex(ContigNode(7, false), g);
+	remove_vertex(ContigNode(7, false), g);
+	Compact cg(g);
+
+	ASSERT_EQ(num_vertices(g), num_vertices(cg));
+	ASSERT_EQ(num_edges(g), num_edges(cg));
+	for (unsigned i = 0; i < num_vertices(g); ++i) {
+		ContigNode u(i);
+		EXPECT_EQ(get(vertex_removed, g, u),
+				get(vertex_removed, cg, u));
+		EXPECT_EQ(g[u], cg[u]);
+		ASSERT_EQ(out_degree(u, g), out_degree(u, cg));
+		ASSERT_EQ(in_degree(u, g), in_degree(u, cg));
+
+		pair<OutIt, OutIt> out = out_edges(u, g);
+		pair<COutIt, COutIt> cout = out_edges(u, cg);
+		pair<CAdjIt, CAdjIt> adj = adjacent_vertices(u, cg);
+		for (; out.first != out.second;
+				++out.first, ++cout.first, ++adj.first) {
+			EXPECT_EQ(*out.first, *cout.first);
+			EXPECT_EQ(target(*out.first, g), *adj.first);
+			EXPECT_EQ(get(edge_bundle, g, out.first),
+					get(edge_bundle, cg, cout.first));
+			EXPECT_EQ(g[*out.first], cg[*cout.first]);
+			EXPECT_TRUE(edge(source(*out.first, g),
+						target(*out.first, g), cg).second);
+		}
+		EXPECT_TRUE(cout.first == cout.second);
+		EXPECT_TRUE(adj.first == adj.second);
+
+		pair<InIt, InIt> in = in_edges(u, g);
+		pair<CInIt, CInIt> cin = in_edges(u, cg);
+		for (; in.first != in.second; ++in.first, ++cin.first)
+			EXPECT_EQ(*in.first, *cin.first);
+		EXPECT_TRUE(cin.first == cin.second);
+	}
+
+	pair<EdgeIt, EdgeIt> e = edges(g);
+	pair<CEdgeIt, CEdgeIt> ce = edges(cg);
+	for (; e.first != e.second; ++e.first, ++ce.first) {
+		ASSERT_TRUE(ce.first != ce.second);
+		EXPECT_EQ(*e.first, *ce.first);
+		EXPECT_EQ(get(edge_bundle, g, e.first),
+				get(edge_bundle, cg, ce.first));
+	}
+	EXPECT_TRUE(ce.first == ce.second);
+
+	for (unsigned i = 0; i < num_vertices(g) / 2; ++i) {
+		ostringstream name;
+		name << i;
+		put(g_contigNames, i, name.str());
+	}
+	ostringstream expected, actual;
+	write_dot(expected, g);
+	write_dot(actual, cg);
+	EXPECT_EQ(expected.str(), actual.str());
+}
@@ -211,4 +211,32 @@ TEST_F(ConstrainedBidiBFSVisitorTest, NoLimitForBranches)
 	ASSERT_TRUE(path2 == "0,1,3" || path2 == "0,2,3");
 }
 
+
+TEST_F(ConstrainedBidiBFSVisitorTest, ReuseSearchContext)
+{
+	BidiBFSSearchContext<V> context;
+
+	ConstrainedBidiBFSVisitor<Graph>
+		visitor1(cyclicGraph, 0, 6, 4, 5, 6, 2, NO_LIMIT, NO_MEM_LIMIT,
+				&context);
+	bidirectionalBFS(cyclicGraph, 0, 6, context.queue[FORWARD],
+			context.queue[REVERSE], visitor1,
+			context.color[FORWARD], context.color[REVERSE]);
+	PathList paths;
+	EXPECT_EQ(FOUND_PATH, visitor1.pathsToGoal(paths));
+	EXPECT_EQ(3u, paths.size());
+	EXPECT_LT(0u, visitor1.approxMemUsage());
+
+	// a second search must not see the state of the first
+	ConstrainedBidiBFSVisitor<Graph>
+		visitor2(simpleAcyclicGraph, 0, 3, 1, 1, 3, 2, NO_LIMIT,
+				NO_MEM_LIMIT, &context);
+	bidirectionalBFS(simpleAcyclicGraph, 0, 3, context.queue[FORWARD],
+			context.queue[REVERSE], visitor2,
+			context.color[FORWARD], context.color[REVERSE]);
+	Path<V> uniquePath;
+	ASSERT_EQ(FOUND_PATH, visitor2.uniquePathToGoal(uniquePath));
+	EXPECT_EQ("0,2,3", uniquePath.str());
+}
+
 }
@@ -0,0 +1,128 @@
+#include "Common/ContigNode.h"
+#include "Common/ContigProperties.h"
+#include "Graph/CompactContigGraph.h"
+#include "Graph/ConstrainedSearch.h"
+#include "Graph/ContigGraph.h"
+#include "Graph/DirectedGraph.h"
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
+
+/** Build a random graph of n contigs with k - 1 = 30 bp overlaps. */
+static void randomGraph(Graph& g, unsigned n, unsigned numEdges)
+{
+	for (unsigned i = 0; i < n; ++i)
+		add_vertex(ContigProperties(31 + rand() % 200, 0), g);
+	for (unsigned i = 0; i < numEdges; ++i) {
+		ContigNode u(rand() % n, rand() % 2), v(rand() % n, rand() % 2);
+		if (!edge(u, v, g).second)
+			add_edge(u, v, Distance(-30), g);
+	}
+}
+
+TEST(ConstrainedSearch, simple)
+{
+	/*
+	 * 0+ -> 1+ -> 3+
+	 *   \-> 2+ -/
+	 */
+	Graph g;
+	for (unsigned i = 0; i < 4; ++i)
+		add_vertex(ContigProperties(100, 0), g);
+	add_edge(ContigNode(0, false), ContigNode(1, false), Distance(-30), g);
+	add_edge(ContigNode(0, false), ContigNode(2, false), Distance(-30), g);
+	add_edge(ContigNode(1, false), ContigNode(3, false), Distance(-30), g);
+	add_edge(ContigNode(2, false), ContigNode(3, false), Distance(-30), g);
+
+	ConstrainedSearch<Graph> search(g);
+	Constraints constraints;
+	constraints.push_back(Constraint(ContigNode(3, false), 40));
+	ContigPaths solutions;
+	unsigned cost = 0;
+	EXPECT_TRUE(search(ContigNode(0, false), constraints,
+				solutions, cost));
+	ASSERT_EQ(2u, solutions.size());
+	EXPECT_EQ(ContigNode(1, false), solutions[0][0]);
+	EXPECT_EQ(ContigNode(2, false), solutions[1][0]);
+
+	// The distance to 3+ is 40 bp, so a constraint of 39 fails.
+	constraints[0].second = 39;
+	solutions.clear();
+	cost = 0;
+	EXPECT_FALSE(search(ContigNode(0, false), constraints,
+				solutions, cost));
+	EXPECT_TRUE(solutions.empty());
+}
+
+/** The search finds the same solutions as the recursive search. */
+TEST(ConstrainedSearch, matchesRecursiveSearch)
+{
+	srand(1);
+	unsigned compared = 0;
+	for (unsigned trial = 0; trial < 50; ++trial) {
+		Graph g;
+		randomGraph(g, 40, 100);
+		ConstrainedSearch<Graph> search(g);
+		for (unsigned i = 0; i < 20; ++i) {
+			ContigNode origin(rand() % 40, rand() % 2);
+			Constraints constraints;
+			unsigned n = 1 + rand() % 3;
+			for (unsigned j = 0; j < n; ++j) {
+				ContigNode v(rand() % 40, rand() % 2);
+				if (findConstraint(constraints, v) == constraints.end()) {
+					constraints.push_back(Constraint(v, rand() % 1500));
+					sort(constraints.begin(), constraints.end());
+				}
+			}
+
+			Constraints expectedConstraints(constraints);
+			ContigPaths expected, actual;
+			unsigned expectedCost = 0, actualCost = 0;
+			constrainedSearch(g, origin, expectedConstraints,
+					expected, expectedCost);
+			search(origin, constraints, actual, actualCost);
+			EXPECT_LE(actualCost, expectedCost);
+			if (expectedCost < opt::maxCost) {
+				EXPECT_EQ(expected, actual);
+				++compared;
+			}
+		}
+	}
+	EXPECT_GT(compared, 0u);
+}
+
+/** The search of a compact snapshot finds the same solutions as the
+ * search of the graph from which it was built. */
+TEST(ConstrainedSearch, compactGraph)
+{
+	typedef CompactContigGraph<ContigProperties, Distance> Compact;
+	srand(2);
+	for (unsigned trial = 0; trial < 20; ++trial) {
+		Graph g;
+		randomGraph(g, 40, 100);
+		Compact cg(g);
+		ASSERT_EQ(num_vertices(g), num_vertices(cg));
+		ASSERT_EQ(num_edges(g), num_edges(cg));
+		ConstrainedSearch<Graph> search(g);
+		ConstrainedSearch<Compact> compactSearch(cg);
+		for (unsigned i = 0; i < 20; ++i) {
+			ContigNode origin(rand() % 40, rand() % 2);
+			EXPECT_EQ(out_degree(origin, g), out_degree(origin, cg));
+			EXPECT_EQ(in_degree(origin, g), in_degree(origin, cg));
+			Constraints constraints;
+			constraints.push_back(Constraint(
+						ContigNode(rand() % 40, rand() % 2),
+						rand() % 1500));
+
+			ContigPaths expected, actual;
+			unsigned expectedCost = 0, actualCost = 0;
+			search(origin, constraints, expected, expectedCost);
+			compactSearch(origin, constraints, actual, actualCost);
+			EXPECT_EQ(expectedCost, actualCost);
+			EXPECT_EQ(expected, actual);
+		}
+	}
+}
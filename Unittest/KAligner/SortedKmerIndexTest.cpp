@@ -0,0 +1,181 @@
+#include "KAligner/SortedKmerIndex.h"
+#include "KAligner/Options.h"
+#include "Common/Sequence.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace opt {
+	/** Defined by KAligner/Aligner.cpp, which is not linked. */
+	int multimap;
+}
+
+typedef multimap<string, uint32_t> KmerMap;
+
+static string randomSequence(size_t n)
+{
+	static const char bases[] = "ACGT";
+	string s(n, 'A');
+	for (size_t i = 0; i < n; ++i)
+		s[i] = bases[rand() % 4];
+	return s;
+}
+
+/** Return a target with repeats and reverse-complement repeats. */
+static vector<string> makeTarget()
+{
+	srand(1);
+	vector<string> target;
+	target.push_back(randomSequence(3000));
+	target.push_back(randomSequence(2000)
+			+ target[0].substr(100, 200) + randomSequence(500));
+	target.push_back(reverseComplement(target[0].substr(1000, 300))
+			+ "NN" + randomSequence(1000));
+	target.push_back("ACGT");
+	return target;
+}
+
+/** Index the target in a sorted k-mer index and in a map. */
+static void buildIndex(const vector<string>& target, unsigned k,
+		SortedKmerIndex& index, KmerMap& kmerMap)
+{
+	uint32_t start = 0;
+	for (size_t i = 0; i < target.size(); ++i) {
+		const string& seq = target[i];
+		index.addSequence(seq, k);
+		for (size_t j = 0; j + k <= seq.size(); ++j) {
+			string kmer = seq.substr(j, k);
+			if (kmer.find_first_not_of("ACGT") == string::npos)
+				kmerMap.insert(make_pair(kmer, start + j));
+		}
+		start += seq.size();
+	}
+	index.build();
+}
+
+/** Return the positions of the k-mer in the sorted k-mer index. */
+static vector<uint32_t> lookup(const SortedKmerIndex& index,
+		const string& kmer)
+{
+	SortedKmerIndex::Code code;
+	pair<SortedKmerIndex::const_iterator,
+		SortedKmerIndex::const_iterator> range
+		= index.equal_range(index.encode(kmer.data(), code));
+	vector<uint32_t> v;
+	for (SortedKmerIndex::const_iterator it = range.first;
+			it != range.second; ++it)
+		if (index.matches(*it, code))
+			v.push_back(*it);
+	sort(v.begin(), v.end());
+	return v;
+}
+
+/** Check the positions of the k-mer of the target and of random
+ * k-mer against the map. */
+static void checkLookup(const SortedKmerIndex& index,
+		const KmerMap& kmerMap, unsigned k)
+{
+	set<string> queries;
+	for (KmerMap::const_iterator it = kmerMap.begin();
+			it != kmerMap.end(); ++it)
+		queries.insert(it->first);
+	for (unsigned i = 0; i < 1000; ++i)
+		queries.insert(randomSequence(k));
+
+	for (set<string>::const_iterator it = queries.begin();
+			it != queries.end(); ++it) {
+		vector<uint32_t> expected;
+		pair<KmerMap::const_iterator, KmerMap::const_iterator> range
+			= kmerMap.equal_range(*it);
+		for (KmerMap::const_iterator x = range.first;
+				x != range.second; ++x)
+			expected.push_back(x->second);
+		sort(expected.begin(), expected.end());
+		ASSERT_EQ(expected, lookup(index, *it)) << *it;
+	}
+}
+
+static void testLookup(unsigned k)
+{
+	opt::multimap = opt::MULTIMAP;
+	vector<string> target = makeTarget();
+	SortedKmerIndex index;
+	KmerMap kmerMap;
+	buildIndex(target, k, index, kmerMap);
+	EXPECT_EQ(kmerMap.size(), index.size());
+	EXPECT_EQ(target.size(), index.numSequences());
+	checkLookup(index, kmerMap, k);
+
+	// Round-trip the index through a stream.
+	stringstream ss;
+	index.write(ss);
+	SortedKmerIndex loaded;
+	loaded.read(ss, k);
+	EXPECT_EQ(index.size(), loaded.size());
+	ASSERT_EQ(index.numSequences(), loaded.numSequences());
+	for (unsigned i = 0; i < index.numSequences(); ++i)
+		EXPECT_EQ(index.length(i), loaded.length(i));
+	checkLookup(loaded, kmerMap, k);
+}
+
+TEST(SortedKmerIndex, lookup_k25)
+{
+	testLookup(25);
+}
+
+TEST(SortedKmerIndex, lookup_k40)
+{
+	testLookup(40);
+}
+
+TEST(SortedKmerIndex, ignore_duplicates)
+{
+	opt::multimap = opt::IGNORE;
+	const unsigned k = 40;
+	vector<string> target = makeTarget();
+	SortedKmerIndex index;
+	KmerMap kmerMap;
+	buildIndex(target, k, index, kmerMap);
+
+	// A k-mer is a duplicate when it occurs more than once or its
+	// reverse complement, other than itself, occurs.
+	size_t unique = 0;
+	set<string> duplicates;
+	for (KmerMap::const_iterator it = kmerMap.begin();
+			it != kmerMap.end(); ++it) {
+		string rc = reverseComplement(it->first);
+		if (kmerMap.count(it->first) > 1
+				|| (rc != it->first && kmerMap.count(rc) > 0))
+			duplicates.insert(min(it->first, rc));
+		else
+			++unique;
+	}
+	EXPECT_EQ(duplicates.size(), index.duplicates());
+	EXPECT_EQ(unique, index.size());
+	EXPECT_TRUE(lookup(index, target[1].substr(2100, k)).empty());
+	EXPECT_EQ(1u, lookup(index, target[0].substr(0, k)).size());
+}
+
+TEST(SortedKmerIndex, empty)
+{
+	opt::multimap = opt::MULTIMAP;
+	SortedKmerIndex index;
+	index.addSequence("ACGT", 25);
+	index.build();
+	EXPECT_EQ(0u, index.size());
+	EXPECT_TRUE(lookup(index, randomSequence(25)).empty());
+
+	stringstream ss;
+	index.write(ss);
+	SortedKmerIndex loaded;
+	loaded.read(ss, 25);
+	EXPECT_EQ(0u, loaded.size());
+	EXPECT_TRUE(lookup(loaded, randomSequence(25)).empty());
+}
@@ -3,6 +3,7 @@
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/BloomFilterWindow.h"
 #include "Bloom/CascadingBloomFilterWindow.h"
+#include "Bloom/RollingBloomFilter.h"
 #include "Common/BitUtil.h"
 
 #include <gtest/gtest.h>
@@ -74,6 +75,38 @@ TEST(BloomFilter, serialization)
 	EXPECT_TRUE(copyBloom[c]);
 }
 
+TEST(RollingBloomFilter, serialization)
+{
+	Konnector::RollingBloomFilter origBloom(1000, 7);
+
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+
+	origBloom.insert(a);
+	origBloom.insert(b);
+	EXPECT_TRUE(origBloom[a]);
+	EXPECT_TRUE(origBloom[reverseComplement(b)]);
+
+	stringstream ss;
+	ss << origBloom;
+	ASSERT_TRUE(ss.good());
+
+	unsigned version;
+	ss >> version;
+	EXPECT_EQ(Bloom::ROLLING_BLOOM_VERSION, version);
+	ss.seekg(0);
+
+	Konnector::RollingBloomFilter copyBloom;
+	ss >> copyBloom;
+	ASSERT_TRUE(ss.good());
+
+	EXPECT_EQ(origBloom.size(), copyBloom.size());
+	EXPECT_EQ(origBloom.popcount(), copyBloom.popcount());
+	EXPECT_TRUE(copyBloom[a]);
+	EXPECT_TRUE(copyBloom[b]);
+}
+
 TEST(BloomFilter, union_)
 {
 	size_t bits = 10000;
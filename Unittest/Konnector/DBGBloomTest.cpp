@@ -1,4 +1,5 @@
 #include "Konnector/DBGBloom.h"
+#include "Konnector/RollingDBGBloom.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/BloomFilter.h"
 
@@ -6,6 +7,7 @@
 #include <string>
 
 using Konnector::BloomFilter;
+using Konnector::RollingBloomFilter;
 
 TEST(DBGBloom, BloomFilterPolymorphism)
 {
@@ -63,3 +65,65 @@ TEST(DBGBloom, BloomFilterPolymorphism)
 	ei2++;
 	EXPECT_TRUE(ei2 == ei_end2);
 }
+
+TEST(RollingKmerHash, shifted)
+{
+	Kmer::setLength(31);
+	Kmer u("GATCGTGGCGGGCGATAGATGTGCTGCCGCC");
+	RollingKmerHash h(u);
+	EXPECT_EQ(h.canonical(), RollingKmerHash(reverseComplement(u)).canonical());
+
+	for (uint8_t base = 0; base < 4; ++base) {
+		Kmer v = u;
+		v.shift(SENSE, base);
+		RollingKmerHash hv = h.shifted(u, SENSE, base);
+		EXPECT_EQ(RollingKmerHash(v).fwd, hv.fwd);
+		EXPECT_EQ(RollingKmerHash(v).rev, hv.rev);
+
+		v = u;
+		v.shift(ANTISENSE, base);
+		hv = h.shifted(u, ANTISENSE, base);
+		EXPECT_EQ(RollingKmerHash(v).fwd, hv.fwd);
+		EXPECT_EQ(RollingKmerHash(v).rev, hv.rev);
+	}
+}
+
+TEST(RollingDBGBloom, edges)
+{
+	Kmer::setLength(3);
+
+	Kmer kmer1("GAC");
+	 Kmer kmer2("ACC");
+	  Kmer kmer3("CCA");
+
+	RollingCascadingBloomFilter countingBloom(100000, 2);
+	countingBloom.insert(kmer1);
+	countingBloom.insert(kmer1);
+	countingBloom.insert(kmer2);
+	countingBloom.insert(kmer2);
+	countingBloom.insert(kmer3);
+
+	typedef RollingDBGBloom<RollingBloomFilter> Graph;
+	Graph g(countingBloom.getBloomFilter(1));
+
+	boost::graph_traits<Graph>::out_edge_iterator ei, ei_end;
+	boost::tie(ei, ei_end) = out_edges(kmer1, g);
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_TRUE(target(*ei, g) == kmer2);
+	ei++;
+	EXPECT_TRUE(ei == ei_end);
+
+	// kmer3 was inserted once and does not pass the second level
+	boost::tie(ei, ei_end) = out_edges(kmer2, g);
+	EXPECT_TRUE(ei == ei_end);
+
+	boost::graph_traits<Graph>::in_edge_iterator ii, ii_end;
+	boost::tie(ii, ii_end) = in_edges(reverseComplement(kmer1), g);
+	ASSERT_TRUE(ii != ii_end);
+	EXPECT_TRUE(source(*ii, g) == reverseComplement(kmer2));
+	ii++;
+	EXPECT_TRUE(ii == ii_end);
+
+	EXPECT_EQ(1U, out_degree(kmer1, g));
+	EXPECT_EQ(1U, in_degree(kmer2, g));
+}
@@ -0,0 +1,131 @@
+#include "Bloom/KmerSpectrum.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(KmerSpectrum, value)
+{
+	EXPECT_EQ(KmerSpectrum::value(0), 0U);
+	EXPECT_EQ(KmerSpectrum::value(1), 1U);
+	EXPECT_EQ(KmerSpectrum::value(2), 2U);
+	EXPECT_EQ(KmerSpectrum::value(3), 3U);
+	EXPECT_EQ(KmerSpectrum::value(4), 4U);
+	EXPECT_EQ(KmerSpectrum::value(5), 6U);
+	EXPECT_EQ(KmerSpectrum::value(6), 8U);
+	EXPECT_EQ(KmerSpectrum::value(15), 192U);
+	for (unsigned v = 2; v < KmerSpectrum::MAX_STATE; ++v)
+		EXPECT_EQ(KmerSpectrum::value(v + 1) - KmerSpectrum::value(v),
+				KmerSpectrum::step(v));
+}
+
+TEST(KmerSpectrum, insert)
+{
+	KmerSpectrum x(1000);
+	EXPECT_EQ(x.size(), 2000U);
+
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+	Kmer c("TAATAACAGTCCCTAT");
+	Kmer aRC = a;
+	aRC.reverseComplement();
+
+	EXPECT_EQ(x[a], 0U);
+	x.insert(a);
+	EXPECT_EQ(x[a], 1U);
+	x.insert(aRC);
+	x.insert(a);
+	EXPECT_EQ(x[a], 3U);
+	x.insert(b);
+	EXPECT_EQ(x[b], 1U);
+	EXPECT_EQ(x[c], 0U);
+
+	EXPECT_EQ(x.distinct(), 2U);
+	EXPECT_EQ(x.histogram(1), 1U);
+	EXPECT_EQ(x.histogram(3), 1U);
+
+	Histogram h = x.histogram();
+	EXPECT_EQ(h.size(), 2U);
+	EXPECT_EQ(h.count(1), 1U);
+	EXPECT_EQ(h.count(3), 1U);
+}
+
+TEST(KmerSpectrum, saturate)
+{
+	KmerSpectrum x(8, 2, 1);
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+
+	// The expected number of insertions to saturate is 192.
+	for (unsigned i = 0; i < 5000; ++i)
+		x.insert(a);
+	EXPECT_EQ(x[a], 192U);
+	EXPECT_EQ(x.distinct(), 1U);
+	EXPECT_EQ(x.histogram(KmerSpectrum::MAX_STATE), 1U);
+}
+
+TEST(KmerSpectrum, estimate)
+{
+	// The average of many counts is close to the number of insertions.
+	const unsigned n = 50;
+	const unsigned kmers = 1000;
+	KmerSpectrum x(1 << 20, 1, 7);
+	Kmer::setLength(16);
+	string seq(16, 'A');
+	const char bases[] = "ACGT";
+	double sum = 0;
+	for (unsigned i = 0; i < kmers; ++i) {
+		for (unsigned j = 0; j < 5; ++j)
+			seq[j] = bases[i >> (2 * j) & 3];
+		Kmer kmer(seq);
+		for (unsigned j = 0; j < n; ++j)
+			x.insert(kmer);
+		sum += x[kmer];
+	}
+	EXPECT_NEAR(sum / kmers, n, 0.1 * n);
+	// A k-mer whose cell collides with another is not distinct.
+	EXPECT_NEAR(x.distinct(), kmers, 5);
+}
+
+TEST(KmerSpectrum, concurrent)
+{
+	// Insert the same k-mers from several threads at once. Each
+	// k-mer is moved from one bin of the histogram to the next once
+	// for each state that it rises.
+	const unsigned kmers = 64;
+	KmerSpectrum x(1 << 20, 3, 11);
+	Kmer::setLength(16);
+	vector<Kmer> keys;
+	string seq(16, 'A');
+	const char bases[] = "ACGT";
+	for (unsigned i = 0; i < kmers; ++i) {
+		for (unsigned j = 0; j < 3; ++j)
+			seq[j] = bases[i >> (2 * j) & 3];
+		keys.push_back(Kmer(seq));
+	}
+
+#pragma omp parallel for num_threads(4) schedule(static, 1)
+	for (int t = 0; t < 4; ++t) {
+		for (unsigned n = 0; n < 500; ++n)
+			for (unsigned i = 0; i < kmers; ++i)
+				x.insert(keys[i]);
+	}
+
+	EXPECT_EQ(x.distinct(), kmers);
+	for (unsigned v = 0; v <= KmerSpectrum::MAX_STATE; ++v)
+		EXPECT_LE(x.histogram(v), kmers);
+
+	// Each bin holds the k-mers whose count is the value of its state.
+	vector<size_t> hist(KmerSpectrum::MAX_STATE + 1);
+	for (unsigned i = 0; i < kmers; ++i) {
+		unsigned v = 0;
+		while (KmerSpectrum::value(v) != x[keys[i]])
+			++v;
+		++hist[v];
+	}
+	for (unsigned v = 1; v <= KmerSpectrum::MAX_STATE; ++v)
+		EXPECT_EQ(x.histogram(v), hist[v]);
+}
@@ -0,0 +1,115 @@
+#include "RResolver/SegmentHashes.h"
+
+#include "btllib/bloom_filter.hpp"
+#include "btllib/nthash.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/** Verify that SegmentHashes agrees with the hashes of btllib::NtHash,
+ * so that a change to ntHash in btllib fails this test. */
+
+using namespace std;
+
+static string
+randomSequence(size_t n)
+{
+	static const char BASES[] = "ACGT";
+	string s(n, 'A');
+	for (size_t i = 0; i < n; i++) {
+		s[i] = BASES[rand() % 4];
+	}
+	return s;
+}
+
+/** A small filter, so that about half of its bits are set and most
+ * windows are tested against several hashes. */
+static const size_t BLOOM_BYTES = 1024;
+static const unsigned HASH_NUM = 4;
+static const unsigned K = 25;
+
+TEST(SegmentHashes, kmerHashes)
+{
+	srand(0);
+	for (unsigned i = 0; i < 20; i++) {
+		const string seq = randomSequence(K + rand() % 100);
+		const SegmentHashes hashes(seq);
+		btllib::NtHash nthash(seq, K, HASH_NUM);
+		while (nthash.roll()) {
+			uint64_t fh, rh;
+			hashes.kmerHashes(nthash.get_pos(), K, fh, rh);
+			const uint64_t h = rh < fh ? rh : fh;
+			ASSERT_EQ(nthash.hashes()[0], h) << seq << ' ' << nthash.get_pos();
+			for (unsigned j = 1; j < HASH_NUM; j++) {
+				ASSERT_EQ(nthash.hashes()[j], btllib::nte64(h, K, j));
+			}
+		}
+	}
+}
+
+TEST(SegmentHashes, countConcatenationHits)
+{
+	srand(1);
+	btllib::KmerBloomFilter bloom(BLOOM_BYTES, HASH_NUM, K);
+	for (unsigned i = 0; i < 10; i++) {
+		bloom.insert(randomSequence(200));
+	}
+
+	for (unsigned i = 0; i < 200; i++) {
+		const string left = randomSequence(1 + rand() % 100);
+		const string right = randomSequence(1 + rand() % 100);
+		const string seq = left + right;
+		if (seq.size() < K) {
+			continue;
+		}
+		const size_t start = rand() % (seq.size() - K + 1);
+		const size_t end = start + K + rand() % (seq.size() - start - K + 1);
+		const string window = seq.substr(start, end - start);
+		EXPECT_EQ(
+		    bloom.contains(window),
+		    countConcatenationHits(SegmentHashes(left), SegmentHashes(right), start, end, bloom))
+		    << left << ' ' << right << ' ' << start << ' ' << end;
+	}
+}
+
+TEST(SegmentHashes, insertedHits)
+{
+	srand(2);
+	btllib::KmerBloomFilter bloom(1 << 20, HASH_NUM, K);
+	const string seq = randomSequence(500);
+	bloom.insert(seq);
+	for (unsigned i = 0; i < 20; i++) {
+		const size_t a = rand() % seq.size();
+		const string left = seq.substr(0, a), right = seq.substr(a);
+		EXPECT_EQ(
+		    seq.size() - K + 1,
+		    countConcatenationHits(
+		        SegmentHashes(left), SegmentHashes(right), 0, seq.size(), bloom));
+	}
+}
+
+TEST(SegmentHashes, containsSubstitution)
+{
+	srand(3);
+	btllib::KmerBloomFilter bloom(1 << 20, HASH_NUM, K);
+	const string seq = randomSequence(100);
+	bloom.insert(seq);
+	const SegmentHashes hashes(seq);
+
+	// Substitute one base of each k-mer, and find the k-mer of seq
+	// by substituting it back.
+	for (size_t pos = 0; pos + K <= seq.size(); pos++) {
+		const unsigned p = rand() % K;
+		string mutated = seq;
+		mutated[pos + p] = mutated[pos + p] == 'A' ? 'C' : 'A';
+		const SegmentHashes mutatedHashes(mutated);
+		vector<unsigned> positions(1, p);
+		EXPECT_TRUE(containsSubstitution(mutatedHashes, mutated, pos, positions, bloom));
+		positions.assign(1, (p + 1) % K);
+		EXPECT_EQ(
+		    bloom.contains(mutated.substr(pos, K)) > 0,
+		    containsSubstitution(mutatedHashes, mutated, pos, positions, bloom));
+	}
+}